@@ -94,8 +94,13 @@ int main(int argc, char *argv[])
                     0 // w2
     };
 
+    /* One planning context serves all three queries */
+    struct aa_rx_mp *mp = aa_rx_mp_create( ssg );
+
+    /* Later queries start from the stored paths of earlier ones */
+    struct aa_rx_mp_library *lib = aa_rx_mp_library_create( ssg );
+    aa_rx_mp_set_library( mp, lib, 0 );
     {
-        struct aa_rx_mp *mp = aa_rx_mp_create( ssg );
         /* Enable path simplification */
         aa_rx_mp_set_simplify(mp,1);
 
@@ -133,15 +138,12 @@ int main(int argc, char *argv[])
         // plan
         int r = aa_rx_mp_plan( mp, 5, &g_n_path, &g_path );
         if(r)  check_mp_error(r);
-        aa_rx_mp_destroy(mp);
     }
     aa_rx_mp_seq_append_all(mp_seq, scenegraph, g_n_path, g_path );
 
     // plan again
     {
-        struct aa_rx_mp *mp = aa_rx_mp_create( ssg );
-        mp = aa_rx_mp_create( ssg );
-        aa_rx_mp_set_simplify(mp,1);
+        aa_rx_mp_reset(mp);
 
         assert(g_n_path > 1 );
         double *end = g_path + n_q * (g_n_path-1);
@@ -157,23 +159,26 @@ int main(int argc, char *argv[])
             aa_mem_region_local_pop(e);
             exit(EXIT_FAILURE);
         }
-
-        aa_rx_mp_destroy(mp);
     }
     aa_rx_mp_seq_append_all(mp_seq, scenegraph, g_n_path, g_path );
 
     // plan once again
     {
-        struct aa_rx_mp *mp = aa_rx_mp_create( ssg );
-        aa_rx_mp_set_simplify(mp,1);
+        aa_rx_mp_reset(mp);
 
         aa_rx_mp_set_start( mp, n_q, q0 );
         aa_rx_mp_set_goal( mp, 7, q1 );
 
         int r = aa_rx_mp_plan( mp, 5, &g_n_path, &g_path );
         if(r)  check_mp_error(r);
-        aa_rx_mp_destroy(mp);
     }
+    {
+        const struct aa_rx_mp_library_stats *stats = aa_rx_mp_library_get_stats(lib);
+        printf("Path library: %lu of %lu queries hit, %lu repairs, %.3fs saved\n",
+               stats->n_hits, stats->n_queries, stats->n_repairs, stats->time_saved);
+    }
+    aa_rx_mp_destroy(mp);
+    aa_rx_mp_library_destroy(lib);
     aa_rx_mp_seq_append_all(mp_seq, scenegraph, g_n_path, g_path );
 
 
@@ -0,0 +1,177 @@
+/* -*- mode: C; c-basic-offset: 4; -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2016, Rice University
+ * All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of copyright holder the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef AMINO_CT_STREAM_H
+#define AMINO_CT_STREAM_H
+
+#include "traj.h"
+
+/**
+ * @file stream.h
+ *
+ * Fixed-rate setpoint streaming for real-time controllers.
+ *
+ * A producer thread samples segment lists ahead of time into a
+ * lock-free ring of setpoints at a fixed period.  A consumer thread,
+ * typically a joint controller, pops one setpoint per tick without
+ * locks, allocation, or segment evaluation.  Setpoints are indexed by
+ * tick, where tick i is at time i*dt from the start of the stream.
+ *
+ * There must be exactly one producer thread and one consumer thread.
+ * Only the producer touches segment lists, which must remain valid
+ * until replaced by a later splice.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Opaque structure for a setpoint stream.
+ */
+struct aa_ct_stream;
+
+/**
+ * Create a setpoint stream.
+ *
+ * @param n_q      Number of configurations per setpoint
+ * @param capacity Maximum number of buffered setpoints
+ * @param dt       Period between setpoints
+ *
+ * @return The new stream, or NULL if capacity is zero or dt is not
+ * positive.
+ */
+AA_API struct aa_ct_stream *
+aa_ct_stream_create( size_t n_q, size_t capacity, double dt );
+
+/**
+ * Destroy a setpoint stream.
+ */
+AA_API void
+aa_ct_stream_destroy( struct aa_ct_stream *stream );
+
+/**
+ * Return the setpoint period.
+ */
+AA_API double
+aa_ct_stream_dt( const struct aa_ct_stream *stream );
+
+/**
+ * Return the tick of the next setpoint the consumer will pop.
+ *
+ * Either thread may call this function.
+ */
+AA_API uint64_t
+aa_ct_stream_read_tick( const struct aa_ct_stream *stream );
+
+/*-- Producer --*/
+
+/**
+ * Return the tick of the next setpoint the producer will fill.
+ */
+AA_API uint64_t
+aa_ct_stream_write_tick( const struct aa_ct_stream *stream );
+
+/**
+ * Switch to a new trajectory at a tick.
+ *
+ * The setpoint at the tick is the start of segs, and later setpoints
+ * follow segs.  After the end of segs, the stream holds its final
+ * configuration.
+ *
+ * The first trajectory of a stream should start at
+ * aa_ct_stream_write_tick(), since no setpoints are filled before it.
+ *
+ * When the tick is already filled, the buffered setpoints from the
+ * tick on are replaced atomically: the consumer either pops every
+ * setpoint before the tick from the old trajectory and every later
+ * setpoint from segs, or, if it has already popped the tick, the splice
+ * fails and the stream is unchanged.
+ *
+ * @param stream The stream
+ * @param segs   The new trajectory, with the stream's configuration count
+ * @param tick   Tick at which to start segs
+ *
+ * @return 0 on success, or -1 if the consumer already passed the tick,
+ * the configuration count differs, or the tick is already filled and
+ * segs cannot be evaluated at its start.
+ */
+AA_API int
+aa_ct_stream_splice( struct aa_ct_stream *stream,
+                     const struct aa_ct_seg_list *segs,
+                     uint64_t tick );
+
+/**
+ * Sample the trajectory into free setpoint slots.
+ *
+ * Filling stops at the first tick where the trajectory cannot be
+ * evaluated, such as a gap between its segments.  No setpoint is
+ * published for that tick, so the consumer runs dry there until a
+ * splice replaces the trajectory.
+ *
+ * @param stream The stream
+ * @param max_n  Maximum number of setpoints to fill, or 0 to fill all
+ *               free slots
+ *
+ * @return The number of setpoints filled.
+ */
+AA_API size_t
+aa_ct_stream_fill( struct aa_ct_stream *stream, size_t max_n );
+
+/*-- Consumer --*/
+
+/**
+ * Pop the next setpoint.
+ *
+ * This function does not block and runs in bounded time.
+ *
+ * @param stream The stream
+ * @param tick   Output tick of the setpoint, may be NULL
+ * @param q      Output configuration, may be NULL
+ * @param dq     Output velocity, may be NULL
+ * @param ddq    Output acceleration, may be NULL
+ *
+ * @return 0 on success, or -1 if the next setpoint is not yet
+ * available.
+ */
+AA_API int
+aa_ct_stream_pop( struct aa_ct_stream *stream, uint64_t *tick,
+                  double *q, double *dq, double *ddq );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AMINO_CT_STREAM_H */
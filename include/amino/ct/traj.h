@@ -53,6 +53,8 @@ extern "C" {
 
 #define AA_CT_LIN_SEG  1
 #define AA_CT_PB_SEG   2
+#define AA_CT_TOPP_SEG 3
+#define AA_CT_QUINTIC_SEG 4
 
 /**
  * Waypoint. For use in aa_ct_pt_list.
@@ -142,24 +144,66 @@ void aa_ct_pt_list_dump(FILE *stream, struct aa_ct_pt_list *list);
  * Evaluates a segment list at a given time. Fills in the provided state struct
  * With the reference state at that time.
  *
+ * The segment containing t is found by binary search over the segment start
+ * times, so times may be evaluated in any order.  Evaluation does not modify
+ * the list, and multiple threads may evaluate the same list concurrently.
+ *
  * @param list  Segment list to evaluate
  * @param state State structure to fill in
  * @param t     Time to evaluate segment list at
  *
  * @return AA_CT_SEG_IN if time is within segment list, AA_CT_SEG_OUT if not.
  */
-int aa_ct_seg_list_eval(struct aa_ct_seg_list *list, struct aa_ct_state *state,
+int aa_ct_seg_list_eval(const struct aa_ct_seg_list *list, struct aa_ct_state *state,
                         double t);
 
+/**
+ * Evaluates a segment list at a given time, starting the search from a hint.
+ *
+ * The hint is the index of the segment that contained the previous time.
+ * When times are evaluated in increasing order, the segment is usually the
+ * hinted one or its successor and is found in constant time.  Otherwise, this
+ * function falls back to binary search.
+ *
+ * @param list  Segment list to evaluate
+ * @param state State structure to fill in
+ * @param t     Time to evaluate segment list at
+ * @param hint  Segment index hint, updated on return; initialize to 0
+ *
+ * @return AA_CT_SEG_IN if time is within segment list, AA_CT_SEG_OUT if not.
+ */
+int aa_ct_seg_list_eval_hint(const struct aa_ct_seg_list *list, struct aa_ct_state *state,
+                             double t, size_t *hint);
+
 /**
  * Evaluate trajectory and fill configuration array.
  */
-int aa_ct_seg_list_eval_q(struct aa_ct_seg_list *list, double t, size_t n, double *q);
+int aa_ct_seg_list_eval_q(const struct aa_ct_seg_list *list, double t, size_t n, double *q);
 
 /**
  * Evaluate trajectory and fill configuration and velocity arrays.
  */
-int aa_ct_seg_list_eval_dq(struct aa_ct_seg_list *list, double t, size_t n, double *q, double *dq);
+int aa_ct_seg_list_eval_dq(const struct aa_ct_seg_list *list, double t, size_t n, double *q, double *dq);
+
+/**
+ * Evaluate trajectory configurations at many times.
+ *
+ * Column j of Q is the configuration at time t[j].  Columns for times outside
+ * the trajectory are not modified.  Evaluation is fastest when t is sorted.
+ *
+ * @param list  Segment list to evaluate
+ * @param n_t   Number of times
+ * @param t     Times to evaluate, length n_t
+ * @param n_q   Number of configurations to fill per column
+ * @param Q     Output configurations, n_q x n_t
+ * @param ldQ   Leading dimension of Q
+ *
+ * @return AA_CT_SEG_IN if all times are within the segment list,
+ *         AA_CT_SEG_OUT if not.
+ */
+int aa_ct_seg_list_eval_grid(const struct aa_ct_seg_list *list,
+                             size_t n_t, const double *t,
+                             size_t n_q, double *Q, size_t ldQ);
 
 /**
  * Plots a segment list with a given resolution. Pipes commands to gnuplot.
@@ -214,6 +258,142 @@ struct aa_ct_seg_list *aa_ct_tjq_lin_generate(struct aa_mem_region *reg,
                                               struct aa_ct_pt_list *list,
                                               struct aa_ct_limit *limits);
 
+/**
+ * Generate a quintic spline trajectory from a point list.
+ *
+ * Each pair of consecutive points is joined by a quintic polynomial in
+ * time.  Velocities at interior points follow the neighboring segments
+ * and accelerations at the points are zero, so the trajectory has
+ * continuous acceleration and bounded jerk.  The trajectory starts and
+ * ends at rest.  Segment durations are stretched until the velocity,
+ * acceleration, and jerk limits hold.
+ *
+ * @param reg      Region to allocate from
+ * @param list     Point list to build segment list from
+ * @param limits   State structure with dq and ddq kinematic limits
+ * @param dddq_max Symmetric jerk limits, or NULL for no jerk limit
+ *
+ * @return An allocated segment list describing a quintic spline
+ * trajectory.
+ */
+AA_API struct aa_ct_seg_list *
+aa_ct_tjq_quintic_generate( struct aa_mem_region *reg,
+                            struct aa_ct_pt_list *list,
+                            struct aa_ct_limit *limits,
+                            const double *dddq_max );
+
+/*-- Time-Optimal Path Parameterization --*/
+
+/**
+ * Opaque structure for time-optimal path parameterization options.
+ */
+struct aa_ct_topp_opts;
+
+/**
+ * Create time-optimal path parameterization options with default values.
+ */
+AA_API struct aa_ct_topp_opts *
+aa_ct_topp_opts_create( void );
+
+/**
+ * Destroy time-optimal path parameterization options.
+ */
+AA_API void
+aa_ct_topp_opts_destroy( struct aa_ct_topp_opts *opts );
+
+/**
+ * Set the number of path discretization intervals (default 200).
+ *
+ * Velocity limits hold along the whole trajectory.  Acceleration and
+ * effort limits hold at the grid points and approximately between
+ * them; finer grids reduce the overshoot and give trajectories closer
+ * to the time-optimum.
+ */
+AA_API void
+aa_ct_topp_opts_set_grid( struct aa_ct_topp_opts *opts, size_t n );
+
+/**
+ * Set the path deviation tolerance (default 0).
+ *
+ * With a positive tolerance, the trajectory follows the straight
+ * segments between points and rounds each interior point with a
+ * blend that passes within tol of the point, in the Euclidean norm
+ * of the configuration.  The whole trajectory then stays within tol
+ * of the polyline through the points.
+ *
+ * With a tolerance of zero, the trajectory passes through every
+ * point on a spline between them; see aa_ct_tjq_topp_generate().
+ */
+AA_API void
+aa_ct_topp_opts_set_tolerance( struct aa_ct_topp_opts *opts, double tol );
+
+/**
+ * Joint effort along the path.
+ *
+ * For path position s, the effort is tau = a*dds + b*ds*ds + c, where
+ * ds and dds are the first and second time derivatives of s.  For
+ * rigid body dynamics, a = M(q) q', b = M(q) q'' + C(q,q') q', and c =
+ * g(q), where q' and q'' are the path derivatives of the
+ * configuration.
+ *
+ * @param cx      User context
+ * @param n_q     Number of configurations
+ * @param q       Configuration at s
+ * @param dq_ds   First path derivative of the configuration
+ * @param ddq_ds  Second path derivative of the configuration
+ * @param a       Output coefficient of dds, length n_q
+ * @param b       Output coefficient of ds*ds, length n_q
+ * @param c       Output constant effort, length n_q
+ */
+typedef void aa_ct_topp_dyn_fun( void *cx, size_t n_q, const double *q,
+                                 const double *dq_ds, const double *ddq_ds,
+                                 double *a, double *b, double *c );
+
+/**
+ * Set a function to compute joint effort along the path.
+ *
+ * When set, the effort limits of the aa_ct_limit are also enforced.
+ */
+AA_API void
+aa_ct_topp_opts_set_dynamics( struct aa_ct_topp_opts *opts,
+                              aa_ct_topp_dyn_fun *fun, void *cx );
+
+/**
+ * Generate a time-optimal trajectory from a point list.
+ *
+ * The points are interpolated with a C1 path, and the path is retimed
+ * to the shortest duration that satisfies the velocity, acceleration,
+ * and optionally effort limits, following the TOPP-RA reachability
+ * analysis.  The trajectory starts and ends at rest.  Repeated
+ * points are skipped; if all points coincide, the trajectory rests at
+ * that point with zero duration.
+ *
+ * The trajectory deviates from the straight segments between the
+ * points.  By default, it passes through each point on a cubic spline
+ * that is monotone in each joint between consecutive points, so it
+ * stays within the axis-aligned box spanned by those points but may
+ * leave the segment anywhere within that box.  With
+ * aa_ct_topp_opts_set_tolerance(), it instead follows the segments
+ * and cuts each corner within the given tolerance.  Either way, a
+ * path that was checked for collisions only along its segments must
+ * be rechecked along the returned trajectory, e.g., by sampling it
+ * with aa_ct_seg_list_eval(), or generated with a tolerance that the
+ * collision check allows for.
+ *
+ * @param reg    Region to allocate from
+ * @param list   Point list to build segment list from
+ * @param limits State structure with dq and ddq kinematic limits
+ * @param opts   Options, or NULL for defaults
+ *
+ * @return An allocated segment list, or NULL if the limits cannot be
+ * satisfied.
+ */
+AA_API struct aa_ct_seg_list *
+aa_ct_tjq_topp_generate( struct aa_mem_region *reg,
+                         struct aa_ct_pt_list *list,
+                         struct aa_ct_limit *limits,
+                         const struct aa_ct_topp_opts *opts );
+
 /**
  * Generate a parabolic blend trajectory in the workspace from a point list.
  *
@@ -60,23 +60,56 @@ struct aa_ct_seg {
                 struct aa_ct_state *state, double t); ///< Evaluate function
     struct aa_ct_seg *prev, *next; ///< Links to next and previous segments
     void *cx; ///< Segment context
+    double t0; ///< Start time, NAN if unknown
+    double t1; ///< End time, NAN if unknown
 };
 
 
 /**
- * Add a reference to a segment to a segment list. The reference will be kept in
- * the list.
+ * Append a copy of a segment header to a segment list.
+ *
+ * Headers are stored contiguously in the list's region, in the order
+ * they are added, and the prev/next links are set to the neighboring
+ * stored headers.  Pointers to stored headers remain valid until the
+ * next add unless space was reserved with aa_ct_seg_list_reserve().
  *
  * @param list List to add segment to
- * @param seg  Segment to add to list
+ * @param seg  Segment header to copy into the list
+ *
+ * @return The stored segment header
  */
-void aa_ct_seg_list_add(struct aa_ct_seg_list *list, struct aa_ct_seg *seg);
+struct aa_ct_seg *
+aa_ct_seg_list_add(struct aa_ct_seg_list *list, const struct aa_ct_seg *seg);
 
 
 void aa_ct_seg_list_add_cx( struct aa_ct_seg_list *list,
                             aa_ct_seg_eval_fun eval,
                             void *cx );
 
+/**
+ * Reserve space for segment headers.
+ *
+ * Generators call this before allocating any segment contexts so that
+ * the headers occupy one block of the list's region, followed by the
+ * segment contexts in time order.
+ *
+ * @param list List to reserve space in
+ * @param n    Number of segments
+ */
+void aa_ct_seg_list_reserve( struct aa_ct_seg_list *list, size_t n );
+
+/**
+ * Build the segment time index from the segment start and end times.
+ *
+ * Generators call this once all segment times are final.  If any
+ * segment time is unknown or the start times are not ordered, the
+ * list is left unindexed and evaluation falls back to a linear
+ * search.
+ *
+ * @param list List to index
+ */
+void aa_ct_seg_list_index( struct aa_ct_seg_list *list );
+
 
 #ifdef __cplusplus
 }
@@ -85,40 +118,55 @@ void aa_ct_seg_list_add_cx( struct aa_ct_seg_list *list,
 #ifdef __cplusplus
 
 struct aa_ct_pt_list {
+    typedef amino::RegionVector<struct aa_ct_pt *>::type pt_vector;
+
     struct aa_mem_region reg;
-    amino::RegionList<struct aa_ct_pt *>::allocator alloc; ///< Allocator
-    amino::RegionList<struct aa_ct_pt *>::type list;       ///< List
+    amino::RegionVector<struct aa_ct_pt *>::allocator alloc; ///< Allocator
+    pt_vector list;                                          ///< Points
 
     aa_ct_pt_list(struct aa_mem_region *_reg) : alloc(_reg), list(alloc) {
         aa_mem_region_init(&reg, 512);
     };
 
     ~aa_ct_pt_list(void) {
-        list.~list();
         aa_mem_region_destroy(&reg);
     }
 };
 
+/**
+ * Segment list.
+ *
+ * The segment headers, time index, and segment contexts are all
+ * allocated from the list's region, so evaluating the list in time
+ * order sweeps linearly through memory.
+ */
 struct aa_ct_seg_list {
+    typedef amino::RegionVector<struct aa_ct_seg>::type seg_vector;
+    typedef amino::RegionVector<double>::type time_vector;
+
     struct aa_mem_region reg;
-    amino::RegionList<struct aa_ct_seg *>::allocator alloc;  ///< Allocator
-    amino::RegionList<struct aa_ct_seg *>::type list;        ///< List
-    amino::RegionList<struct aa_ct_seg *>::iterator it;      ///< Iterator
-    int it_on;                                               ///< Iterator init?
+    amino::RegionVector<struct aa_ct_seg>::allocator alloc;   ///< Allocator
+    seg_vector list;                                          ///< Segments
+    amino::RegionVector<double>::allocator t_alloc;           ///< Allocator
+    time_vector t_start;     ///< Segment start times, valid when indexed
+    int indexed;             ///< Is the time index valid?
 
     size_t n_q;
     double duration;
 
-    aa_ct_seg_list(struct aa_mem_region *_reg) :
-        alloc(_reg),
-        list(alloc)
+    aa_ct_seg_list(void) :
+        alloc(&reg),
+        list(alloc),
+        t_alloc(&reg),
+        t_start(t_alloc)
     {
         aa_mem_region_init(&reg, 512);
-        it_on = 0;
+        indexed = 0;
     }
 
+    /* The vectors are destroyed after the region, which is safe
+     * because region deallocation is a no-op. */
     ~aa_ct_seg_list(void) {
-        list.~list();
         aa_mem_region_destroy(&reg);
     }
 };
@@ -631,6 +631,58 @@ AA_API void aa_la_xlsnp( size_t m, size_t n,
                          const double *A, const double *A_star, const double *b,
                          const double *xp, double *x );
 
+/** Deadzone, Damped Pseudo Inverse of a 6 x n matrix.
+ *
+ * Computes the same result as aa_la_dzdpinv() for m=6 using
+ * fixed-size kernels, without heap or memory region allocation.
+ *
+ * \param n cols of A, from 1 to 10
+ * \param s2_min Minimum acceptable value for squared Singular Value
+ * \param A \f$ A \in \Re^6\times\Re^n\f$
+ * \param A_star \f$ A^\ddagger \in \Re^n\times\Re^6\f$
+ *
+ * \return 0 on success, nonzero if n is not supported
+ */
+AA_API int aa_la_d6zdpinv( size_t n, double s2_min, const double *A, double *A_star );
+
+/** Deadzone, Damped Pseudo Inverse of a 6 x n matrix, warm started.
+ *
+ * Computes the same result as aa_la_d6zdpinv(), starting the
+ * eigendecomposition of \f$ A A^T \f$ from the basis of a previous
+ * call.  When A changes little between calls, as in a servo loop,
+ * this needs fewer iterations.
+ *
+ * \param n cols of A, from 1 to 10
+ * \param s2_min Minimum acceptable value for squared Singular Value
+ * \param A \f$ A \in \Re^6\times\Re^n\f$
+ * \param U \f$ U \in \Re^6\times\Re^6\f$, on entry an approximate
+ *          eigenbasis, e.g., the identity for the first call; on
+ *          exit the eigenbasis for A when one was computed
+ * \param A_star \f$ A^\ddagger \in \Re^n\times\Re^6\f$
+ *
+ * \return 0 on success, nonzero if n is not supported
+ */
+AA_API int aa_la_d6zdpinv_warm( size_t n, double s2_min, const double *A,
+                                double *U, double *A_star );
+
+/** Least Squares with Nullspace projection for a 6 x n matrix.
+ *
+ * Computes the same result as aa_la_xlsnp() for m=6 using
+ * fixed-size kernels, without heap or memory region allocation.
+ *
+ * \param n cols in A, from 1 to 10
+ * \param A \f$ A \in \Re^6\times\Re^n \f$
+ * \param A_star \f$ A^* \in \Re^n\times\Re^6 \f$
+ * \param b \f$ b \in \Re^6 \f$
+ * \param xp \f$ x \in \Re^n \f$
+ * \param x \f$ x \in \Re^n \f$
+ *
+ * \return 0 on success, nonzero if n is not supported
+ */
+AA_API int aa_la_d6xlsnp( size_t n,
+                          const double *A, const double *A_star, const double *b,
+                          const double *xp, double *x );
+
 
 
 /** Damped Least Squares with Nullspace projection.
@@ -67,4 +67,31 @@ AA_API int aa_opt_qp_solve_cgal (
     const double *l, const double *u,
     double *x );
 
+/**
+ * Solve a dense, box-constrained quadratic program.
+ *
+ * \f[ \min_x\ \tfrac{1}{2} x^T D x + c^T x
+ *     \quad \mathrm{s.t.}\quad l \leq x \leq u \f]
+ *
+ * Uses a primal active-set method with stack workspace only, intended
+ * for small problems (about ten variables or fewer).
+ *
+ * @param n   number of variables
+ * @param D   symmetric positive definite matrix, n x n
+ * @param ldD leading dimension of D
+ * @param c   linear term, length n
+ * @param l   lower bounds, length n
+ * @param u   upper bounds, length n
+ * @param x   output solution, length n
+ *
+ * @return 0 on success, nonzero if the bounds are inconsistent, D is
+ *         not positive definite, or the iteration limit is reached
+ */
+AA_API int aa_opt_qp_box_dense (
+    size_t n,
+    const double *D, size_t ldD,
+    const double *c,
+    const double *l, const double *u,
+    double *x );
+
 #endif //AMINO_OPT_QP_H
@@ -0,0 +1,353 @@
+/* -*- mode: C; c-basic-offset: 4; -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2016, Rice University
+ * All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of copyright holder the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef AMINO_RX_IK_ANALYTIC_IMPL_H
+#define AMINO_RX_IK_ANALYTIC_IMPL_H
+
+#include "amino.h"
+
+/**
+ * @file ik_analytic_impl.h
+ * @brief Closed-form IK kernels for 6R chains.
+ *
+ * The kernels are static inline so that code generated by
+ * aa_rx_ik_analytic_gen(), which passes a constant parameter struct,
+ * is specialized by the compiler for one chain.
+ *
+ * Parameters are standard Denavit-Hartenberg:
+ *
+ *   A_i = Rz(theta_i) Tz(d_i) Tx(a_i) Rx(alpha_i),
+ *
+ * with theta_i = sign_i*q_i + offset_i.  The end-effector pose is
+ * base * A_1 * ... * A_6 * tool.
+ *
+ * Poses are relative to the scenegraph root, as for the other IK
+ * solvers.  The base therefore includes the transforms above the chain
+ * at the configuration used when the parameters were extracted; see
+ * aa_rx_ik_analytic_cx_create().
+ */
+
+/**
+ * Solvable kinematic structures.
+ */
+enum aa_rx_ik_analytic_kind {
+    /**
+     * No closed-form solution.
+     */
+    AA_RX_IK_ANALYTIC_NONE,
+
+    /**
+     * Perpendicular, intersecting first two axes, parallel second and
+     * third axes, and a spherical wrist (e.g., PUMA-type arms).
+     */
+    AA_RX_IK_ANALYTIC_WRIST,
+
+    /**
+     * Perpendicular, intersecting first two axes, parallel second,
+     * third, and fourth axes, and intersecting fourth, fifth, and
+     * sixth axes pairs (e.g., UR-type arms).
+     */
+    AA_RX_IK_ANALYTIC_PARALLEL
+};
+
+/**
+ * Maximum number of closed-form solutions.
+ */
+#define AA_RX_IK_ANALYTIC_MAX_SOL 8
+
+/**
+ * Parameters of a closed-form solvable 6R chain.
+ */
+struct aa_rx_ik_analytic_param {
+    enum aa_rx_ik_analytic_kind kind; ///< kinematic structure
+    double d[6];       ///< DH offsets along previous z
+    double a[6];       ///< DH lengths along x
+    double alpha[6];   ///< DH twists about x
+    double offset[6];  ///< joint angle offsets
+    double sign[6];    ///< joint axis directions, +1 or -1
+    double base[7];    ///< scenegraph root to DH frame 0, quaternion-translation
+    double tool[7];    ///< DH frame 6 to end-effector, quaternion-translation
+};
+
+/** DH transform, as a 3x4 column-major matrix */
+static inline void
+aa_rx_ik_analytic_dh( double theta, double d, double a, double alpha, double T[12] )
+{
+    double ct = cos(theta), st = sin(theta);
+    double ca = cos(alpha), sa = sin(alpha);
+    T[0] = ct;     T[1] = st;     T[2] = 0;
+    T[3] = -st*ca; T[4] = ct*ca;  T[5] = sa;
+    T[6] = st*sa;  T[7] = -ct*sa; T[8] = ca;
+    T[9] = a*ct;   T[10] = a*st;  T[11] = d;
+}
+
+/** Product of the first n DH transforms */
+static inline void
+aa_rx_ik_analytic_fk( const struct aa_rx_ik_analytic_param *P, size_t n,
+                      const double *theta, double T[12] )
+{
+    double A[12], B[12];
+    aa_rx_ik_analytic_dh( theta[0], P->d[0], P->a[0], P->alpha[0], T );
+    for( size_t i = 1; i < n; i ++ ) {
+        aa_rx_ik_analytic_dh( theta[i], P->d[i], P->a[i], P->alpha[i], A );
+        aa_tf_tfmat_mul( T, A, B );
+        AA_MEM_CPY( T, B, 12 );
+    }
+}
+
+/** Clamp a cosine that is within tolerance of [-1,1] */
+static inline int
+aa_rx_ik_analytic_acos( double c, double *theta )
+{
+    if( c > 1 + 1e-9 || c < -1 - 1e-9 ) return -1;
+    *theta = acos( AA_MAX(-1, AA_MIN(1, c)) );
+    return 0;
+}
+
+/** R = R0^T * R1, for column-major rotation matrices */
+static inline void
+aa_rx_ik_analytic_rimul( const double R0[9], const double R1[9], double R[9] )
+{
+    for( size_t j = 0; j < 3; j ++ ) {
+        for( size_t i = 0; i < 3; i ++ ) {
+            R[3*j + i] = AA_TF_VDOT( R0 + 3*i, R1 + 3*j );
+        }
+    }
+}
+
+static inline double
+aa_rx_ik_analytic_sign( double x )
+{
+    return x < 0 ? -1 : 1;
+}
+
+/**
+ * Solve the wrist joints 4-6 given the rotation R36 from DH frame 3
+ * to frame 6.
+ */
+static inline size_t
+aa_rx_ik_analytic_wrist( const struct aa_rx_ik_analytic_param *P,
+                         const double R36[9], double *theta, size_t ld, double *TH )
+{
+    double s4 = aa_rx_ik_analytic_sign( sin(P->alpha[3]) );
+    double s5 = aa_rx_ik_analytic_sign( sin(P->alpha[4]) );
+    double t5;
+    if( aa_rx_ik_analytic_acos( -s4*s5*R36[8], &t5 ) ) return 0;
+
+    size_t n = 0;
+    for( int i5 = 0; i5 < 2; i5 ++ ) {
+        theta[4] = i5 ? -t5 : t5;
+        double st5 = sin(theta[4]);
+        if( fabs(st5) < 1e-9 ) {
+            /* Singular: keep theta_4, solve theta_6 */
+            double R[9], Rx4[9], Rz5[9], Rx5[9], M[9], N[9];
+            theta[3] = 0;
+            aa_tf_xangle2rotmat( P->alpha[3], Rx4 );
+            aa_tf_zangle2rotmat( theta[4], Rz5 );
+            aa_tf_xangle2rotmat( P->alpha[4], Rx5 );
+            aa_tf_rotmat_mul( Rx4, Rz5, M );
+            aa_tf_rotmat_mul( M, Rx5, N );
+            aa_rx_ik_analytic_rimul( N, R36, R );
+            theta[5] = atan2( R[1], R[0] );
+        } else {
+            theta[3] = atan2( s5*R36[7]/st5, s5*R36[6]/st5 );
+            theta[5] = atan2( -s4*R36[5]/st5, s4*R36[2]/st5 );
+        }
+        AA_MEM_CPY( TH + (n++)*ld, theta, 6 );
+    }
+    return n;
+}
+
+/**
+ * Compute DH joint angles for the pose T06 of DH frame 6 relative to
+ * DH frame 0.
+ *
+ * @return number of candidate solutions written to TH
+ */
+static inline size_t
+aa_rx_ik_analytic_theta( const struct aa_rx_ik_analytic_param *P,
+                         const double T06[12], double *TH, size_t ld )
+{
+    const double *R06 = T06, *p = T06 + 9;
+    double theta[6];
+    size_t n = 0;
+
+    /* theta_1: the wrist lies in a plane at fixed offset along z_1 */
+    double D = ( AA_RX_IK_ANALYTIC_WRIST == P->kind )
+        ? P->d[1] + P->d[2] + P->d[3]*cos(P->alpha[2])
+        : P->d[1] + P->d[2] + P->d[3];
+    D *= aa_rx_ik_analytic_sign( sin(P->alpha[0]) );
+    double r = sqrt( p[0]*p[0] + p[1]*p[1] );
+    if( r < fabs(D) - 1e-9 || r < 1e-12 ) return 0;
+    double psi = atan2( p[1], p[0] );
+    double beta = asin( AA_MAX(-1, AA_MIN(1, D/r)) );
+
+    for( int i1 = 0; i1 < 2; i1 ++ ) {
+        double A1[12], A1_inv[12];
+        theta[0] = i1 ? psi + M_PI - beta : psi + beta;
+        aa_rx_ik_analytic_dh( theta[0], P->d[0], P->a[0], P->alpha[0], A1 );
+        aa_tf_tfmat_inv2( A1, A1_inv );
+
+        if( AA_RX_IK_ANALYTIC_WRIST == P->kind ) {
+            /* planar 2R to the wrist center */
+            double w[3];
+            aa_tf_tfmat_tf( A1_inv, p, w );
+            double L2 = P->a[1];
+            double L3 = sqrt( P->a[2]*P->a[2] +
+                              P->d[3]*P->d[3]*sin(P->alpha[2])*sin(P->alpha[2]) );
+            double b3 = atan2( -P->d[3]*sin(P->alpha[2]), P->a[2] );
+            double g;
+            if( aa_rx_ik_analytic_acos( (w[0]*w[0] + w[1]*w[1] - L2*L2 - L3*L3)/(2*L2*L3),
+                                        &g ) )
+            {
+                continue;
+            }
+            for( int i3 = 0; i3 < 2; i3 ++ ) {
+                double gi = i3 ? -g : g;
+                theta[2] = gi - b3;
+                theta[1] = atan2( w[1], w[0] ) - atan2( L3*sin(gi), L2 + L3*cos(gi) );
+                double T03[12], R36[9];
+                aa_rx_ik_analytic_fk( P, 3, theta, T03 );
+                aa_rx_ik_analytic_rimul( T03, R06, R36 );
+                n += aa_rx_ik_analytic_wrist( P, R36, theta, ld, TH + n*ld );
+            }
+        } else {
+            /* wrist from the parallel axes' normal z_1 */
+            double s4 = aa_rx_ik_analytic_sign( sin(P->alpha[3]) );
+            double s5 = aa_rx_ik_analytic_sign( sin(P->alpha[4]) );
+            const double *z1 = A1 + 6;
+            double t5;
+            if( aa_rx_ik_analytic_acos( -s4*s5*AA_TF_VDOT(R06+6, z1), &t5 ) ) continue;
+            for( int i5 = 0; i5 < 2; i5 ++ ) {
+                theta[4] = i5 ? -t5 : t5;
+                double st5 = sin(theta[4]);
+                theta[5] = ( fabs(st5) < 1e-9 )
+                    ? 0 /* singular */
+                    : atan2( -s4*AA_TF_VDOT(R06+3, z1)/st5,
+                             s4*AA_TF_VDOT(R06, z1)/st5 );
+
+                /* T14 Rx(-alpha_4) = Rz(theta_2+theta_3+theta_4), planar translation */
+                double A5[12], A6[12], T46[12], T46_inv[12], T04[12], T14[12], M[12];
+                aa_rx_ik_analytic_dh( theta[4], P->d[4], P->a[4], P->alpha[4], A5 );
+                aa_rx_ik_analytic_dh( theta[5], P->d[5], P->a[5], P->alpha[5], A6 );
+                aa_tf_tfmat_mul( A5, A6, T46 );
+                aa_tf_tfmat_inv2( T46, T46_inv );
+                aa_tf_tfmat_mul( T06, T46_inv, T04 );
+                aa_tf_tfmat_mul( A1_inv, T04, T14 );
+                double Rx4[12] = {0};
+                aa_tf_xangle2rotmat( -P->alpha[3], Rx4 );
+                aa_tf_tfmat_mul( T14, Rx4, M );
+
+                double phi = atan2( M[1], M[0] );
+                double x = M[9], y = M[10];
+                double a2 = P->a[1], a3 = P->a[2];
+                double g;
+                if( aa_rx_ik_analytic_acos( (x*x + y*y - a2*a2 - a3*a3)/(2*a2*a3), &g ) ) {
+                    continue;
+                }
+                for( int i3 = 0; i3 < 2; i3 ++ ) {
+                    theta[2] = i3 ? -g : g;
+                    theta[1] = atan2( y, x ) - atan2( a3*sin(theta[2]), a2 + a3*cos(theta[2]) );
+                    theta[3] = phi - theta[1] - theta[2];
+                    AA_MEM_CPY( TH + (n++)*ld, theta, 6 );
+                }
+            }
+        }
+    }
+    return n;
+}
+
+/**
+ * Compute all closed-form solutions for end-effector pose E.
+ *
+ * Solutions are checked by forward kinematics and joint angles are
+ * normalized to [-pi, pi].  Joint limits are not considered.
+ *
+ * @param P   chain parameters
+ * @param E   end-effector pose relative to the scenegraph root,
+ *            quaternion-translation
+ * @param Q   output joint configurations, 6 x AA_RX_IK_ANALYTIC_MAX_SOL
+ * @param ldQ leading dimension of Q
+ *
+ * @return the number of solutions
+ */
+static inline size_t
+aa_rx_ik_analytic_kernel( const struct aa_rx_ik_analytic_param *P,
+                          const double E[7], double *Q, size_t ldQ )
+{
+    if( AA_RX_IK_ANALYTIC_NONE == P->kind ) return 0;
+
+    /* Target for DH frame 6 */
+    double E_b[7], E06[7], T06[12];
+    aa_tf_qutr_cmul( P->base, E, E_b );
+    aa_tf_qutr_mulc( E_b, P->tool, E06 );
+    aa_tf_qutr2tfmat( E06, T06 );
+
+    double TH[6*2*AA_RX_IK_ANALYTIC_MAX_SOL];
+    size_t n_th = aa_rx_ik_analytic_theta( P, T06, TH, 6 );
+
+    size_t n = 0;
+    for( size_t k = 0; k < n_th && n < AA_RX_IK_ANALYTIC_MAX_SOL; k ++ ) {
+        const double *theta = TH + 6*k;
+
+        /* Reject spurious candidates */
+        double T[12];
+        aa_rx_ik_analytic_fk( P, 6, theta, T );
+        double err = 0;
+        for( size_t i = 0; i < 12; i ++ ) {
+            err = AA_MAX( err, fabs(T[i] - T06[i]) );
+        }
+        if( err > 1e-6 ) continue;
+
+        double *q = Q + n*ldQ;
+        for( size_t i = 0; i < 6; i ++ ) {
+            q[i] = aa_ang_norm_pi( P->sign[i] * (theta[i] - P->offset[i]) );
+        }
+
+        /* Skip duplicates at singularities */
+        int dup = 0;
+        for( size_t j = 0; !dup && j < n; j ++ ) {
+            double d = 0;
+            for( size_t i = 0; i < 6; i ++ ) {
+                d = AA_MAX( d, fabs(aa_ang_norm_pi(q[i] - Q[j*ldQ + i])) );
+            }
+            dup = d < 1e-9;
+        }
+        if( !dup ) n++;
+    }
+    return n;
+}
+
+#endif /*AMINO_RX_IK_ANALYTIC_IMPL_H*/
@@ -0,0 +1,118 @@
+/* -*- mode: C++; c-basic-offset: 4; -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2015, Rice University
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@rice.edu>
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of copyright holder the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef AMINO_RX_OMPL_SCENE_NATIVE_PATH_H
+#define AMINO_RX_OMPL_SCENE_NATIVE_PATH_H
+
+/**
+ * @file scene_native_path.h
+ * @brief Path post-processing on configuration arrays
+ */
+
+#include <vector>
+
+namespace amino {
+
+/**
+ * Validity callbacks for path post-processing.
+ */
+struct sgPathProblem {
+    void *cx;                   ///< callback context
+    size_t n_threads;           ///< number of threads to use
+
+    /**
+     * Return true if configuration q is valid.
+     *
+     * Calls with different thread indices may run concurrently.
+     */
+    bool (*is_valid)( void *cx, size_t thread, const double *q );
+};
+
+/**
+ * Return the length of a path of n_q-dimensional waypoints.
+ */
+double
+sgPathLength( size_t n_q, const std::vector<double> &path );
+
+/**
+ * Check each segment of a path at the given resolution, spreading
+ * segments across threads.
+ *
+ * @param valid on return, nonzero for each valid segment between
+ * consecutive waypoints
+ *
+ * @return the number of invalid segments
+ */
+size_t
+sgPathCheck( const sgPathProblem *prob, size_t n_q, double resolution,
+             const std::vector<double> &path, std::vector<char> &valid );
+
+/**
+ * Shorten path by replacing sections with straight lines.
+ *
+ * Each round draws a batch of random shortcuts between points along
+ * the path, checks them in parallel at the given resolution, and
+ * applies the non-overlapping valid ones, largest gain first.
+ * Rounds continue until time t_end (see aa_tm_now()) or until
+ * several consecutive rounds make no significant progress.
+ *
+ * @return the number of shortcuts applied
+ */
+size_t
+sgPathShortcut( const sgPathProblem *prob, size_t n_q, double resolution,
+                double t_end, unsigned seed, std::vector<double> &path );
+
+/**
+ * Smooth path in the manner of a B-spline.
+ *
+ * Each step subdivides the path, then moves every other interior
+ * waypoint toward the midpoint of its neighbors when both adjoining
+ * segments remain valid and the waypoint moves by more than
+ * min_change.  Candidates are checked in parallel.  Steps continue
+ * until max_steps, until a step moves no waypoint, or until time
+ * t_end, after which no further candidates are checked.
+ *
+ * @return the number of waypoints moved
+ */
+size_t
+sgPathSmooth( const sgPathProblem *prob, size_t n_q, double resolution,
+              double t_end, size_t max_steps, double min_change,
+              std::vector<double> &path );
+
+} /* namespace amino */
+
+#endif /*AMINO_RX_OMPL_SCENE_NATIVE_PATH_H*/
@@ -0,0 +1,191 @@
+/* -*- mode: C++; c-basic-offset: 4; -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2015, Rice University
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@rice.edu>
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of copyright holder the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef AMINO_RX_OMPL_SCENE_NATIVE_PRM_H
+#define AMINO_RX_OMPL_SCENE_NATIVE_PRM_H
+
+/**
+ * @file scene_native_prm.h
+ * @brief Persistent lazy roadmap planner
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "amino/rx/ompl/scene_native_rrt.h"
+
+namespace amino {
+
+/**
+ * Problem callbacks for the roadmap planner.
+ */
+struct sgRoadmapProblem : public sgNativeProblem {
+    /**
+     * Check q only against the scene changes of the last
+     * invalidation, or NULL to use is_valid.
+     */
+    bool (*is_valid_changed)( void *cx, const double *q );
+
+    /**
+     * Identify the cause of the most recent failed validity check,
+     * or NULL.
+     */
+    uint64_t (*blocker)( void *cx );
+};
+
+/**
+ * Lazy probabilistic roadmap.
+ *
+ * Nodes are connected to their nearest neighbors without checking
+ * validity.  Nodes and edges are checked only when they lie on a
+ * candidate path, and the results are kept for later queries.
+ * Invalid nodes and edges record a blocker identifying the cause, so
+ * that scene changes need only reopen the ones they affect.
+ */
+class sgLazyPRM {
+public:
+    enum Validity {
+        UNKNOWN = 0,            ///< not yet checked
+        VALID = 1,              ///< valid
+        INVALID = 2,            ///< invalid
+        STALE = 3               ///< valid before the last scene change
+    };
+
+    sgLazyPRM( size_t n_q, const double *lo, const double *hi );
+
+    ~sgLazyPRM();
+
+    void set_seed( unsigned seed );
+
+    /** Number of neighbors to connect to new nodes. */
+    void set_neighbors( size_t k ) { this->k = k; }
+
+    /** Step size for checking edges. */
+    void set_resolution( double resolution ) { this->resolution = resolution; }
+
+    size_t config_count() const { return n_q; }
+    size_t node_count() const { return tree.size(); }
+    size_t edge_count() const { return edges.size(); }
+
+    /** Add a node at q, connected to its nearest neighbors. */
+    size_t add_node( const double *q );
+
+    /** Add n uniformly sampled nodes. */
+    void grow( size_t n );
+
+    /**
+     * Search for a path, growing the roadmap as needed.
+     *
+     * Start and goal configurations are added to the roadmap.
+     *
+     * @return 0 on success, nonzero if no path was found before the
+     * timeout
+     */
+    int solve( const sgRoadmapProblem *prob, double timeout,
+               std::vector<double> &path );
+
+    /**
+     * Update validity after a scene change.
+     *
+     * Valid nodes and edges become STALE, and previously stale ones
+     * become UNKNOWN.  Invalid nodes and edges become UNKNOWN when
+     * affected(cx, blocker) is true.
+     */
+    void invalidate( bool (*affected)(void *cx, uint64_t blocker), void *cx );
+
+    /**
+     * Update validity after a change that can only remove
+     * collisions, such as allowing more collisions.
+     *
+     * Invalid nodes and edges become UNKNOWN when affected(cx,
+     * blocker) is true.
+     */
+    void reopen_invalid( bool (*affected)(void *cx, uint64_t blocker), void *cx );
+
+    /** Mark all nodes and edges as unchecked. */
+    void invalidate_all();
+
+    /** Write the roadmap and its validity. */
+    int write( FILE *out ) const;
+
+    /**
+     * Read a roadmap of n_q-dimensional configurations, or return
+     * NULL on error or if the file has a different dimension.
+     */
+    static sgLazyPRM *read( FILE *in, size_t n_q, const double *lo, const double *hi );
+
+private:
+    struct Edge {
+        size_t a, b;
+        double length;
+        uint64_t blocker;
+        uint8_t validity;
+    };
+
+    struct Node {
+        std::vector<size_t> edges;
+        uint64_t blocker;
+        uint8_t validity;
+    };
+
+    size_t find_or_add( const double *q );
+    bool search( const std::vector<size_t> &starts,
+                 const std::vector<size_t> &goals,
+                 std::vector<size_t> &path_edges, size_t *i_start );
+    bool check_node( size_t i );
+    bool check_edge( size_t i );
+    bool check_config( const double *q, bool stale, uint64_t *blocker );
+    void add_edge( size_t a, size_t b, double length );
+
+    size_t n_q;
+    size_t k;
+    double resolution;
+    unsigned short xsubi[3];
+
+    const sgRoadmapProblem *prob;
+
+    struct aa_mem_region reg;
+    double *lo, *hi;
+    double *q_a, *q_b, *q_tmp;
+    sgNNTree tree;
+    std::vector<Node> nodes;
+    std::vector<Edge> edges;
+};
+
+} /* namespace amino */
+
+#endif /*AMINO_RX_OMPL_SCENE_NATIVE_PRM_H*/
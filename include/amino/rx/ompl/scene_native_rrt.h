@@ -0,0 +1,201 @@
+/* -*- mode: C++; c-basic-offset: 4; -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2015, Rice University
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@rice.edu>
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of copyright holder the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef AMINO_RX_OMPL_SCENE_NATIVE_RRT_H
+#define AMINO_RX_OMPL_SCENE_NATIVE_RRT_H
+
+/**
+ * @file scene_native_rrt.h
+ * @brief Native RRT-Connect planner
+ *
+ * The planner works directly on arrays of sub-scenegraph
+ * configurations, without OMPL states.
+ */
+
+#include <vector>
+
+#include "amino/mem.h"
+
+namespace amino {
+
+/**
+ * Problem callbacks for the native planners.
+ */
+struct sgNativeProblem {
+    void *cx;                   ///< callback context
+
+    /**
+     * Return true if sub-scenegraph configuration q is valid.
+     */
+    bool (*is_valid)( void *cx, const double *q );
+
+    /**
+     * Fetch the next goal configuration into q.
+     *
+     * Return 1 if a goal was stored, 0 if none is available yet, or
+     * -1 if no more goals will become available.
+     */
+    int (*next_goal)( void *cx, double *q );
+
+    /**
+     * Return true to stop the search early, or NULL to run until the
+     * timeout.
+     */
+    bool (*is_cancelled)( void *cx );
+
+    size_t n_start;             ///< number of start configurations
+    const double *start;        ///< start configurations, n_q x n_start
+};
+
+/**
+ * Tree of configurations with nearest-neighbor search.
+ *
+ * Nodes are stored in fixed-size chunks allocated from a memory
+ * region.  Within a chunk, nodes are grouped into blocks of LANES
+ * nodes with configurations stored dimension-major, so that
+ * distances to all nodes of a block are computed with vector
+ * operations.
+ *
+ * There is no spatial index: nearest() and nearest_k() are an
+ * exhaustive scan over all blocks, linear in the number of nodes.
+ * This suits the tree sizes of single queries; large roadmaps
+ * should prefer fewer, better-placed nodes.
+ */
+class sgNNTree {
+public:
+    static const size_t LANES = 4;
+    static const size_t CHUNK_BLOCKS = 64;
+    static const size_t NONE = (size_t)-1;
+
+    sgNNTree( size_t n_q, struct aa_mem_region *reg );
+
+    /** Remove all nodes, keeping allocated chunks for reuse. */
+    void clear() { n_nodes = 0; }
+
+    size_t size() const { return n_nodes; }
+
+    /** Add configuration q with the given parent, returning its index. */
+    size_t add( const double *q, size_t parent );
+
+    /** Index of the node nearest q, and its squared distance, by a
+     *  linear scan over all blocks. */
+    size_t nearest( const double *q, double *d2 ) const;
+
+    /**
+     * Find up to k nodes nearest q, in order of increasing distance,
+     * by a linear scan over all blocks.
+     *
+     * @return the number of nodes found
+     */
+    size_t nearest_k( const double *q, size_t k, size_t *idx, double *d2 ) const;
+
+    /** Copy configuration of node i into q. */
+    void get( size_t i, double *q ) const;
+
+    size_t parent( size_t i ) const;
+
+private:
+    struct Chunk {
+        double *q;              ///< CHUNK_BLOCKS blocks of n_q x LANES
+        size_t *parent;
+    };
+
+    static const size_t CHUNK_NODES = LANES*CHUNK_BLOCKS;
+
+    const double *block( size_t i ) const {
+        return chunks[i / CHUNK_NODES].q + ((i % CHUNK_NODES) / LANES) * n_q * LANES;
+    }
+
+    size_t n_q;
+    size_t n_nodes;
+    struct aa_mem_region *reg;
+    std::vector<Chunk> chunks;
+};
+
+/**
+ * Bidirectional RRT (RRT-Connect) over a box of configurations.
+ */
+class sgRRTConnect {
+public:
+    /**
+     * Create a planner for configurations within [lo,hi].
+     *
+     * The step size defaults to 0.2 and the collision checking
+     * resolution to 0.01 of the box diagonal.
+     */
+    sgRRTConnect( size_t n_q, const double *lo, const double *hi );
+
+    ~sgRRTConnect();
+
+    void set_range( double range ) { this->range = range; }
+
+    void set_seed( unsigned seed );
+
+    /**
+     * Search for a path.
+     *
+     * @param path on success, the path configurations, n_q per waypoint
+     *
+     * @return 0 on success, nonzero if no path was found before the
+     * timeout
+     */
+    int solve( const sgNativeProblem *prob, double timeout,
+               std::vector<double> &path );
+
+private:
+    enum Status { TRAPPED, ADVANCED, REACHED };
+
+    Status extend( sgNNTree &tree, const double *q_target, size_t *i_new );
+    bool check_motion( const double *q0, const double *q1 );
+    void sample( double *q );
+
+    size_t n_q;
+    double range;
+    double resolution;
+    unsigned short xsubi[3];
+
+    const sgNativeProblem *prob;
+
+    struct aa_mem_region reg;
+    double *lo, *hi;
+    double *q_near, *q_new, *q_tmp, *q_rand, *q_conn;
+    sgNNTree tree_start, tree_goal;
+};
+
+} /* namespace amino */
+
+#endif /*AMINO_RX_OMPL_SCENE_NATIVE_RRT_H*/
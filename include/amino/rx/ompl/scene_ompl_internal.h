@@ -56,18 +56,31 @@
 #include <ompl/base/Planner.h>
 
 #include "scene_ompl.h"
+#include "scene_native_path.h"
+
+#include <atomic>
 
 namespace amino {
 class sgStateValidityChecker;
 class sgWorkspaceGoal;
+class sgRRTConnect;
+struct sgNativeProblem;
 }
 
+struct aa_rx_mp_roadmap;
+struct aa_rx_mp_library;
+struct aa_rx_mp_parallel;
+struct aa_rx_mp_path_checker;
+
 
 /* Forward Declaration */
 namespace ompl {
 namespace base {
 class GoalLazySamples;
 }
+namespace geometric {
+class PathGeometric;
+}
 }
 
 struct aa_rx_mp {
@@ -77,8 +90,14 @@ struct aa_rx_mp {
 
     void set_planner( ompl::base::Planner *p ) {
         this->planner.reset(p);
+        set_native(NULL);
+        set_roadmap(NULL);
     }
 
+    void set_native( amino::sgRRTConnect *p );
+
+    void set_roadmap( struct aa_rx_mp_roadmap *p );
+
     amino::sgSpaceInformation::Ptr space_information;
     ompl::base::ProblemDefinitionPtr problem_definition;
 
@@ -86,15 +105,165 @@ struct aa_rx_mp {
 
     ompl::base::PlannerPtr planner;
 
+    /* Native planner, used instead of `planner' when non-null */
+    amino::sgRRTConnect *native_rrt;
+
+    /* Persistent roadmap, used instead of `planner' when non-null */
+    struct aa_rx_mp_roadmap *roadmap;
+
+    /* Per-thread state of aa_rx_mp_plan_parallel(), kept across calls */
+    struct aa_rx_mp_parallel *parallel;
+
     double *config_start;
 
     amino::sgWorkspaceGoal *lazy_samples;
+    size_t wsg_threads;
+    double wsg_min_dist;
+
+    aa_rx_ik_fun *ik_fun;
+    void *ik_context;
+
+    const struct aa_rx_reach_map *reach_map;
 
     struct aa_rx_cl_set *collisions;
 
-    unsigned simplify : 1;
+    double pp_budget;
+    size_t pp_threads;
+    struct aa_rx_mp_pp_stats pp_stats;
+
+    /* Path checkers for post-processing and repair, kept across calls */
+    struct aa_rx_mp_path_checker *pp_checker;
+
+    /* Stored paths to retrieve and repair, not owned */
+    struct aa_rx_mp_library *library;
+    size_t library_candidates;
+
+    /* Set from any thread to stop planning early */
+    std::atomic<bool> cancelled;
+
+    /* Receives intermediate solutions of anytime planners */
+    aa_rx_mp_solution_fun *solution_fun;
+    void *solution_cx;
+
     unsigned track_collisions : 1;
 
 };
 
+/**
+ * Destroy a persistent roadmap.
+ */
+void
+aa_rx_mp_roadmap_destroy( struct aa_rx_mp_roadmap *rm );
+
+/**
+ * Destroy the per-thread state of parallel planning.
+ */
+void
+aa_rx_mp_parallel_destroy( struct aa_rx_mp_parallel *par );
+
+/**
+ * Search the persistent roadmap, after updating it for scene changes.
+ */
+int
+aa_rx_mp_roadmap_solve( struct aa_rx_mp_roadmap *rm,
+                        const amino::sgNativeProblem *prob,
+                        double timeout, std::vector<double> &path );
+
+/**
+ * Solve the problem pdef with the context's planner.
+ *
+ * @return 0 on success, nonzero if no path was found before the
+ * timeout
+ */
+int
+aa_rx_mp_solve( struct aa_rx_mp *mp, const ompl::base::ProblemDefinitionPtr &pdef,
+                double timeout, ompl::geometric::PathGeometric &path );
+
+/**
+ * Plan as aa_rx_mp_plan(), but keep a pending cancellation.
+ *
+ * Planning jobs use this so that a cancellation requested before the
+ * job's thread starts still applies.
+ */
+int
+aa_rx_mp_plan_run( struct aa_rx_mp *mp, double timeout,
+                   size_t *n_path, double **p_path_all );
+
+/**
+ * Solve the context's problem by repairing stored paths.
+ *
+ * @return 0 on success, nonzero if no stored path could be repaired
+ */
+int
+aa_rx_mp_library_solve( struct aa_rx_mp_library *lib, struct aa_rx_mp *mp,
+                        double timeout, ompl::geometric::PathGeometric &path );
+
+/**
+ * Record the outcome of a query, storing its path when path is
+ * non-null.
+ */
+void
+aa_rx_mp_library_record( struct aa_rx_mp_library *lib,
+                         const ompl::geometric::PathGeometric *path,
+                         int hit, double time );
+
+/**
+ * Collision checkers for validating paths from several threads.
+ */
+struct aa_rx_mp_path_checker {
+    /**
+     * Create checkers for n_threads threads, or one per processor
+     * when n_threads is 0.
+     */
+    aa_rx_mp_path_checker( struct aa_rx_mp *mp, size_t n_threads );
+
+    ~aa_rx_mp_path_checker();
+
+    /**
+     * Take the allowed collisions and the configuration outside the
+     * sub-scenegraph from mp.
+     */
+    void update( struct aa_rx_mp *mp );
+
+    amino::sgPathProblem problem;   ///< callbacks for the path functions
+    double resolution;              ///< motion checking resolution
+    size_t n_threads;               ///< thread count requested at creation
+    uint64_t geom_version;          ///< scene geometry version at creation
+
+private:
+    struct thread {
+        struct aa_rx_cl *cl;
+        std::vector<double> q_all;
+        std::vector<double> TF_abs;
+    };
+
+    static bool is_valid( void *cx, size_t thread, const double *q );
+
+    amino::sgStateSpace *ss;
+    std::vector<thread> threads;
+};
+
+/**
+ * Return the path checkers of mp, updated for the current query.
+ *
+ * The checkers are created on first use and rebuilt only when the
+ * post-processing thread count or the scene geometry changes.
+ */
+struct aa_rx_mp_path_checker *
+aa_rx_mp_get_path_checker( struct aa_rx_mp *mp );
+
+/**
+ * Post-process a planned path.
+ */
+void
+aa_rx_mp_path_cleanup( struct aa_rx_mp *mp, ompl::geometric::PathGeometric &path );
+
+/**
+ * Copy a planned path into a newly allocated array of full
+ * scenegraph configurations.
+ */
+void
+aa_rx_mp_path_output( struct aa_rx_mp *mp, ompl::geometric::PathGeometric &path,
+                      size_t *n_path, double **p_path_all );
+
 #endif /*AMINO_RX_SCENE_OMPL_INTERNAL_H*/
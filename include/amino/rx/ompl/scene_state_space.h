@@ -50,6 +50,8 @@
 #include "amino/rx/scene_collision.h"
 #include "amino/rx/scene_planning.h"
 
+#include <vector>
+
 #include <ompl/base/spaces/RealVectorStateSpace.h>
 #include <ompl/base/spaces/RealVectorBounds.h>
 #include <ompl/base/TypedSpaceInformation.h>
@@ -114,6 +116,14 @@ public:
         aa_rx_sg_get_collision(scene_graph, config_count_all(), q, allowed);
     }
 
+    /**
+     * Restore the allowed collisions to those of the scene graph.
+     */
+    void reset_allowed() {
+        aa_rx_cl_set_clear(allowed);
+        aa_rx_sg_cl_set_copy(scene_graph, allowed);
+    }
+
     /**
      * Retrieve the sub-scenegraph configuration `q_set' from the full
      * scenegraph array `q_all'.
@@ -142,6 +152,40 @@ public:
         std::copy( q_set, q_set + config_count_subset(), state->values );
     }
 
+    /**
+     * Compute absolute transforms of all frames into TF_abs.
+     *
+     * Frames that the sub-scenegraph cannot move are copied from the
+     * transforms computed by set_static() when q_all matches its
+     * configuration, and are otherwise computed in full.  The cache
+     * is only read, so concurrent calls take no lock.
+     *
+     * @param q_set  Sub-scenegraph configuration
+     * @param q_all  Full configuration, supplying the remaining variables
+     * @param TF_abs Output array of 7*frame_count() transforms
+     */
+    void tf_abs( const double *q_set, const double *q_all, double *TF_abs );
+
+    /**
+     * Compute the transforms of frames the sub-scenegraph cannot move
+     * at configuration q_all.
+     *
+     * Call once per query, before any concurrent calls to tf_abs().
+     */
+    void set_static( const double *q_all );
+
+    /**
+     * Restrict collision context cl to re-pose only the moving frames.
+     *
+     * Call again whenever the variables outside the sub-scenegraph
+     * change.
+     */
+    void set_moving( struct aa_rx_cl *cl ) const {
+        aa_rx_cl_set_moving( cl, moving_frames.size(), moving_frames.data() );
+    }
+
+    double * get_tf_abs( const double *q_set, const double *q_all );
+
     double * get_tf_abs( const ompl::base::State *state, const double *q_all );
 
     double * get_tf_abs( const ompl::base::State *state);
@@ -154,6 +198,20 @@ public:
     const aa_rx_sg_sub *sub_scene_graph;
     struct aa_rx_cl_set *allowed;
     struct aa_mem_region reg;
+
+    /** Frames moved by the sub-scenegraph configuration, parents first */
+    std::vector<aa_rx_frame_id> moving_frames;
+
+private:
+    /* Variables outside the sub-scenegraph */
+    std::vector<aa_rx_config_id> static_configs;
+
+    /* Values of static_configs for which static_tf is valid */
+    std::vector<double> static_q;
+
+    /* Absolute transforms of all frames at static_q */
+    std::vector<double> static_tf;
+    bool static_valid;
 };
 
 typedef ::ompl::base::TypedSpaceInformation<amino::sgStateSpace> sgSpaceInformation;
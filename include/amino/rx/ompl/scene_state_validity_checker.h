@@ -66,11 +66,23 @@ public:
     ~sgStateValidityChecker() ;
 
     virtual bool isValid(const ompl::base::State *state_) const ;
+
+    /**
+     * Check validity of sub-scenegraph configuration q_set.
+     */
+    bool is_valid_config(const double *q_set) const ;
+
     double *q_all;
 
     void set_start( size_t n_q, double *q_all);
     void allow( );
 
+    /**
+     * Replace the allowed collisions with those of the state space,
+     * dropping pairs allowed earlier.
+     */
+    void reset_allowed( );
+
     mutable std::mutex mutex;
     struct aa_rx_cl *cl;
 
@@ -55,6 +55,8 @@
 
 namespace amino {
 
+struct sgGoalPool;
+
 class sgWorkspaceGoal : public ompl::base::GoalLazySamples {
 public:
     sgWorkspaceGoal (const sgSpaceInformation::Ptr &si,
@@ -67,6 +69,10 @@ public:
     struct aa_rx_ksol_opts *ko;
     struct aa_rx_ik_jac_cx *ik_cx;
 
+    /** IK function for sampling, or NULL to use ik_cx */
+    aa_rx_ik_fun *ik_fun;
+    void *ik_fun_cx;
+
     ompl::base::StateSamplerPtr state_sampler;
     sgSpaceInformation::StateType *seed;
 
@@ -74,6 +80,25 @@ public:
 
     void setStart(size_t n_all, double *q);
 
+    /**
+     * Start sampling.
+     *
+     * Hides GoalLazySamples::startSampling() to re-arm the pool after
+     * stopSampling().
+     */
+    void startSampling();
+
+    /**
+     * Stop sampling, including any pool workers.
+     *
+     * Hides GoalLazySamples::stopSampling(), which does not know
+     * about the pool.
+     */
+    void stopSampling();
+
+    /** Remove sampled goals and forget them for deduplication */
+    virtual void clear();
+
     /** number of goal frames */
     size_t n_e;
 
@@ -90,6 +115,37 @@ public:
 
     /** Weighting of translation error in distance computation */
     double weight_translation;
+
+    /**
+     * Number of IK sampling workers, or 0 for one per processor.
+     *
+     * With one worker, or with ik_fun set, goals are sampled on the
+     * OMPL sampling thread.
+     */
+    size_t n_threads;
+
+    /**
+     * Minimum configuration distance between pooled goal samples.
+     *
+     * Only recent goals are compared, so a goal close to one sampled
+     * long before may still be returned.
+     */
+    double min_dist;
+
+    /**
+     * Reachability map to bias IK seeds, or NULL.
+     *
+     * The map is sampled, so a goal in an unreached cell may still be
+     * reachable.  It only ranks candidate seeds and never rejects a
+     * goal.
+     */
+    const struct aa_rx_reach_map *reach_map;
+
+    /** Index of the goal for the map's frame, or n_e if none */
+    size_t reach_goal;
+
+    /** Worker pool, created on first use */
+    sgGoalPool *pool;
 };
 
 }
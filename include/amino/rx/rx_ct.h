@@ -82,4 +82,121 @@ AA_API struct aa_ct_limit *
 aa_rx_ct_sg_limits( struct aa_mem_region *region, const struct aa_rx_sg *sg );
 
 
+/*-- Trajectory Optimization --*/
+
+/**
+ * Opaque structure for trajectory optimization options.
+ */
+struct aa_rx_ct_opt_opts;
+
+/**
+ * Create trajectory optimization options with default values.
+ */
+AA_API struct aa_rx_ct_opt_opts *
+aa_rx_ct_opt_opts_create( void );
+
+/**
+ * Destroy trajectory optimization options.
+ */
+AA_API void
+aa_rx_ct_opt_opts_destroy( struct aa_rx_ct_opt_opts *opts );
+
+/**
+ * Set the number of waypoints, including start and goal (default 32).
+ */
+AA_API void
+aa_rx_ct_opt_opts_set_waypoints( struct aa_rx_ct_opt_opts *opts, size_t n );
+
+/**
+ * Set the maximum number of iterations (default 200).
+ */
+AA_API void
+aa_rx_ct_opt_opts_set_iterations( struct aa_rx_ct_opt_opts *opts, size_t n );
+
+/**
+ * Set the obstacle clearance, in meters, below which obstacle cost
+ * applies (default 0.05).
+ */
+AA_API void
+aa_rx_ct_opt_opts_set_clearance( struct aa_rx_ct_opt_opts *opts, double clearance );
+
+/**
+ * Set the weights of the smoothness and obstacle costs (default 1 and
+ * 1e4).
+ *
+ * Smoothness is the integral of squared acceleration and the obstacle
+ * cost is the integral of penetration, both over a unit duration.
+ */
+AA_API void
+aa_rx_ct_opt_opts_set_weights( struct aa_rx_ct_opt_opts *opts,
+                               double smooth, double obstacle );
+
+/**
+ * Set the step size, as a fraction of the preconditioned gradient
+ * (default 1), and the largest change of any variable in one
+ * iteration (default 0.1).
+ */
+AA_API void
+aa_rx_ct_opt_opts_set_step( struct aa_rx_ct_opt_opts *opts,
+                            double step, double max_step );
+
+/**
+ * Set the number of threads, or 0 for one per processor (default 0).
+ */
+AA_API void
+aa_rx_ct_opt_opts_set_threads( struct aa_rx_ct_opt_opts *opts, size_t n_threads );
+
+/**
+ * Optimize a joint-space trajectory for smoothness and obstacle
+ * clearance.
+ *
+ * The optimizer follows CHOMP: it descends a cost of squared joint
+ * accelerations plus obstacle penetration, preconditioning each step
+ * by the banded acceleration metric so that updates stay smooth, and
+ * backtracking when a step does not reduce the cost.
+ * Obstacle cost is computed on spheres covering the collision
+ * geometry of frames that the sub-scenegraph moves, against the
+ * analytic signed distance of all other collision geometry, and
+ * mapped to joint space through the frame Jacobians.  Waypoints are
+ * evaluated in parallel.  The start and goal are fixed, and
+ * intermediate waypoints are kept within position limits.
+ *
+ * Collisions allowed in the scene graph are ignored.  A pair already
+ * in contact at the start or goal is excused only near that endpoint:
+ * the allowance fades to zero as the covering sphere moves away by
+ * its radius plus its penetration and the clearance.  Collisions
+ * between moving frames are not considered.
+ *
+ * Clearance is evaluated only at the waypoints, not between them.
+ * Use enough waypoints that consecutive ones are closer than the
+ * clearance, or check the resulting trajectory separately.
+ *
+ * The initial trajectory may be the output of aa_rx_mp_plan(), for
+ * refinement, or only the start and goal.
+ *
+ * @param region  Memory region to allocate the segment list from
+ * @param opts    Options, or NULL for defaults
+ * @param ssg     Sub-scenegraph whose configurations are optimized
+ * @param limits  Kinematic limits for the full scene graph, or NULL
+ *                to use the scene graph's limits
+ * @param n_q_all Number of configuration variables in the scene graph
+ * @param n_path  Number of waypoints in path, at least two
+ * @param path    Initial waypoints of the full configuration
+ * @param segs    Output parabolic-blend trajectory of the full configuration
+ *
+ * @return AA_RX_OK when the optimized waypoints are clear of
+ * obstacles (between waypoints is not checked), AA_RX_NO_SOLUTION when the trajectory is produced but
+ * still collides, or AA_RX_INVALID_PARAMETER.
+ *
+ * @sa aa_ct_tjq_pb_generate()
+ */
+AA_API int
+aa_rx_ct_tjq_opt( struct aa_mem_region *region,
+                  const struct aa_rx_ct_opt_opts *opts,
+                  const struct aa_rx_sg_sub *ssg,
+                  struct aa_ct_limit *limits,
+                  size_t n_q_all, size_t n_path, const double *path,
+                  struct aa_ct_seg_list **segs );
+
+
 #endif /*AMINO_RX_CT_H*/
@@ -148,6 +148,12 @@ AA_API void
 aa_rx_cl_allow_set( struct aa_rx_cl *cl,
                     const struct aa_rx_cl_set *set );
 
+/**
+ * Restore the allowed collisions to those of the scene graph.
+ */
+AA_API void
+aa_rx_cl_allow_reset( struct aa_rx_cl *cl );
+
 /**
  * Allow (ignore) collisions between frames0 and frame1 if allowed is true.
  */
@@ -157,12 +163,34 @@ aa_rx_cl_allow_name( struct aa_rx_cl *cl,
                      const char *frame1,
                      int allowed );
 
+/**
+ * Set the frames whose geometry may move between collision checks.
+ *
+ * By default, aa_rx_cl_check() poses all geometry on every call.
+ * After this function, the next call to aa_rx_cl_check() poses all
+ * geometry, and later calls re-pose only the geometry of the given
+ * frames, so geometry of other frames keeps its earlier pose even if
+ * TF moves it.  Call again, e.g., with the same frames, whenever the
+ * other frames move.
+ *
+ * @param cl       The collision context
+ * @param n_frames Number of moving frames
+ * @param frames   IDs of the moving frames, or NULL to restore the
+ *                 default of posing all geometry on every check
+ */
+AA_API void
+aa_rx_cl_set_moving( struct aa_rx_cl *cl,
+                     size_t n_frames, const aa_rx_frame_id *frames );
+
 /**
  * Detect collisions.
  *
  * If cl_set is non-NULL, it will be filled in with all detected collisions.
  * If cl_set is NULL, collision checking may short-circuit after the first collision is detected.
  *
+ * All geometry is posed from TF unless aa_rx_cl_set_moving() has
+ * limited the context to certain frames.
+ *
  * @returns 0 if no collisions are detected and non-zero if any collisions are detected.
  */
 AA_API int
@@ -59,6 +59,31 @@ typedef int aa_rx_ik_fun( void *context,
 
 struct aa_rx_ksol_opts;
 
+struct aa_rx_ik_cache;
+
+/**
+ * Iterative methods for the Jacobian IK solver.
+ */
+enum aa_rx_ik_method {
+    /**
+     * Integrate the differential kinematics with an adaptive
+     * Runge-Kutta method (default).
+     */
+    AA_RX_IK_ODE,
+
+    /**
+     * Damped Newton (Levenberg-Marquardt) iteration with adaptive
+     * damping, backtracking line search, and joint-limit clamping.
+     */
+    AA_RX_IK_LM,
+
+    /**
+     * Damped Newton iteration where each step is a box-constrained
+     * quadratic program over the joint position and velocity limits.
+     */
+    AA_RX_IK_QP
+};
+
 /**
  * Create options struct for kinematic solver.
  */
@@ -137,6 +162,27 @@ aa_rx_ksol_opts_set_gain_trans( struct aa_rx_ksol_opts *opts, double k );
 AA_API void
 aa_rx_ksol_opts_set_max_iterations( struct aa_rx_ksol_opts *opts, size_t n );
 
+/**
+ * Set the iterative method for the Jacobian IK solver.
+ */
+AA_API void
+aa_rx_ksol_opts_set_ik_method( struct aa_rx_ksol_opts *opts, enum aa_rx_ik_method method );
+
+/**
+ * Set a seed cache for the Jacobian IK solver.
+ *
+ * Single-target solves first try the nearest cached solutions as
+ * seeds, then the option seed, and add successful solutions to the
+ * cache.  The cache is not owned by the options and may be shared
+ * between threads.  It is mutable shared state: solvers update it
+ * even through const options, and it serializes access with its own
+ * lock.
+ *
+ * @sa aa_rx_ik_cache_create()
+ */
+AA_API void
+aa_rx_ksol_opts_set_cache( struct aa_rx_ksol_opts *opts, struct aa_rx_ik_cache *cache );
+
 /**
  * Set frame to solve.
  */
@@ -165,6 +211,17 @@ aa_rx_ksol_opts_take_seed( struct aa_rx_ksol_opts *opts, size_t n_q,
                            double *q_all, enum aa_mem_refop refop );
 
 
+/**
+ * Set per-end-effector weights for multi-target solves.
+ *
+ * Each weight scales the error and Jacobian rows of the corresponding
+ * end-effector of the sub-scenegraph.  Ignored unless n equals the
+ * number of end-effectors.
+ */
+AA_API void
+aa_rx_ksol_opts_take_ee_weights( struct aa_rx_ksol_opts *opts, size_t n,
+                                 double *w, enum aa_mem_refop refop );
+
 /**
  * Set the configuration seed (initial) to be the center position.
  */
@@ -218,6 +275,360 @@ AA_API int aa_rx_ik_jac_fun( void *context,
                              size_t n_tf, const double *TF, size_t ld_TF,
                              size_t n_q, double *q );
 
+/**
+ * Solve the Jacobian IK from multiple seeds in parallel.
+ *
+ * The first seed is the option seed and the remaining n_starts-1
+ * seeds are sampled uniformly within the position limits.  Each
+ * thread solves with its own memory region and workspace.  Remaining
+ * solves are cancelled once n_sol distinct solutions are found.
+ *
+ * @param context   the IK solver
+ * @param n_threads number of threads, or 0 for the number of online CPUs
+ * @param n_starts  number of seeds to try
+ * @param q_ref     reference configuration (subset) for ranking, or NULL
+ *                  for the option reference or else the seed
+ * @param n_q       number of configurations in the sub-scenegraph
+ * @param n_sol     maximum number of distinct solutions to collect,
+ *                  1 to stop at the first solution
+ * @param Q         output solutions (n_q x n_sol), ordered by
+ *                  increasing distance to q_ref
+ * @param ld_Q      leading dimension of Q
+ * @param n_found   output number of solutions found, may be NULL
+ *
+ * @return zero when at least one solution is found, nonzero otherwise
+ */
+AA_API int
+aa_rx_ik_solve_multistart( const struct aa_rx_ik_jac_cx *context,
+                           size_t n_threads, size_t n_starts,
+                           size_t n_tf, const double *TF, size_t ld_TF,
+                           const double *q_ref,
+                           size_t n_q, size_t n_sol, double *Q, size_t ld_Q,
+                           size_t *n_found );
+
+/*-- Differential IK Servo --*/
+
+struct aa_rx_ik_servo;
+
+/**
+ * Create a differential IK servo for a single end-effector.
+ *
+ * All workspace is allocated here, so aa_rx_ik_servo_step() performs
+ * no allocation, which suits real-time control loops.  A step costs
+ * about the same as computing kinematics and calling
+ * aa_rx_ik_jac_x2dq(); the servo bounds memory use, not latency.
+ *
+ * Configurations outside the sub-scenegraph are taken from the option
+ * seed, or else zero, when the servo is created.  The servo keeps a
+ * pointer to opts and reads the gains, deadzone and reference
+ * configuration on every step, so opts must remain valid until
+ * aa_rx_ik_servo_destroy().
+ *
+ * @return the servo, or NULL if the sub-scenegraph has multiple
+ * end-effectors or more than 10 configurations
+ */
+AA_API struct aa_rx_ik_servo *
+aa_rx_ik_servo_create( const struct aa_rx_sg_sub *ssg,
+                       const struct aa_rx_ksol_opts *opts );
+
+/**
+ * Destroy a differential IK servo.
+ */
+AA_API void
+aa_rx_ik_servo_destroy( struct aa_rx_ik_servo *servo );
+
+/**
+ * Compute joint velocities for one servo cycle.
+ *
+ * Computes the same velocity as aa_rx_ik_jac_x2dq() at the measured
+ * configuration q, including nullspace projection toward the option
+ * reference configuration.
+ *
+ * @param q      measured configuration of the sub-scenegraph
+ * @param E_ref  reference pose for error feedback, or NULL
+ * @param dx_ref desired twist, or NULL
+ * @param dq     output joint velocities
+ */
+AA_API int
+aa_rx_ik_servo_step( struct aa_rx_ik_servo *servo,
+                     size_t n_q, const double *AA_RESTRICT q,
+                     const double E_ref[7], const double dx_ref[6],
+                     double *AA_RESTRICT dq );
+
+/**
+ * Return the end-effector pose computed by the last step.
+ */
+AA_API const double *
+aa_rx_ik_servo_pose( const struct aa_rx_ik_servo *servo );
+
+/*-- IK Seed Cache --*/
+
+/**
+ * Create a cache of IK solutions indexed by end-effector pose.
+ *
+ * Lookups use a k-d tree over translation and quaternion, with the
+ * quaternion scaled by a rotation weight (default 1).  Once full, the
+ * oldest entries are replaced.
+ *
+ * @param n_q         number of configurations in the sub-scenegraph
+ * @param max_entries maximum number of cached solutions
+ */
+AA_API struct aa_rx_ik_cache *
+aa_rx_ik_cache_create( size_t n_q, size_t max_entries );
+
+/**
+ * Destroy an IK seed cache.
+ */
+AA_API void
+aa_rx_ik_cache_destroy( struct aa_rx_ik_cache *cache );
+
+/**
+ * Return the number of cached solutions.
+ */
+AA_API size_t
+aa_rx_ik_cache_count( struct aa_rx_ik_cache *cache );
+
+/**
+ * Set the weight of quaternion distance relative to translation.
+ */
+AA_API void
+aa_rx_ik_cache_set_rot_weight( struct aa_rx_ik_cache *cache, double w );
+
+/**
+ * Add a solution q for pose E.
+ *
+ * A solution for an already cached pose replaces the previous one.
+ */
+AA_API void
+aa_rx_ik_cache_add( struct aa_rx_ik_cache *cache, const double E[7],
+                    size_t n_q, const double *q );
+
+/**
+ * Find the cached solutions for the k poses nearest E.
+ *
+ * @param Q   output solutions (n_q x k), by increasing pose distance
+ * @param ldQ leading dimension of Q
+ *
+ * @return the number of solutions found
+ */
+AA_API size_t
+aa_rx_ik_cache_nearest( struct aa_rx_ik_cache *cache, const double E[7],
+                        size_t k, size_t n_q, double *Q, size_t ldQ );
+
+/**
+ * Write the cache in a binary, host-endian format.
+ */
+AA_API int
+aa_rx_ik_cache_write( struct aa_rx_ik_cache *cache, FILE *out );
+
+/**
+ * Read a cache written by aa_rx_ik_cache_write().
+ *
+ * The stream must be seekable; the stored counts are checked against
+ * the remaining file length before anything is allocated.
+ *
+ * @param n_q         expected configuration size; a file with a
+ *                    different size is rejected
+ * @param max_entries capacity of the new cache; when the file holds
+ *                    more solutions, only the first max_entries are kept
+ *
+ * @return the cache, or NULL on error
+ */
+AA_API struct aa_rx_ik_cache *
+aa_rx_ik_cache_read( FILE *in, size_t n_q, size_t max_entries );
+
+/*-- Reachability Map --*/
+
+struct aa_rx_reach_map;
+
+/**
+ * Create an empty reachability map over a box in the global frame.
+ *
+ * The map is a sampled approximation, useful to bias IK seeds toward
+ * well-conditioned configurations (see aa_rx_mp_set_reach_map()).  An
+ * unreached cell does not prove a pose unreachable, so the map should
+ * not be used to reject goals.
+ *
+ * The box is divided into cubic voxels.  Each voxel is further
+ * divided into orientation bins over the direction of the
+ * end-effector z axis, using a cube map with n_side x n_side bins per
+ * face.
+ *
+ * @param min        lower corner of the box
+ * @param max        upper corner of the box
+ * @param resolution voxel edge length
+ * @param n_side     orientation bins along each cube map face edge
+ *
+ * @sa aa_rx_reach_map_sample()
+ */
+AA_API struct aa_rx_reach_map *
+aa_rx_reach_map_create( const double min[3], const double max[3],
+                        double resolution, size_t n_side );
+
+/**
+ * Destroy a reachability map.
+ */
+AA_API void
+aa_rx_reach_map_destroy( struct aa_rx_reach_map *map );
+
+/**
+ * Add random configurations of the sub-scenegraph to the map.
+ *
+ * Each configuration is drawn uniformly within the position limits.
+ * The cell of the end-effector pose is marked reachable and records
+ * the largest manipulability, sqrt(det(J*J')), of its samples.
+ * Samples may be added over multiple calls.
+ *
+ * Each worker draws from its own stream, seeded from the map's seed
+ * sequence, so a given seed and thread count reproduces the map.
+ *
+ * @param q_all     configurations outside the sub-scenegraph
+ * @param n_threads number of threads, or 0 for one per processor
+ * @param n_samples total number of configurations to sample
+ *
+ * @return 0 on success, AA_RX_INVALID_PARAMETER for a mismatched
+ * sub-scenegraph or if the sampling buffers cannot be allocated
+ */
+AA_API int
+aa_rx_reach_map_sample( struct aa_rx_reach_map *map,
+                        const struct aa_rx_sg_sub *ssg,
+                        size_t n_q_all, const double *q_all,
+                        size_t n_threads, size_t n_samples );
+
+/**
+ * Set the seed for the next call to aa_rx_reach_map_sample().
+ *
+ * The default seed is 0.
+ */
+AA_API void
+aa_rx_reach_map_set_seed( struct aa_rx_reach_map *map, uint64_t seed );
+
+/**
+ * Return the end-effector frame of the map, or AA_RX_FRAME_NONE if
+ * not yet sampled.
+ */
+AA_API aa_rx_frame_id
+aa_rx_reach_map_frame( const struct aa_rx_reach_map *map );
+
+/**
+ * Whether any sample reached the cell of pose E.
+ *
+ * A false result only means no sample landed in the cell.
+ */
+AA_API int
+aa_rx_reach_map_reachable( const struct aa_rx_reach_map *map, const double E[7] );
+
+/**
+ * Return the largest sampled manipulability in the cell of pose E,
+ * or -1 if the cell was not reached.
+ *
+ * Values are quantized to 255 levels.
+ */
+AA_API double
+aa_rx_reach_map_manip( const struct aa_rx_reach_map *map, const double E[7] );
+
+/**
+ * Return the fraction of orientation bins reached at position v.
+ */
+AA_API double
+aa_rx_reach_map_index( const struct aa_rx_reach_map *map, const double v[3] );
+
+/**
+ * Write the map in a binary, host-endian format, one byte per cell.
+ */
+AA_API int
+aa_rx_reach_map_write( const struct aa_rx_reach_map *map, FILE *out );
+
+/**
+ * Read a map written by aa_rx_reach_map_write().
+ *
+ * @return the map, or NULL on error
+ */
+AA_API struct aa_rx_reach_map *
+aa_rx_reach_map_read( FILE *in );
+
+/*-- Analytic IK Solver --*/
+
+struct aa_rx_ik_analytic_cx;
+
+/**
+ * Create a closed-form IK solver for a 6R chain.
+ *
+ * The chain structure is detected from the joint axes.  Supported
+ * structures are arms with a spherical wrist and arms with three
+ * parallel middle axes (e.g., UR-type arms).  Configurations outside
+ * the chain are taken from the option seed, or else zero.
+ *
+ * Target poses are relative to the scenegraph root.  The pose of the
+ * chain root is fixed when the solver is created, so create a new
+ * solver if configurations outside the chain change.
+ *
+ * @return the solver, or NULL if the chain has no supported
+ * closed-form solution
+ *
+ * @sa aa_rx_ik_analytic_gen()
+ */
+AA_API struct aa_rx_ik_analytic_cx *
+aa_rx_ik_analytic_cx_create( const struct aa_rx_sg_sub *ssg,
+                             const struct aa_rx_ksol_opts *opts );
+
+/**
+ * Destroy a closed-form IK solver.
+ */
+AA_API void
+aa_rx_ik_analytic_cx_destroy( struct aa_rx_ik_analytic_cx *cx );
+
+/**
+ * Compute all closed-form IK solutions within the joint limits.
+ *
+ * @param n_sol maximum number of solutions, at most 8 exist
+ * @param Q     output solutions (n_q x n_sol)
+ * @param ldQ   leading dimension of Q
+ *
+ * @return the number of solutions
+ */
+AA_API size_t
+aa_rx_ik_analytic_solve_all( const struct aa_rx_ik_analytic_cx *cx,
+                             size_t n_tf, const double *TF, size_t ld_TF,
+                             size_t n_q, size_t n_sol, double *Q, size_t ldQ );
+
+/**
+ * Compute the closed-form IK solution nearest the reference.
+ *
+ * The reference is the option reference configuration if set, or
+ * else the value of q on entry.
+ */
+AA_API int
+aa_rx_ik_analytic_solve( const struct aa_rx_ik_analytic_cx *cx,
+                         size_t n_tf, const double *TF, size_t ld_TF,
+                         size_t n_q, double *q );
+
+/**
+ * Convenience function for the closed-form IK solver.
+ *
+ * @sa aa_rx_ik_analytic_solve()
+ */
+AA_API int
+aa_rx_ik_analytic_fun( void *context,
+                       size_t n_tf, const double *TF, size_t ld_TF,
+                       size_t n_q, double *q );
+
+/**
+ * Write C source for a specialized closed-form IK solver.
+ *
+ * The source defines the function aa_rx_dl_ik__NAME, which may be
+ * compiled into a plugin and loaded with aa_rx_dl_ik_analytic().  Like
+ * the solver, the generated function takes poses relative to the
+ * scenegraph root, with the chain root where it was when cx was
+ * created.
+ *
+ * @param name  C identifier for the solver
+ * @param out   output stream
+ */
+AA_API int
+aa_rx_ik_analytic_gen( const struct aa_rx_ik_analytic_cx *cx,
+                       const char *name, FILE *out );
+
 
 /* AA_API int */
 /* aa_rx_sg_sub_ksol_dls( const struct aa_rx_sg_sub *ssg, */
@@ -39,6 +39,7 @@
 #define AMINO_RX_SCENE_KIN_INTERNAL_H
 
 #include "scene_kin.h"
+#include "ik_analytic_impl.h"
 
 struct aa_rx_sg_sub
 {
@@ -49,6 +50,22 @@ struct aa_rx_sg_sub
     size_t config_count;
     aa_rx_frame_id *configs;
 
+    size_t ee_count;            ///< number of end-effector frames
+    aa_rx_frame_id *ees;        ///< end-effector frames
+
+    /**
+     * Configurations that move each end-effector.  For end-effector
+     * i, the configuration indices are ee_cols[ee_col_ptr[i]] through
+     * ee_cols[ee_col_ptr[i+1]-1].
+     */
+    size_t *ee_col_ptr;
+    size_t *ee_cols;
+
+    /**
+     * Joint frame of each configuration, so the Jacobian needs no
+     * workspace.
+     */
+    aa_rx_frame_id *col_frames;
 };
 
 
@@ -121,9 +138,49 @@ struct aa_rx_ksol_opts {
     size_t n_all_seed;
     double *q_all_seed_data;
 
+    const double *ee_weight;   ///< per-end-effector weights
+    size_t n_ee_weight;
+    double *ee_weight_data;
+
     size_t max_iterations;
 
     aa_rx_frame_id frame;
+
+    enum aa_rx_ik_method ik_method;
+
+    struct aa_rx_ik_cache *cache;  ///< seed cache, not owned, see aa_rx_ksol_opts_cache()
+};
+
+/**
+ * Return the seed cache of the options.
+ *
+ * The cache is mutable shared state rather than part of the options
+ * value: solvers add to it through const options, and it is guarded
+ * by its own lock.
+ */
+static inline struct aa_rx_ik_cache *
+aa_rx_ksol_opts_cache( const struct aa_rx_ksol_opts *opts )
+{
+    return opts->cache;
+}
+
+/**
+ * Closed-form IK solver for a 6R chain.
+ */
+struct aa_rx_ik_analytic_cx
+{
+    const struct aa_rx_sg_sub *ssg;
+    const struct aa_rx_ksol_opts *opts;
+    aa_rx_frame_id frame_ee;
+
+    /** Extracted chain parameters */
+    struct aa_rx_ik_analytic_param param;
+
+    /** Compiled solver from a plugin, or NULL to use param */
+    size_t (*dl_kernel)( const double E[7], double *Q, size_t ldQ );
+
+    void (*destructor)(void*);
+    void *destructor_context;
 };
 
 #endif /*AMINO_RX_SCENE_KIN_H*/
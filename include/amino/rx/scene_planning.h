@@ -69,9 +69,29 @@ aa_rx_mp_create( const struct aa_rx_sg_sub *sub_sg );
 AA_API void
 aa_rx_mp_destroy( struct aa_rx_mp *mp );
 
+/**
+ * Reset the motion planning context for a new query.
+ *
+ * Clears the start configuration, the goal, any solution, the
+ * planner's search data, and any pending cancellation.  Allowed
+ * collisions return to those of the scene graph, dropping pairs
+ * allowed at earlier start configurations and by
+ * aa_rx_mp_allow_collision().  The state space, collision objects,
+ * planner selection, persistent roadmap, IK function, and
+ * post-processing settings are kept, so the context may be reused
+ * for a sequence of queries on the same scene without being
+ * recreated.
+ *
+ * Call aa_rx_mp_set_start() and set a goal before planning again.
+ */
+AA_API void
+aa_rx_mp_reset( struct aa_rx_mp *mp );
+
 /**
  * Set the motion planning start configuration.
  *
+ * Replaces any previous start configuration.
+ *
  * \param mp The motion planning context
  * \param n_all Length of array q_all
  * \param q_all Array of start configurations for the entire scene graph.
@@ -122,14 +142,102 @@ aa_rx_mp_set_wsgoal( struct aa_rx_mp *mp,
                      size_t n_e, const aa_rx_frame_id *frames,
                      const double *E, size_t ldE );
 
+/**
+ * Set the IK function used to sample workspace goals.
+ *
+ * By default, workspace goals are sampled with the Jacobian IK
+ * solver.  On each call, q holds a random seed configuration, which
+ * the function may use to select among solutions.
+ *
+ * @sa aa_rx_ik_analytic_fun()
+ */
+AA_API void
+aa_rx_mp_set_ik_fun( struct aa_rx_mp *mp,
+                     aa_rx_ik_fun *ik_fun, void *ik_context );
+
+/**
+ * Set the pool of threads that sample workspace goals.
+ *
+ * Each thread solves IK from random seeds with its own solver
+ * context, then discards goals that collide or that lie within
+ * min_dist of a recently found goal.  The planner thus receives
+ * distinct, valid goals at a higher rate on hard goals.  Threads
+ * pause while a small number of goals await the planner, so the pool
+ * does not outrun it.  A custom IK function from
+ * aa_rx_mp_set_ik_fun() is always run on a single thread.
+ *
+ * @param mp        The motion planning context
+ * @param n_threads Number of threads, 0 for one per processor, or 1
+ *                  (the default) to sample on the planner's goal thread
+ * @param min_dist  Minimum configuration-space distance between goals
+ */
+AA_API void
+aa_rx_mp_set_wsgoal_pool( struct aa_rx_mp *mp,
+                          size_t n_threads, double min_dist );
+
+
+/**
+ * Set a reachability map to bias workspace goal sampling.
+ *
+ * Goal sampling for a later aa_rx_mp_set_wsgoal() then draws several
+ * candidate IK seeds and starts from the one that places the map's
+ * end-effector frame nearest its goal, favoring well-conditioned
+ * cells.  The map is built by sampling, so an unreached cell does not
+ * prove a goal unreachable, and goals are never rejected by the map.
+ * The map must outlive the planner.
+ *
+ * @sa aa_rx_reach_map_sample()
+ */
+AA_API void
+aa_rx_mp_set_reach_map( struct aa_rx_mp *mp,
+                        const struct aa_rx_reach_map *map );
 
 /**
  * Set whether to simplify the planned path.
+ *
+ * Equivalent to aa_rx_mp_set_postprocess() with a budget of one
+ * second and one thread per processor, or with no budget.
  */
 AA_API void
 aa_rx_mp_set_simplify( struct aa_rx_mp *mp,
                        int simplify );
 
+/**
+ * Statistics from post-processing the most recent path.
+ */
+struct aa_rx_mp_pp_stats {
+    double length_initial;      ///< length of the planned path
+    double length_shortcut;     ///< length after shortcutting
+    double length_smooth;       ///< length after smoothing
+    double time_shortcut;       ///< seconds spent shortcutting
+    double time_smooth;         ///< seconds spent smoothing
+    size_t n_shortcuts;         ///< number of shortcuts applied
+};
+
+/**
+ * Set the time budget for post-processing planned paths.
+ *
+ * Post-processing first shortcuts the path, checking batches of
+ * candidate shortcuts in parallel, until the budget is spent or the
+ * path stops improving.  If time remains, it then smooths the path,
+ * also checking in parallel.  No new check starts after the budget
+ * is spent.  The collision checkers are kept in mp and rebuilt only
+ * when n_threads or the scene geometry changes.
+ *
+ * @param mp        The motion planning context
+ * @param budget    Time budget in seconds, or 0 to disable
+ * @param n_threads Number of threads, or 0 for one per processor
+ */
+AA_API void
+aa_rx_mp_set_postprocess( struct aa_rx_mp *mp,
+                          double budget, size_t n_threads );
+
+/**
+ * Get statistics from post-processing the most recent path.
+ */
+AA_API const struct aa_rx_mp_pp_stats *
+aa_rx_mp_get_postprocess_stats( const struct aa_rx_mp *mp );
+
 /**
  * Set whether to track collisions.
  */
@@ -162,6 +270,79 @@ aa_rx_mp_plan( struct aa_rx_mp *mp,
                size_t *n_path,
                double **p_path_all );
 
+/**
+ * Callback for solutions found during planning.
+ *
+ * @param cx       User context
+ * @param n_path   Number of waypoints in the path
+ * @param path_all Configurations of the entire scene graph at each
+ *                 waypoint, valid only during the call
+ */
+typedef void aa_rx_mp_solution_fun( void *cx, size_t n_path, const double *path_all );
+
+/**
+ * Opaque structure for a planning job.
+ */
+struct aa_rx_mp_job;
+
+/**
+ * Start planning in a new thread.
+ *
+ * The job runs aa_rx_mp_plan() and must be finished with
+ * aa_rx_mp_job_wait(), which is the only function that frees the
+ * job; every job must be waited on, even after
+ * aa_rx_mp_job_cancel() or once aa_rx_mp_job_poll() reports it
+ * done.  The planning context must not be used until then.
+ *
+ * Anytime planners, which keep improving their solution until the
+ * timeout, pass each improved solution to fun from the planning
+ * thread.
+ *
+ * \param mp      The motion planning context
+ * \param timeout Maximum time to execute the planner
+ * \param fun     Callback for intermediate solutions, or NULL
+ * \param cx      Context for fun
+ *
+ * \return the planning job, or NULL if the thread could not be started
+ */
+AA_API struct aa_rx_mp_job *
+aa_rx_mp_plan_async( struct aa_rx_mp *mp,
+                     double timeout,
+                     aa_rx_mp_solution_fun *fun, void *cx );
+
+/**
+ * Request that a planning job stop early.
+ *
+ * Planners return their best solution found so far, if any.  The
+ * request applies only to this job; the next planning query on the
+ * context starts uncancelled.  The job must still be finished with
+ * aa_rx_mp_job_wait().
+ */
+AA_API void
+aa_rx_mp_job_cancel( struct aa_rx_mp_job *job );
+
+/**
+ * Return non-zero if the planning job has finished.
+ */
+AA_API int
+aa_rx_mp_job_poll( const struct aa_rx_mp_job *job );
+
+/**
+ * Wait for a planning job to finish and destroy it.
+ *
+ * The job may not be used afterwards.
+ *
+ * \param job        The planning job
+ * \param n_path     Number of waypoints in the path
+ * \param p_path_all Output path data, as for aa_rx_mp_plan()
+ *
+ * \return the result of aa_rx_mp_plan()
+ */
+AA_API int
+aa_rx_mp_job_wait( struct aa_rx_mp_job *job,
+                   size_t *n_path,
+                   double **p_path_all );
+
 /**
  * Return a pointer to the allowed collision set for the motion
  * planning context.
@@ -196,6 +377,16 @@ AA_API void
 aa_rx_mp_rrt_attr_set_bidirectional( struct aa_rx_mp_rrt_attr* attrs,
                                      int is_bidirectional );
 
+/**
+ * Whether to use the built-in RRT implementation instead of OMPL's.
+ *
+ * The built-in planner is bidirectional only and stores tree nodes in
+ * contiguous blocks for vectorized nearest-neighbor search.
+ */
+AA_API void
+aa_rx_mp_rrt_attr_set_native( struct aa_rx_mp_rrt_attr* attrs,
+                              int is_native );
+
 /**
  * Use the RRT motion planning algorithm
  *
@@ -267,6 +458,283 @@ aa_rx_mp_set_kpiece( struct aa_rx_mp* mp,
                      const struct aa_rx_mp_kpiece_attr *attr );
 
 
+/*---- Lazy PRM -----*/
+
+/**
+ * Opaque structure for lazy PRM planner attributes
+ */
+struct aa_rx_mp_prm_attr;
+
+/**
+ * Create a lazy PRM attribute struct
+ */
+AA_API struct aa_rx_mp_prm_attr*
+aa_rx_mp_prm_attr_create(void);
+
+/**
+ * Destroy a lazy PRM attribute struct
+ */
+AA_API void
+aa_rx_mp_prm_attr_destroy(struct aa_rx_mp_prm_attr*);
+
+/**
+ * Number of nearest neighbors connected to each roadmap node.
+ */
+AA_API void
+aa_rx_mp_prm_attr_set_neighbors( struct aa_rx_mp_prm_attr* attrs,
+                                 size_t n_neighbors );
+
+/**
+ * Use a persistent, lazily checked roadmap.
+ *
+ * The roadmap is kept with the motion planning context and reused by
+ * each call to aa_rx_mp_plan().  Nodes and edges are collision
+ * checked only when they lie on a candidate path, and the results are
+ * kept for later queries.
+ *
+ * Before each query, the roadmap is updated for changes to the scene.
+ * After geometry is added to a frame or marked dirty with
+ * aa_rx_sg_frame_dirty_geom(), or after a frame is moved with
+ * aa_rx_sg_reparent_name(), previously valid results are rechecked
+ * only against collisions with the changed frames and their
+ * descendants, and invalid results are reopened only if blocked by a
+ * changed frame.  Changing the configuration outside the
+ * sub-scenegraph discards all results.
+ *
+ * aa_rx_sg_dirty_geom() does not say which frame changed, so it
+ * counts as a change to every frame: all valid results are rechecked
+ * and all invalid results are reopened.  Prefer
+ * aa_rx_sg_frame_dirty_geom() for incremental changes.
+ *
+ * @param mp   The motion planning context
+ * @param attr Attributes for the planning algorithm (NULL uses defaults)
+ */
+AA_API void
+aa_rx_mp_set_lazy_prm( struct aa_rx_mp* mp,
+                       const struct aa_rx_mp_prm_attr *attr );
+
+/**
+ * Add n_nodes uniformly sampled nodes to the roadmap.
+ *
+ * The roadmap otherwise grows as needed during planning.
+ */
+AA_API int
+aa_rx_mp_prm_grow( struct aa_rx_mp* mp, size_t n_nodes );
+
+/**
+ * Return the number of roadmap nodes.
+ */
+AA_API size_t
+aa_rx_mp_prm_node_count( const struct aa_rx_mp* mp );
+
+/**
+ * Write the roadmap to a binary file.
+ */
+AA_API int
+aa_rx_mp_prm_write( const struct aa_rx_mp* mp, FILE *out );
+
+/**
+ * Replace the roadmap with one read from a binary file.
+ *
+ * The file must have the configuration count of the planning
+ * sub-scenegraph.  Stored collision checking results are discarded,
+ * since the file does not record the scene they were checked
+ * against; nodes and edges are rechecked lazily as usual.
+ */
+AA_API int
+aa_rx_mp_prm_read( struct aa_rx_mp* mp, FILE *in );
+
+
+/*---- Experience -----*/
+
+/**
+ * Opaque structure for a library of planned paths.
+ */
+struct aa_rx_mp_library;
+
+/**
+ * Create an empty path library for planning over the configurations
+ * of ssg.
+ */
+AA_API struct aa_rx_mp_library *
+aa_rx_mp_library_create( const struct aa_rx_sg_sub *ssg );
+
+/**
+ * Destroy a path library.
+ */
+AA_API void
+aa_rx_mp_library_destroy( struct aa_rx_mp_library *lib );
+
+/**
+ * Return the number of stored paths.
+ */
+AA_API size_t
+aa_rx_mp_library_size( const struct aa_rx_mp_library *lib );
+
+/**
+ * Plan using stored paths.
+ *
+ * Each successful aa_rx_mp_plan() stores its path in the library,
+ * indexed by its start and goal configurations.  For queries with a
+ * single start and goal configuration, the planner first retrieves
+ * the stored paths with the nearest endpoints and connects each to
+ * the query start and goal.  All segments of a candidate path are
+ * collision checked together, and each run of invalid segments is
+ * replanned with the context's planner.  Retrieval uses at most half
+ * the planning timeout, and the planner searches from scratch if no
+ * candidate can be repaired.
+ *
+ * The library is not copied and must outlive its use by the context.
+ *
+ * @param mp           The motion planning context
+ * @param lib          The path library, or NULL to stop using one
+ * @param n_candidates Number of stored paths to try (0 uses 3)
+ *
+ * @return AA_RX_OK, or AA_RX_INVALID_PARAMETER when the library
+ * is for a different number of configurations
+ */
+AA_API int
+aa_rx_mp_set_library( struct aa_rx_mp *mp, struct aa_rx_mp_library *lib,
+                      size_t n_candidates );
+
+/**
+ * Statistics of planning with a path library.
+ *
+ * The hit rate is n_hits / n_queries.
+ */
+struct aa_rx_mp_library_stats {
+    size_t n_queries;           ///< planning queries using the library
+    size_t n_hits;              ///< queries solved from a stored path
+    size_t n_repairs;           ///< path sections replanned in hits
+    double time_hits;           ///< total time of hit queries
+    double time_misses;         ///< total time of other queries
+    double time_saved;          ///< hits times the mean miss time, less time_hits
+};
+
+/**
+ * Return the statistics of planning with the library.
+ */
+AA_API const struct aa_rx_mp_library_stats *
+aa_rx_mp_library_get_stats( const struct aa_rx_mp_library *lib );
+
+/**
+ * Write the stored paths to a binary file.
+ */
+AA_API int
+aa_rx_mp_library_write( const struct aa_rx_mp_library *lib, FILE *out );
+
+/**
+ * Replace the stored paths with those read from a binary file.
+ *
+ * Paths are assumed valid for the same sub-scenegraph; they are
+ * checked against the current scene when retrieved.
+ *
+ * @return AA_RX_OK, or AA_RX_INVALID_PARAMETER when the file is not
+ * a library for this number of configurations, is truncated, or is
+ * too large to load.  A malformed file leaves the stored paths
+ * unchanged.
+ */
+AA_API int
+aa_rx_mp_library_read( struct aa_rx_mp_library *lib, FILE *in );
+
+
+/*---- Parallel -----*/
+
+/**
+ * Planning algorithms for parallel planning.
+ */
+enum aa_rx_mp_algorithm {
+    AA_RX_MP_NATIVE_RRT = 0x1,  ///< built-in RRT-Connect
+    AA_RX_MP_RRT = 0x2,         ///< OMPL RRT-Connect
+    AA_RX_MP_SBL = 0x4,         ///< OMPL SBL
+    AA_RX_MP_KPIECE = 0x8       ///< OMPL LBKPIECE
+};
+
+/**
+ * Opaque structure for parallel planning attributes
+ */
+struct aa_rx_mp_parallel_attr;
+
+/**
+ * Create a parallel planning attribute struct
+ */
+AA_API struct aa_rx_mp_parallel_attr*
+aa_rx_mp_parallel_attr_create(void);
+
+/**
+ * Destroy a parallel planning attribute struct
+ */
+AA_API void
+aa_rx_mp_parallel_attr_destroy(struct aa_rx_mp_parallel_attr*);
+
+/**
+ * Set the algorithms to run, as a bitwise OR of enum
+ * aa_rx_mp_algorithm.
+ *
+ * Threads are assigned the given algorithms in turn.  The default is
+ * AA_RX_MP_NATIVE_RRT | AA_RX_MP_RRT.
+ */
+AA_API void
+aa_rx_mp_parallel_attr_set_algorithms( struct aa_rx_mp_parallel_attr* attrs,
+                                       unsigned algorithms );
+
+/**
+ * Set the number of solutions to wait for.
+ *
+ * The shortest solution found is returned.  Planning stops once this
+ * many threads have found a solution, or at the timeout.  The default
+ * of 1 returns the first solution.
+ */
+AA_API void
+aa_rx_mp_parallel_attr_set_solutions( struct aa_rx_mp_parallel_attr* attrs,
+                                      size_t n_solutions );
+
+/**
+ * Set the random seed for the built-in planners.
+ *
+ * Each built-in planner thread uses a different seed derived from this
+ * value.  OMPL planners draw from OMPL's process-wide generator, so the
+ * seed does not affect them; see ompl::RNG::setSeed().
+ */
+AA_API void
+aa_rx_mp_parallel_attr_set_seed( struct aa_rx_mp_parallel_attr* attrs,
+                                 unsigned seed );
+
+/**
+ * Execute several planners in parallel.
+ *
+ * Each thread runs an independent planner with its own collision
+ * checking context on the problem of mp.  The planner set with
+ * aa_rx_mp_set_rrt() or similar is not used.  The collision checking
+ * contexts are kept in mp and reused by later calls until the scene
+ * geometry changes.
+ *
+ * \param mp The motion planning context
+ *
+ * \param n_threads Number of threads, or 0 for one per processor
+ *
+ * \param timeout Maximum time to execute the planners
+ *
+ * \param attr Attributes for parallel planning (NULL uses defaults)
+ *
+ * \param n_path Number of waypoints in the path.
+ *
+ * \param p_path_all Output path data, as for aa_rx_mp_plan().
+ *
+ * @return AA_RX_OK on success, or AA_RX_INVALID_STATE if no start
+ * configuration is set.
+ *
+ * @sa aa_rx_mp_plan()
+ */
+AA_API int
+aa_rx_mp_plan_parallel( struct aa_rx_mp *mp,
+                        size_t n_threads,
+                        double timeout,
+                        const struct aa_rx_mp_parallel_attr *attr,
+                        size_t *n_path,
+                        double **p_path_all );
+
+
 
 
 #endif /*AMINO_RX_SCENE_PLANNING_H*/
@@ -85,4 +85,34 @@ AA_API struct aa_rx_sg *
 aa_rx_dl_sg( const char *filename, const char *name,
              struct aa_rx_sg *scenegraph);
 
+/**
+ * Type signature of compiled closed-form IK functions.
+ *
+ * @sa aa_rx_ik_analytic_gen()
+ */
+typedef size_t (*aa_rx_dl_ik_fun)( const double E[7], double *Q, size_t ldQ );
+
+struct aa_rx_sg_sub;
+struct aa_rx_ksol_opts;
+
+/**
+ * Dynamically load a compiled closed-form IK solver.
+ *
+ * @param filename   The name of the shared object, passed
+ *                   directly as the first parameter to dlopen().
+ *
+ * @param name       The name of the solver, as specified in the prior
+ *                   call to aa_rx_ik_analytic_gen().
+ *
+ * @param ssg        The chain the solver was generated for.
+ *
+ * @param opts       Solver options, or NULL.
+ *
+ * @sa aa_rx_ik_analytic_fun()
+ */
+AA_API struct aa_rx_ik_analytic_cx *
+aa_rx_dl_ik_analytic( const char *filename, const char *name,
+                      const struct aa_rx_sg_sub *ssg,
+                      const struct aa_rx_ksol_opts *opts );
+
 #endif /*AMINO_RX_SCENE_PLUGIN_H*/
@@ -106,11 +106,25 @@ aa_rx_sg_sub_frame( const struct aa_rx_sg_sub *sg_sub, size_t i );
 
 
 /**
- * Return the end-effector frame id, if any
+ * Return the (first) end-effector frame id, or AA_RX_FRAME_NONE
  */
 AA_API aa_rx_frame_id
 aa_rx_sg_sub_frame_ee( const struct aa_rx_sg_sub *sg_sub );
 
+/**
+ * Return the number of end-effector frames.
+ *
+ * Chains have one end-effector, trees have one for each tip.
+ */
+AA_API size_t
+aa_rx_sg_sub_ee_count( const struct aa_rx_sg_sub *sg_sub );
+
+/**
+ * Return the full scenegraph frame id for the i'th end-effector.
+ */
+AA_API aa_rx_frame_id
+aa_rx_sg_sub_ee( const struct aa_rx_sg_sub *sg_sub, size_t i );
+
 
 /**
  * Return the array of full scenegraph config ids contained in the sub-scenegraph.
@@ -147,6 +161,19 @@ aa_rx_sg_chain_create( const struct aa_rx_sg *sg,
                        aa_rx_frame_id root, aa_rx_frame_id tip );
 
 
+/**
+ * Create a sub-scenegraph for the tree of kinematic chains starting at
+ * root and ending at each of the tips.
+ *
+ * Frames shared by several chains, e.g., a torso, appear once.  The
+ * tips are the end-effectors of the sub-scenegraph, in the given
+ * order.
+ */
+AA_API struct aa_rx_sg_sub *
+aa_rx_sg_tree_create( const struct aa_rx_sg *sg,
+                      aa_rx_frame_id root,
+                      size_t n_tips, const aa_rx_frame_id *tips );
+
 /**
  * Fill q with the centered positions of each configuration.
  */
@@ -154,6 +181,22 @@ AA_API void
 aa_rx_sg_sub_center_configs( const struct aa_rx_sg_sub *ssg,
                              size_t n, double *q );
 
+/*-- Kinematics --*/
+
+/**
+ * Compute absolute transforms for only the frames of the sub-scenegraph.
+ *
+ * Entries of TF_abs for frames outside the sub-scenegraph are not
+ * updated.  Parents of the sub-scenegraph frames must already be
+ * valid in TF_abs, e.g., from a previous call to aa_rx_sg_tf().
+ *
+ * @see aa_rx_sg_tf_frames()
+ */
+AA_API void
+aa_rx_sg_sub_tf( const struct aa_rx_sg_sub *ssg,
+                 size_t n_q_all, const double *q_all,
+                 size_t n_tf, double *TF_abs, size_t ld_TF );
+
 /*-- Jacobians --*/
 
 /**
@@ -165,6 +208,11 @@ aa_rx_sg_sub_jacobian_size( const struct aa_rx_sg_sub *ssg,
 
 /**
  * Compute the Jacobian matrix for the sub-scenegraph.
+ *
+ * For multiple end-effectors, the Jacobians of each end-effector are
+ * stacked, i.e., rows 6*i through 6*i+5 are for end-effector i.
+ * Entries for configurations that do not move an end-effector are
+ * zero.
  */
 AA_API void
 aa_rx_sg_sub_jacobian( const struct aa_rx_sg_sub *ssg,
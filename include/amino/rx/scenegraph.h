@@ -460,6 +460,35 @@ AA_API void aa_rx_sg_tf_update
   double *TF_rel, size_t ld_rel,
   double *TF_abs, size_t ld_abs );
 
+/**
+ *  Compute absolute transforms for only the given frames.
+ *
+ *  Entries of TF_abs for frames not in the list are neither read nor
+ *  written, except as the parents of listed frames.  Such parent
+ *  entries must already be valid, e.g., from a previous call to
+ *  aa_rx_sg_tf().
+ *
+ * @param scene_graph The scene graph container
+ * @param n_q         Size of configuration vector q
+ * @param q           Configuraiton vector
+ * @param n_frames    Number of frames to update
+ * @param frames      Ids of the frames to update, ordered so that
+ *                    each frame follows its parent when the parent
+ *                    is also listed
+ * @param n_tf        Number of entries in the TF array
+ * @param TF_abs      Absolute transform matrix in quaternion-vector format
+ * @param ld_abs      Leading dimensional of TF_abs, i.e., space between each entry
+ *
+ * @pre aa_rx_sg_init() has been called after all frames were added to
+ * the scenegraph.
+ */
+AA_API void aa_rx_sg_tf_frames
+( const struct aa_rx_sg *scene_graph,
+  size_t n_q, const double *q,
+  size_t n_frames, const aa_rx_frame_id *frames,
+  size_t n_tf,
+  double *TF_abs, size_t ld_abs );
+
 
 
 /**
@@ -530,6 +559,12 @@ AA_API void aa_rx_sg_allow_collision( struct aa_rx_sg *scene_graph,
 AA_API void aa_rx_sg_allow_collision_name( struct aa_rx_sg *scene_graph,
                                            const char* frame0, const char* frame1, int allowed );
 
+/**
+ * Return non-zero if collisions between frames id0 and id1 are allowed.
+ */
+AA_API int aa_rx_sg_is_collision_allowed( const struct aa_rx_sg *scene_graph,
+                                          aa_rx_frame_id id0, aa_rx_frame_id id1 );
+
 
 
 /**
@@ -99,6 +99,12 @@ struct SceneFrame  {
 
     /* Geometry */
     std::vector<struct aa_rx_geom*> geometry;
+
+    /** Scene graph geometry version of the last change to this frame */
+    uint64_t geom_version;
+
+    /** Scene graph geometry version of the last change to E */
+    uint64_t tf_version;
 };
 
 
@@ -192,6 +198,12 @@ struct SceneGraph  {
     unsigned dirty_indices : 1;
     unsigned dirty_collision : 1;
     unsigned dirty_gl : 1;
+
+    /** Incremented on each geometry change */
+    uint64_t geom_version;
+
+    /** Geometry version of the last change not specific to a frame */
+    uint64_t geom_version_all;
 };
 
 }
@@ -211,6 +223,34 @@ aa_rx_sg_add_geom( struct aa_rx_sg *scene_graph, const char *frame,
 AA_API void
 aa_rx_sg_dirty_geom( struct aa_rx_sg *scene_graph );
 
+/**
+ * Mark the geometry of frame_id as changed.
+ */
+AA_API void
+aa_rx_sg_frame_dirty_geom( struct aa_rx_sg *scene_graph,
+                           aa_rx_frame_id frame_id );
+
+/**
+ * Return the geometry version of the scene graph.
+ *
+ * The version increases whenever geometry is added or marked dirty,
+ * or a frame is reparented.
+ */
+AA_API uint64_t
+aa_rx_sg_geom_version( const struct aa_rx_sg *scene_graph );
+
+/**
+ * Return the geometry version of the last change that may affect
+ * frame_id.
+ *
+ * Adding geometry to a frame or aa_rx_sg_frame_dirty_geom() changes
+ * only that frame, while aa_rx_sg_dirty_geom() changes all frames.
+ * Reparenting a frame changes the frame and its descendants.
+ */
+AA_API uint64_t
+aa_rx_sg_frame_geom_version( const struct aa_rx_sg *scene_graph,
+                             aa_rx_frame_id frame_id );
+
 AA_API void
 aa_rx_sg_ensure_clean_frames( const struct aa_rx_sg *scene_graph );
 
@@ -46,6 +46,9 @@
 
 
 
+(cffi:defcfun aa-rx-mp-reset :void
+  (mp rx-mp-t))
+
 (cffi:defcfun aa-rx-mp-set-start :void
   (mp rx-mp-t)
   (n-all size-t)
@@ -0,0 +1,318 @@
+/* -*- mode: C; c-basic-offset: 4; -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2016, Rice University
+ * All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of copyright holder the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <math.h>
+
+#include <amino.hpp>
+
+#include <amino/ct/state.h>
+#include <amino/ct/traj.h>
+#include <amino/ct/traj_internal.hpp>
+
+/* Number of samples when bracketing polynomial extrema */
+#define QUINTIC_SAMPLES 32
+
+/* Maximum number of passes to stretch individual segments */
+#define QUINTIC_PASSES 64
+
+/**
+ * Quintic spline trajectory segment context.
+ */
+struct aa_ct_seg_quintic_cx {
+    size_t n_q;  ///< Number of configurations
+    double t0;   ///< Start time
+    double t1;   ///< End time
+    double *c;   ///< Coefficients, 6 per configuration, constant term first
+};
+
+/**
+ * Evaluate a quintic and its first two derivatives by Horner's rule.
+ */
+static inline void
+quintic_eval( const double c[6], double t, double *x, double *dx, double *ddx )
+{
+    double p = c[5], dp = 0, ddp = 0;
+    for( int k = 4; k >= 0; k -- ) {
+        ddp = ddp*t + 2*dp;
+        dp = dp*t + p;
+        p = p*t + c[k];
+    }
+    *x = p;
+    *dx = dp;
+    *ddx = ddp;
+}
+
+static int
+aa_ct_seg_quintic_eval( struct aa_ct_seg *seg, struct aa_ct_state *state, double t )
+{
+    struct aa_ct_seg_quintic_cx *cx = (struct aa_ct_seg_quintic_cx *) seg->cx;
+    if( t < cx->t0 || t > cx->t1 ) return AA_CT_SEG_OUT;
+
+    double tau = t - cx->t0;
+    size_t n = AA_MIN( cx->n_q, state->n_q );
+    for( size_t j = 0; j < n; j ++ ) {
+        double x, dx, ddx;
+        quintic_eval( cx->c + 6*j, tau, &x, &dx, &ddx );
+        if( state->q ) state->q[j] = x;
+        if( state->dq ) state->dq[j] = dx;
+        if( state->ddq ) state->ddq[j] = ddx;
+    }
+
+    return AA_CT_SEG_IN;
+}
+
+/**
+ * Compute the packed coefficients of one configuration.
+ */
+static void
+quintic_param( double T, double x1, double dx1, double x2, double dx2, double c[6] )
+{
+    double ddx = 0;
+    c[0] = x1;
+    c[1] = dx1;
+    c[2] = ddx / 2;
+    aa_la_d_5spline_param( 1, T,
+                           &x1, 1, &dx1, 1, &ddx, 1,
+                           &x2, 1, &dx2, 1, &ddx, 1,
+                           c+3, c+4, c+5 );
+}
+
+static double
+poly_eval( size_t deg, const double *d, double t )
+{
+    double p = d[deg];
+    for( size_t k = deg; k > 0; k -- ) p = p*t + d[k-1];
+    return p;
+}
+
+/**
+ * Range of derivative `order` of a quintic over [0, T].
+ *
+ * Extrema are at the ends or at roots of the next derivative, which are
+ * bracketed by sampling and refined by bisection.
+ */
+static void
+quintic_range( const double c[6], double T, size_t order, double *lo, double *hi )
+{
+    /* Coefficients of the derivative and of its derivative */
+    double d[6], g[6];
+    AA_MEM_CPY(d, c, 6);
+    size_t deg = 5;
+    for( size_t o = 0; o < order; o ++, deg -- ) {
+        for( size_t k = 0; k < deg; k ++ ) d[k] = (double)(k+1) * d[k+1];
+    }
+    for( size_t k = 0; k < deg; k ++ ) g[k] = (double)(k+1) * d[k+1];
+
+    double f0 = poly_eval(deg, d, 0), f1 = poly_eval(deg, d, T);
+    *lo = AA_MIN(f0, f1);
+    *hi = AA_MAX(f0, f1);
+    if( deg < 2 ) return;
+
+    double ta = 0, ga = poly_eval(deg-1, g, 0);
+    for( size_t i = 1; i <= QUINTIC_SAMPLES; i ++ ) {
+        double tb = T * (double)i / QUINTIC_SAMPLES;
+        double gb = poly_eval(deg-1, g, tb);
+        if( (ga < 0) != (gb < 0) ) {
+            double a = ta, b = tb, sa = ga;
+            for( int k = 0; k < 50; k ++ ) {
+                double m = (a + b) / 2;
+                double sm = poly_eval(deg-1, g, m);
+                if( (sa < 0) == (sm < 0) ) { a = m; sa = sm; }
+                else { b = m; }
+            }
+            double f = poly_eval(deg, d, (a + b) / 2);
+            *lo = AA_MIN(*lo, f);
+            *hi = AA_MAX(*hi, f);
+        }
+        ta = tb;
+        ga = gb;
+    }
+}
+
+/* Ratio of a range to asymmetric limits */
+static double
+limit_ratio( double lo, double hi, double lim_min, double lim_max )
+{
+    double r = 0;
+    if( hi > 0 ) r = AA_MAX( r, hi / lim_max );
+    if( lo < 0 ) r = AA_MAX( r, lo / lim_min );
+    return r;
+}
+
+/**
+ * Velocities at the points from the neighboring segment slopes, zero
+ * at the ends and where the path reverses.
+ */
+static void
+quintic_velocities( size_t n_q, size_t n_k, const double *q, const double *T, double *dq )
+{
+    AA_MEM_ZERO( dq, n_q );
+    AA_MEM_ZERO( dq + n_k*n_q, n_q );
+    for( size_t k = 1; k < n_k; k ++ ) {
+        for( size_t j = 0; j < n_q; j ++ ) {
+            double m0 = (q[k*n_q+j] - q[(k-1)*n_q+j]) / T[k-1];
+            double m1 = (q[(k+1)*n_q+j] - q[k*n_q+j]) / T[k];
+            dq[k*n_q+j] = (m0*m1 > 0) ? (m0 + m1) / 2 : 0;
+        }
+    }
+}
+
+/**
+ * Compute the coefficients of every segment and the factor by which
+ * each segment exceeds the limits.
+ *
+ * The factor combines velocity, the square root of acceleration, and
+ * the cube root of jerk, so stretching a segment by the factor brings
+ * it within the limits.
+ */
+static double
+quintic_fit( size_t n_q, size_t n_k, const double *q, const double *T,
+             const struct aa_ct_limit *limits, const double *dddq_max,
+             double *dq, double *c, double *r )
+{
+    quintic_velocities( n_q, n_k, q, T, dq );
+
+    double r_max = 0;
+    for( size_t k = 0; k < n_k; k ++ ) {
+        r[k] = 0;
+        for( size_t j = 0; j < n_q; j ++ ) {
+            double *cj = c + 6*(k*n_q+j);
+            quintic_param( T[k], q[k*n_q+j], dq[k*n_q+j],
+                           q[(k+1)*n_q+j], dq[(k+1)*n_q+j], cj );
+
+            double lo, hi;
+            quintic_range( cj, T[k], 1, &lo, &hi );
+            r[k] = AA_MAX( r[k], limit_ratio(lo, hi, limits->min->dq[j], limits->max->dq[j]) );
+
+            quintic_range( cj, T[k], 2, &lo, &hi );
+            r[k] = AA_MAX( r[k], sqrt(limit_ratio(lo, hi, limits->min->ddq[j], limits->max->ddq[j])) );
+
+            if( dddq_max ) {
+                quintic_range( cj, T[k], 3, &lo, &hi );
+                r[k] = AA_MAX( r[k], cbrt(limit_ratio(lo, hi, -dddq_max[j], dddq_max[j])) );
+            }
+        }
+        r_max = AA_MAX( r_max, r[k] );
+    }
+    return r_max;
+}
+
+AA_API struct aa_ct_seg_list *
+aa_ct_tjq_quintic_generate( struct aa_mem_region *reg,
+                            struct aa_ct_pt_list *pt_list,
+                            struct aa_ct_limit *limits,
+                            const double *dddq_max )
+{
+    size_t n_p = pt_list->list.size();
+    if( n_p < 2 ) return NULL;
+
+    struct aa_ct_seg_list *list = new(reg) struct aa_ct_seg_list();
+    size_t n_q = list->n_q = pt_list->list.front()->state.n_q;
+    size_t n_k = n_p - 1;
+
+    struct aa_mem_region *local = aa_mem_region_local_get();
+    double *q = AA_MEM_REGION_NEW_N(local, double, n_q*n_p);
+    double *dq = AA_MEM_REGION_NEW_N(local, double, n_q*n_p);
+    double *T = AA_MEM_REGION_NEW_N(local, double, n_k);
+    double *r = AA_MEM_REGION_NEW_N(local, double, n_k);
+
+    /* Headers, then contexts, then coefficients, all in time order */
+    aa_ct_seg_list_reserve( list, n_k );
+    struct aa_ct_seg_quintic_cx *cx = AA_MEM_REGION_NEW_N(&list->reg, struct aa_ct_seg_quintic_cx, n_k);
+    double *c = AA_MEM_REGION_NEW_N(&list->reg, double, 6*n_q*n_k);
+
+    {
+        size_t k = 0;
+        for( struct aa_ct_pt *pt = pt_list->list.front(); pt; pt = pt->next, k++ ) {
+            AA_MEM_CPY( q + k*n_q, pt->state.q, n_q );
+        }
+    }
+
+    /* Initial durations: the rest-to-rest quintic peaks are 15/8,
+     * 10/sqrt(3), and 60 times the distance over powers of time. */
+    for( size_t k = 0; k < n_k; k ++ ) {
+        T[k] = DBL_EPSILON;
+        for( size_t j = 0; j < n_q; j ++ ) {
+            double d = q[(k+1)*n_q+j] - q[k*n_q+j];
+            double v = (d > 0) ? limits->max->dq[j] : -limits->min->dq[j];
+            double a = AA_MIN( limits->max->ddq[j], -limits->min->ddq[j] );
+            T[k] = AA_MAX( T[k], 15./8 * fabs(d) / v );
+            T[k] = AA_MAX( T[k], sqrt( 10/sqrt(3) * fabs(d) / a ) );
+            if( dddq_max ) T[k] = AA_MAX( T[k], cbrt( 60 * fabs(d) / dddq_max[j] ) );
+        }
+    }
+
+    /* Stretch the segments that exceed the limits */
+    double r_max = 0;
+    for( size_t i = 0; i < QUINTIC_PASSES; i ++ ) {
+        r_max = quintic_fit( n_q, n_k, q, T, limits, dddq_max, dq, c, r );
+        if( r_max <= 1 ) break;
+        for( size_t k = 0; k < n_k; k ++ ) {
+            if( r[k] > 1 ) T[k] *= r[k];
+        }
+    }
+
+    /* Uniform stretching scales every derivative alike */
+    if( r_max > 1 ) {
+        for( size_t k = 0; k < n_k; k ++ ) T[k] *= r_max;
+        quintic_fit( n_q, n_k, q, T, limits, dddq_max, dq, c, r );
+    }
+
+    /* Segments */
+    double t = 0;
+    for( size_t k = 0; k < n_k; k ++ ) {
+        cx[k].n_q = n_q;
+        cx[k].t0 = t;
+        cx[k].t1 = t + T[k];
+        cx[k].c = c + 6*k*n_q;
+
+        struct aa_ct_seg seg;
+        AA_MEM_ZERO(&seg,1);
+        seg.type = AA_CT_QUINTIC_SEG;
+        seg.eval = aa_ct_seg_quintic_eval;
+        seg.cx = &cx[k];
+        seg.t0 = cx[k].t0;
+        seg.t1 = cx[k].t1;
+        aa_ct_seg_list_add( list, &seg );
+
+        t = cx[k].t1;
+    }
+    list->duration = t;
+    aa_ct_seg_list_index(list);
+
+    aa_mem_region_pop(local, q);
+
+    return list;
+}
@@ -0,0 +1,344 @@
+/* -*- mode: C; c-basic-offset: 4; -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2016, Rice University
+ * All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of copyright holder the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <stdatomic.h>
+
+#include <amino.h>
+#include <amino/ct/state.h>
+#include <amino/ct/traj.h>
+#include <amino/ct/stream.h>
+
+/*
+ * Each slot has one atomic state word holding the tick of the slot, a
+ * generation counter, and a flag.  The producer publishes a slot by
+ * marking it BUSY, writing the data, and marking it READY with a new
+ * generation.  The consumer copies a READY slot and then claims it by
+ * compare-and-swap to DONE; if the producer rewrote the slot meanwhile,
+ * the swap fails and the copy is discarded.  A splice claims the slot
+ * at its tick by compare-and-swap from READY to BUSY, so exactly one of
+ * the consumer and the splice wins that slot.  The generation prevents
+ * a rewrite of the same tick from looking unchanged to the consumer.
+ *
+ * Since the consumer may copy a slot while the producer rewrites it,
+ * the slot data is accessed with relaxed atomic loads and stores, and
+ * the state word orders them.
+ */
+
+#define STREAM_READY 0
+#define STREAM_BUSY  1
+#define STREAM_DONE  2
+
+#define STREAM_GEN_MASK 0x3fff
+
+/* Consumer attempts before reporting an unavailable setpoint */
+#define STREAM_POP_TRIES 4
+
+static inline uint64_t
+stream_state( uint64_t tick, uint64_t gen, unsigned flag )
+{
+    return (tick << 16) | ((gen & STREAM_GEN_MASK) << 2) | flag;
+}
+
+static inline uint64_t stream_state_tick( uint64_t s ) { return s >> 16; }
+static inline uint64_t stream_state_gen( uint64_t s ) { return (s >> 2) & STREAM_GEN_MASK; }
+static inline unsigned stream_state_flag( uint64_t s ) { return (unsigned)(s & 3); }
+
+struct aa_ct_stream_slot {
+    _Atomic uint64_t state;
+};
+
+struct aa_ct_stream {
+    size_t n_q;     ///< Number of configurations
+    size_t cap;     ///< Number of slots
+    double dt;      ///< Setpoint period
+
+    struct aa_ct_stream_slot *slot; ///< Slot states
+    _Atomic double *data; ///< Slot data, q, dq, and ddq for each slot
+
+    /* Shared */
+    char pad0[64];
+    _Atomic uint64_t read;  ///< Next tick to pop
+    char pad1[64];
+
+    /* Producer only */
+    uint64_t write;                      ///< Next tick to fill
+    const struct aa_ct_seg_list *cur;    ///< Current trajectory
+    uint64_t cur_start;                  ///< Tick at start of cur
+    size_t cur_hint;                     ///< Segment hint for cur
+    const struct aa_ct_seg_list *next;   ///< Pending trajectory
+    uint64_t next_start;                 ///< Tick at start of next
+    struct aa_mem_region reg;            ///< Evaluation workspace
+    struct aa_ct_state *state;           ///< Evaluation state
+};
+
+static _Atomic double *
+stream_data( const struct aa_ct_stream *stream, uint64_t tick )
+{
+    return stream->data + 3 * stream->n_q * (tick % stream->cap);
+}
+
+static void
+stream_data_store( _Atomic double *dst, const double *src, size_t n )
+{
+    for( size_t i = 0; i < n; i ++ ) {
+        atomic_store_explicit( dst + i, src[i], memory_order_relaxed );
+    }
+}
+
+static void
+stream_data_load( double *dst, _Atomic double *src, size_t n )
+{
+    for( size_t i = 0; i < n; i ++ ) {
+        dst[i] = atomic_load_explicit( src + i, memory_order_relaxed );
+    }
+}
+
+static struct aa_ct_stream_slot *
+stream_slot( const struct aa_ct_stream *stream, uint64_t tick )
+{
+    return stream->slot + (tick % stream->cap);
+}
+
+AA_API struct aa_ct_stream *
+aa_ct_stream_create( size_t n_q, size_t capacity, double dt )
+{
+    if( 0 == capacity || !(dt > 0) ) return NULL;
+
+    struct aa_ct_stream *stream = AA_NEW0(struct aa_ct_stream);
+    stream->n_q = n_q;
+    stream->cap = capacity;
+    stream->dt = dt;
+    stream->slot = AA_NEW_AR(struct aa_ct_stream_slot, capacity);
+    stream->data = AA_NEW_AR(_Atomic double, 3*n_q*capacity);
+    for( size_t i = 0; i < capacity; i ++ ) {
+        atomic_init( &stream->slot[i].state, stream_state(0, 0, STREAM_BUSY) );
+    }
+    for( size_t i = 0; i < 3*n_q*capacity; i ++ ) {
+        atomic_init( &stream->data[i], 0.0 );
+    }
+    atomic_init( &stream->read, 0 );
+
+    aa_mem_region_init( &stream->reg, 1024 );
+    stream->state = aa_ct_state_alloc( &stream->reg, n_q, 0 );
+
+    return stream;
+}
+
+AA_API void
+aa_ct_stream_destroy( struct aa_ct_stream *stream )
+{
+    aa_mem_region_destroy( &stream->reg );
+    free( stream->slot );
+    free( stream->data );
+    free( stream );
+}
+
+AA_API double
+aa_ct_stream_dt( const struct aa_ct_stream *stream )
+{
+    return stream->dt;
+}
+
+AA_API uint64_t
+aa_ct_stream_read_tick( const struct aa_ct_stream *stream )
+{
+    return atomic_load_explicit( (_Atomic uint64_t*)&stream->read, memory_order_acquire );
+}
+
+AA_API uint64_t
+aa_ct_stream_write_tick( const struct aa_ct_stream *stream )
+{
+    return stream->write;
+}
+
+/*
+ * Sample trajectory segs, started at tick start, at tick.  After the
+ * end, hold the final configuration at rest.  Return nonzero, leaving
+ * x unchanged, if segs has no state at the time.
+ */
+static int
+stream_sample( struct aa_ct_stream *stream,
+               const struct aa_ct_seg_list *segs, uint64_t start, size_t *hint,
+               uint64_t tick, double *x )
+{
+    size_t n_q = stream->n_q;
+    struct aa_ct_state *state = stream->state;
+    double duration = aa_ct_seg_list_duration( segs );
+    double t = (double)(tick - start) * stream->dt;
+    int hold = t >= duration;
+    if( hold ) t = duration;
+
+    if( AA_CT_SEG_IN != aa_ct_seg_list_eval_hint( segs, state, t, hint ) )
+        return -1;
+
+    AA_MEM_CPY( x, state->q, n_q );
+    if( hold ) {
+        AA_MEM_ZERO( x + n_q, 2*n_q );
+    } else {
+        AA_MEM_CPY( x + n_q, state->dq, n_q );
+        AA_MEM_CPY( x + 2*n_q, state->ddq, n_q );
+    }
+    return 0;
+}
+
+/* Write and publish the setpoint for tick */
+static void
+stream_publish( struct aa_ct_stream *stream, uint64_t tick, const double *x )
+{
+    struct aa_ct_stream_slot *slot = stream_slot( stream, tick );
+    uint64_t gen = stream_state_gen( atomic_load_explicit(&slot->state, memory_order_relaxed) ) + 1;
+
+    atomic_store_explicit( &slot->state, stream_state(tick, gen, STREAM_BUSY),
+                           memory_order_relaxed );
+    atomic_thread_fence( memory_order_release );
+
+    stream_data_store( stream_data(stream, tick), x, 3*stream->n_q );
+
+    atomic_store_explicit( &slot->state, stream_state(tick, gen, STREAM_READY),
+                           memory_order_release );
+}
+
+AA_API int
+aa_ct_stream_splice( struct aa_ct_stream *stream,
+                     const struct aa_ct_seg_list *segs,
+                     uint64_t tick )
+{
+    if( aa_ct_seg_list_n_q(segs) != stream->n_q ) return -1;
+
+    /* Not yet filled: switch when the fill reaches the tick */
+    if( tick >= stream->write ) {
+        stream->next = segs;
+        stream->next_start = tick;
+        return 0;
+    }
+
+    if( tick < aa_ct_stream_read_tick(stream) ) return -1;
+
+    /* Sample first to keep the consumer's wait short */
+    size_t hint = 0;
+    double x[3*stream->n_q];
+    if( stream_sample( stream, segs, tick, &hint, tick, x ) ) return -1;
+
+    /* Claim the slot at the tick, blocking the consumer there */
+    struct aa_ct_stream_slot *slot = stream_slot( stream, tick );
+    uint64_t s = atomic_load_explicit( &slot->state, memory_order_acquire );
+    if( stream_state_tick(s) != tick || STREAM_READY != stream_state_flag(s) ||
+        !atomic_compare_exchange_strong_explicit(
+            &slot->state, &s,
+            stream_state(tick, stream_state_gen(s), STREAM_BUSY),
+            memory_order_acq_rel, memory_order_acquire ) )
+    {
+        return -1;
+    }
+
+    /* Retract the later setpoints of the old trajectory */
+    for( uint64_t i = tick + 1; i < stream->write; i ++ ) {
+        struct aa_ct_stream_slot *si = stream_slot( stream, i );
+        uint64_t gen = stream_state_gen( atomic_load_explicit(&si->state, memory_order_relaxed) );
+        atomic_store_explicit( &si->state, stream_state(i, gen, STREAM_BUSY),
+                               memory_order_relaxed );
+    }
+
+    stream_publish( stream, tick, x );
+
+    stream->cur = segs;
+    stream->cur_start = tick;
+    stream->cur_hint = hint;
+    stream->next = NULL;
+    stream->write = tick + 1;
+
+    return 0;
+}
+
+AA_API size_t
+aa_ct_stream_fill( struct aa_ct_stream *stream, size_t max_n )
+{
+    double x[3*stream->n_q];
+    uint64_t read = aa_ct_stream_read_tick( stream );
+    size_t n = 0;
+
+    while( (0 == max_n || n < max_n) && stream->write - read < stream->cap ) {
+        if( stream->next && stream->write >= stream->next_start ) {
+            stream->cur = stream->next;
+            stream->cur_start = stream->next_start;
+            stream->cur_hint = 0;
+            stream->next = NULL;
+        }
+        if( NULL == stream->cur ) break;
+
+        if( stream_sample( stream, stream->cur, stream->cur_start,
+                           &stream->cur_hint, stream->write, x ) )
+            break;
+        stream_publish( stream, stream->write, x );
+        stream->write++;
+        n++;
+    }
+
+    return n;
+}
+
+AA_API int
+aa_ct_stream_pop( struct aa_ct_stream *stream, uint64_t *tick,
+                  double *q, double *dq, double *ddq )
+{
+    size_t n_q = stream->n_q;
+    uint64_t r = atomic_load_explicit( &stream->read, memory_order_relaxed );
+    struct aa_ct_stream_slot *slot = stream_slot( stream, r );
+    _Atomic double *x = stream_data( stream, r );
+
+    for( int i = 0; i < STREAM_POP_TRIES; i ++ ) {
+        uint64_t s = atomic_load_explicit( &slot->state, memory_order_acquire );
+        if( stream_state_tick(s) != r || STREAM_READY != stream_state_flag(s) )
+            return -1;
+
+        if( q ) stream_data_load( q, x, n_q );
+        if( dq ) stream_data_load( dq, x + n_q, n_q );
+        if( ddq ) stream_data_load( ddq, x + 2*n_q, n_q );
+        /* Order the copy before the claim */
+        atomic_thread_fence( memory_order_acquire );
+
+        if( atomic_compare_exchange_strong_explicit(
+                &slot->state, &s,
+                stream_state(r, stream_state_gen(s), STREAM_DONE),
+                memory_order_acq_rel, memory_order_relaxed ) )
+        {
+            if( tick ) *tick = r;
+            atomic_store_explicit( &stream->read, r + 1, memory_order_release );
+            return 0;
+        }
+    }
+
+    return -1;
+}
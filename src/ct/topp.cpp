@@ -0,0 +1,699 @@
+/* -*- mode: C; c-basic-offset: 4; -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2016, Rice University
+ * All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of copyright holder the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <math.h>
+
+#include <amino.hpp>
+
+#include <amino/ct/state.h>
+#include <amino/ct/traj.h>
+#include <amino/ct/traj_internal.hpp>
+
+/*
+ * Time-optimal path parameterization by reachability analysis
+ * (TOPP-RA).
+ *
+ * The path q(s) is discretized into intervals [s_i, s_{i+1}].  With
+ * x = ds^2 and u = dds constant over each interval, joint velocity,
+ * acceleration, and effort are linear in (x, u), and x_{i+1} = x_i +
+ * 2*h_i*u_i.  A backward pass computes the controllable set K_i of
+ * each x_i, a small two-variable linear program per interval.  A
+ * forward pass then greedily takes the largest u_i that stays inside
+ * K_{i+1}.
+ */
+
+/* Bounds that keep every stage program bounded */
+#define TOPP_X_MAX 1e10
+#define TOPP_U_MAX 1e10
+
+/*
+ * Acceleration and effort constraints are enforced at the ends and the
+ * middle of each interval, which bounds the violation between grid
+ * points.
+ */
+#define TOPP_POINTS 3
+
+/* Relative feasibility tolerance */
+#define TOPP_TOL 1e-9
+
+struct aa_ct_topp_opts {
+    size_t n_grid;
+    aa_ct_topp_dyn_fun *dyn;
+    void *dyn_cx;
+    double tol;
+};
+
+AA_API struct aa_ct_topp_opts *
+aa_ct_topp_opts_create( void )
+{
+    struct aa_ct_topp_opts *opts = AA_NEW0(struct aa_ct_topp_opts);
+    opts->n_grid = 200;
+    return opts;
+}
+
+AA_API void
+aa_ct_topp_opts_destroy( struct aa_ct_topp_opts *opts )
+{
+    free(opts);
+}
+
+AA_API void
+aa_ct_topp_opts_set_grid( struct aa_ct_topp_opts *opts, size_t n )
+{
+    opts->n_grid = n;
+}
+
+AA_API void
+aa_ct_topp_opts_set_tolerance( struct aa_ct_topp_opts *opts, double tol )
+{
+    opts->tol = tol;
+}
+
+AA_API void
+aa_ct_topp_opts_set_dynamics( struct aa_ct_topp_opts *opts,
+                              aa_ct_topp_dyn_fun *fun, void *cx )
+{
+    opts->dyn = fun;
+    opts->dyn_cx = cx;
+}
+
+/**
+ * Cubic spline path, parameterized by chord length.
+ *
+ * Without a tolerance, the path passes through the waypoints.
+ * Tangents are limited so that each joint is monotone over each
+ * piece.  The path therefore stays within the axis-aligned box
+ * spanned by consecutive waypoints: it never leaves the range of
+ * the waypoints in any joint, and deviates from the straight segment
+ * between two waypoints by at most their difference in each joint.
+ *
+ * With a tolerance, the path follows the straight segments and
+ * rounds each interior waypoint with a quadratic blend that stays
+ * within the tolerance of the waypoint.
+ */
+struct topp_path {
+    size_t n_q;  ///< Number of configurations
+    size_t n_k;  ///< Number of spline pieces
+    double *s;   ///< Knot path positions, n_k+1
+    double *q;   ///< Knot configurations, n_q x (n_k+1)
+    double *dq;  ///< Knot tangents, n_q x (n_k+1)
+    double *a2;  ///< Quadratic coefficients, n_q x n_k
+    double *a3;  ///< Cubic coefficients, n_q x n_k
+};
+
+static void
+topp_path_eval( const struct topp_path *path, size_t k, double s,
+                double *q, double *dq, double *ddq )
+{
+    size_t n_q = path->n_q;
+    aa_la_d_3spline( n_q, s - path->s[k],
+                     path->q + k*n_q, 1, path->dq + k*n_q, 1,
+                     path->a2 + k*n_q, path->a3 + k*n_q,
+                     q, 1, dq, 1, ddq, 1 );
+}
+
+/* Slope of joint j over piece k */
+static double
+topp_path_secant( const struct topp_path *path, size_t k, size_t j )
+{
+    size_t n_q = path->n_q;
+    return (path->q[(k+1)*n_q+j] - path->q[k*n_q+j]) / (path->s[k+1] - path->s[k]);
+}
+
+/* Knot k of the path at w + d*u, with tangent u */
+static void
+topp_path_knot( struct topp_path *path, size_t k, double s,
+                const double *w, double d, const double *u )
+{
+    size_t n_q = path->n_q;
+    path->s[k] = s;
+    for( size_t j = 0; j < n_q; j ++ ) {
+        path->q[k*n_q+j] = w[j] + d*u[j];
+        path->dq[k*n_q+j] = u[j];
+    }
+}
+
+/*
+ * Replace the corners of the polyline through the knots with
+ * quadratic blends.
+ *
+ * The blend at waypoint w starts at a = w - d*u0 and ends at b = w +
+ * d*u1, where u0 and u1 are the unit directions of the adjoining
+ * segments.  Its control point is w, so with tangents u0 at a and u1
+ * at b over length 2*d, the cubic piece is exactly the quadratic.
+ * The blend comes closest to w at its midpoint, at distance
+ * d*|u1-u0|/4, so d is chosen to keep that within tol.  Each blend
+ * takes at most half of each adjoining segment.
+ */
+static void
+topp_path_blend( struct aa_mem_region *reg, struct topp_path *path, double tol )
+{
+    size_t n_q = path->n_q;
+    size_t n_w = path->n_k + 1;
+    const double *w = path->q;
+    const double *sw = path->s;
+    double L = sw[n_w-1];
+
+    /* Segment directions and blend distances */
+    double *u = AA_MEM_REGION_NEW_N(reg, double, n_q*(n_w-1));
+    for( size_t k = 0; k+1 < n_w; k ++ ) {
+        double len = sw[k+1] - sw[k];
+        for( size_t j = 0; j < n_q; j ++ ) {
+            u[k*n_q+j] = (w[(k+1)*n_q+j] - w[k*n_q+j]) / len;
+        }
+    }
+    double *d = AA_MEM_REGION_NEW_N(reg, double, n_w);
+    d[0] = d[n_w-1] = 0;
+    for( size_t i = 1; i+1 < n_w; i ++ ) {
+        double turn = sqrt(aa_la_ssd(n_q, u + (i-1)*n_q, u + i*n_q));
+        d[i] = (turn > 0)
+            ? AA_MIN( 4*tol/turn, AA_MIN(sw[i]-sw[i-1], sw[i+1]-sw[i]) / 2 )
+            : 0;
+    }
+
+    /* Knots: the start, both ends of each blend, and the goal.
+     * Straight pieces of negligible length are dropped. */
+    struct topp_path blend = *path;
+    blend.s = AA_MEM_REGION_NEW_N(reg, double, 2*n_w-2);
+    blend.q = AA_MEM_REGION_NEW_N(reg, double, n_q*(2*n_w-2));
+    blend.dq = AA_MEM_REGION_NEW_N(reg, double, n_q*(2*n_w-2));
+
+    size_t k = 0;
+    double s = 0;       /* position on the blended path */
+    double p = 0;       /* position on the polyline of the last knot */
+    double eps = L * 1e-12;
+    topp_path_knot( &blend, k++, s, w, 0, u );
+    for( size_t i = 1; i+1 < n_w; i ++ ) {
+        if( 0 == d[i] ) continue;
+        double len = sw[i] - d[i] - p;
+        if( len > eps ) {
+            s += len;
+            topp_path_knot( &blend, k++, s, w + i*n_q, -d[i], u + (i-1)*n_q );
+        }
+        s += 2*d[i];
+        topp_path_knot( &blend, k++, s, w + i*n_q, d[i], u + i*n_q );
+        p = sw[i] + d[i];
+    }
+    s += L - p;
+    topp_path_knot( &blend, k++, s, w + (n_w-1)*n_q, 0, u + (n_w-2)*n_q );
+
+    blend.n_k = k - 1;
+    *path = blend;
+}
+
+/*
+ * Build the path, dropping repeated waypoints.  If all waypoints
+ * coincide, the path is a single piece of zero length.
+ */
+static struct topp_path *
+topp_path_create( struct aa_mem_region *reg, struct aa_ct_pt_list *list,
+                  double tol )
+{
+    size_t n_p = list->list.size();
+    if( n_p < 1 ) return NULL;
+
+    struct topp_path *path = AA_MEM_REGION_NEW(reg, struct topp_path);
+    size_t n_q = path->n_q = list->list.front()->state.n_q;
+    path->q = AA_MEM_REGION_NEW_N(reg, double, n_q*AA_MAX(n_p,2));
+
+    /* Knots */
+    size_t k = 0;
+    for( struct aa_ct_pt *pt = list->list.front(); pt; pt = pt->next ) {
+        if( k > 0 && 0 == aa_la_ssd(n_q, path->q + (k-1)*n_q, pt->state.q) ) continue;
+        AA_MEM_CPY(path->q + k*n_q, pt->state.q, n_q);
+        k++;
+    }
+    if( 1 == k ) {
+        AA_MEM_CPY(path->q + n_q, path->q, n_q);
+        k++;
+    }
+    size_t n_k = path->n_k = k - 1;
+
+    path->s = AA_MEM_REGION_NEW_N(reg, double, n_k+1);
+    path->s[0] = 0;
+    for( k = 1; k <= n_k; k ++ ) {
+        path->s[k] = path->s[k-1]
+            + sqrt(aa_la_ssd(n_q, path->q + (k-1)*n_q, path->q + k*n_q));
+    }
+
+    if( 0 == path->s[n_k] ) {
+        path->dq = AA_MEM_REGION_NEW_N(reg, double, n_q*(n_k+1));
+        path->a2 = AA_MEM_REGION_NEW_N(reg, double, n_q*n_k);
+        path->a3 = AA_MEM_REGION_NEW_N(reg, double, n_q*n_k);
+        AA_MEM_ZERO(path->dq, n_q*(n_k+1));
+        AA_MEM_ZERO(path->a2, n_q*n_k);
+        AA_MEM_ZERO(path->a3, n_q*n_k);
+        return path;
+    }
+
+    if( tol > 0 ) {
+        topp_path_blend( reg, path, tol );
+        n_k = path->n_k;
+    } else {
+        /* Tangents: one-sided at the ends, central in the interior.
+         * Zero where a joint reverses, and otherwise at most three
+         * times either adjacent slope, which keeps each piece
+         * monotone (Fritsch-Carlson). */
+        path->dq = AA_MEM_REGION_NEW_N(reg, double, n_q*(n_k+1));
+        for( k = 0; k <= n_k; k ++ ) {
+            size_t k0 = (k > 0) ? k-1 : k;
+            size_t k1 = (k < n_k) ? k+1 : k;
+            double ds = path->s[k1] - path->s[k0];
+            for( size_t j = 0; j < n_q; j ++ ) {
+                double d0 = topp_path_secant( path, (k > 0) ? k-1 : k, j );
+                double d1 = topp_path_secant( path, (k < n_k) ? k : k-1, j );
+                double m = 0;
+                if( d0*d1 > 0 ) {
+                    m = (path->q[k1*n_q+j] - path->q[k0*n_q+j]) / ds;
+                    m = copysign( AA_MIN(fabs(m), 3*AA_MIN(fabs(d0), fabs(d1))), d0 );
+                }
+                path->dq[k*n_q+j] = m;
+            }
+        }
+    }
+
+    /* Coefficients */
+    path->a2 = AA_MEM_REGION_NEW_N(reg, double, n_q*n_k);
+    path->a3 = AA_MEM_REGION_NEW_N(reg, double, n_q*n_k);
+    for( k = 0; k < n_k; k ++ ) {
+        aa_la_d_3spline_param( n_q, path->s[k+1] - path->s[k],
+                               path->q + k*n_q, 1, path->dq + k*n_q, 1,
+                               path->q + (k+1)*n_q, 1, path->dq + (k+1)*n_q, 1,
+                               path->a2 + k*n_q, path->a3 + k*n_q );
+    }
+
+    return path;
+}
+
+/**
+ * Retimed path interval.
+ */
+struct aa_ct_seg_topp_cx {
+    const struct topp_path *path; ///< Spline path
+    size_t k;    ///< Spline piece
+    double s0;   ///< Start path position
+    double s1;   ///< End path position
+    double ds0;  ///< Start path velocity
+    double u;    ///< Path acceleration
+    double t0;   ///< Start time
+    double t1;   ///< End time
+};
+
+static int
+aa_ct_seg_topp_eval( struct aa_ct_seg *seg, struct aa_ct_state *state, double t )
+{
+    struct aa_ct_seg_topp_cx *cx = (struct aa_ct_seg_topp_cx *) seg->cx;
+    if( t < cx->t0 || t > cx->t1 ) return AA_CT_SEG_OUT;
+
+    double tau = t - cx->t0;
+    double s = AA_MIN( cx->s1, AA_MAX( cx->s0, cx->s0 + cx->ds0*tau + cx->u*tau*tau/2 ) );
+    double ds = AA_MAX( 0, cx->ds0 + cx->u*tau );
+
+    size_t n_q = cx->path->n_q;
+    double q[n_q], dq[n_q], ddq[n_q];
+    topp_path_eval( cx->path, cx->k, s, q, dq, ddq );
+
+    size_t n = AA_MIN( n_q, state->n_q );
+    if( state->q ) AA_MEM_CPY( state->q, q, n );
+    if( state->dq ) {
+        for( size_t j = 0; j < n; j ++ ) state->dq[j] = dq[j]*ds;
+    }
+    if( state->ddq ) {
+        for( size_t j = 0; j < n; j ++ ) state->ddq[j] = ddq[j]*ds*ds + dq[j]*cx->u;
+    }
+
+    return AA_CT_SEG_IN;
+}
+
+static void
+topp_seg_add( struct aa_ct_seg_list *list, const struct topp_path *path,
+              size_t k, double s0, double s1, double ds0, double u,
+              double t0, double t1 )
+{
+    struct aa_ct_seg_topp_cx *cx = AA_MEM_REGION_NEW(&list->reg, struct aa_ct_seg_topp_cx);
+    cx->path = path;
+    cx->k = k;
+    cx->s0 = s0;
+    cx->s1 = s1;
+    cx->ds0 = ds0;
+    cx->u = u;
+    cx->t0 = t0;
+    cx->t1 = t1;
+
+    struct aa_ct_seg seg;
+    AA_MEM_ZERO(&seg,1);
+    seg.type = AA_CT_TOPP_SEG;
+    seg.eval = aa_ct_seg_topp_eval;
+    seg.cx = cx;
+    seg.t0 = t0;
+    seg.t1 = t1;
+    aa_ct_seg_list_add( list, &seg );
+}
+
+/**
+ * Path derivatives and effort coefficients at a point of an interval.
+ */
+struct topp_point {
+    double *dq;   ///< First path derivative
+    double *ddq;  ///< Second path derivative
+    double *a;    ///< Effort coefficient of u
+    double *b;    ///< Effort coefficient of x
+    double *c;    ///< Constant effort
+};
+
+/**
+ * Linear constraints A*x + B*u <= C for one interval.
+ */
+struct topp_stage {
+    size_t m;
+    double *A, *B, *C;
+};
+
+static void
+topp_stage_add( struct topp_stage *st, double a, double b, double c )
+{
+    st->A[st->m] = a;
+    st->B[st->m] = b;
+    st->C[st->m] = c;
+    st->m++;
+}
+
+/* Add lo <= a*x + b*u <= hi, skipping infinite bounds */
+static void
+topp_stage_add2( struct topp_stage *st, double a, double b, double lo, double hi )
+{
+    if( isfinite(hi) ) topp_stage_add( st, a, b, hi );
+    if( isfinite(lo) ) topp_stage_add( st, -a, -b, -lo );
+}
+
+/*
+ * Constraints at a point of an interval, where x at the point is
+ * x_e = x + w*u.
+ */
+static void
+topp_stage_point( struct topp_stage *st, size_t n_q,
+                  const struct topp_point *p, double w,
+                  const struct aa_ct_limit *limits, int effort )
+{
+    for( size_t j = 0; j < n_q; j ++ ) {
+        /* ddq = q'' x_e + q' u */
+        topp_stage_add2( st, p->ddq[j], w*p->ddq[j] + p->dq[j],
+                         limits->min->ddq[j], limits->max->ddq[j] );
+        /* eff = b x_e + a u + c */
+        if( effort ) {
+            topp_stage_add2( st, p->b[j], w*p->b[j] + p->a[j],
+                             limits->min->eff[j] - p->c[j],
+                             limits->max->eff[j] - p->c[j] );
+        }
+    }
+}
+
+/* All constraints for interval i */
+static void
+topp_stage_build( struct topp_stage *st, size_t n_q, const double *s,
+                  const double *K_lo, const double *K_hi,
+                  const struct topp_point *p, const double *x_max, size_t i,
+                  const struct aa_ct_limit *limits, int effort )
+{
+    double w = 2*(s[i+1] - s[i]);
+    st->m = 0;
+    topp_stage_add( st, -1, 0, 0 );
+    topp_stage_add( st, 1, 0, AA_MIN(TOPP_X_MAX, x_max[i]) );
+    topp_stage_add( st, 1, w, AA_MIN(TOPP_X_MAX, x_max[i]) );
+    topp_stage_add2( st, 0, 1, -TOPP_U_MAX, TOPP_U_MAX );
+    topp_stage_add2( st, 1, w, K_lo[i+1], K_hi[i+1] );
+    for( size_t l = 0; l < TOPP_POINTS; l ++ ) {
+        topp_stage_point( st, n_q, p + TOPP_POINTS*i + l,
+                          w * (double)l / (TOPP_POINTS-1), limits, effort );
+    }
+}
+
+static int
+topp_feasible( const struct topp_stage *st, double x, double u )
+{
+    for( size_t k = 0; k < st->m; k ++ ) {
+        if( st->A[k]*x + st->B[k]*u - st->C[k] > TOPP_TOL*(1 + fabs(st->C[k])) )
+            return 0;
+    }
+    return 1;
+}
+
+/*
+ * Range of x over the feasible polygon, by enumerating its vertices.
+ * The programs are tiny, so this is simpler and more robust than a
+ * general solver.
+ */
+static int
+topp_stage_range( const struct topp_stage *st, double *x_min, double *x_max )
+{
+    double lo = INFINITY, hi = -INFINITY;
+    for( size_t i = 0; i < st->m; i ++ ) {
+        for( size_t j = i+1; j < st->m; j ++ ) {
+            double p = st->A[i]*st->B[j], q = st->A[j]*st->B[i];
+            double det = p - q;
+            if( fabs(det) <= TOPP_TOL*(fabs(p) + fabs(q)) ) continue;
+            double x = (st->C[i]*st->B[j] - st->C[j]*st->B[i]) / det;
+            double u = (st->A[i]*st->C[j] - st->A[j]*st->C[i]) / det;
+            if( topp_feasible(st, x, u) ) {
+                lo = AA_MIN(lo, x);
+                hi = AA_MAX(hi, x);
+            }
+        }
+    }
+    if( lo > hi ) return -1;
+
+    *x_min = AA_MAX(0, lo);
+    *x_max = AA_MAX(0, hi);
+    return 0;
+}
+
+/* Largest feasible u for fixed x */
+static double
+topp_stage_u_max( const struct topp_stage *st, double x )
+{
+    double u = TOPP_U_MAX;
+    for( size_t k = 0; k < st->m; k ++ ) {
+        if( st->B[k] > 0 ) {
+            u = AA_MIN( u, (st->C[k] - st->A[k]*x) / st->B[k] );
+        }
+    }
+    return u;
+}
+
+/*
+ * Velocity limit on x over the interval [s0, s1] of piece k.
+ *
+ * Since x is linear over the interval, bounding it at both ends by the
+ * largest q' within the interval keeps joint velocity within limits
+ * everywhere, not just at the grid points.
+ */
+static double
+topp_interval_x_max( const struct topp_path *path, size_t k,
+                     double s0, double s1, const struct aa_ct_limit *limits )
+{
+    size_t n_q = path->n_q;
+    double x_max = INFINITY;
+    for( size_t j = 0; j < n_q; j ++ ) {
+        /* q' = dq + 2*a2*s + 3*a3*s^2 in piece coordinates */
+        double d1 = path->dq[k*n_q+j];
+        double c2 = path->a2[k*n_q+j];
+        double c3 = path->a3[k*n_q+j];
+        double l0 = s0 - path->s[k], l1 = s1 - path->s[k];
+        double v0 = d1 + 2*c2*l0 + 3*c3*l0*l0;
+        double v1 = d1 + 2*c2*l1 + 3*c3*l1*l1;
+        double hi = AA_MAX(v0, v1), lo = AA_MIN(v0, v1);
+        if( c3 != 0 ) {
+            double le = -c2 / (3*c3);
+            if( l0 < le && le < l1 ) {
+                double ve = d1 + 2*c2*le + 3*c3*le*le;
+                hi = AA_MAX(hi, ve);
+                lo = AA_MIN(lo, ve);
+            }
+        }
+        if( hi > 0 ) {
+            double sd = limits->max->dq[j] / hi;
+            if( isfinite(sd) ) x_max = AA_MIN( x_max, sd*sd );
+        }
+        if( lo < 0 ) {
+            double sd = limits->min->dq[j] / lo;
+            if( isfinite(sd) ) x_max = AA_MIN( x_max, sd*sd );
+        }
+    }
+    return x_max;
+}
+
+static void
+topp_point_eval( struct aa_mem_region *reg, const struct topp_path *path,
+                 size_t k, double s, const struct aa_ct_topp_opts *opts,
+                 struct topp_point *p )
+{
+    size_t n_q = path->n_q;
+    double q[n_q];
+    p->dq = AA_MEM_REGION_NEW_N(reg, double, n_q);
+    p->ddq = AA_MEM_REGION_NEW_N(reg, double, n_q);
+    topp_path_eval( path, k, s, q, p->dq, p->ddq );
+
+    if( opts->dyn ) {
+        p->a = AA_MEM_REGION_NEW_N(reg, double, n_q);
+        p->b = AA_MEM_REGION_NEW_N(reg, double, n_q);
+        p->c = AA_MEM_REGION_NEW_N(reg, double, n_q);
+        opts->dyn( opts->dyn_cx, n_q, q, p->dq, p->ddq, p->a, p->b, p->c );
+    } else {
+        p->a = p->b = p->c = NULL;
+    }
+}
+
+AA_API struct aa_ct_seg_list *
+aa_ct_tjq_topp_generate( struct aa_mem_region *reg,
+                         struct aa_ct_pt_list *pt_list,
+                         struct aa_ct_limit *limits,
+                         const struct aa_ct_topp_opts *opts )
+{
+    struct aa_ct_topp_opts default_opts = {200, NULL, NULL, 0};
+    if( NULL == opts ) opts = &default_opts;
+
+    struct aa_ct_seg_list *list = new(reg) struct aa_ct_seg_list();
+    struct topp_path *path = topp_path_create( &list->reg, pt_list, opts->tol );
+    if( NULL == path ) goto FAIL;
+
+    if( 0 == path->s[path->n_k] ) {
+        /* All waypoints coincide: remain at rest */
+        topp_seg_add( list, path, 0, 0, 0, 0, 0, 0, 0 );
+        list->duration = 0;
+    } else {
+        size_t n_q = path->n_q;
+        size_t n_k = path->n_k;
+        double L = path->s[n_k];
+        int effort = opts->dyn && limits->min->eff && limits->max->eff;
+
+        struct aa_mem_region *local = aa_mem_region_local_get();
+        void *ptrtop = aa_mem_region_ptr(local);
+
+        /* Grid, with the knots on grid points */
+        size_t n = 0;
+        size_t m_k[n_k];
+        for( size_t k = 0; k < n_k; k ++ ) {
+            double len = path->s[k+1] - path->s[k];
+            m_k[k] = AA_MAX( 1, (size_t)ceil( (double)opts->n_grid * len / L ) );
+            n += m_k[k];
+        }
+        double *s = AA_MEM_REGION_NEW_N(local, double, n+1);
+        size_t *piece = AA_MEM_REGION_NEW_N(local, size_t, n);
+        {
+            size_t i = 0;
+            for( size_t k = 0; k < n_k; k ++ ) {
+                double len = path->s[k+1] - path->s[k];
+                for( size_t l = 0; l < m_k[k]; l ++, i ++ ) {
+                    s[i] = path->s[k] + len * (double)l / (double)m_k[k];
+                    piece[i] = k;
+                }
+            }
+            s[n] = L;
+        }
+
+        /* Path derivatives at the ends and middle of each interval */
+        double *x_max = AA_MEM_REGION_NEW_N(local, double, n);
+        struct topp_point *p = AA_MEM_REGION_NEW_N(local, struct topp_point, TOPP_POINTS*n);
+        for( size_t i = 0; i < n; i ++ ) {
+            for( size_t l = 0; l < TOPP_POINTS; l ++ ) {
+                double sl = s[i] + (s[i+1] - s[i]) * (double)l / (TOPP_POINTS-1);
+                topp_point_eval( local, path, piece[i], sl, opts,
+                                 p + TOPP_POINTS*i + l );
+            }
+            x_max[i] = topp_interval_x_max( path, piece[i], s[i], s[i+1], limits );
+        }
+
+        size_t m_max = 7 + TOPP_POINTS * (2*n_q + (effort ? 2*n_q : 0));
+        struct topp_stage st;
+        st.A = AA_MEM_REGION_NEW_N(local, double, m_max);
+        st.B = AA_MEM_REGION_NEW_N(local, double, m_max);
+        st.C = AA_MEM_REGION_NEW_N(local, double, m_max);
+
+        double *K_lo = AA_MEM_REGION_NEW_N(local, double, n+1);
+        double *K_hi = AA_MEM_REGION_NEW_N(local, double, n+1);
+        double *x = AA_MEM_REGION_NEW_N(local, double, n+1);
+        double *u = AA_MEM_REGION_NEW_N(local, double, n);
+
+        /* Backward pass: controllable sets, ending at rest */
+        int r = 0;
+        K_lo[n] = K_hi[n] = 0;
+        for( size_t i = n; !r && i > 0; i -- ) {
+            topp_stage_build( &st, n_q, s, K_lo, K_hi, p, x_max, i-1, limits, effort );
+            r = topp_stage_range( &st, &K_lo[i-1], &K_hi[i-1] );
+        }
+
+        /* Forward pass: greedy acceleration, starting at rest */
+        if( !r && K_lo[0] <= TOPP_TOL ) {
+            aa_ct_seg_list_reserve( list, n );
+            x[0] = 0;
+            double t = 0;
+            for( size_t i = 0; !r && i < n; i ++ ) {
+                topp_stage_build( &st, n_q, s, K_lo, K_hi, p, x_max, i, limits, effort );
+                double h = s[i+1] - s[i];
+                x[i+1] = x[i] + 2*h*topp_stage_u_max( &st, x[i] );
+                x[i+1] = AA_MAX( K_lo[i+1], AA_MIN( K_hi[i+1], x[i+1] ) );
+                u[i] = (x[i+1] - x[i]) / (2*h);
+
+                double v = sqrt(x[i]) + sqrt(x[i+1]);
+                if( v <= 0 ) {
+                    /* Cannot leave this point */
+                    r = -1;
+                    break;
+                }
+                double dt = 2*h / v;
+
+                topp_seg_add( list, path, piece[i], s[i], s[i+1],
+                              sqrt(x[i]), u[i], t, t + dt );
+
+                t += dt;
+            }
+            list->duration = t;
+        } else {
+            r = -1;
+        }
+
+        aa_mem_region_pop(local, ptrtop);
+
+        if( r ) goto FAIL;
+    }
+
+    list->n_q = path->n_q;
+    aa_ct_seg_list_index(list);
+    return list;
+
+FAIL:
+    aa_ct_seg_list_destroy(list);
+    return NULL;
+}
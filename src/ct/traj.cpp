@@ -38,6 +38,8 @@
 
 #include <math.h>
 
+#include <algorithm>
+
 #include <amino.hpp>
 
 #include <amino/ct/state.h>
@@ -57,10 +59,12 @@ static inline void
 aa_ct_list_add(T *list, U *el)
 {
     el->next = NULL;
-    if (list->list.size())
-        list->list.back()->next = el;
+    el->prev = NULL;
+    if (list->list.size()) {
+        el->prev = list->list.back();
+        el->prev->next = el;
+    }
 
-    el->prev = list->list.back();
     list->list.push_back(el);
 }
 
@@ -75,11 +79,12 @@ static inline void
 aa_ct_list_add_front(T *list, U *el)
 {
     el->prev = NULL;
+    el->next = NULL;
     if (list->list.size()) {
-        list->list.front()->prev = el;
+        el->next = list->list.front();
+        el->next->prev = el;
     }
 
-    el->next = list->list.front();
     list->list.insert(list->list.begin(), el);
 }
 
@@ -181,10 +186,42 @@ aa_ct_pt_list_dump(FILE *stream, struct aa_ct_pt_list *list)
 /**
  * Segment lists
  */
-AA_API void
-aa_ct_seg_list_add(struct aa_ct_seg_list *list, struct aa_ct_seg *seg)
+
+/**
+ * Link the stored segment headers from index i onward to their neighbors.
+ */
+static void
+aa_ct_seg_list_link(struct aa_ct_seg_list *list, size_t i)
+{
+    size_t n = list->list.size();
+    struct aa_ct_seg *segs = list->list.data();
+    for (; i < n; i++) {
+        segs[i].prev = (i > 0) ? &segs[i-1] : NULL;
+        segs[i].next = (i + 1 < n) ? &segs[i+1] : NULL;
+    }
+}
+
+AA_API struct aa_ct_seg *
+aa_ct_seg_list_add(struct aa_ct_seg_list *list, const struct aa_ct_seg *seg)
+{
+    const struct aa_ct_seg *base = list->list.data();
+    size_t n = list->list.size();
+
+    list->list.push_back(*seg);
+    list->indexed = 0;
+
+    /* Relink everything if the headers moved, otherwise just the tail */
+    aa_ct_seg_list_link(list, (base == list->list.data() && n) ? n-1 : 0);
+
+    return &list->list.back();
+}
+
+void aa_ct_seg_list_reserve( struct aa_ct_seg_list *list, size_t n )
 {
-    aa_ct_list_add(list, seg);
+    const struct aa_ct_seg *base = list->list.data();
+    list->list.reserve(n);
+    if (base != list->list.data())
+        aa_ct_seg_list_link(list, 0);
 }
 
 
@@ -192,37 +229,106 @@ void aa_ct_seg_list_add_cx( struct aa_ct_seg_list *list,
                             aa_ct_seg_eval_fun eval,
                             void *cx )
 {
-    struct aa_ct_seg *seg = AA_MEM_REGION_NEW(&list->reg, aa_ct_seg);
-    seg->cx = cx;
-    seg->eval = eval;
-    aa_ct_seg_list_add( list, seg );
+    struct aa_ct_seg seg;
+    AA_MEM_ZERO(&seg,1);
+    seg.cx = cx;
+    seg.eval = eval;
+    seg.t0 = NAN;
+    seg.t1 = NAN;
+    aa_ct_seg_list_add( list, &seg );
+}
+
+void aa_ct_seg_list_index( struct aa_ct_seg_list *list )
+{
+    list->indexed = 0;
+    list->t_start.clear();
+    list->t_start.reserve(list->list.size());
+
+    double t_prev = -INFINITY;
+    for( const struct aa_ct_seg &seg : list->list ) {
+        if( std::isnan(seg.t0) || std::isnan(seg.t1) || seg.t0 < t_prev ) {
+            list->t_start.clear();
+            return;
+        }
+        t_prev = seg.t0;
+        list->t_start.push_back(seg.t0);
+    }
 
+    list->indexed = 1;
+}
+
+/**
+ * Evaluate segment i, trying its predecessor when t is at the shared boundary.
+ */
+static int
+aa_ct_seg_list_eval_at(const struct aa_ct_seg_list *list, struct aa_ct_state *state,
+                       double t, size_t i, size_t *hint)
+{
+    /* Evaluation does not modify the segment */
+    struct aa_ct_seg *seg = const_cast<struct aa_ct_seg *>(&list->list[i]);
+    int r;
+    if ((r = seg->eval(seg, state, t))) {
+        *hint = i;
+        return r;
+    }
+    if (i > 0) {
+        seg--;
+        if ((r = seg->eval(seg, state, t))) {
+            *hint = i-1;
+            return r;
+        }
+    }
+    return AA_CT_SEG_OUT;
 }
 
 AA_API int
-aa_ct_seg_list_eval(struct aa_ct_seg_list *list, struct aa_ct_state *state,
-                    double t)
+aa_ct_seg_list_eval_hint(const struct aa_ct_seg_list *list, struct aa_ct_state *state,
+                         double t, size_t *hint)
 {
-    if (!list->it_on) {
-        list->it = list->list.begin();
-        list->it_on = 1;
+    size_t n = list->list.size();
+
+    if (!list->indexed) {
+        /* No time index, try every segment */
+        for (size_t i = 0; i < n; i++) {
+            struct aa_ct_seg *seg = const_cast<struct aa_ct_seg *>(&list->list[i]);
+            int r;
+            if ((r = seg->eval(seg, state, t))) {
+                *hint = i;
+                return r;
+            }
+        }
+        return AA_CT_SEG_OUT;
     }
 
-    do {
-        struct aa_ct_seg *seg = *list->it;
+    if (0 == n || t < list->t_start[0] || t > list->list[n-1].t1)
+        return AA_CT_SEG_OUT;
 
-        int r;
-        if ((r = seg->eval(seg, state, t)))
-            return r;
+    const double *t_start = list->t_start.data();
+    size_t i = *hint;
 
-        list->it++;
-    } while (list->it != list->list.end());
+    /* Monotone case: the hinted segment or its successor */
+    if (i < n && t_start[i] <= t) {
+        if (i + 1 == n || t < t_start[i+1])
+            return aa_ct_seg_list_eval_at(list, state, t, i, hint);
+        if (i + 2 == n || t < t_start[i+2])
+            return aa_ct_seg_list_eval_at(list, state, t, i+1, hint);
+    }
 
-    list->it_on = 0;
-    return AA_CT_SEG_OUT;
+    /* Last segment with start time <= t */
+    i = (size_t)(std::upper_bound(t_start, t_start + n, t) - t_start) - 1;
+
+    return aa_ct_seg_list_eval_at(list, state, t, i, hint);
 }
 
-int aa_ct_seg_list_eval_q(struct aa_ct_seg_list *list, double t, size_t n, double *q)
+AA_API int
+aa_ct_seg_list_eval(const struct aa_ct_seg_list *list, struct aa_ct_state *state,
+                    double t)
+{
+    size_t hint = 0;
+    return aa_ct_seg_list_eval_hint(list, state, t, &hint);
+}
+
+int aa_ct_seg_list_eval_q(const struct aa_ct_seg_list *list, double t, size_t n, double *q)
 {
     struct aa_ct_state state;
     AA_MEM_ZERO(&state,1);
@@ -231,7 +337,7 @@ int aa_ct_seg_list_eval_q(struct aa_ct_seg_list *list, double t, size_t n, doubl
     return aa_ct_seg_list_eval(list,&state,t);
 }
 
-int aa_ct_seg_list_eval_dq(struct aa_ct_seg_list *list, double t, size_t n, double *q, double *dq)
+int aa_ct_seg_list_eval_dq(const struct aa_ct_seg_list *list, double t, size_t n, double *q, double *dq)
 {
     struct aa_ct_state state;
     AA_MEM_ZERO(&state,1);
@@ -241,6 +347,31 @@ int aa_ct_seg_list_eval_dq(struct aa_ct_seg_list *list, double t, size_t n, doub
     return aa_ct_seg_list_eval(list,&state,t);
 }
 
+AA_API int
+aa_ct_seg_list_eval_grid(const struct aa_ct_seg_list *list,
+                         size_t n_t, const double *t,
+                         size_t n_q, double *Q, size_t ldQ)
+{
+    /* Segments may fill any state field, so evaluate into a full state */
+    struct aa_mem_region *reg = aa_mem_region_local_get();
+    size_t n_s = AA_MAX(list->n_q, n_q);
+    struct aa_ct_state *state = aa_ct_state_alloc(reg, n_s, 0);
+    size_t n = AA_MIN(n_q, list->n_q);
+
+    int result = AA_CT_SEG_IN;
+    size_t hint = 0;
+    for (size_t j = 0; j < n_t; j++) {
+        if (aa_ct_seg_list_eval_hint(list, state, t[j], &hint)) {
+            AA_MEM_CPY(Q + j*ldQ, state->q, n);
+        } else {
+            result = AA_CT_SEG_OUT;
+        }
+    }
+
+    aa_mem_region_pop(reg, state);
+    return result;
+}
+
 AA_API void
 aa_ct_seg_list_destroy(struct aa_ct_seg_list *list)
 {
@@ -365,12 +496,13 @@ static int aa_ct_seg_dq_eval( struct aa_ct_seg *seg,
 
 
 static struct aa_ct_seg *
-aa_ct_seg_dq_new( struct aa_mem_region *reg,
+aa_ct_seg_dq_new( struct aa_ct_seg_list *list,
                   double t0, struct aa_ct_state *state0,
                   struct aa_ct_state *state1,
                   struct aa_ct_limit *limits )
 {
     /* Allocate */
+    struct aa_mem_region *reg = &list->reg;
     struct aa_ct_seg_dq *cx = AA_MEM_REGION_NEW(reg,struct aa_ct_seg_dq);
     AA_MEM_ZERO(cx,1);
     cx->n_q = AA_MIN(state0->n_q, state1->n_q);
@@ -380,11 +512,11 @@ aa_ct_seg_dq_new( struct aa_mem_region *reg,
     cx->t0 = t0;
     cx->t1 = t0;
 
-    struct aa_ct_seg *seg = AA_MEM_REGION_NEW(reg,struct aa_ct_seg);
-    AA_MEM_ZERO(seg,1);
-    seg->eval = aa_ct_seg_dq_eval;
-    seg->cx = cx;
-    seg->type = AA_CT_LIN_SEG;
+    struct aa_ct_seg seg;
+    AA_MEM_ZERO(&seg,1);
+    seg.eval = aa_ct_seg_dq_eval;
+    seg.cx = cx;
+    seg.type = AA_CT_LIN_SEG;
 
     /* Compute segment time */
     double dt = 0;
@@ -409,8 +541,10 @@ aa_ct_seg_dq_new( struct aa_mem_region *reg,
         cx->dq[i] /= dt;
     }
     cx->t1 = cx->t0 + dt;
+    seg.t0 = cx->t0;
+    seg.t1 = cx->t1;
 
-    return seg;
+    return aa_ct_seg_list_add(list, &seg);
 }
 
 
@@ -418,12 +552,13 @@ struct aa_ct_seg_list *aa_ct_tjq_lin_generate(struct aa_mem_region *reg,
                                               struct aa_ct_pt_list *list,
                                               struct aa_ct_limit *limits)
 {
-    struct aa_ct_seg_list *segs = new(reg) aa_ct_seg_list(reg);
+    struct aa_ct_seg_list *segs = new(reg) aa_ct_seg_list();
 
     auto itr0 = list->list.begin();
     auto itr1 = list->list.begin();
     itr1++;
     segs->n_q = (*itr0)->state.n_q;
+    aa_ct_seg_list_reserve(segs, list->list.size() - 1);
 
     segs->duration = 0;
     for( ; itr1 != list->list.end(); itr0++, itr1++ ) {
@@ -432,14 +567,15 @@ struct aa_ct_seg_list *aa_ct_tjq_lin_generate(struct aa_mem_region *reg,
             fprintf(stderr, "WARNING: mistmactched confiuration count during trajectory generation.\n");
         }
 
-        struct aa_ct_seg *seg = aa_ct_seg_dq_new( reg, segs->duration,
+        struct aa_ct_seg *seg = aa_ct_seg_dq_new( segs, segs->duration,
                                                   &(*itr0)->state, &(*itr1)->state, limits );
-        aa_ct_seg_list_add(segs, seg);
 
         struct aa_ct_seg_dq *cx = (struct aa_ct_seg_dq*)seg->cx;
         segs->duration = cx->t1;
     }
 
+    aa_ct_seg_list_index(segs);
+
     return segs;
 }
 
@@ -455,6 +591,7 @@ struct aa_ct_seg_pb_cx {
     double *q;   ///< Waypoint position
     double *dq;  ///< Velocity of the linear segment
     double *ddq; ///< Acceleration of the blend segment
+    double *p_dq; ///< Velocity of the previous linear segment, zero if none
 
     double t;    ///< Start time
     double dt;   ///< Duration of segment
@@ -486,28 +623,26 @@ aa_ct_tj_pb_nbrs(struct aa_ct_seg *seg, struct aa_ct_seg_pb_cx **p,
 int
 aa_ct_tj_pb_eval(struct aa_ct_seg *seg, struct aa_ct_state *state, double t)
 {
-    struct aa_ct_seg_pb_cx *c_cx, *p_cx, *n_cx;
-    aa_ct_tj_pb_nbrs(seg, &p_cx, &c_cx, &n_cx);
+    // Only this segment is touched: the linear region ends at the
+    // segment end time, and the context keeps the previous velocity.
+    struct aa_ct_seg_pb_cx *c_cx = (struct aa_ct_seg_pb_cx *) seg->cx;
 
     double dt = t - c_cx->t;
     if ((c_cx->t - c_cx->b / 2) <= t && t <= (c_cx->t + c_cx->b / 2)) {
         // Blend region
         for (size_t i = 0; i < c_cx->n_q; i++) {
-            double p_dq = (p_cx) ? p_cx->dq[i] : 0;
-
-            state->q[i] = c_cx->q[i] + p_dq * dt + \
+            state->q[i] = c_cx->q[i] + c_cx->p_dq[i] * dt + \
                 c_cx->ddq[i] * pow((dt + c_cx->b / 2), 2) / 2;
-            state->dq[i] = p_dq + c_cx->ddq[i] * (dt + c_cx->b / 2);
-            state->ddq[i] = c_cx->ddq[i];
+            if (state->dq) state->dq[i] = c_cx->p_dq[i] + c_cx->ddq[i] * (dt + c_cx->b / 2);
+            if (state->ddq) state->ddq[i] = c_cx->ddq[i];
         }
 
-    } else if (n_cx && ((c_cx->t + c_cx->b / 2) <= t
-                        && t <= (c_cx->t + c_cx->dt - n_cx->b / 2))) {
+    } else if ((c_cx->t + c_cx->b / 2) <= t && t <= seg->t1) {
         // Linear region
         for (size_t i = 0; i < c_cx->n_q; i++) {
             state->q[i] = c_cx->q[i] + c_cx->dq[i] * dt;
-            state->dq[i] = c_cx->dq[i];
-            state->ddq[i] = 0;
+            if (state->dq) state->dq[i] = c_cx->dq[i];
+            if (state->ddq) state->ddq[i] = 0;
         }
 
     } else {
@@ -543,21 +678,26 @@ aa_ct_tj_pb_limit(double *a, double *b, double *min, double *max, size_t n_q)
 }
 
 /**
- * Create a new parabolic blend segment allocated from a memory region.
+ * Add a new parabolic blend segment to a segment list, allocating its
+ * context from the list's region.
  *
- * @param reg Region to allocate from
+ * @param list List to add the segment to
  * @param pt  Point to base segment from
  * @param limits Kinematic limits
  *
- * @return Returns a newly allocated and initialized segment.
+ * @return Returns the newly added and initialized segment.
  */
 struct aa_ct_seg *
-aa_ct_tj_pb_new(struct aa_mem_region *reg, struct aa_ct_pt *pt,
+aa_ct_tj_pb_new(struct aa_ct_seg_list *list, struct aa_ct_pt *pt,
                 struct aa_ct_limit *limits)
 {
+    struct aa_mem_region *reg = &list->reg;
     size_t n_q = pt->state.n_q;
-    struct aa_ct_seg *seg = new(reg) struct aa_ct_seg();
-    seg->eval = aa_ct_tj_pb_eval;
+    struct aa_ct_seg seg;
+    AA_MEM_ZERO(&seg, 1);
+    seg.eval = aa_ct_tj_pb_eval;
+    seg.t0 = NAN;
+    seg.t1 = NAN;
 
     struct aa_ct_seg_pb_cx *cx = new(reg) struct aa_ct_seg_pb_cx();
     bzero(cx, sizeof(struct aa_ct_seg_pb_cx));
@@ -568,8 +708,10 @@ aa_ct_tj_pb_new(struct aa_mem_region *reg, struct aa_ct_pt *pt,
 
     cx->dq = AA_MEM_REGION_NEW_N(reg, double, n_q);
     cx->ddq = AA_MEM_REGION_NEW_N(reg, double, n_q);
+    cx->p_dq = AA_MEM_REGION_NEW_N(reg, double, n_q);
     bzero(cx->dq, sizeof(double) * n_q);
     bzero(cx->ddq, sizeof(double) * n_q);
+    bzero(cx->p_dq, sizeof(double) * n_q);
 
     cx->t = 0;
     cx->dt = DBL_MAX;
@@ -578,9 +720,9 @@ aa_ct_tj_pb_new(struct aa_mem_region *reg, struct aa_ct_pt *pt,
     }
     cx->b = 0;
 
-    seg->cx = (void *) cx;
-    seg->type = AA_CT_PB_SEG;
-    return seg;
+    seg.cx = (void *) cx;
+    seg.type = AA_CT_PB_SEG;
+    return aa_ct_seg_list_add(list, &seg);
 }
 
 /**
@@ -600,7 +742,10 @@ aa_ct_tj_pb_update(struct aa_ct_seg *seg, struct aa_ct_limit *limits)
         for (size_t i = 0; i < c_cx->n_q; i++)
             c_cx->dq[i] = (n_cx->q[i] - c_cx->q[i]) / c_cx->dt;
 
-    // Calculate acceleration based on new velocities
+    // Calculate acceleration based on new velocities, keeping a copy
+    // of the previous velocity for evaluation
+    if (p_cx)
+        memcpy(c_cx->p_dq, p_cx->dq, sizeof(double) * c_cx->n_q);
     c_cx->b = aa_ct_tj_pb_limit(c_cx->dq, (p_cx) ? p_cx->dq : NULL,
                                 limits->min->ddq, limits->max->ddq, c_cx->n_q);
 
@@ -618,15 +763,16 @@ AA_API struct aa_ct_seg_list *
 aa_ct_tjq_pb_generate(struct aa_mem_region *reg, struct aa_ct_pt_list *pt_list,
                       struct aa_ct_limit *limits)
 {
-    struct aa_ct_seg_list *list = new(reg) struct aa_ct_seg_list(reg);
+    struct aa_ct_seg_list *list = new(reg) struct aa_ct_seg_list();
+
+    bool flag;
+    size_t n = pt_list->list.size();
 
     // Populate segment list with one segment per point
+    aa_ct_seg_list_reserve(list, n);
     struct aa_ct_pt *c_pt = pt_list->list.front();
     for (; c_pt != NULL; c_pt = c_pt->next)
-        aa_ct_seg_list_add(list, aa_ct_tj_pb_new(&list->reg, c_pt, limits));
-
-    bool flag;
-    size_t n = pt_list->list.size();
+        aa_ct_tj_pb_new(list, c_pt, limits);
 
     // Iterate and update segments until no overlap
     do {
@@ -634,13 +780,13 @@ aa_ct_tjq_pb_generate(struct aa_mem_region *reg, struct aa_ct_pt_list *pt_list,
         double f[n];
         flag = false;
 
-        struct aa_ct_seg *c_seg = list->list.front();
+        struct aa_ct_seg *c_seg = &list->list.front();
         // Update all segments before checking for overlap.
         for (; c_seg != NULL; c_seg = c_seg->next) {
             aa_ct_tj_pb_update(c_seg, limits);
         }
 
-        c_seg = list->list.front();
+        c_seg = &list->list.front();
         for (; c_seg != NULL; c_seg = c_seg->next, i++) {
             struct aa_ct_seg_pb_cx *c_cx, *p_cx, *n_cx;
             aa_ct_tj_pb_nbrs(c_seg, &p_cx, &c_cx, &n_cx);
@@ -667,7 +813,7 @@ aa_ct_tjq_pb_generate(struct aa_mem_region *reg, struct aa_ct_pt_list *pt_list,
         }
 
         i = 0;
-        c_seg = list->list.front();
+        c_seg = &list->list.front();
         for (; c_seg != NULL; c_seg = c_seg->next, i++)
             // Scale each region's time based on calculated constant
             ((struct aa_ct_seg_pb_cx *) c_seg->cx)->dt /= \
@@ -675,18 +821,29 @@ aa_ct_tjq_pb_generate(struct aa_mem_region *reg, struct aa_ct_pt_list *pt_list,
     } while (flag);
 
     // The final duration of a segment needs to be 0, defaults to DBL_MAX.
-    ((struct aa_ct_seg_pb_cx *)list->list.back()->cx)->dt = 0;
+    ((struct aa_ct_seg_pb_cx *)list->list.back().cx)->dt = 0;
 
-    list->n_q = ((struct aa_ct_seg_pb_cx *)list->list.front()->cx)->n_q;
+    list->n_q = ((struct aa_ct_seg_pb_cx *)list->list.front().cx)->n_q;
 
     // The full duration of the trajectory needs to be set.
-    struct aa_ct_seg *c_seg = list->list.front();
+    struct aa_ct_seg *c_seg = &list->list.front();
     list->duration = ((struct aa_ct_seg_pb_cx*)c_seg->cx)->b / 2;
     for (; c_seg != NULL; c_seg = c_seg->next) {
         struct aa_ct_seg_pb_cx *seg_cx = (struct aa_ct_seg_pb_cx *)c_seg->cx;
         list->duration += seg_cx->dt;
     }
-    list->duration += ((struct aa_ct_seg_pb_cx *) list->list.back()->cx)->b / 2;
+    list->duration += ((struct aa_ct_seg_pb_cx *) list->list.back().cx)->b / 2;
+
+    // Each segment spans from its blend start to the next blend start.
+    for (c_seg = &list->list.front(); c_seg != NULL; c_seg = c_seg->next) {
+        struct aa_ct_seg_pb_cx *c_cx, *p_cx, *n_cx;
+        aa_ct_tj_pb_nbrs(c_seg, &p_cx, &c_cx, &n_cx);
+        c_seg->t0 = c_cx->t - c_cx->b / 2;
+        c_seg->t1 = (n_cx) ? c_cx->t + c_cx->dt - n_cx->b / 2
+                           : c_cx->t + c_cx->b / 2;
+    }
+    aa_ct_seg_list_index(list);
+
     return list;
 }
 
@@ -765,7 +922,7 @@ aa_ct_tjX_pb_generate(struct aa_mem_region *reg, struct aa_ct_pt_list *pt_list,
     struct aa_ct_seg_list *Xseg_list =
         aa_ct_tjq_pb_generate(reg, Xpt_list, &Xlimits);
 
-    struct aa_ct_seg *c_seg = Xseg_list->list.front();
+    struct aa_ct_seg *c_seg = &Xseg_list->list.front();
     for (; c_seg != NULL; c_seg = c_seg->next) {
         c_seg->eval = aa_ct_tjX_pb_eval;
     }
@@ -830,7 +987,7 @@ int aa_ct_seg_list_check_c0( struct aa_ct_seg_list * segs, double dt,
         state1 = temp;
     }
 
-    struct aa_ct_seg *c_seg = segs->list.front();
+    struct aa_ct_seg *c_seg = &segs->list.front();
     for (; c_seg->next != NULL; c_seg = c_seg->next)
     {
         if (c_seg->type == AA_CT_LIN_SEG)
@@ -848,6 +1005,11 @@ int aa_ct_seg_list_check_c0( struct aa_ct_seg_list * segs, double dt,
             c_seg->eval(c_seg, state0, c_cx->t + c_cx->dt - n_cx->b / 2);
             c_seg->next->eval(c_seg->next, state1, n_cx->t - n_cx->b / 2);
         }
+        else if (!std::isnan(c_seg->t1) && !std::isnan(c_seg->next->t0))
+        {
+            c_seg->eval(c_seg, state0, c_seg->t1);
+            c_seg->next->eval(c_seg->next, state1, c_seg->next->t0);
+        }
         else
         {
             // Why does the segment have a weird type?
@@ -925,7 +1087,8 @@ struct aa_ct_seg_list *aa_ct_tjx_slerp_generate(struct aa_mem_region *reg,
         return NULL;
     }
 
-    struct aa_ct_slerp_seg *s = AA_MEM_REGION_NEW(reg, struct aa_ct_slerp_seg);
+    struct aa_ct_seg_list *segs  = new(reg) aa_ct_seg_list();
+    struct aa_ct_slerp_seg *s = AA_MEM_REGION_NEW(&segs->reg, struct aa_ct_slerp_seg);
     {
         // TODO: non-unit time
         s->dt = 1;
@@ -951,8 +1114,10 @@ struct aa_ct_seg_list *aa_ct_tjx_slerp_generate(struct aa_mem_region *reg,
 
     }
 
-    struct aa_ct_seg_list *segs  = new(reg) aa_ct_seg_list(reg);
     aa_ct_seg_list_add_cx(segs, aa_ct_seg_slerp_eval,  s);
+    segs->list.back().t0 = 0;
+    segs->list.back().t1 = s->dt;
+    aa_ct_seg_list_index(segs);
     segs->duration = 1;
 
     return segs;
@@ -0,0 +1,367 @@
+/* -*- mode: C++; c-basic-offset: 4; -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2016, Rice University
+ * All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of copyright holder the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Fixed-size kernels for 6 x n matrices (Jacobians).
+ *
+ * The general routines in la.c call LAPACK and allocate scratch from
+ * the thread-local region.  For the small matrices of a single
+ * kinematic chain, that overhead exceeds the arithmetic.  These
+ * kernels size all loops and storage at compile time so the compiler
+ * can unroll and vectorize them, and use only stack storage.
+ */
+
+#include <cmath>
+
+#include "amino.h"
+
+namespace {
+
+/* Orthonormalize the columns of the M x M matrix V by modified
+ * Gram-Schmidt.  Returns false if V is numerically singular.
+ */
+template <size_t M>
+bool orthonormalize( double *V )
+{
+    for( size_t j = 0; j < M; j ++ ) {
+        double *v = V + M*j;
+        for( size_t k = 0; k < j; k ++ ) {
+            const double *u = V + M*k;
+            double d = 0;
+            for( size_t i = 0; i < M; i ++ ) d += u[i]*v[i];
+            for( size_t i = 0; i < M; i ++ ) v[i] -= d*u[i];
+        }
+        double nrm = 0;
+        for( size_t i = 0; i < M; i ++ ) nrm += v[i]*v[i];
+        if( !(nrm > 1e-12) ) return false;
+        nrm = 1 / std::sqrt(nrm);
+        for( size_t i = 0; i < M; i ++ ) v[i] *= nrm;
+    }
+    return true;
+}
+
+/* Eigendecomposition of a symmetric M x M matrix by cyclic Jacobi
+ * rotations.  On return, the diagonal of A holds the eigenvalues and
+ * the columns of V the eigenvectors.
+ *
+ * When warm, V on entry holds an approximate eigenbasis, e.g., from a
+ * nearby matrix.  A is first transformed into that basis, which is
+ * then nearly diagonal and needs fewer sweeps.
+ */
+template <size_t M>
+void sym_eig( double *A, double *V, bool warm = false )
+{
+    if( warm && orthonormalize<M>( V ) ) {
+        /* A = V^T A V */
+        double T[M*M];
+        for( size_t j = 0; j < M; j ++ ) {
+            for( size_t i = 0; i < M; i ++ ) {
+                double x = 0;
+                for( size_t k = 0; k < M; k ++ ) x += A[i+M*k] * V[k+M*j];
+                T[i+M*j] = x;
+            }
+        }
+        for( size_t j = 0; j < M; j ++ ) {
+            for( size_t i = 0; i <= j; i ++ ) {
+                double x = 0;
+                for( size_t k = 0; k < M; k ++ ) x += V[k+M*i] * T[k+M*j];
+                A[i+M*j] = A[j+M*i] = x;
+            }
+        }
+    } else {
+        for( size_t j = 0; j < M; j ++ ) {
+            for( size_t i = 0; i < M; i ++ ) {
+                V[i+M*j] = (i == j) ? 1 : 0;
+            }
+        }
+    }
+
+    for( size_t sweep = 0; sweep < 32; sweep ++ ) {
+        double off = 0, diag = 0;
+        for( size_t j = 0; j < M; j ++ ) {
+            diag += A[j+M*j]*A[j+M*j];
+            for( size_t i = 0; i < j; i ++ ) {
+                off += A[i+M*j]*A[i+M*j];
+            }
+        }
+        if( off <= 1e-30 * diag ) break;
+
+        for( size_t p = 0; p < M; p ++ ) {
+            for( size_t q = p+1; q < M; q ++ ) {
+                double a_pq = A[p+M*q];
+                /* Already negligible against the convergence test,
+                 * e.g., in the later sweeps of a warm start */
+                if( a_pq*a_pq <= 1e-34 * diag ) continue;
+
+                double theta = (A[q+M*q] - A[p+M*p]) / (2*a_pq);
+                double t = ( (theta >= 0) ? 1 : -1 ) /
+                    ( std::fabs(theta) + std::sqrt(theta*theta + 1) );
+                double c = 1 / std::sqrt(t*t + 1);
+                double s = t*c;
+
+                /* A = R^T A R */
+                for( size_t k = 0; k < M; k ++ ) {
+                    double a_kp = A[k+M*p];
+                    double a_kq = A[k+M*q];
+                    A[k+M*p] = c*a_kp - s*a_kq;
+                    A[k+M*q] = s*a_kp + c*a_kq;
+                }
+                for( size_t k = 0; k < M; k ++ ) {
+                    double a_pk = A[p+M*k];
+                    double a_qk = A[q+M*k];
+                    A[p+M*k] = c*a_pk - s*a_qk;
+                    A[q+M*k] = s*a_pk + c*a_qk;
+                }
+                /* V = V R */
+                for( size_t k = 0; k < M; k ++ ) {
+                    double v_kp = V[k+M*p];
+                    double v_kq = V[k+M*q];
+                    V[k+M*p] = c*v_kp - s*v_kq;
+                    V[k+M*q] = s*v_kp + c*v_kq;
+                }
+            }
+        }
+    }
+}
+
+/* Cholesky factorization L L^T = A - shift*I of a symmetric M x M
+ * matrix.  Returns false if the shifted matrix is not positive
+ * definite.
+ */
+template <size_t M>
+bool cholesky( const double *A, double shift, double *L )
+{
+    for( size_t j = 0; j < M; j ++ ) {
+        double d = A[j+M*j] - shift;
+        for( size_t k = 0; k < j; k ++ ) d -= L[j+M*k]*L[j+M*k];
+        if( !(d > 0) ) return false;
+        double l = std::sqrt(d);
+        L[j+M*j] = l;
+        for( size_t i = j+1; i < M; i ++ ) {
+            double x = A[i+M*j];
+            for( size_t k = 0; k < j; k ++ ) x -= L[i+M*k]*L[j+M*k];
+            L[i+M*j] = x / l;
+        }
+    }
+    return true;
+}
+
+/* Inverse W = (L L^T)^{-1} = L^{-T} L^{-1} from the Cholesky factor.
+ */
+template <size_t M>
+void cholesky_inv( const double *L, double *W )
+{
+    /* X = L^{-1}, lower triangular */
+    double X[M*M];
+    for( size_t j = 0; j < M; j ++ ) {
+        for( size_t i = 0; i < j; i ++ ) X[i+M*j] = 0;
+        X[j+M*j] = 1 / L[j+M*j];
+        for( size_t i = j+1; i < M; i ++ ) {
+            double x = 0;
+            for( size_t k = j; k < i; k ++ ) x -= L[i+M*k]*X[k+M*j];
+            X[i+M*j] = x / L[i+M*i];
+        }
+    }
+    for( size_t j = 0; j < M; j ++ ) {
+        for( size_t i = 0; i <= j; i ++ ) {
+            double x = 0;
+            for( size_t k = j; k < M; k ++ ) x += X[k+M*i]*X[k+M*j];
+            W[i+M*j] = W[j+M*i] = x;
+        }
+    }
+}
+
+/* Deadzone damped pseudoinverse of the 6 x N matrix A.
+ *
+ * With A A^T = U diag(s^2) U^T, the SVD form
+ *
+ *   A^* = \sum s_i / max(s_i^2, s2_min) v_i u_i^T
+ *
+ * equals A^T U diag(1/max(s_i^2, s2_min)) U^T since A^T u_i = s_i v_i.
+ *
+ * When every s_i^2 exceeds the deadzone, this is A^T (A A^T)^{-1},
+ * which a Cholesky factorization computes far faster than the
+ * eigendecomposition.
+ */
+template <size_t N>
+void d6zdpinv( double s2_min, const double *A, double *A_star,
+               double *U_warm = NULL )
+{
+    const size_t M = 6;
+
+    /* B = A A^T */
+    double B[M*M];
+    for( size_t j = 0; j < M; j ++ ) {
+        for( size_t i = 0; i <= j; i ++ ) {
+            double b = 0;
+            for( size_t k = 0; k < N; k ++ ) {
+                b += A[i+M*k] * A[j+M*k];
+            }
+            B[i+M*j] = B[j+M*i] = b;
+        }
+    }
+
+    double W[M*M];
+
+    /* All s_i^2 exceed both the deadzone and the zero threshold
+     * below (trace(B) >= s2_max) iff B - c*I is positive definite */
+    double tr = 0;
+    for( size_t i = 0; i < M; i ++ ) tr += B[i+M*i];
+    double L[M*M];
+    if( N >= M &&
+        cholesky<M>( B, AA_MAX(s2_min, 1e-14*tr), L ) &&
+        cholesky<M>( B, 0, L ) )
+    {
+        cholesky_inv<M>( L, W );
+    } else {
+        double U_local[M*M];
+        double *U = U_warm ? U_warm : U_local;
+        sym_eig<M>( B, U, NULL != U_warm );
+
+        /* Singular values are at most N, remaining eigenvalues are
+         * numerically zero and so are their A^T u_i */
+        double s2_max = 0;
+        for( size_t i = 0; i < M; i ++ ) {
+            s2_max = AA_MAX( s2_max, B[i+M*i] );
+        }
+        double w[M];
+        for( size_t i = 0; i < M; i ++ ) {
+            double s2 = B[i+M*i];
+            w[i] = ( s2 > 1e-14 * s2_max ) ? 1 / AA_MAX( s2, s2_min ) : 0;
+        }
+
+        /* W = U diag(w) U^T */
+        for( size_t j = 0; j < M; j ++ ) {
+            for( size_t i = 0; i <= j; i ++ ) {
+                double x = 0;
+                for( size_t k = 0; k < M; k ++ ) {
+                    x += U[i+M*k] * w[k] * U[j+M*k];
+                }
+                W[i+M*j] = W[j+M*i] = x;
+            }
+        }
+    }
+
+    /* A^* = A^T W */
+    for( size_t j = 0; j < M; j ++ ) {
+        for( size_t i = 0; i < N; i ++ ) {
+            double x = 0;
+            for( size_t k = 0; k < M; k ++ ) {
+                x += A[k+M*i] * W[k+M*j];
+            }
+            A_star[i+N*j] = x;
+        }
+    }
+}
+
+/* x = A^* b + (I - A^* A) x_p = x_p + A^* (b - A x_p)
+ */
+template <size_t N>
+void d6xlsnp( const double *A, const double *A_star,
+              const double *b, const double *xp, double *x )
+{
+    const size_t M = 6;
+
+    double r[M];
+    for( size_t i = 0; i < M; i ++ ) {
+        r[i] = b[i];
+    }
+    for( size_t k = 0; k < N; k ++ ) {
+        for( size_t i = 0; i < M; i ++ ) {
+            r[i] -= A[i+M*k] * xp[k];
+        }
+    }
+
+    for( size_t i = 0; i < N; i ++ ) {
+        x[i] = xp[i];
+    }
+    for( size_t k = 0; k < M; k ++ ) {
+        for( size_t i = 0; i < N; i ++ ) {
+            x[i] += A_star[i+N*k] * r[k];
+        }
+    }
+}
+
+} /* namespace */
+
+#define LA_FIXED6_CASES(CALL)                   \
+    case 1: CALL(1); break;                     \
+    case 2: CALL(2); break;                     \
+    case 3: CALL(3); break;                     \
+    case 4: CALL(4); break;                     \
+    case 5: CALL(5); break;                     \
+    case 6: CALL(6); break;                     \
+    case 7: CALL(7); break;                     \
+    case 8: CALL(8); break;                     \
+    case 9: CALL(9); break;                     \
+    case 10: CALL(10); break;
+
+AA_API int
+aa_la_d6zdpinv( size_t n, double s2_min, const double *A, double *A_star )
+{
+#define CALL(N) d6zdpinv<N>( s2_min, A, A_star )
+    switch(n) {
+        LA_FIXED6_CASES(CALL)
+    default: return -1;
+    }
+#undef CALL
+    return 0;
+}
+
+AA_API int
+aa_la_d6zdpinv_warm( size_t n, double s2_min, const double *A,
+                     double *U, double *A_star )
+{
+#define CALL(N) d6zdpinv<N>( s2_min, A, A_star, U )
+    switch(n) {
+        LA_FIXED6_CASES(CALL)
+    default: return -1;
+    }
+#undef CALL
+    return 0;
+}
+
+AA_API int
+aa_la_d6xlsnp( size_t n, const double *A, const double *A_star,
+               const double *b, const double *xp, double *x )
+{
+#define CALL(N) d6xlsnp<N>( A, A_star, b, xp, x )
+    switch(n) {
+        LA_FIXED6_CASES(CALL)
+    default: return -1;
+    }
+#undef CALL
+    return 0;
+}
@@ -0,0 +1,184 @@
+/* -*- mode: C; c-basic-offset: 4; -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2016, Rice University
+ * All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of copyright holder the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "amino.h"
+#include "amino/opt/qp.h"
+
+/* Solve the k x k symmetric positive definite system A x = b in place
+ * by Cholesky decomposition.  A is column major with leading
+ * dimension k, only the lower triangle is used. */
+static int
+qp_box_chol_solve( size_t k, double *A, double *b )
+{
+    for( size_t j = 0; j < k; j ++ ) {
+        double d = A[j+k*j];
+        for( size_t p = 0; p < j; p ++ ) {
+            d -= A[j+k*p]*A[j+k*p];
+        }
+        if( d <= 0 ) return -1;
+        d = sqrt(d);
+        A[j+k*j] = d;
+        for( size_t i = j+1; i < k; i ++ ) {
+            double a = A[i+k*j];
+            for( size_t p = 0; p < j; p ++ ) {
+                a -= A[i+k*p]*A[j+k*p];
+            }
+            A[i+k*j] = a / d;
+        }
+    }
+    /* L y = b */
+    for( size_t i = 0; i < k; i ++ ) {
+        double y = b[i];
+        for( size_t p = 0; p < i; p ++ ) {
+            y -= A[i+k*p]*b[p];
+        }
+        b[i] = y / A[i+k*i];
+    }
+    /* L^T x = y */
+    for( size_t i = k; i-- > 0; ) {
+        double x = b[i];
+        for( size_t p = i+1; p < k; p ++ ) {
+            x -= A[p+k*i]*b[p];
+        }
+        b[i] = x / A[i+k*i];
+    }
+    return 0;
+}
+
+/*
+ * Primal active-set method for box constraints.
+ *
+ * Each iteration minimizes over the free variables with the bounded
+ * variables held at their bounds.  If the minimizer is infeasible, the
+ * step is cut at the first bound reached and that variable is fixed.
+ * Otherwise, the fixed variable whose multiplier has the wrong sign
+ * is released, or the current point is optimal.
+ */
+AA_API int
+aa_opt_qp_box_dense( size_t n,
+                     const double *D, size_t ldD,
+                     const double *c,
+                     const double *l, const double *u,
+                     double *x )
+{
+    enum { FREE = 0, LOWER = -1, UPPER = 1 };
+    int state[n];
+    size_t free_idx[n];
+    double D_ff[n*n], y[n];
+
+    /* Feasible start, nearest the origin */
+    for( size_t i = 0; i < n; i ++ ) {
+        if( l[i] > u[i] ) return -1;
+        x[i] = aa_fclamp( 0, l[i], u[i] );
+        state[i] = FREE;
+    }
+
+    for( size_t iter = 0; iter < 10*n + 10; iter ++ ) {
+        /* Minimize over the free variables */
+        size_t k = 0;
+        for( size_t i = 0; i < n; i ++ ) {
+            if( FREE == state[i] ) free_idx[k++] = i;
+        }
+        for( size_t jj = 0; jj < k; jj ++ ) {
+            size_t j = free_idx[jj];
+            for( size_t ii = 0; ii < k; ii ++ ) {
+                D_ff[ii+k*jj] = AA_MATREF(D, ldD, free_idx[ii], j);
+            }
+        }
+        for( size_t ii = 0; ii < k; ii ++ ) {
+            size_t i = free_idx[ii];
+            double r = -c[i];
+            for( size_t j = 0; j < n; j ++ ) {
+                if( FREE != state[j] ) {
+                    r -= AA_MATREF(D, ldD, i, j) * x[j];
+                }
+            }
+            y[ii] = r;
+        }
+        if( k > 0 && qp_box_chol_solve( k, D_ff, y ) ) {
+            return -1;
+        }
+
+        /* Step towards the subspace minimizer until a bound */
+        double alpha = 1;
+        size_t i_block = n;
+        int side = FREE;
+        for( size_t ii = 0; ii < k; ii ++ ) {
+            size_t i = free_idx[ii];
+            double d = y[ii] - x[i];
+            if( y[ii] < l[i] && d < 0 ) {
+                double a = (l[i] - x[i]) / d;
+                if( a < alpha ) { alpha = a; i_block = i; side = LOWER; }
+            } else if( y[ii] > u[i] && d > 0 ) {
+                double a = (u[i] - x[i]) / d;
+                if( a < alpha ) { alpha = a; i_block = i; side = UPPER; }
+            }
+        }
+        alpha = AA_MAX( alpha, 0 );
+        for( size_t ii = 0; ii < k; ii ++ ) {
+            size_t i = free_idx[ii];
+            x[i] = aa_fclamp( x[i] + alpha*(y[ii] - x[i]), l[i], u[i] );
+        }
+
+        if( i_block < n ) {
+            state[i_block] = side;
+            x[i_block] = (LOWER == side) ? l[i_block] : u[i_block];
+            continue;
+        }
+
+        /* Subspace optimal, check multipliers of the fixed variables */
+        size_t i_release = n;
+        double g_max = 0;
+        for( size_t i = 0; i < n; i ++ ) {
+            if( FREE == state[i] ) continue;
+            double g = c[i];
+            for( size_t j = 0; j < n; j ++ ) {
+                g += AA_MATREF(D, ldD, i, j) * x[j];
+            }
+            /* Descent direction points into the box */
+            double v = (LOWER == state[i]) ? -g : g;
+            if( v > g_max ) {
+                g_max = v;
+                i_release = i;
+            }
+        }
+        if( i_release == n || g_max <= 1e-12 ) {
+            return 0;
+        }
+        state[i_release] = FREE;
+    }
+
+    return -1;
+}
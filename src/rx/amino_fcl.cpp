@@ -49,6 +49,8 @@
 
 #include "amino/rx/scene_collision.h"
 
+#include <algorithm>
+
 #include <fcl/collision.h>
 #include <fcl/shape/geometric_shapes.h>
 #include <fcl/broadphase/broadphase.h>
@@ -245,6 +247,11 @@ struct aa_rx_cl
     fcl::BroadPhaseCollisionManager *manager;
     std::vector<fcl::CollisionObject*> *objects;
 
+    // Objects re-posed on every check, or NULL for all objects
+    std::vector<fcl::CollisionObject*> *moving;
+    // Whether the remaining objects hold their (static) poses
+    bool static_posed;
+
     // A bit-matrix of allowable collisions
     struct aa_rx_cl_set *allowed;
 };
@@ -272,6 +279,8 @@ aa_rx_cl_create( const struct aa_rx_sg *scene_graph )
     struct aa_rx_cl *cl = new aa_rx_cl;
     cl->sg = scene_graph;
     cl->objects = new std::vector<fcl::CollisionObject*>;
+    cl->moving = NULL;
+    cl->static_posed = false;
     cl->manager = new fcl::DynamicAABBTreeCollisionManager();
 
     cl->allowed = aa_rx_cl_set_create(scene_graph);
@@ -293,6 +302,7 @@ aa_rx_cl_destroy( struct aa_rx_cl *cl )
 
     delete cl->manager;
     delete cl->objects;
+    delete cl->moving;
     aa_rx_cl_set_destroy( cl->allowed );
     delete cl;
 }
@@ -313,6 +323,13 @@ aa_rx_cl_allow_set( struct aa_rx_cl *cl,
     aa_rx_cl_set_fill( cl->allowed, set );
 }
 
+AA_API void
+aa_rx_cl_allow_reset( struct aa_rx_cl *cl )
+{
+    aa_rx_cl_set_clear( cl->allowed );
+    aa_rx_sg_cl_set_copy( cl->sg, cl->allowed );
+}
+
 
 AA_API void
 aa_rx_cl_allow_name( struct aa_rx_cl *cl,
@@ -376,6 +393,61 @@ cl_check_callback( ::fcl::CollisionObject *o1,
     return false;
 }
 
+AA_API void
+aa_rx_cl_set_moving( struct aa_rx_cl *cl,
+                     size_t n_frames, const aa_rx_frame_id *frames )
+{
+    cl->static_posed = false;
+    if( NULL == frames ) {
+        /* Back to posing all objects */
+        delete cl->moving;
+        cl->moving = NULL;
+        return;
+    }
+
+    size_t n_f = aa_rx_sg_frame_count(cl->sg);
+    bool is_moving[n_f];
+    std::fill( is_moving, is_moving + n_f, false );
+    for( size_t i = 0; i < n_frames; i ++ ) {
+        assert( (size_t)frames[i] < n_f );
+        is_moving[frames[i]] = true;
+    }
+
+    if( NULL == cl->moving ) {
+        cl->moving = new std::vector<fcl::CollisionObject*>;
+    }
+    cl->moving->clear();
+    for( fcl::CollisionObject *obj : *cl->objects ) {
+        aa_rx_frame_id id = (intptr_t) obj->getUserData();
+        if( is_moving[id] ) cl->moving->push_back(obj);
+    }
+}
+
+static void
+cl_pose( fcl::CollisionObject *obj, const double *TF, size_t ldTF )
+{
+    aa_rx_frame_id id = (intptr_t) obj->getUserData();
+    const double *TF_obj = TF+id*ldTF;
+
+    enum aa_rx_geom_shape shape_type;
+    struct aa_rx_geom *geom = (struct aa_rx_geom*)obj->collisionGeometry()->getUserData();
+    void *shape_ = aa_rx_geom_shape( geom, &shape_type);
+
+    /* Special case cylinders.
+     * Amino cylinders extend in +Z
+     * FCL cylinders extend in both +/- Z.
+     */
+    if( AA_RX_CYLINDER == shape_type ) {
+        struct aa_rx_shape_cylinder *shape = (struct aa_rx_shape_cylinder *)  shape_;
+        double E[7] = {0,0,0,1, 0,0, shape->height/2};
+        double E1[7];
+        aa_tf_qutr_mul(TF_obj, E, E1);
+        obj->setTransform(amino::fcl::qutr2fcltf(E1));
+    } else {
+        obj->setTransform( amino::fcl::qutr2fcltf(TF_obj) );
+    }
+}
+
 int
 aa_rx_cl_check( struct aa_rx_cl *cl,
                 size_t n_tf,
@@ -383,33 +455,18 @@ aa_rx_cl_check( struct aa_rx_cl *cl,
                 struct aa_rx_cl_set *cl_set )
 {
     /* Update Transforms */
-    for( auto itr = cl->objects->begin();
-         itr != cl->objects->end();
-         itr++ )
-    {
-        fcl::CollisionObject *obj = *itr;
-        aa_rx_frame_id id = (intptr_t) obj->getUserData();
-        const double *TF_obj = TF+id*ldTF;
-
-        enum aa_rx_geom_shape shape_type;
-        struct aa_rx_geom *geom = (struct aa_rx_geom*)obj->collisionGeometry()->getUserData();
-        void *shape_ = aa_rx_geom_shape( geom, &shape_type);
-
-        /* Special case cylinders.
-         * Amino cylinders extend in +Z
-         * FCL cylinders extend in both +/- Z.
-         */
-        if( AA_RX_CYLINDER == shape_type ) {
-            struct aa_rx_shape_cylinder *shape = (struct aa_rx_shape_cylinder *)  shape_;
-            double E[7] = {0,0,0,1, 0,0, shape->height/2};
-            double E1[7];
-            aa_tf_qutr_mul(TF_obj, E, E1);
-            obj->setTransform(amino::fcl::qutr2fcltf(E1));
-        } else {
-            obj->setTransform( amino::fcl::qutr2fcltf(TF_obj) );
+    if( cl->moving && cl->static_posed ) {
+        for( fcl::CollisionObject *obj : *cl->moving ) {
+            cl_pose( obj, TF, ldTF );
+        }
+        cl->manager->update( *cl->moving );
+    } else {
+        for( fcl::CollisionObject *obj : *cl->objects ) {
+            cl_pose( obj, TF, ldTF );
         }
+        cl->manager->update();
+        cl->static_posed = true;
     }
-    cl->manager->update();
 
     /* Check Collision */
     struct cl_check_data data;
@@ -0,0 +1,1107 @@
+/* -*- mode: C; c-basic-offset: 4; -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2016, Rice University
+ * All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of copyright holder the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "amino.h"
+#include "amino/rx/rxtype.h"
+#include "amino/rx/rxerr.h"
+#include "amino/rx/scenegraph.h"
+#include "amino/rx/scene_geom.h"
+#include "amino/rx/scene_kin.h"
+#include "amino/rx/scene_kin_internal.h"
+#include "amino/rx/scene_sub.h"
+#include "amino/rx/rx_ct.h"
+
+struct aa_rx_ct_opt_opts {
+    size_t n_waypoints;
+    size_t max_iterations;
+    double clearance;
+    double w_smooth;
+    double w_obstacle;
+    double step;
+    double max_step;
+    size_t n_threads;
+};
+
+AA_API struct aa_rx_ct_opt_opts *
+aa_rx_ct_opt_opts_create( void )
+{
+    struct aa_rx_ct_opt_opts *opts = AA_NEW(struct aa_rx_ct_opt_opts);
+    opts->n_waypoints = 32;
+    opts->max_iterations = 200;
+    opts->clearance = 0.05;
+    opts->w_smooth = 1;
+    opts->w_obstacle = 1e4;
+    opts->step = 1;
+    opts->max_step = 0.1;
+    opts->n_threads = 0;
+    return opts;
+}
+
+AA_API void
+aa_rx_ct_opt_opts_destroy( struct aa_rx_ct_opt_opts *opts )
+{
+    free(opts);
+}
+
+AA_API void
+aa_rx_ct_opt_opts_set_waypoints( struct aa_rx_ct_opt_opts *opts, size_t n )
+{
+    opts->n_waypoints = n;
+}
+
+AA_API void
+aa_rx_ct_opt_opts_set_iterations( struct aa_rx_ct_opt_opts *opts, size_t n )
+{
+    opts->max_iterations = n;
+}
+
+AA_API void
+aa_rx_ct_opt_opts_set_clearance( struct aa_rx_ct_opt_opts *opts, double clearance )
+{
+    opts->clearance = clearance;
+}
+
+AA_API void
+aa_rx_ct_opt_opts_set_weights( struct aa_rx_ct_opt_opts *opts,
+                               double smooth, double obstacle )
+{
+    opts->w_smooth = smooth;
+    opts->w_obstacle = obstacle;
+}
+
+AA_API void
+aa_rx_ct_opt_opts_set_step( struct aa_rx_ct_opt_opts *opts,
+                            double step, double max_step )
+{
+    opts->step = step;
+    opts->max_step = max_step;
+}
+
+AA_API void
+aa_rx_ct_opt_opts_set_threads( struct aa_rx_ct_opt_opts *opts, size_t n_threads )
+{
+    opts->n_threads = n_threads;
+}
+
+
+/*-- Geometry --*/
+
+enum tjo_shape {
+    TJO_BOX,
+    TJO_SPHERE,
+    TJO_CYLINDER
+};
+
+/* A primitive in the local frame of its scene frame */
+struct tjo_prim {
+    enum tjo_shape shape;
+    double center[3];   ///< offset of the primitive center
+    double dim[3];      ///< box half extents, sphere radius, or cylinder radius and half height
+};
+
+/* Static collision geometry */
+struct tjo_obstacle {
+    aa_rx_frame_id frame;
+    struct tjo_prim prim;
+    double q[4];        ///< orientation in the global frame
+    double E_inv[7];    ///< global to frame transform
+    double pos[3];      ///< global position of the center
+    double bound;       ///< bounding radius about pos
+};
+
+/* Sphere covering part of a moving frame's geometry */
+struct tjo_sphere {
+    size_t body;
+    double c[3];        ///< center in the body frame
+    double r;
+    double p_start[3];  ///< global center at the start
+    double p_goal[3];   ///< global center at the goal
+    size_t pair0, pair1;        ///< range of obstacles to check
+};
+
+/* Obstacle to check against a sphere */
+struct tjo_pair {
+    size_t obstacle;
+    int contact;        ///< whether in contact at the start or goal
+    double d_start;     ///< signed distance at the start
+    double d_goal;      ///< signed distance at the goal
+};
+
+/* A moving frame with collision geometry */
+struct tjo_body {
+    aa_rx_frame_id frame;
+    size_t n_chain;
+    aa_rx_frame_id *chain;      ///< frames from the root to this frame
+    size_t n_cols;
+    ssize_t *col;               ///< sub-scenegraph index of each Jacobian column, or -1
+    size_t sphere0, sphere1;    ///< range of spheres
+};
+
+/* Convert a geometry object to a bounding primitive, or return -1 */
+static int
+tjo_prim_geom( const struct aa_rx_geom *geom, struct tjo_prim *p )
+{
+    enum aa_rx_geom_shape type;
+    void *shape = aa_rx_geom_shape(geom, &type);
+    double s = aa_rx_geom_opt_get_scale( aa_rx_geom_get_opt(geom) );
+    AA_MEM_ZERO(p->center, 3);
+
+    switch( type ) {
+    case AA_RX_BOX: {
+        struct aa_rx_shape_box *b = (struct aa_rx_shape_box*)shape;
+        p->shape = TJO_BOX;
+        for( size_t i = 0; i < 3; i ++ ) p->dim[i] = s*b->dimension[i]/2;
+        return 0;
+    }
+    case AA_RX_SPHERE: {
+        struct aa_rx_shape_sphere *b = (struct aa_rx_shape_sphere*)shape;
+        p->shape = TJO_SPHERE;
+        p->dim[0] = s*b->radius;
+        return 0;
+    }
+    case AA_RX_CYLINDER: {
+        /* Amino cylinders extend in +Z */
+        struct aa_rx_shape_cylinder *b = (struct aa_rx_shape_cylinder*)shape;
+        p->shape = TJO_CYLINDER;
+        p->dim[0] = s*b->radius;
+        p->dim[1] = s*b->height/2;
+        p->center[2] = p->dim[1];
+        return 0;
+    }
+    case AA_RX_CONE: {
+        /* Bounding cylinder */
+        struct aa_rx_shape_cone *b = (struct aa_rx_shape_cone*)shape;
+        p->shape = TJO_CYLINDER;
+        p->dim[0] = s*AA_MAX(b->start_radius, b->end_radius);
+        p->dim[1] = s*b->height/2;
+        p->center[2] = p->dim[1];
+        return 0;
+    }
+    case AA_RX_MESH: {
+        /* Bounding box */
+        size_t n;
+        const float *v = aa_rx_mesh_get_vertices( (struct aa_rx_mesh*)shape, &n );
+        if( 0 == n ) return -1;
+        double lo[3], hi[3];
+        for( size_t i = 0; i < 3; i ++ ) lo[i] = hi[i] = v[i];
+        for( size_t k = 0; k < 3*n; k += 3 ) {
+            for( size_t i = 0; i < 3; i ++ ) {
+                lo[i] = AA_MIN(lo[i], (double)v[k+i]);
+                hi[i] = AA_MAX(hi[i], (double)v[k+i]);
+            }
+        }
+        p->shape = TJO_BOX;
+        for( size_t i = 0; i < 3; i ++ ) {
+            p->center[i] = s*(lo[i] + hi[i])/2;
+            p->dim[i] = s*(hi[i] - lo[i])/2;
+        }
+        return 0;
+    }
+    default:
+        return -1;
+    }
+}
+
+static double
+tjo_prim_bound( const struct tjo_prim *p )
+{
+    switch( p->shape ) {
+    case TJO_BOX: return sqrt(AA_TF_VDOT(p->dim, p->dim));
+    case TJO_SPHERE: return p->dim[0];
+    case TJO_CYLINDER: return sqrt(p->dim[0]*p->dim[0] + p->dim[1]*p->dim[1]);
+    }
+    return 0;
+}
+
+/*
+ * Signed distance from local point x (relative to the primitive
+ * center) to the primitive surface, and the unit gradient g.
+ */
+static double
+tjo_prim_sdf( const struct tjo_prim *p, const double x[3], double g[3] )
+{
+    switch( p->shape ) {
+    case TJO_SPHERE: {
+        double n = sqrt(AA_TF_VDOT(x,x));
+        if( n > 0 ) {
+            for( size_t i = 0; i < 3; i ++ ) g[i] = x[i]/n;
+        } else {
+            g[0] = g[1] = 0; g[2] = 1;
+        }
+        return n - p->dim[0];
+    }
+    case TJO_BOX: {
+        double q[3], o[3], q_max = -INFINITY;
+        size_t k_max = 0;
+        for( size_t i = 0; i < 3; i ++ ) {
+            q[i] = fabs(x[i]) - p->dim[i];
+            o[i] = AA_MAX(q[i], 0);
+            if( q[i] > q_max ) { q_max = q[i]; k_max = i; }
+        }
+        if( q_max > 0 ) {
+            double d = sqrt(AA_TF_VDOT(o,o));
+            for( size_t i = 0; i < 3; i ++ ) g[i] = copysign(o[i]/d, x[i]);
+            return d;
+        } else {
+            AA_MEM_ZERO(g,3);
+            g[k_max] = copysign(1, x[k_max]);
+            return q_max;
+        }
+    }
+    case TJO_CYLINDER: {
+        double rho = sqrt(x[0]*x[0] + x[1]*x[1]);
+        double u[2] = {1, 0};
+        if( rho > 0 ) { u[0] = x[0]/rho; u[1] = x[1]/rho; }
+        double a = rho - p->dim[0];
+        double b = fabs(x[2]) - p->dim[1];
+        double sz = copysign(1, x[2]);
+        if( a > 0 || b > 0 ) {
+            double oa = AA_MAX(a,0), ob = AA_MAX(b,0);
+            double d = sqrt(oa*oa + ob*ob);
+            g[0] = oa*u[0]/d;
+            g[1] = oa*u[1]/d;
+            g[2] = ob*sz/d;
+            return d;
+        } else if( a > b ) {
+            g[0] = u[0]; g[1] = u[1]; g[2] = 0;
+            return a;
+        } else {
+            g[0] = 0; g[1] = 0; g[2] = sz;
+            return b;
+        }
+    }
+    }
+    return INFINITY;
+}
+
+/* Signed distance from global point p to the obstacle */
+static double
+tjo_obstacle_sdf( const struct tjo_obstacle *o, const double p[3], double g[3] )
+{
+    double x[3], gl[3];
+    aa_tf_qutr_tf( o->E_inv, p, x );
+    for( size_t i = 0; i < 3; i ++ ) x[i] -= o->prim.center[i];
+    double d = tjo_prim_sdf( &o->prim, x, gl );
+    aa_tf_qrot( o->q, gl, g );
+    return d;
+}
+
+/* CHOMP obstacle cost for signed distance d, and its derivative */
+static double
+tjo_cost( double eps, double d, double *dc )
+{
+    if( d < 0 ) {
+        *dc = -1;
+        return -d + eps/2;
+    } else if( d < eps ) {
+        *dc = (d - eps) / eps;
+        return (d-eps)*(d-eps) / (2*eps);
+    } else {
+        *dc = 0;
+        return 0;
+    }
+}
+
+
+/*-- Problem Setup --*/
+
+struct tjo_cx {
+    const struct aa_rx_ct_opt_opts *opts;
+    const struct aa_rx_sg_sub *ssg;
+    const struct aa_rx_sg *sg;
+    size_t n_q_all;
+    size_t n_s;
+    size_t n_f;
+
+    const double *q_base;       ///< full configuration for other variables
+    double *TF_abs0;            ///< transforms at q_base
+
+    size_t n_moving;
+    aa_rx_frame_id *moving;     ///< frames the sub-scenegraph moves, parents first
+
+    size_t n_body, n_sphere, n_obstacle, n_pair;
+    struct tjo_body *body;
+    struct tjo_sphere *sphere;
+    struct tjo_obstacle *obstacle;
+    struct tjo_pair *pair;      ///< obstacles, per sphere range
+
+    size_t n_point;             ///< number of waypoints
+    double *xi;                 ///< waypoints of the sub-scenegraph configuration
+    double *grad;               ///< obstacle gradient per waypoint
+    double *cost;               ///< obstacle cost per waypoint
+    double *dist;               ///< least distance per waypoint
+};
+
+struct tjo_geom_list {
+    size_t n, max;
+    aa_rx_frame_id *frame;
+    const struct aa_rx_geom **geom;
+};
+
+static void
+tjo_collect_geom( void *vcx, aa_rx_frame_id frame_id, struct aa_rx_geom *geom )
+{
+    struct tjo_geom_list *l = (struct tjo_geom_list*)vcx;
+    if( ! aa_rx_geom_opt_get_collision(aa_rx_geom_get_opt(geom)) ) return;
+    if( l->n == l->max ) {
+        l->max = AA_MAX( (size_t)16, 2*l->max );
+        l->frame = (aa_rx_frame_id*)realloc( l->frame, l->max * sizeof(l->frame[0]) );
+        l->geom = (const struct aa_rx_geom**)realloc( l->geom, l->max * sizeof(l->geom[0]) );
+    }
+    l->frame[l->n] = frame_id;
+    l->geom[l->n] = geom;
+    l->n++;
+}
+
+/* Number of covering spheres for a primitive */
+static size_t
+tjo_sphere_count( const struct tjo_prim *p )
+{
+    double L, rho;
+    switch( p->shape ) {
+    case TJO_SPHERE:
+        return 1;
+    case TJO_CYLINDER:
+        L = p->dim[1];
+        rho = p->dim[0];
+        break;
+    case TJO_BOX: {
+        size_t a = 0;
+        for( size_t i = 1; i < 3; i ++ ) if( p->dim[i] > p->dim[a] ) a = i;
+        L = p->dim[a];
+        rho = sqrt( AA_TF_VDOT(p->dim,p->dim) - L*L );
+        break;
+    }
+    default:
+        return 0;
+    }
+    if( rho <= 0 ) return 1;
+    return AA_MAX( (size_t)1, AA_MIN( (size_t)16, (size_t)ceil(L/rho) ) );
+}
+
+/* Cover a primitive with n spheres along its long axis */
+static void
+tjo_sphere_fill( const struct tjo_prim *p, size_t n, struct tjo_sphere *s )
+{
+    double axis[3] = {0,0,0};
+    double L = 0, rho = 0;
+    switch( p->shape ) {
+    case TJO_SPHERE:
+        AA_MEM_CPY( s->c, p->center, 3 );
+        s->r = p->dim[0];
+        return;
+    case TJO_CYLINDER:
+        axis[2] = 1;
+        L = p->dim[1];
+        rho = p->dim[0];
+        break;
+    case TJO_BOX: {
+        size_t a = 0;
+        for( size_t i = 1; i < 3; i ++ ) if( p->dim[i] > p->dim[a] ) a = i;
+        axis[a] = 1;
+        L = p->dim[a];
+        rho = sqrt( AA_TF_VDOT(p->dim,p->dim) - L*L );
+        break;
+    }
+    }
+    double h = L / (double)n;
+    for( size_t k = 0; k < n; k ++ ) {
+        double t = -L + (2*(double)k + 1)*h;
+        for( size_t i = 0; i < 3; i ++ ) s[k].c[i] = p->center[i] + t*axis[i];
+        s[k].r = sqrt( rho*rho + h*h );
+    }
+}
+
+/* Transforms of all frames at sub-scenegraph configuration q */
+static void
+tjo_tf( const struct tjo_cx *cx, const double *q, double *q_all, double *TF_abs )
+{
+    AA_MEM_CPY( q_all, cx->q_base, cx->n_q_all );
+    aa_rx_sg_sub_config_set( cx->ssg, cx->n_s, q, cx->n_q_all, q_all );
+    AA_MEM_CPY( TF_abs, cx->TF_abs0, 7*cx->n_f );
+    aa_rx_sg_tf_frames( cx->sg, cx->n_q_all, q_all,
+                        cx->n_moving, cx->moving,
+                        cx->n_f, TF_abs, 7 );
+}
+
+static void
+tjo_sphere_pos( const struct tjo_cx *cx, const struct tjo_sphere *s,
+                const double *TF_abs, double p[3] )
+{
+    aa_tf_qutr_tf( TF_abs + 7*cx->body[s->body].frame, s->c, p );
+}
+
+static void
+tjo_setup( struct tjo_cx *cx, struct aa_mem_region *reg,
+           const double *q_start, const double *q_goal )
+{
+    const struct aa_rx_sg *sg = cx->sg;
+    size_t n_f = cx->n_f;
+    size_t n_q = cx->n_q_all;
+
+    /* Sub-scenegraph index of each configuration */
+    ssize_t *sub_index = AA_MEM_REGION_NEW_N( reg, ssize_t, n_q );
+    for( size_t i = 0; i < n_q; i ++ ) sub_index[i] = -1;
+    for( size_t i = 0; i < cx->n_s; i ++ ) {
+        sub_index[aa_rx_sg_sub_config(cx->ssg, i)] = (ssize_t)i;
+    }
+
+    /* Moving frames */
+    int *moving = AA_MEM_REGION_NEW_N( reg, int, n_f );
+    cx->moving = AA_MEM_REGION_NEW_N( reg, aa_rx_frame_id, n_f );
+    cx->n_moving = 0;
+    for( size_t i = 0; i < n_f; i ++ ) {
+        aa_rx_config_id cid = aa_rx_sg_frame_config(sg, (aa_rx_frame_id)i);
+        aa_rx_frame_id parent = aa_rx_sg_frame_parent(sg, (aa_rx_frame_id)i);
+        moving[i] = ( (AA_RX_CONFIG_NONE != cid && sub_index[cid] >= 0) ||
+                      (parent >= 0 && moving[parent]) );
+        if( moving[i] ) cx->moving[cx->n_moving++] = (aa_rx_frame_id)i;
+    }
+
+    /* Geometry */
+    struct tjo_geom_list geoms = {0, 0, NULL, NULL};
+    aa_rx_sg_map_geom( sg, tjo_collect_geom, &geoms );
+
+    struct tjo_prim *prim = AA_MEM_REGION_NEW_N( reg, struct tjo_prim, geoms.n+1 );
+    int *valid = AA_MEM_REGION_NEW_N( reg, int, geoms.n+1 );
+    size_t n_sphere = 0, n_obstacle = 0;
+    for( size_t k = 0; k < geoms.n; k ++ ) {
+        valid[k] = (0 == tjo_prim_geom(geoms.geom[k], prim+k));
+        if( !valid[k] ) continue;
+        if( moving[geoms.frame[k]] ) n_sphere += tjo_sphere_count(prim+k);
+        else n_obstacle ++;
+    }
+
+    cx->body = AA_MEM_REGION_NEW_N( reg, struct tjo_body, cx->n_moving+1 );
+    cx->sphere = AA_MEM_REGION_NEW_N( reg, struct tjo_sphere, n_sphere+1 );
+    cx->obstacle = AA_MEM_REGION_NEW_N( reg, struct tjo_obstacle, n_obstacle+1 );
+    cx->n_body = cx->n_sphere = cx->n_obstacle = 0;
+
+    /* Obstacles */
+    for( size_t k = 0; k < geoms.n; k ++ ) {
+        if( !valid[k] || moving[geoms.frame[k]] ) continue;
+        struct tjo_obstacle *o = cx->obstacle + cx->n_obstacle++;
+        const double *E = cx->TF_abs0 + 7*geoms.frame[k];
+        o->frame = geoms.frame[k];
+        o->prim = prim[k];
+        AA_MEM_CPY( o->q, E + AA_TF_QUTR_Q, 4 );
+        aa_tf_qutr_conj( E, o->E_inv );
+        aa_tf_qutr_tf( E, o->prim.center, o->pos );
+        o->bound = tjo_prim_bound( &o->prim );
+    }
+
+    /* Bodies and their spheres, in frame order */
+    for( size_t m = 0; m < cx->n_moving; m ++ ) {
+        aa_rx_frame_id f = cx->moving[m];
+        size_t sphere0 = cx->n_sphere;
+        for( size_t k = 0; k < geoms.n; k ++ ) {
+            if( !valid[k] || geoms.frame[k] != f ) continue;
+            size_t n = tjo_sphere_count(prim+k);
+            tjo_sphere_fill( prim+k, n, cx->sphere + cx->n_sphere );
+            for( size_t j = 0; j < n; j ++ ) {
+                cx->sphere[cx->n_sphere + j].body = cx->n_body;
+            }
+            cx->n_sphere += n;
+        }
+        if( sphere0 == cx->n_sphere ) continue;
+
+        struct tjo_body *b = cx->body + cx->n_body++;
+        b->frame = f;
+        b->sphere0 = sphere0;
+        b->sphere1 = cx->n_sphere;
+        b->n_chain = aa_rx_sg_chain_frame_count( sg, AA_RX_FRAME_ROOT, f );
+        b->chain = AA_MEM_REGION_NEW_N( reg, aa_rx_frame_id, b->n_chain );
+        aa_rx_sg_chain_frames( sg, AA_RX_FRAME_ROOT, f, b->n_chain, b->chain );
+        b->n_cols = aa_rx_sg_chain_config_count( sg, b->n_chain, b->chain );
+        aa_rx_config_id configs[b->n_cols+1];
+        aa_rx_sg_chain_configs( sg, b->n_chain, b->chain, b->n_cols, configs );
+        b->col = AA_MEM_REGION_NEW_N( reg, ssize_t, b->n_cols+1 );
+        for( size_t j = 0; j < b->n_cols; j ++ ) {
+            b->col[j] = sub_index[configs[j]];
+        }
+    }
+    free( geoms.frame );
+    free( geoms.geom );
+
+    /* Pairs to check: those not allowed.  Pairs in contact at an
+     * endpoint are relieved near that endpoint; see tjo_relief(). */
+    double *q_all = AA_MEM_REGION_NEW_N( reg, double, n_q );
+    double *TF_start = AA_MEM_REGION_NEW_N( reg, double, 7*n_f );
+    double *TF_goal = AA_MEM_REGION_NEW_N( reg, double, 7*n_f );
+    tjo_tf( cx, q_start, q_all, TF_start );
+    tjo_tf( cx, q_goal, q_all, TF_goal );
+
+    cx->pair = AA_MEM_REGION_NEW_N( reg, struct tjo_pair, cx->n_sphere * cx->n_obstacle + 1 );
+    cx->n_pair = 0;
+    for( size_t i = 0; i < cx->n_sphere; i ++ ) {
+        struct tjo_sphere *s = cx->sphere + i;
+        aa_rx_frame_id f = cx->body[s->body].frame;
+        double g[3];
+        tjo_sphere_pos( cx, s, TF_start, s->p_start );
+        tjo_sphere_pos( cx, s, TF_goal, s->p_goal );
+        s->pair0 = cx->n_pair;
+        for( size_t j = 0; j < cx->n_obstacle; j ++ ) {
+            const struct tjo_obstacle *o = cx->obstacle + j;
+            if( aa_rx_sg_is_collision_allowed(sg, f, o->frame) ) continue;
+            struct tjo_pair *pr = cx->pair + cx->n_pair++;
+            pr->obstacle = j;
+            pr->d_start = tjo_obstacle_sdf(o, s->p_start, g) - s->r;
+            pr->d_goal = tjo_obstacle_sdf(o, s->p_goal, g) - s->r;
+            pr->contact = pr->d_start < 0 || pr->d_goal < 0;
+        }
+        s->pair1 = cx->n_pair;
+    }
+}
+
+
+/*-- Waypoint Evaluation --*/
+
+struct tjo_worker {
+    struct tjo_cx *cx;
+    size_t index;
+    size_t n_workers;
+    double *q_all;
+    double *TF_abs;
+    double *J;
+};
+
+/* Relief from an endpoint contact, fading from the endpoint's
+ * penetration plus the clearance to zero as the sphere moves its
+ * radius plus that amount away from its position at the endpoint.
+ * Gradient is added to g. */
+static double
+tjo_relief_end( const struct tjo_sphere *s, const double *p_end, double d_end,
+                const double p[3], double eps, double g[3] )
+{
+    if( d_end >= 0 ) return 0;
+    double depth = eps - d_end;
+    double R = s->r + depth;
+    double dp[3];
+    for( size_t l = 0; l < 3; l ++ ) dp[l] = p[l] - p_end[l];
+    double rho = sqrt(AA_TF_VDOT(dp,dp));
+    if( rho >= R ) return 0;
+    if( rho > 0 ) {
+        for( size_t l = 0; l < 3; l ++ ) g[l] -= depth/R * dp[l]/rho;
+    }
+    return depth * (1 - rho/R);
+}
+
+/* Distance added to a pair in contact at the start or goal, so that
+ * the contact is excused only near that endpoint */
+static double
+tjo_relief( const struct tjo_sphere *s, const struct tjo_pair *pr,
+            const double p[3], double eps, double g[3] )
+{
+    double g0[3] = {0,0,0}, g1[3] = {0,0,0};
+    double r0 = tjo_relief_end( s, s->p_start, pr->d_start, p, eps, g0 );
+    double r1 = tjo_relief_end( s, s->p_goal, pr->d_goal, p, eps, g1 );
+    const double *gr = (r0 >= r1) ? g0 : g1;
+    for( size_t l = 0; l < 3; l ++ ) g[l] += gr[l];
+    return AA_MAX(r0, r1);
+}
+
+/* Obstacle cost and gradient at waypoint i */
+static void
+tjo_eval_point( struct tjo_worker *w, size_t i )
+{
+    struct tjo_cx *cx = w->cx;
+    size_t n_s = cx->n_s;
+    double eps = cx->opts->clearance;
+    const double *q = cx->xi + i*n_s;
+    double *grad = cx->grad + i*n_s;
+    double cost = 0, dist = INFINITY;
+
+    tjo_tf( cx, q, w->q_all, w->TF_abs );
+    AA_MEM_ZERO( grad, n_s );
+
+    for( size_t k = 0; k < cx->n_body; k ++ ) {
+        const struct tjo_body *b = cx->body + k;
+        const double *pe = w->TF_abs + 7*b->frame + AA_TF_QUTR_T;
+
+        /* Net force and moment about the frame origin */
+        double F[3] = {0,0,0}, M[3] = {0,0,0};
+        for( size_t j = b->sphere0; j < b->sphere1; j ++ ) {
+            const struct tjo_sphere *s = cx->sphere + j;
+            double p[3];
+            tjo_sphere_pos( cx, s, w->TF_abs, p );
+            double Fs[3] = {0,0,0};
+            for( size_t m = s->pair0; m < s->pair1; m ++ ) {
+                const struct tjo_pair *pr = cx->pair + m;
+                const struct tjo_obstacle *o = cx->obstacle + pr->obstacle;
+                double dp[3];
+                for( size_t l = 0; l < 3; l ++ ) dp[l] = p[l] - o->pos[l];
+                double d_bound = sqrt(AA_TF_VDOT(dp,dp)) - o->bound - s->r;
+                if( d_bound >= eps ) {
+                    /* Beyond the clearance, and a lower bound on distance */
+                    dist = AA_MIN( dist, d_bound );
+                    continue;
+                }
+
+                double g[3], dc;
+                double d = tjo_obstacle_sdf( o, p, g ) - s->r;
+                if( pr->contact ) d += tjo_relief( s, pr, p, eps, g );
+                dist = AA_MIN( dist, d );
+                cost += tjo_cost( eps, d, &dc );
+                for( size_t l = 0; l < 3; l ++ ) Fs[l] += dc*g[l];
+            }
+            if( 0 == Fs[0] && 0 == Fs[1] && 0 == Fs[2] ) continue;
+            double r[3], rxF[3];
+            for( size_t l = 0; l < 3; l ++ ) {
+                r[l] = p[l] - pe[l];
+                F[l] += Fs[l];
+            }
+            aa_tf_cross( r, Fs, rxF );
+            for( size_t l = 0; l < 3; l ++ ) M[l] += rxF[l];
+        }
+        if( 0 == F[0] && 0 == F[1] && 0 == F[2] ) continue;
+
+        /* Map to joint space through the frame Jacobian */
+        aa_rx_sg_chain_jacobian( cx->sg, cx->n_f, w->TF_abs, 7,
+                                 b->n_chain, b->chain,
+                                 b->n_cols, b->chain,
+                                 w->J, 6 );
+        for( size_t j = 0; j < b->n_cols; j ++ ) {
+            if( b->col[j] < 0 ) continue;
+            const double *Jc = w->J + 6*j;
+            grad[b->col[j]] += ( AA_TF_VDOT(Jc + AA_TF_DX_V, F) +
+                                 AA_TF_VDOT(Jc + AA_TF_DX_W, M) );
+        }
+    }
+
+    cx->cost[i] = cost;
+    cx->dist[i] = dist;
+}
+
+static void
+tjo_eval_worker( struct tjo_worker *w )
+{
+    /* Interior waypoints, interleaved across workers */
+    for( size_t i = 1 + w->index; i + 1 < w->cx->n_point; i += w->n_workers ) {
+        tjo_eval_point( w, i );
+    }
+}
+
+/* Workers wait for each generation of waypoints */
+struct tjo_pool {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond_start;
+    pthread_cond_t cond_done;
+    unsigned long generation;
+    size_t n_busy;
+    int quit;
+    struct tjo_worker *workers;
+};
+
+struct tjo_thread_arg {
+    struct tjo_pool *pool;
+    struct tjo_worker *worker;
+};
+
+static void *
+tjo_thread( void *varg )
+{
+    struct tjo_thread_arg *arg = (struct tjo_thread_arg*)varg;
+    struct tjo_pool *pool = arg->pool;
+    unsigned long seen = 0;
+    for(;;) {
+        pthread_mutex_lock( &pool->mutex );
+        while( !pool->quit && seen == pool->generation ) {
+            pthread_cond_wait( &pool->cond_start, &pool->mutex );
+        }
+        int quit = pool->quit;
+        seen = pool->generation;
+        pthread_mutex_unlock( &pool->mutex );
+        if( quit ) break;
+
+        tjo_eval_worker( arg->worker );
+
+        pthread_mutex_lock( &pool->mutex );
+        if( 0 == --pool->n_busy ) pthread_cond_signal( &pool->cond_done );
+        pthread_mutex_unlock( &pool->mutex );
+    }
+    return NULL;
+}
+
+/* Evaluate all interior waypoints, using n_started pool threads */
+static void
+tjo_eval( struct tjo_pool *pool, size_t n_started )
+{
+    pthread_mutex_lock( &pool->mutex );
+    pool->generation++;
+    pool->n_busy = n_started;
+    pthread_cond_broadcast( &pool->cond_start );
+    pthread_mutex_unlock( &pool->mutex );
+
+    tjo_eval_worker( pool->workers );
+
+    pthread_mutex_lock( &pool->mutex );
+    while( pool->n_busy ) {
+        pthread_cond_wait( &pool->cond_done, &pool->mutex );
+    }
+    pthread_mutex_unlock( &pool->mutex );
+}
+
+
+/* Smoothness plus weighted obstacle cost at the evaluated waypoints */
+static double
+tjo_total_cost( const struct tjo_cx *cx, double w_obstacle )
+{
+    size_t n_s = cx->n_s;
+    double c_smooth = 0, c_obstacle = 0;
+    for( size_t r = 0; r + 2 < cx->n_point; r ++ ) {
+        for( size_t j = 0; j < n_s; j ++ ) {
+            double a = ( cx->xi[r*n_s+j]
+                         - 2*cx->xi[(r+1)*n_s+j]
+                         + cx->xi[(r+2)*n_s+j] );
+            c_smooth += a*a;
+        }
+    }
+    for( size_t i = 1; i + 1 < cx->n_point; i ++ ) {
+        c_obstacle += cx->cost[i];
+    }
+    return c_smooth/2 + w_obstacle*c_obstacle;
+}
+
+
+/*-- Banded Solver --*/
+
+/*
+ * Cholesky factor of the pentadiagonal matrix with diagonals a0,
+ * a1 (first subdiagonal) and a2 (second subdiagonal), in place.
+ */
+static void
+tjo_band_factor( size_t m, double *a0, double *a1, double *a2 )
+{
+    for( size_t i = 0; i < m; i ++ ) {
+        if( i >= 2 ) a2[i] /= a0[i-2];
+        if( i >= 1 ) a1[i] = (a1[i] - ((i >= 2) ? a2[i]*a1[i-1] : 0)) / a0[i-1];
+        a0[i] = sqrt( a0[i]
+                      - ((i >= 1) ? a1[i]*a1[i] : 0)
+                      - ((i >= 2) ? a2[i]*a2[i] : 0) );
+    }
+}
+
+/* Solve L L' x = b for the factor from tjo_band_factor(), strided */
+static void
+tjo_band_solve( size_t m, const double *l0, const double *l1, const double *l2,
+                double *x, size_t inc )
+{
+    for( size_t i = 0; i < m; i ++ ) {
+        double s = x[i*inc];
+        if( i >= 1 ) s -= l1[i]*x[(i-1)*inc];
+        if( i >= 2 ) s -= l2[i]*x[(i-2)*inc];
+        x[i*inc] = s / l0[i];
+    }
+    for( size_t i = m; i-- > 0; ) {
+        double s = x[i*inc];
+        if( i+1 < m ) s -= l1[i+1]*x[(i+1)*inc];
+        if( i+2 < m ) s -= l2[i+2]*x[(i+2)*inc];
+        x[i*inc] = s / l0[i];
+    }
+}
+
+
+/*-- Optimization --*/
+
+/* Resample path at n_point waypoints, evenly spaced by arc length */
+static void
+tjo_resample( struct aa_mem_region *reg,
+              size_t n_s, size_t n_path, const double *path, size_t ld,
+              size_t n_point, double *xi )
+{
+    double *len = AA_MEM_REGION_NEW_N( reg, double, n_path );
+    len[0] = 0;
+    for( size_t k = 1; k < n_path; k ++ ) {
+        len[k] = len[k-1] + aa_la_dist( n_s, path + (k-1)*ld, path + k*ld );
+    }
+    double total = len[n_path-1];
+
+    size_t k = 0;
+    for( size_t i = 0; i < n_point; i ++ ) {
+        double s = total * (double)i / (double)(n_point-1);
+        while( k+2 < n_path && len[k+1] < s ) k++;
+        double seg = len[k+1] - len[k];
+        double u = (seg > 0) ? AA_MIN(1.0, (s - len[k]) / seg) : 0;
+        for( size_t j = 0; j < n_s; j ++ ) {
+            xi[i*n_s+j] = (1-u)*path[k*ld+j] + u*path[(k+1)*ld+j];
+        }
+    }
+}
+
+AA_API int
+aa_rx_ct_tjq_opt( struct aa_mem_region *region,
+                  const struct aa_rx_ct_opt_opts *opts_arg,
+                  const struct aa_rx_sg_sub *ssg,
+                  struct aa_ct_limit *limits,
+                  size_t n_q_all, size_t n_path, const double *path,
+                  struct aa_ct_seg_list **segs )
+{
+    const struct aa_rx_sg *sg = aa_rx_sg_sub_sg(ssg);
+    if( n_path < 2 || n_q_all != aa_rx_sg_config_count(sg) ) {
+        return AA_RX_INVALID_PARAMETER;
+    }
+
+    struct aa_rx_ct_opt_opts opts_default;
+    if( NULL == opts_arg ) {
+        struct aa_rx_ct_opt_opts *o = aa_rx_ct_opt_opts_create();
+        opts_default = *o;
+        aa_rx_ct_opt_opts_destroy(o);
+        opts_arg = &opts_default;
+    }
+    const struct aa_rx_ct_opt_opts *opts = opts_arg;
+
+    struct aa_mem_region *reg = aa_mem_region_local_get();
+    void *reg_ptr = aa_mem_region_alloc(reg, 1);
+
+    size_t n_s = aa_rx_sg_sub_config_count(ssg);
+    size_t T = AA_MAX( (size_t)3, opts->n_waypoints );
+    size_t m = T - 2;
+
+    struct tjo_cx cx;
+    cx.opts = opts;
+    cx.ssg = ssg;
+    cx.sg = sg;
+    cx.n_q_all = n_q_all;
+    cx.n_s = n_s;
+    cx.n_f = aa_rx_sg_frame_count(sg);
+    cx.q_base = path;
+    cx.TF_abs0 = AA_MEM_REGION_NEW_N( reg, double, 7*cx.n_f );
+    {
+        double *TF_rel = AA_MEM_REGION_NEW_N( reg, double, 7*cx.n_f );
+        aa_rx_sg_tf( sg, n_q_all, path, cx.n_f, TF_rel, 7, cx.TF_abs0, 7 );
+    }
+    cx.n_point = T;
+    cx.xi = AA_MEM_REGION_NEW_N( reg, double, T*n_s );
+    cx.grad = AA_MEM_REGION_NEW_N( reg, double, T*n_s );
+    cx.cost = AA_MEM_REGION_NEW_N( reg, double, T );
+    cx.dist = AA_MEM_REGION_NEW_N( reg, double, T );
+
+    /* Initial waypoints */
+    {
+        double *path_sub = AA_MEM_REGION_NEW_N( reg, double, n_path*n_s );
+        for( size_t k = 0; k < n_path; k ++ ) {
+            aa_rx_sg_sub_config_get( ssg, n_q_all, path + k*n_q_all,
+                                     n_s, path_sub + k*n_s );
+        }
+        tjo_resample( reg, n_s, n_path, path_sub, n_s, T, cx.xi );
+    }
+
+    tjo_setup( &cx, reg, cx.xi, cx.xi + (T-1)*n_s );
+
+    /* Position limits */
+    double *lo = AA_MEM_REGION_NEW_N( reg, double, n_s );
+    double *hi = AA_MEM_REGION_NEW_N( reg, double, n_s );
+    for( size_t j = 0; j < n_s; j ++ ) {
+        if( aa_rx_sg_get_limit_pos(sg, aa_rx_sg_sub_config(ssg,j), lo+j, hi+j) ) {
+            lo[j] = -INFINITY;
+            hi[j] = INFINITY;
+        }
+    }
+
+    /* Smoothness metric: squared second differences of the waypoints,
+     * over the interior waypoints */
+    double *l0 = AA_MEM_REGION_NEW_N( reg, double, m );
+    double *l1 = AA_MEM_REGION_NEW_N( reg, double, m );
+    double *l2 = AA_MEM_REGION_NEW_N( reg, double, m );
+    AA_MEM_ZERO(l0, m);
+    AA_MEM_ZERO(l1, m);
+    AA_MEM_ZERO(l2, m);
+    for( size_t r = 0; r + 2 < T; r ++ ) {
+        static const double c[3] = {1, -2, 1};
+        for( size_t a = 0; a < 3; a ++ ) {
+            size_t pa = r + a;
+            if( 0 == pa || T-1 == pa ) continue;
+            for( size_t b = 0; b <= a; b ++ ) {
+                size_t pb = r + b;
+                if( 0 == pb || T-1 == pb ) continue;
+                double v = c[a]*c[b];
+                switch( a - b ) {
+                case 0: l0[pa-1] += v; break;
+                case 1: l1[pa-1] += v; break;
+                case 2: l2[pa-1] += v; break;
+                }
+            }
+        }
+    }
+    tjo_band_factor( m, l0, l1, l2 );
+
+    /* Workers */
+    size_t n_threads = opts->n_threads;
+    if( 0 == n_threads ) {
+        long n_cpu = sysconf(_SC_NPROCESSORS_ONLN);
+        n_threads = (n_cpu > 0) ? (size_t)n_cpu : 1;
+    }
+    n_threads = AA_MAX( (size_t)1, AA_MIN(n_threads, m) );
+
+    struct tjo_pool pool;
+    pthread_mutex_init( &pool.mutex, NULL );
+    pthread_cond_init( &pool.cond_start, NULL );
+    pthread_cond_init( &pool.cond_done, NULL );
+    pool.generation = 0;
+    pool.n_busy = 0;
+    pool.quit = 0;
+    pool.workers = AA_MEM_REGION_NEW_N( reg, struct tjo_worker, n_threads );
+    struct tjo_thread_arg args[n_threads];
+    for( size_t k = 0; k < n_threads; k ++ ) {
+        struct tjo_worker *w = pool.workers + k;
+        w->cx = &cx;
+        w->index = k;
+        w->n_workers = n_threads;
+        w->q_all = AA_MEM_REGION_NEW_N( reg, double, n_q_all );
+        w->TF_abs = AA_MEM_REGION_NEW_N( reg, double, 7*cx.n_f );
+        w->J = AA_MEM_REGION_NEW_N( reg, double, 6*n_q_all + 1 );
+        args[k].pool = &pool;
+        args[k].worker = w;
+    }
+    pthread_t threads[n_threads];
+    size_t n_started = 0;
+    for( ; n_started + 1 < n_threads; n_started ++ ) {
+        if( pthread_create( threads + n_started, NULL, tjo_thread, args + n_started + 1 ) ) {
+            break;
+        }
+    }
+    if( n_started + 1 < n_threads ) {
+        /* Fewer threads than planned, so the calling thread takes the rest */
+        for( size_t k = 0; k < n_threads; k ++ ) {
+            pool.workers[k].n_workers = n_started + 1;
+        }
+    }
+
+    /* Descend, scaling costs to a unit duration trajectory: the
+     * smoothness metric by (T-1)^4 and the obstacle cost by 1 */
+    double *delta = AA_MEM_REGION_NEW_N( reg, double, T*n_s );
+    double *xi0 = AA_MEM_REGION_NEW_N( reg, double, T*n_s );
+    double s4 = pow( (double)(T-1), 4 );
+    double w_ratio = opts->w_obstacle / (opts->w_smooth * s4);
+    double alpha = opts->step;
+
+    tjo_eval( &pool, n_started );
+    double cost = tjo_total_cost( &cx, w_ratio );
+    for( size_t iter = 0; iter < opts->max_iterations; iter ++ ) {
+        /* Gradient */
+        AA_MEM_ZERO( delta, T*n_s );
+        for( size_t r = 0; r + 2 < T; r ++ ) {
+            for( size_t j = 0; j < n_s; j ++ ) {
+                double a = ( cx.xi[r*n_s+j]
+                             - 2*cx.xi[(r+1)*n_s+j]
+                             + cx.xi[(r+2)*n_s+j] );
+                delta[r*n_s+j]     += a;
+                delta[(r+1)*n_s+j] -= 2*a;
+                delta[(r+2)*n_s+j] += a;
+            }
+        }
+        for( size_t i = 1; i + 1 < T; i ++ ) {
+            for( size_t j = 0; j < n_s; j ++ ) {
+                delta[i*n_s+j] += w_ratio * cx.grad[i*n_s+j];
+            }
+        }
+
+        /* Precondition */
+        for( size_t j = 0; j < n_s; j ++ ) {
+            tjo_band_solve( m, l0, l1, l2, delta + n_s + j, n_s );
+        }
+
+        double d_max = 0;
+        for( size_t i = n_s; i < (T-1)*n_s; i ++ ) {
+            d_max = AA_MAX( d_max, fabs(delta[i]) );
+        }
+        if( d_max * opts->max_step < 1e-12 ) break;
+        if( alpha * d_max > opts->max_step ) alpha = opts->max_step / d_max;
+
+        /* Backtracking line search */
+        AA_MEM_CPY( xi0, cx.xi, T*n_s );
+        int accepted = 0;
+        for( ; alpha * d_max >= 1e-6; alpha /= 2 ) {
+            for( size_t i = 1; i + 1 < T; i ++ ) {
+                for( size_t j = 0; j < n_s; j ++ ) {
+                    cx.xi[i*n_s+j] = aa_fclamp( xi0[i*n_s+j] - alpha*delta[i*n_s+j],
+                                                lo[j], hi[j] );
+                }
+            }
+            tjo_eval( &pool, n_started );
+            double cost1 = tjo_total_cost( &cx, w_ratio );
+            if( cost1 < cost ) {
+                cost = cost1;
+                accepted = 1;
+                break;
+            }
+        }
+        if( !accepted ) {
+            AA_MEM_CPY( cx.xi, xi0, T*n_s );
+            break;
+        }
+        alpha = AA_MIN( 2*alpha, opts->step );
+    }
+
+    /* Final clearance */
+    tjo_eval( &pool, n_started );
+    double dist = INFINITY;
+    for( size_t i = 1; i + 1 < T; i ++ ) {
+        dist = AA_MIN( dist, cx.dist[i] );
+    }
+
+    pthread_mutex_lock( &pool.mutex );
+    pool.quit = 1;
+    pthread_cond_broadcast( &pool.cond_start );
+    pthread_mutex_unlock( &pool.mutex );
+    for( size_t k = 0; k < n_started; k ++ ) {
+        pthread_join( threads[k], NULL );
+    }
+    pthread_cond_destroy( &pool.cond_done );
+    pthread_cond_destroy( &pool.cond_start );
+    pthread_mutex_destroy( &pool.mutex );
+
+    /* Output.  Region may be the local region, so release the
+     * workspace before allocating from it. */
+    double *xi = AA_MEM_DUP( double, cx.xi, T*n_s );
+    aa_mem_region_pop( reg, reg_ptr );
+
+    double *path_out = AA_MEM_REGION_NEW_N( region, double, T*n_q_all );
+    for( size_t i = 0; i < T; i ++ ) {
+        AA_MEM_CPY( path_out + i*n_q_all, path, n_q_all );
+        aa_rx_sg_sub_config_set( ssg, n_s, xi + i*n_s,
+                                 n_q_all, path_out + i*n_q_all );
+    }
+    free( xi );
+
+    if( NULL == limits ) limits = aa_rx_ct_limits( region, sg );
+    struct aa_ct_pt_list *pt_list = aa_rx_ct_pt_list( region, n_q_all, T, path_out );
+    *segs = aa_ct_tjq_pb_generate( region, pt_list, limits );
+
+    return (dist < 0) ? AA_RX_NO_SOLUTION : AA_RX_OK;
+}
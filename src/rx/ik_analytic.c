@@ -0,0 +1,429 @@
+/* -*- mode: C; c-basic-offset: 4; -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2016, Rice University
+ * All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of copyright holder the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <ctype.h>
+
+#include "amino.h"
+#include "amino/rx/rxtype.h"
+#include "amino/rx/rxerr.h"
+#include "amino/rx/scenegraph.h"
+#include "amino/rx/scene_kin.h"
+#include "amino/rx/scene_sub.h"
+#include "amino/rx/scene_kin_internal.h"
+
+/* Length and angle tolerance for structure detection */
+static const double ika_tol = 1e-6;
+
+static void ika_normalize( double v[3] )
+{
+    double n = sqrt( AA_TF_VDOT(v,v) );
+    for( size_t i = 0; i < 3; i ++ ) v[i] /= n;
+}
+
+/* Point on line (p2,u2) closest to line (p1,u1), for unit, non-parallel u1, u2 */
+static void ika_common_normal( const double p1[3], const double u1[3],
+                               const double p2[3], const double u2[3],
+                               double o[3] )
+{
+    double w[3];
+    for( size_t i = 0; i < 3; i ++ ) w[i] = p1[i] - p2[i];
+    double b = AA_TF_VDOT(u1,u2);
+    double d = AA_TF_VDOT(u1,w);
+    double e = AA_TF_VDOT(u2,w);
+    double t = (e - b*d) / (1 - b*b);
+    for( size_t i = 0; i < 3; i ++ ) o[i] = p2[i] + t*u2[i];
+}
+
+/* Frame from x, z axes and origin */
+static void ika_frame( const double x[3], const double z[3], const double o[3],
+                       double E[7] )
+{
+    double T[12];
+    AA_MEM_CPY( T, x, 3 );
+    aa_tf_cross( z, x, T+3 );
+    AA_MEM_CPY( T+6, z, 3 );
+    AA_MEM_CPY( T+9, o, 3 );
+    aa_tf_tfmat2qutr( T, E );
+}
+
+/* Full configuration with the chain at qs */
+static void ika_config( const struct aa_rx_ik_analytic_cx *cx, const double *qs,
+                        size_t n_all, double *q_all )
+{
+    const struct aa_rx_ksol_opts *opts = cx->opts;
+    if( opts && opts->q_all_seed && opts->n_all_seed == n_all ) {
+        AA_MEM_CPY( q_all, opts->q_all_seed, n_all );
+    } else {
+        AA_MEM_ZERO( q_all, n_all );
+    }
+    aa_rx_sg_sub_config_set( cx->ssg, 6, qs, n_all, q_all );
+}
+
+/* Compare DH and scenegraph kinematics at qs */
+static double ika_fk_err( const struct aa_rx_ik_analytic_cx *cx, const double *qs )
+{
+    const struct aa_rx_sg *sg = aa_rx_sg_sub_sg(cx->ssg);
+    const struct aa_rx_ik_analytic_param *P = &cx->param;
+    size_t n_all = aa_rx_sg_config_count(sg);
+    size_t n_f = aa_rx_sg_frame_count(sg);
+    double q_all[n_all], TF_rel[7*n_f], TF_abs[7*n_f];
+    ika_config( cx, qs, n_all, q_all );
+    aa_rx_sg_tf( sg, n_all, q_all, n_f, TF_rel, 7, TF_abs, 7 );
+
+    double theta[6], T[12], E_dh[7], E_b[7], E[7];
+    for( size_t i = 0; i < 6; i ++ ) {
+        theta[i] = P->sign[i]*qs[i] + P->offset[i];
+    }
+    aa_rx_ik_analytic_fk( P, 6, theta, T );
+    aa_tf_tfmat2qutr( T, E_dh );
+    aa_tf_qutr_mul( P->base, E_dh, E_b );
+    aa_tf_qutr_mul( E_b, P->tool, E );
+
+    const double *E_ee = TF_abs + 7*cx->frame_ee;
+    double E_rel[7];
+    aa_tf_qutr_cmul( E, E_ee, E_rel );
+    aa_tf_qminimize( E_rel + AA_TF_QUTR_Q );
+    return AA_MAX( aa_la_norm(3, E_rel + AA_TF_QUTR_Q),
+                   aa_la_norm(3, E_rel + AA_TF_QUTR_T) );
+}
+
+/*
+ * Extract DH parameters from the joint axes at the zero configuration.
+ *
+ * DH frame j-1 has z along the axis of joint j.  For non-parallel
+ * axes, x is along the common normal; for parallel axes, the origin
+ * is the foot of the perpendicular from the previous origin.
+ */
+static int ika_extract( struct aa_rx_ik_analytic_cx *cx )
+{
+    const struct aa_rx_sg_sub *ssg = cx->ssg;
+    const struct aa_rx_sg *sg = aa_rx_sg_sub_sg(ssg);
+    struct aa_rx_ik_analytic_param *P = &cx->param;
+
+    if( 6 != aa_rx_sg_sub_config_count(ssg) ) return -1;
+
+    size_t n_all = aa_rx_sg_config_count(sg);
+    size_t n_f = aa_rx_sg_frame_count(sg);
+    double q_all[n_all], TF_rel[7*n_f], TF_abs[7*n_f];
+    double qs0[6] = {0};
+    ika_config( cx, qs0, n_all, q_all );
+    aa_rx_sg_tf( sg, n_all, q_all, n_f, TF_rel, 7, TF_abs, 7 );
+
+    /* Joint axes */
+    double p[6][3], u[6][3];
+    for( size_t i = 0, j = 0; i < aa_rx_sg_sub_frame_count(ssg); i ++ ) {
+        aa_rx_frame_id f = aa_rx_sg_sub_frame(ssg, i);
+        enum aa_rx_frame_type type = aa_rx_sg_frame_type(sg, f);
+        if( AA_RX_FRAME_FIXED == type ) continue;
+        if( AA_RX_FRAME_REVOLUTE != type ) return -1;
+        const double *E = TF_abs + 7*f;
+        AA_MEM_CPY( p[j], E + AA_TF_QUTR_T, 3 );
+        aa_tf_qrot( E + AA_TF_QUTR_Q, aa_rx_sg_frame_axis(sg, f), u[j] );
+        ika_normalize( u[j] );
+        j++;
+    }
+
+    /* DH frames */
+    double x[7][3], z[7][3], o[7][3];
+    AA_MEM_CPY( z[0], u[0], 3 );
+    P->sign[0] = 1;
+    for( size_t j = 1; j < 6; j ++ ) {
+        const double *o_prev = (1 == j) ? p[0] : o[j-1];
+        double c[3];
+        aa_tf_cross( z[j-1], u[j], c );
+        if( sqrt(AA_TF_VDOT(c,c)) < ika_tol ) {
+            if( 1 == j ) return -1;
+            P->sign[j] = aa_rx_ik_analytic_sign( AA_TF_VDOT(u[j], z[j-1]) );
+            for( size_t i = 0; i < 3; i ++ ) z[j][i] = P->sign[j]*u[j][i];
+            double s = 0;
+            for( size_t i = 0; i < 3; i ++ ) s += (o_prev[i] - p[j][i]) * z[j][i];
+            for( size_t i = 0; i < 3; i ++ ) {
+                o[j][i] = p[j][i] + s*z[j][i];
+                x[j][i] = o[j][i] - o_prev[i];
+            }
+            if( sqrt(AA_TF_VDOT(x[j],x[j])) < ika_tol ) {
+                AA_MEM_CPY( x[j], x[j-1], 3 );
+            } else {
+                ika_normalize( x[j] );
+            }
+        } else {
+            P->sign[j] = 1;
+            AA_MEM_CPY( z[j], u[j], 3 );
+            AA_MEM_CPY( x[j], c, 3 );
+            ika_normalize( x[j] );
+            ika_common_normal( o_prev, z[j-1], p[j], z[j], o[j] );
+        }
+    }
+
+    /* Base frame on the first axis, level with frame 1 */
+    {
+        double s = 0;
+        for( size_t i = 0; i < 3; i ++ ) s += (o[1][i] - p[0][i]) * z[0][i];
+        for( size_t i = 0; i < 3; i ++ ) o[0][i] = p[0][i] + s*z[0][i];
+        AA_MEM_CPY( x[0], x[1], 3 );
+    }
+
+    /* Last frame coincides with frame 5 at zero */
+    AA_MEM_CPY( x[6], x[5], 3 );
+    AA_MEM_CPY( z[6], z[5], 3 );
+    AA_MEM_CPY( o[6], o[5], 3 );
+
+    for( size_t j = 1; j <= 6; j ++ ) {
+        double v[3], c[3];
+        for( size_t i = 0; i < 3; i ++ ) v[i] = o[j][i] - o[j-1][i];
+        P->d[j-1] = AA_TF_VDOT( v, z[j-1] );
+        P->a[j-1] = AA_TF_VDOT( v, x[j] );
+        aa_tf_cross( z[j-1], z[j], c );
+        P->alpha[j-1] = atan2( AA_TF_VDOT(c, x[j]), AA_TF_VDOT(z[j-1], z[j]) );
+        aa_tf_cross( x[j-1], x[j], c );
+        P->offset[j-1] = atan2( AA_TF_VDOT(c, z[j-1]), AA_TF_VDOT(x[j-1], x[j]) );
+    }
+
+    ika_frame( x[0], z[0], o[0], P->base );
+    {
+        double F6[7];
+        ika_frame( x[6], z[6], o[6], F6 );
+        aa_tf_qutr_cmul( F6, TF_abs + 7*cx->frame_ee, P->tool );
+    }
+
+    /* Classify */
+    const double h = M_PI_2;
+#define IKA_ZERO(x) (fabs(x) < ika_tol)
+    int shoulder = IKA_ZERO(fabs(P->alpha[0]) - h) && IKA_ZERO(P->alpha[1]) &&
+        !IKA_ZERO(P->a[1]);
+    int wrist = IKA_ZERO(P->a[3]) && IKA_ZERO(P->a[4]) &&
+        IKA_ZERO(fabs(P->alpha[3]) - h) && IKA_ZERO(fabs(P->alpha[4]) - h);
+    if( shoulder && wrist && IKA_ZERO(P->d[4]) &&
+        !IKA_ZERO(hypot(P->a[2], P->d[3]*sin(P->alpha[2]))) )
+    {
+        P->kind = AA_RX_IK_ANALYTIC_WRIST;
+    } else if( shoulder && wrist && IKA_ZERO(P->alpha[2]) && !IKA_ZERO(P->a[2]) ) {
+        P->kind = AA_RX_IK_ANALYTIC_PARALLEL;
+    } else {
+        P->kind = AA_RX_IK_ANALYTIC_NONE;
+        return -1;
+    }
+#undef IKA_ZERO
+
+    /* Check against the scenegraph */
+    for( size_t k = 0; k < 4; k ++ ) {
+        double qs[6];
+        for( size_t i = 0; i < 6; i ++ ) qs[i] = (k) ? sin( (double)(7*k + 3*i) ) * M_PI : 0;
+        if( ika_fk_err(cx, qs) > ika_tol ) {
+            P->kind = AA_RX_IK_ANALYTIC_NONE;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+AA_API struct aa_rx_ik_analytic_cx *
+aa_rx_ik_analytic_cx_create( const struct aa_rx_sg_sub *ssg, const struct aa_rx_ksol_opts *opts )
+{
+    struct aa_rx_ik_analytic_cx *cx = AA_NEW0( struct aa_rx_ik_analytic_cx );
+    cx->ssg = ssg;
+    cx->opts = opts;
+    cx->frame_ee = ( opts && AA_RX_FRAME_NONE != opts->frame )
+        ? opts->frame
+        : aa_rx_sg_sub_frame_ee(ssg);
+
+    if( AA_RX_FRAME_NONE == cx->frame_ee || ika_extract(cx) ) {
+        free(cx);
+        return NULL;
+    }
+
+    return cx;
+}
+
+AA_API void
+aa_rx_ik_analytic_cx_destroy( struct aa_rx_ik_analytic_cx *cx )
+{
+    if( NULL == cx ) return;
+    if( cx->destructor ) {
+        cx->destructor( cx->destructor_context );
+    }
+    free(cx);
+}
+
+/* Move each joint by multiples of 2*pi into its limits, nearest q_ref */
+static int ika_fit( const struct aa_rx_ik_analytic_cx *cx,
+                    const double *q_ref, double *q )
+{
+    const struct aa_rx_sg *sg = aa_rx_sg_sub_sg(cx->ssg);
+    for( size_t i = 0; i < 6; i ++ ) {
+        double min, max;
+        int limited = !aa_rx_sg_get_limit_pos( sg, aa_rx_sg_sub_config(cx->ssg, i),
+                                               &min, &max );
+        double best = 0, best_dist = DBL_MAX;
+        for( int k = -2; k <= 2; k ++ ) {
+            double v = q[i] + 2*M_PI*k;
+            if( limited && (v < min || v > max) ) continue;
+            double dist = q_ref ? fabs(v - q_ref[i]) : fabs((double)k);
+            if( dist < best_dist ) {
+                best = v;
+                best_dist = dist;
+            }
+        }
+        if( DBL_MAX == best_dist ) return -1;
+        q[i] = best;
+    }
+    return 0;
+}
+
+static size_t ika_solve( const struct aa_rx_ik_analytic_cx *cx,
+                         size_t n_tf, const double *TF, size_t n_q,
+                         const double *q_ref,
+                         size_t n_sol, double *Q, size_t ldQ )
+{
+    if( 1 != n_tf || 6 != n_q ) return 0;
+
+    double Q_all[6*AA_RX_IK_ANALYTIC_MAX_SOL];
+    size_t n_all = cx->dl_kernel
+        ? cx->dl_kernel( TF, Q_all, 6 )
+        : aa_rx_ik_analytic_kernel( &cx->param, TF, Q_all, 6 );
+
+    size_t n = 0;
+    for( size_t k = 0; k < n_all && n < n_sol; k ++ ) {
+        double *q = Q + n*ldQ;
+        AA_MEM_CPY( q, Q_all + 6*k, 6 );
+        if( 0 == ika_fit(cx, q_ref, q) ) n++;
+    }
+    return n;
+}
+
+AA_API size_t
+aa_rx_ik_analytic_solve_all( const struct aa_rx_ik_analytic_cx *cx,
+                             size_t n_tf, const double *TF, size_t ld_TF,
+                             size_t n_q, size_t n_sol, double *Q, size_t ldQ )
+{
+    (void)ld_TF;
+    return ika_solve( cx, n_tf, TF, n_q, NULL, n_sol, Q, ldQ );
+}
+
+AA_API int
+aa_rx_ik_analytic_solve( const struct aa_rx_ik_analytic_cx *cx,
+                         size_t n_tf, const double *TF, size_t ld_TF,
+                         size_t n_q, double *q )
+{
+    (void)ld_TF;
+    const struct aa_rx_ksol_opts *opts = cx->opts;
+    double q_ref[6];
+    AA_MEM_CPY( q_ref,
+                (opts && opts->q_ref && 6 == opts->n_q_ref) ? opts->q_ref : q,
+                6 );
+
+    double Q[6*AA_RX_IK_ANALYTIC_MAX_SOL];
+    size_t n = ika_solve( cx, n_tf, TF, n_q, q_ref, AA_RX_IK_ANALYTIC_MAX_SOL, Q, 6 );
+    if( 0 == n ) {
+        return AA_RX_NO_SOLUTION | AA_RX_NO_IK;
+    }
+
+    size_t i_min = 0;
+    double d_min = DBL_MAX;
+    for( size_t k = 0; k < n; k ++ ) {
+        double d = aa_la_ssd( 6, q_ref, Q + 6*k );
+        if( d < d_min ) {
+            d_min = d;
+            i_min = k;
+        }
+    }
+    AA_MEM_CPY( q, Q + 6*i_min, 6 );
+    return 0;
+}
+
+AA_API int
+aa_rx_ik_analytic_fun( void *context,
+                       size_t n_tf, const double *TF, size_t ld_TF,
+                       size_t n_q, double *q )
+{
+    return aa_rx_ik_analytic_solve( (const struct aa_rx_ik_analytic_cx *)context,
+                                    n_tf, TF, ld_TF, n_q, q );
+}
+
+static void ika_gen_vec( FILE *out, const char *field, size_t n, const double *x )
+{
+    fprintf( out, "    .%s = {", field );
+    for( size_t i = 0; i < n; i ++ ) {
+        fprintf( out, "%s%.17g", i ? ", " : "", x[i] );
+    }
+    fprintf( out, "},\n" );
+}
+
+AA_API int
+aa_rx_ik_analytic_gen( const struct aa_rx_ik_analytic_cx *cx,
+                       const char *name, FILE *out )
+{
+    const struct aa_rx_ik_analytic_param *P = &cx->param;
+
+    if( '\0' == name[0] || isdigit((unsigned char)name[0]) ) {
+        return AA_RX_INVALID_PARAMETER;
+    }
+    for( const char *c = name; *c; c ++ ) {
+        if( !isalnum((unsigned char)*c) && '_' != *c ) {
+            return AA_RX_INVALID_PARAMETER;
+        }
+    }
+
+    fprintf( out,
+             "/* Closed-form IK for chain '%s', generated by aa_rx_ik_analytic_gen().\n"
+             " * Poses are relative to the scenegraph root. */\n"
+             "\n"
+             "#include \"amino/rx/ik_analytic_impl.h\"\n"
+             "\n"
+             "static const struct aa_rx_ik_analytic_param param = {\n"
+             "    .kind = %s,\n",
+             name,
+             ( AA_RX_IK_ANALYTIC_WRIST == P->kind )
+             ? "AA_RX_IK_ANALYTIC_WRIST" : "AA_RX_IK_ANALYTIC_PARALLEL" );
+    ika_gen_vec( out, "d", 6, P->d );
+    ika_gen_vec( out, "a", 6, P->a );
+    ika_gen_vec( out, "alpha", 6, P->alpha );
+    ika_gen_vec( out, "offset", 6, P->offset );
+    ika_gen_vec( out, "sign", 6, P->sign );
+    ika_gen_vec( out, "base", 7, P->base );
+    ika_gen_vec( out, "tool", 7, P->tool );
+    fprintf( out,
+             "};\n"
+             "\n"
+             "AA_API size_t\n"
+             "aa_rx_dl_ik__%s( const double E[7], double *Q, size_t ldQ )\n"
+             "{\n"
+             "    return aa_rx_ik_analytic_kernel( &param, E, Q, ldQ );\n"
+             "}\n",
+             name );
+
+    return ferror(out) ? AA_RX_INVALID_PARAMETER : 0;
+}
@@ -0,0 +1,425 @@
+/* -*- mode: C; c-basic-offset: 4; -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2016, Rice University
+ * All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of copyright holder the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <pthread.h>
+
+#include "amino.h"
+#include "amino/rx/rxtype.h"
+#include "amino/rx/rxerr.h"
+#include "amino/rx/scenegraph.h"
+#include "amino/rx/scene_kin.h"
+
+/* Dimension of the pose embedding: translation, weighted quaternion */
+#define IKC_DIM 7
+
+/* Entries closer than this share a slot */
+static const double ikc_merge_dist = 1e-6;
+
+static const char ikc_magic[8] = {'a','a','r','x','i','k','c','1'};
+
+struct aa_rx_ik_cache {
+    size_t n_q;
+    size_t max_entries;
+    double rot_weight;
+
+    size_t count;        ///< number of entries
+    size_t next;         ///< next slot to overwrite when full
+    double *E;           ///< poses, 7 x max_entries
+    double *X;           ///< embedded poses, IKC_DIM x max_entries
+    double *Q;           ///< configurations, n_q x max_entries
+
+    unsigned *gen;       ///< generation of each slot, incremented on overwrite
+
+    /* Implicit k-d tree over idx[0,n_tree).  Nodes keep a copy of
+     * their point, so overwritten slots only invalidate the node. */
+    size_t *idx;
+    unsigned char *dim;  ///< split dimension at each tree node
+    double *T_X;         ///< tree points
+    size_t *T_slot;      ///< slot of each tree point
+    unsigned *T_gen;     ///< slot generation when the tree was built
+    size_t n_tree;
+    int dirty;           ///< tree points are stale
+
+    /* Slots written since the last build, searched linearly */
+    size_t *pending;
+    size_t n_pending;
+
+    pthread_mutex_t mutex;
+};
+
+static void ikc_embed( double w, int flip, const double E[7], double x[IKC_DIM] )
+{
+    const double *q = E + AA_TF_QUTR_Q;
+    double s = (q[3] < 0) ? -w : w;
+    if( flip ) s = -s;
+    x[0] = E[AA_TF_QUTR_T+0];
+    x[1] = E[AA_TF_QUTR_T+1];
+    x[2] = E[AA_TF_QUTR_T+2];
+    for( size_t i = 0; i < 4; i ++ ) x[3+i] = s*q[i];
+}
+
+static double ikc_dist2( const double *a, const double *b )
+{
+    double d = 0;
+    for( size_t i = 0; i < IKC_DIM; i ++ ) {
+        double t = a[i] - b[i];
+        d += t*t;
+    }
+    return d;
+}
+
+AA_API struct aa_rx_ik_cache *
+aa_rx_ik_cache_create( size_t n_q, size_t max_entries )
+{
+    struct aa_rx_ik_cache *c = AA_NEW0( struct aa_rx_ik_cache );
+    c->n_q = n_q;
+    c->max_entries = max_entries ? max_entries : 1;
+    c->rot_weight = 1;
+    c->E = AA_NEW_AR( double, 7*c->max_entries );
+    c->X = AA_NEW_AR( double, IKC_DIM*c->max_entries );
+    c->Q = AA_NEW_AR( double, n_q*c->max_entries );
+    c->gen = AA_NEW0_AR( unsigned, c->max_entries );
+    c->idx = AA_NEW_AR( size_t, c->max_entries );
+    c->dim = AA_NEW_AR( unsigned char, c->max_entries );
+    c->T_X = AA_NEW_AR( double, IKC_DIM*c->max_entries );
+    c->T_slot = AA_NEW_AR( size_t, c->max_entries );
+    c->T_gen = AA_NEW_AR( unsigned, c->max_entries );
+    c->pending = AA_NEW_AR( size_t, c->max_entries );
+    pthread_mutex_init( &c->mutex, NULL );
+    return c;
+}
+
+AA_API void
+aa_rx_ik_cache_destroy( struct aa_rx_ik_cache *c )
+{
+    if( NULL == c ) return;
+    pthread_mutex_destroy( &c->mutex );
+    free( c->E );
+    free( c->X );
+    free( c->Q );
+    free( c->gen );
+    free( c->idx );
+    free( c->dim );
+    free( c->T_X );
+    free( c->T_slot );
+    free( c->T_gen );
+    free( c->pending );
+    free( c );
+}
+
+AA_API size_t
+aa_rx_ik_cache_count( struct aa_rx_ik_cache *c )
+{
+    pthread_mutex_lock( &c->mutex );
+    size_t n = c->count;
+    pthread_mutex_unlock( &c->mutex );
+    return n;
+}
+
+AA_API void
+aa_rx_ik_cache_set_rot_weight( struct aa_rx_ik_cache *c, double w )
+{
+    pthread_mutex_lock( &c->mutex );
+    c->rot_weight = w;
+    for( size_t i = 0; i < c->count; i ++ ) {
+        ikc_embed( w, 0, c->E + 7*i, c->X + IKC_DIM*i );
+    }
+    c->dirty = 1;
+    pthread_mutex_unlock( &c->mutex );
+}
+
+/*-- k-d tree --*/
+
+/* Partition idx[lo,hi) so that idx[k] holds the k-th smallest along d */
+static void ikc_select( const double *X, size_t *idx, size_t lo, size_t hi,
+                        size_t k, unsigned d )
+{
+    while( hi - lo > 1 ) {
+        double pivot = X[IKC_DIM*idx[lo + (hi-lo-1)/2] + d];
+        size_t i = lo, j = hi - 1;
+        for(;;) {
+            while( X[IKC_DIM*idx[i] + d] < pivot ) i++;
+            while( X[IKC_DIM*idx[j] + d] > pivot ) j--;
+            if( i >= j ) break;
+            size_t t = idx[i]; idx[i] = idx[j]; idx[j] = t;
+            i++; j--;
+        }
+        if( k <= j ) hi = j + 1;
+        else lo = j + 1;
+    }
+}
+
+static void ikc_build( struct aa_rx_ik_cache *c, size_t lo, size_t hi )
+{
+    if( hi <= lo ) return;
+    size_t mid = lo + (hi - lo)/2;
+
+    /* Split along the dimension of greatest spread */
+    double min[IKC_DIM], max[IKC_DIM];
+    for( size_t i = 0; i < IKC_DIM; i ++ ) {
+        min[i] = DBL_MAX;
+        max[i] = -DBL_MAX;
+    }
+    for( size_t j = lo; j < hi; j ++ ) {
+        const double *x = c->T_X + IKC_DIM*c->idx[j];
+        for( size_t i = 0; i < IKC_DIM; i ++ ) {
+            min[i] = AA_MIN( min[i], x[i] );
+            max[i] = AA_MAX( max[i], x[i] );
+        }
+    }
+    unsigned d = 0;
+    for( unsigned i = 1; i < IKC_DIM; i ++ ) {
+        if( max[i] - min[i] > max[d] - min[d] ) d = i;
+    }
+
+    ikc_select( c->T_X, c->idx, lo, hi, mid, d );
+    c->dim[mid] = (unsigned char)d;
+    ikc_build( c, lo, mid );
+    ikc_build( c, mid+1, hi );
+}
+
+static void ikc_rebuild( struct aa_rx_ik_cache *c )
+{
+    for( size_t i = 0; i < c->count; i ++ ) {
+        AA_MEM_CPY( c->T_X + IKC_DIM*i, c->X + IKC_DIM*i, IKC_DIM );
+        c->T_slot[i] = i;
+        c->T_gen[i] = c->gen[i];
+        c->idx[i] = i;
+    }
+    ikc_build( c, 0, c->count );
+    c->n_tree = c->count;
+    c->n_pending = 0;
+    c->dirty = 0;
+}
+
+/* k nearest, sorted by increasing distance */
+struct ikc_knn {
+    size_t k;
+    size_t n;
+    size_t *i;
+    double *d2;
+};
+
+static void ikc_knn_add( struct ikc_knn *r, size_t i, double d2 )
+{
+    for( size_t j = 0; j < r->n; j ++ ) {
+        if( r->i[j] == i ) return;
+    }
+    if( r->n == r->k && d2 >= r->d2[r->n-1] ) return;
+    size_t j = (r->n < r->k) ? r->n++ : r->n - 1;
+    for( ; j > 0 && r->d2[j-1] > d2; j -- ) {
+        r->i[j] = r->i[j-1];
+        r->d2[j] = r->d2[j-1];
+    }
+    r->i[j] = i;
+    r->d2[j] = d2;
+}
+
+static double ikc_knn_bound( const struct ikc_knn *r )
+{
+    return (r->n < r->k) ? DBL_MAX : r->d2[r->n-1];
+}
+
+static void ikc_search( const struct aa_rx_ik_cache *c, size_t lo, size_t hi,
+                        const double *x, struct ikc_knn *r )
+{
+    if( hi <= lo ) return;
+    size_t mid = lo + (hi - lo)/2;
+    size_t e = c->idx[mid];
+    const double *x_e = c->T_X + IKC_DIM*e;
+    if( c->T_gen[e] == c->gen[c->T_slot[e]] ) {
+        ikc_knn_add( r, c->T_slot[e], ikc_dist2(x, x_e) );
+    }
+
+    unsigned d = c->dim[mid];
+    double diff = x[d] - x_e[d];
+    if( diff < 0 ) {
+        ikc_search( c, lo, mid, x, r );
+        if( diff*diff < ikc_knn_bound(r) ) ikc_search( c, mid+1, hi, x, r );
+    } else {
+        ikc_search( c, mid+1, hi, x, r );
+        if( diff*diff < ikc_knn_bound(r) ) ikc_search( c, lo, mid, x, r );
+    }
+}
+
+/* Both quaternion signs; caller holds the mutex */
+static void ikc_knn( struct aa_rx_ik_cache *c, const double E[7], struct ikc_knn *r )
+{
+    /* Amortize rebuilds against the linear search of new entries */
+    if( c->dirty || c->n_pending > 16 + c->n_tree/4 ) {
+        ikc_rebuild( c );
+    }
+    for( int flip = 0; flip < 2; flip ++ ) {
+        double x[IKC_DIM];
+        ikc_embed( c->rot_weight, flip, E, x );
+        ikc_search( c, 0, c->n_tree, x, r );
+        for( size_t j = 0; j < c->n_pending; j ++ ) {
+            size_t i = c->pending[j];
+            ikc_knn_add( r, i, ikc_dist2(x, c->X + IKC_DIM*i) );
+        }
+    }
+}
+
+AA_API void
+aa_rx_ik_cache_add( struct aa_rx_ik_cache *c, const double E[7],
+                    size_t n_q, const double *q )
+{
+    if( n_q != c->n_q ) return;
+
+    pthread_mutex_lock( &c->mutex );
+
+    size_t i_near;
+    double d2_near;
+    struct ikc_knn r = {1, 0, &i_near, &d2_near};
+    ikc_knn( c, E, &r );
+
+    size_t i;
+    if( r.n && d2_near < ikc_merge_dist*ikc_merge_dist ) {
+        /* Same pose, keep the latest configuration */
+        i = i_near;
+    } else {
+        if( c->count < c->max_entries ) {
+            i = c->count++;
+        } else {
+            /* Full, overwrite the oldest */
+            i = c->next;
+            c->next = (c->next + 1) % c->max_entries;
+            c->gen[i]++;
+        }
+        if( c->n_pending < c->max_entries ) c->pending[c->n_pending++] = i;
+        else c->dirty = 1;
+        AA_MEM_CPY( c->E + 7*i, E, 7 );
+        ikc_embed( c->rot_weight, 0, E, c->X + IKC_DIM*i );
+    }
+    AA_MEM_CPY( c->Q + c->n_q*i, q, c->n_q );
+
+    pthread_mutex_unlock( &c->mutex );
+}
+
+AA_API size_t
+aa_rx_ik_cache_nearest( struct aa_rx_ik_cache *c, const double E[7],
+                        size_t k, size_t n_q, double *Q, size_t ldQ )
+{
+    if( n_q != c->n_q || 0 == k ) return 0;
+
+    pthread_mutex_lock( &c->mutex );
+
+    size_t i[k];
+    double d2[k];
+    struct ikc_knn r = {k, 0, i, d2};
+    ikc_knn( c, E, &r );
+    for( size_t j = 0; j < r.n; j ++ ) {
+        AA_MEM_CPY( Q + j*ldQ, c->Q + c->n_q*i[j], c->n_q );
+    }
+
+    pthread_mutex_unlock( &c->mutex );
+    return r.n;
+}
+
+/*-- Persistence --*/
+
+AA_API int
+aa_rx_ik_cache_write( struct aa_rx_ik_cache *c, FILE *out )
+{
+    pthread_mutex_lock( &c->mutex );
+    uint64_t hdr[2] = { c->n_q, c->count };
+    int ok =
+        1 == fwrite( ikc_magic, sizeof(ikc_magic), 1, out ) &&
+        1 == fwrite( hdr, sizeof(hdr), 1, out ) &&
+        1 == fwrite( &c->rot_weight, sizeof(double), 1, out ) &&
+        c->count == fwrite( c->E, 7*sizeof(double), c->count, out ) &&
+        c->count == fwrite( c->Q, c->n_q*sizeof(double), c->count, out );
+    pthread_mutex_unlock( &c->mutex );
+    return ok ? 0 : AA_RX_INVALID_PARAMETER;
+}
+
+/* Bytes left in a seekable stream, or -1 */
+static long
+ikc_remaining( FILE *in )
+{
+    long pos = ftell(in);
+    if( pos < 0 || 0 != fseek(in, 0, SEEK_END) ) return -1;
+    long end = ftell(in);
+    if( end < pos || 0 != fseek(in, pos, SEEK_SET) ) return -1;
+    return end - pos;
+}
+
+AA_API struct aa_rx_ik_cache *
+aa_rx_ik_cache_read( FILE *in, size_t n_q, size_t max_entries )
+{
+    char magic[sizeof(ikc_magic)];
+    uint64_t hdr[2];
+    double w;
+    if( 0 == n_q || 0 == max_entries ||
+        1 != fread( magic, sizeof(magic), 1, in ) ||
+        0 != memcmp( magic, ikc_magic, sizeof(magic) ) ||
+        1 != fread( hdr, sizeof(hdr), 1, in ) ||
+        1 != fread( &w, sizeof(w), 1, in ) ||
+        !isfinite(w) || w < 0 )
+    {
+        return NULL;
+    }
+
+    /* The header must match the caller and the data must fit in the
+     * rest of the file before anything is allocated. */
+    if( hdr[0] != n_q ) return NULL;
+    size_t entry_size = (7 + n_q) * sizeof(double);
+    long remaining = ikc_remaining(in);
+    if( remaining < 0 ||
+        hdr[1] > (uint64_t)remaining / entry_size )
+    {
+        return NULL;
+    }
+    size_t count = (size_t)hdr[1];
+
+    /* Keep the first max_entries solutions */
+    size_t n = AA_MIN(count, max_entries);
+    struct aa_rx_ik_cache *c = aa_rx_ik_cache_create( n_q, max_entries );
+    c->rot_weight = w;
+    if( n != fread( c->E, 7*sizeof(double), n, in ) ||
+        0 != fseek( in, (long)((count - n) * 7*sizeof(double)), SEEK_CUR ) ||
+        n != fread( c->Q, n_q*sizeof(double), n, in ) ||
+        0 != fseek( in, (long)((count - n) * n_q*sizeof(double)), SEEK_CUR ) )
+    {
+        aa_rx_ik_cache_destroy( c );
+        return NULL;
+    }
+    c->count = n;
+    for( size_t i = 0; i < n; i ++ ) {
+        ikc_embed( w, 0, c->E + 7*i, c->X + IKC_DIM*i );
+    }
+    c->dirty = 1;
+    return c;
+}
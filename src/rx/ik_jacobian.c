@@ -45,6 +45,10 @@
  *
  */
 
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
 #include "amino.h"
 #include "amino/rx/rxtype.h"
 #include "amino/rx/rxerr.h"
@@ -52,6 +56,7 @@
 #include "amino/rx/scene_kin.h"
 #include "amino/rx/scene_sub.h"
 #include "amino/rx/scene_kin_internal.h"
+#include "amino/opt/qp.h"
 
 typedef int (*rfx_kin_duqu_fun) ( const void *cx, const double *q, double S[8],  double *J);
 
@@ -60,70 +65,167 @@ struct kin_solve_cx {
     size_t n;
     const struct aa_rx_ksol_opts *opts;
     const struct aa_rx_sg_sub *ssg;
-    const double *E1;
+    const double *E1;           ///< target poses
+    size_t ld_E1;               ///< leading dimension of E1
     //const double *dq_dt;
 
     size_t iteration;
 
     struct aa_mem_region *reg;
+    atomic_int *cancel;         ///< abort the solve when set, may be NULL
 
-    const double *q0_all;
     size_t n_all;
-    double *TF_rel0;
-    double *TF_abs0;
+    size_t n_f;
+
+    /* Workspace, persistent over one solve */
+    size_t n_ee;                ///< number of frames to solve for
+    size_t m;                   ///< rows of the stacked Jacobian, 6*n_ee
+    aa_rx_frame_id *frame_ee;   ///< frames to solve for
+    const double *weight;       ///< per-frame weights, or NULL
+    size_t n_fk;                ///< number of frames updated per evaluation
+    aa_rx_frame_id *fk_frames;  ///< frames updated per evaluation
+    double *q_all;              ///< full configuration
+    double *TF_abs;             ///< absolute transforms
 };
 
 
 
+/* Weighted, stacked Jacobian at the current workspace transforms */
+static void ksol_jacobian( const struct kin_solve_cx *cx, double *J )
+{
+    aa_rx_sg_sub_jacobian( cx->ssg, cx->n_f, cx->TF_abs, 7,
+                           J, cx->m );
+    if( cx->weight ) {
+        for( size_t j = 0; j < cx->n; j ++ ) {
+            for( size_t k = 0; k < cx->n_ee; k ++ ) {
+                for( size_t i = 0; i < 6; i ++ ) {
+                    J[j*cx->m + 6*k + i] *= cx->weight[k];
+                }
+            }
+        }
+    }
+}
 
 static int ksol_qutr ( const struct kin_solve_cx *cx, const double *q_s, double *E,  double *J)
 {
     const struct aa_rx_sg_sub *ssg = cx->ssg;
     const struct aa_rx_sg *sg = ssg->scenegraph;
 
-    size_t n_f = aa_rx_sg_frame_count(sg);
-    size_t n_q = aa_rx_sg_config_count(sg);
     size_t n_sq = aa_rx_sg_sub_config_count(ssg);
 
-    /* Get the configuration */
-    double q_all[n_q];
-    AA_MEM_CPY(q_all, cx->q0_all, n_q);
+    /* Set the configuration */
     aa_rx_sg_sub_config_set( ssg,
                              n_sq, q_s,
-                             n_q, q_all);
-
-    /* Compute the transforms */
-    double *TF_rel = AA_MEM_REGION_NEW_N(cx->reg, double, 7*n_f);
-    double *TF_abs = AA_MEM_REGION_NEW_N(cx->reg, double, 7*n_f);
+                             cx->n_all, cx->q_all );
 
-    aa_rx_sg_tf_update( sg,
-                        n_q, cx->q0_all, q_all,
-                        n_f,
-                        cx->TF_rel0, 7, cx->TF_abs0, 7,
-                        TF_rel, 7, TF_abs, 7 );
+    /* Compute the transforms, only for frames that may move */
+    aa_rx_sg_tf_frames( sg, cx->n_all, cx->q_all,
+                        cx->n_fk, cx->fk_frames,
+                        cx->n_f, cx->TF_abs, 7 );
 
-    /* Fill the desired transform */
+    /* Fill the desired transforms */
     if( E ) {
-        aa_rx_frame_id id_ee = ( AA_RX_FRAME_NONE == cx->opts->frame )
-            /* default to last frame in chain */
-            ? aa_rx_sg_sub_frame_ee(ssg)
-            /* use specified frame */
-            : cx->opts->frame;
-
-        double *E_ee = TF_abs + 7*id_ee;
-        AA_MEM_CPY(E, E_ee, 7);
+        for( size_t k = 0; k < cx->n_ee; k ++ ) {
+            AA_MEM_CPY(E + 7*k, cx->TF_abs + 7*cx->frame_ee[k], 7);
+        }
     }
 
     /* Fill the Jacobian */
     if( J ) {
-        aa_rx_sg_sub_jacobian( ssg, n_f, TF_abs, 7,
-                               J, 6 );
+        ksol_jacobian( cx, J );
     }
 
-    aa_mem_region_pop(cx->reg, TF_rel);
     return 0;
 }
 
+/* Whether to solve for opts->frame instead of the sub-scenegraph
+ * end-effectors.  Only possible with a single end-effector. */
+static int
+kin_solve_frame_override( const struct aa_rx_ksol_opts *opts,
+                          const struct aa_rx_sg_sub *ssg )
+{
+    return AA_RX_FRAME_NONE != opts->frame &&
+        aa_rx_sg_sub_ee_count(ssg) <= 1;
+}
+
+static int
+sub_has_frame( const struct aa_rx_sg_sub *ssg, aa_rx_frame_id frame )
+{
+    size_t n = aa_rx_sg_sub_frame_count(ssg);
+    for( size_t i = 0; i < n; i ++ ) {
+        if( frame == aa_rx_sg_sub_frame(ssg,i) ) return 1;
+    }
+    return 0;
+}
+
+/*
+ * Allocate the solver workspace from cx->reg and compute the
+ * transforms of all frames at the start configuration.  Frames that
+ * do not depend on the sub-scenegraph configuration keep these
+ * transforms for the whole solve.
+ */
+static void
+kin_solve_cx_init( struct kin_solve_cx *cx, const double *q_start_all )
+{
+    const struct aa_rx_sg_sub *ssg = cx->ssg;
+    const struct aa_rx_sg *sg = ssg->scenegraph;
+    size_t n_sf = aa_rx_sg_sub_frame_count(ssg);
+
+    cx->n_f = aa_rx_sg_frame_count(sg);
+    cx->q_all = AA_MEM_REGION_NEW_N(cx->reg, double, cx->n_all);
+    cx->TF_abs = AA_MEM_REGION_NEW_N(cx->reg, double, 7*cx->n_f);
+    cx->fk_frames = AA_MEM_REGION_NEW_N(cx->reg, aa_rx_frame_id, n_sf + cx->n_f);
+    cx->frame_ee = AA_MEM_REGION_NEW_N(cx->reg, aa_rx_frame_id, cx->n_ee);
+
+    AA_MEM_CPY(cx->q_all, q_start_all, cx->n_all);
+    {
+        double *TF_rel = AA_MEM_REGION_NEW_N(cx->reg, double, 7*cx->n_f);
+        aa_rx_sg_tf( sg, cx->n_all, cx->q_all,
+                     cx->n_f,
+                     TF_rel, 7,
+                     cx->TF_abs, 7 );
+        aa_mem_region_pop(cx->reg, TF_rel);
+    }
+
+    if( kin_solve_frame_override(cx->opts, ssg) ) {
+        /* use specified frame */
+        cx->frame_ee[0] = cx->opts->frame;
+    } else {
+        /* default to the end-effectors of the sub-scenegraph */
+        for( size_t k = 0; k < cx->n_ee; k ++ ) {
+            cx->frame_ee[k] = aa_rx_sg_sub_ee(ssg, k);
+        }
+    }
+
+    /* Update the sub-scenegraph frames, then any ancestors of the
+     * solved frames that lie outside the sub-scenegraph. */
+    AA_MEM_CPY(cx->fk_frames, aa_rx_sg_sub_frames(ssg), n_sf);
+    size_t n_ext = 0;
+    for( size_t k = 0; k < cx->n_ee; k ++ ) {
+        for( aa_rx_frame_id f = cx->frame_ee[k];
+             f >= 0 && !sub_has_frame(ssg, f);
+             f = aa_rx_sg_frame_parent(sg, f) )
+        {
+            int dup = 0;
+            for( size_t i = 0; !dup && i < n_ext; i ++ ) {
+                dup = (f == cx->fk_frames[n_sf+i]);
+            }
+            if( dup ) break;
+            cx->fk_frames[n_sf + n_ext++] = f;
+        }
+    }
+    /* Parents precede children */
+    for( size_t i = 1; i < n_ext; i ++ ) {
+        aa_rx_frame_id f = cx->fk_frames[n_sf+i];
+        size_t j = i;
+        for( ; j > 0 && cx->fk_frames[n_sf+j-1] > f; j -- ) {
+            cx->fk_frames[n_sf+j] = cx->fk_frames[n_sf+j-1];
+        }
+        cx->fk_frames[n_sf+j] = f;
+    }
+    cx->n_fk = n_sf + n_ext;
+}
+
 static void rfx_kin_duqu_werr( const double S[8], const double S_ref[8], double werr[6] ) {
     double twist[8], de[8];
     aa_tf_duqu_mulc( S, S_ref, de );  // de = d*conj(d_r)
@@ -157,19 +259,22 @@ static void rfx_kin_qutr_serr( const double E_act[7], const double E_ref[7],
 }
 
 
-AA_API int
-aa_rx_ik_jac_dx2dq ( const struct aa_rx_ksol_opts *opts, size_t n_q,
-                     const double *AA_RESTRICT q_act, const double *AA_RESTRICT dx, const double *J,
-                     double *AA_RESTRICT dq )
+static int
+kin_dx2dq ( const struct aa_rx_ksol_opts *opts, size_t m, size_t n_q,
+            const double *AA_RESTRICT q_act, const double *AA_RESTRICT dx, const double *J,
+            double *AA_RESTRICT dq )
 {
 
-    double J_star[6*n_q];
+    double J_star[m*n_q];
 
     /* if( theta_err < opts->tol_angle_svd && */
     /*     x_err < opts->tol_trans_svd ) */
     /* { */
     // TODO: sometimes do LU
-    aa_la_dzdpinv( 6, n_q, opts->s2min, J, J_star );
+    int fixed = (6 == m && 0 == aa_la_d6zdpinv( n_q, opts->s2min, J, J_star ));
+    if( !fixed ) {
+        aa_la_dzdpinv( m, n_q, opts->s2min, J, J_star );
+    }
     /* } else { */
     /*     aa_la_dpinv( 6, n_q, opts->k_dls, J, J_star ); */
     /* } */
@@ -182,14 +287,26 @@ aa_rx_ik_jac_dx2dq ( const struct aa_rx_ksol_opts *opts, size_t n_q,
             dqnull[i] = - opts->dq_dt[i] * ( q_act[i] - opts->q_ref[i] );
         }
         //aa_dump_vec( stdout, dqnull, cx->n );
-        aa_la_xlsnp( 6, n_q, J, J_star, dx, dqnull, dq );
+        if( !fixed ) {
+            aa_la_xlsnp( m, n_q, J, J_star, dx, dqnull, dq );
+        } else {
+            aa_la_d6xlsnp( n_q, J, J_star, dx, dqnull, dq );
+        }
     } else {
         //printf("no projection\n");
-        aa_la_mvmul(n_q,6,J_star,dx,dq);
+        aa_la_mvmul(n_q,m,J_star,dx,dq);
     }
     return 0;
 }
 
+AA_API int
+aa_rx_ik_jac_dx2dq ( const struct aa_rx_ksol_opts *opts, size_t n_q,
+                     const double *AA_RESTRICT q_act, const double *AA_RESTRICT dx, const double *J,
+                     double *AA_RESTRICT dq )
+{
+    return kin_dx2dq( opts, 6, n_q, q_act, dx, J, dq );
+}
+
 AA_API int
 aa_rx_ik_jac_x2dq ( const struct aa_rx_ksol_opts *opts, size_t n_q,
                     const double *AA_RESTRICT q_act, const double *AA_RESTRICT E_act,
@@ -239,6 +356,164 @@ aa_rx_ik_jac_x2dq ( const struct aa_rx_ksol_opts *opts, size_t n_q,
     /* return 0; */
 }
 
+/*-- Servo --*/
+
+/*
+ * The servo holds a solver workspace for its lifetime.  Each step
+ * updates only the transforms that depend on the sub-scenegraph and
+ * uses the fixed-size 6 x n kernels, so no step touches the heap or
+ * a memory region.  The pseudoinverse is warm started from the
+ * previous step.  The options are borrowed from the caller for the
+ * life of the servo.
+ */
+struct aa_rx_ik_servo {
+    struct aa_mem_region reg;
+    struct kin_solve_cx cx;
+    double *E_act;              ///< end-effector pose at the last step
+    double *J;                  ///< 6 x n
+    double *J_star;             ///< n x 6
+    double *dq_null;            ///< n
+    double U[36];               ///< eigenbasis of J*J', warm start
+};
+
+/* Largest size supported by aa_la_d6zdpinv() */
+static const size_t servo_max_q = 10;
+
+AA_API struct aa_rx_ik_servo *
+aa_rx_ik_servo_create( const struct aa_rx_sg_sub *ssg,
+                       const struct aa_rx_ksol_opts *opts )
+{
+    const struct aa_rx_sg *sg = ssg->scenegraph;
+    size_t n_q = aa_rx_sg_sub_config_count(ssg);
+    size_t n_q_all = aa_rx_sg_config_count(sg);
+    size_t n_ee = kin_solve_frame_override(opts, ssg) ? 1 : aa_rx_sg_sub_ee_count(ssg);
+
+    if( 0 == n_q || n_q > servo_max_q || 1 != n_ee ||
+        (opts->q_all_seed && opts->n_all_seed != n_q_all) )
+    {
+        return NULL;
+    }
+
+    struct aa_rx_ik_servo *servo = AA_NEW0( struct aa_rx_ik_servo );
+    aa_mem_region_init( &servo->reg, 16*1024 );
+
+    struct kin_solve_cx *cx = &servo->cx;
+    cx->n = n_q;
+    cx->opts = opts;            /* borrowed until destroy */
+    cx->ssg = ssg;
+    cx->E1 = NULL;
+    cx->ld_E1 = 7;
+    cx->iteration = 0;
+    cx->reg = &servo->reg;
+    cx->cancel = NULL;
+    cx->n_all = n_q_all;
+    cx->n_ee = 1;
+    cx->m = 6;
+    cx->weight = NULL;
+
+    double *q_start_all = AA_MEM_REGION_NEW_N( cx->reg, double, n_q_all );
+    if( opts->q_all_seed ) {
+        AA_MEM_CPY( q_start_all, opts->q_all_seed, n_q_all );
+    } else {
+        AA_MEM_ZERO( q_start_all, n_q_all );
+    }
+    kin_solve_cx_init( cx, q_start_all );
+
+    servo->E_act = AA_MEM_REGION_NEW_N( cx->reg, double, 7 );
+    servo->J = AA_MEM_REGION_NEW_N( cx->reg, double, 6*n_q );
+    servo->J_star = AA_MEM_REGION_NEW_N( cx->reg, double, 6*n_q );
+    servo->dq_null = AA_MEM_REGION_NEW_N( cx->reg, double, n_q );
+    AA_MEM_CPY( servo->E_act, cx->TF_abs + 7*cx->frame_ee[0], 7 );
+    for( size_t i = 0; i < 6; i ++ ) servo->U[7*i] = 1;
+
+    return servo;
+}
+
+AA_API void
+aa_rx_ik_servo_destroy( struct aa_rx_ik_servo *servo )
+{
+    if( NULL == servo ) return;
+    aa_mem_region_destroy( &servo->reg );
+    free( servo );
+}
+
+AA_API const double *
+aa_rx_ik_servo_pose( const struct aa_rx_ik_servo *servo )
+{
+    return servo->E_act;
+}
+
+AA_API int
+aa_rx_ik_servo_step( struct aa_rx_ik_servo *servo,
+                     size_t n_q, const double *AA_RESTRICT q,
+                     const double E_ref[7], const double dx_ref[6],
+                     double *AA_RESTRICT dq )
+{
+    const struct kin_solve_cx *cx = &servo->cx;
+    const struct aa_rx_ksol_opts *opts = cx->opts;
+    if( n_q != cx->n ) return AA_RX_INVALID_PARAMETER;
+
+    ksol_qutr( cx, q, servo->E_act, servo->J );
+
+    double dx[6];
+    if( E_ref ) {
+        rfx_kin_qutr_werr( servo->E_act, E_ref, dx );
+        for( size_t i = 0; i < 3; i ++ ) {
+            dx[AA_TF_DX_V + i] *= -opts->gain_trans;
+            dx[AA_TF_DX_W + i] *= -opts->gain_angle;
+        }
+    } else {
+        AA_MEM_ZERO( dx, 6 );
+    }
+    if( dx_ref ) {
+        for( size_t i = 0; i < 6; i ++ ) dx[i] += dx_ref[i];
+    }
+
+    /* Successive Jacobians are close, so start from the last basis */
+    aa_la_d6zdpinv_warm( n_q, opts->s2min, servo->J, servo->U, servo->J_star );
+
+    if( opts->q_ref ) {
+        for( size_t i = 0; i < n_q; i ++ ) {
+            servo->dq_null[i] = - opts->dq_dt[i] * ( q[i] - opts->q_ref[i] );
+        }
+        aa_la_d6xlsnp( n_q, servo->J, servo->J_star, dx, servo->dq_null, dq );
+    } else {
+        for( size_t i = 0; i < n_q; i ++ ) {
+            double x = 0;
+            for( size_t k = 0; k < 6; k ++ ) x += servo->J_star[i + n_q*k] * dx[k];
+            dq[i] = x;
+        }
+    }
+    return 0;
+}
+
+
+/* Stacked, gain-weighted pose error.  Returns the squared norm. */
+static double kin_solve_err( const struct kin_solve_cx *cx, const double *E, double *e )
+{
+    for( size_t k = 0; k < cx->n_ee; k ++ ) {
+        double *e_k = e + 6*k;
+        double w = cx->weight ? cx->weight[k] : 1;
+        rfx_kin_qutr_werr( E + 7*k, cx->E1 + k*cx->ld_E1, e_k );
+        for( size_t i = 0; i < 3; i ++ ) {
+            e_k[AA_TF_DX_V + i] *= -w * cx->opts->gain_trans;
+            e_k[AA_TF_DX_W + i] *= -w * cx->opts->gain_angle;
+        }
+    }
+    return aa_la_dot( cx->m, e, e );
+}
+
+static int kin_solve_converged( const struct kin_solve_cx *cx, const double *E )
+{
+    for( size_t k = 0; k < cx->n_ee; k ++ ) {
+        double theta_err, x_err;
+        rfx_kin_qutr_serr( E + 7*k, cx->E1 + k*cx->ld_E1, &theta_err, &x_err );
+        if( theta_err >= cx->opts->tol_angle || x_err >= cx->opts->tol_trans ) {
+            return 0;
+        }
+    }
+    return 1;
+}
 
 static void kin_solve_sys( const void *vcx,
                            double t, const double *AA_RESTRICT q,
@@ -248,12 +523,13 @@ static void kin_solve_sys( const void *vcx,
     //printf("ksolve\n");
 
     // compute kinematics
-    double J[6*cx->n];
-    double E_act[7];
+    double J[cx->m*cx->n];
+    double E_act[7*cx->n_ee];
     ksol_qutr(cx, q, E_act, J);
 
-    aa_rx_ik_jac_x2dq ( cx->opts, cx->n,
-                        q,  E_act, cx->E1, NULL, J, dq );
+    double e[cx->m];
+    kin_solve_err( cx, E_act, e );
+    kin_dx2dq( cx->opts, cx->m, cx->n, q, e, J, dq );
     return;
 
     /* // position error */
@@ -298,28 +574,35 @@ static void kin_solve_sys( const void *vcx,
 /*     const struct aa_rx_sg_sub *ssg; */
 /* } */
 
-static int kin_solve_check( void *vcx, double t, double *AA_RESTRICT x, double *AA_RESTRICT y )
+static void kin_solve_clamp( const struct aa_rx_sg_sub *ssg, size_t n, double *q )
 {
-    //printf("check\n");
-    (void)t;
-    struct kin_solve_cx *cx = (struct kin_solve_cx*)vcx;
-    const struct aa_rx_sg_sub *ssg  = cx->ssg;
-    /* Clamp */
-    for( size_t i = 0; i < cx->n; i ++ ) {
+    for( size_t i = 0; i < n; i ++ ) {
         double min,max;
         aa_rx_config_id id = aa_rx_sg_sub_config(ssg,i);
         if( 0 == aa_rx_sg_get_limit_pos(ssg->scenegraph, id, &min, &max ) ) {
-            x[i] = aa_fclamp(x[i], min, max );
+            q[i] = aa_fclamp(q[i], min, max );
         }
     }
+}
+
+static int kin_solve_cancelled( const struct kin_solve_cx *cx )
+{
+    return cx->cancel && atomic_load_explicit( cx->cancel, memory_order_relaxed );
+}
+
+static int kin_solve_check( void *vcx, double t, double *AA_RESTRICT x, double *AA_RESTRICT y )
+{
+    //printf("check\n");
+    (void)t;
+    struct kin_solve_cx *cx = (struct kin_solve_cx*)vcx;
+    /* Clamp */
+    kin_solve_clamp( cx->ssg, cx->n, x );
 
     /* Check term */
     double dq_norm = aa_la_dot( cx->n, y, y );
 
-    double  E[7];
-    double theta_err, x_err;
+    double  E[7*cx->n_ee];
     ksol_qutr( cx, x, E, NULL );
-    rfx_kin_qutr_serr( E, cx->E1, &theta_err, &x_err );
     //printf("%f, %f, %f\n", t, theta_err, x_err );
     //printf("x: ");
     //aa_dump_vec(stdout, x, cx->n);
@@ -327,9 +610,10 @@ static int kin_solve_check( void *vcx, double t, double *AA_RESTRICT x, double *
     //aa_dump_vec(stdout, y, cx->n);
 
     cx->iteration++;
-    if( (theta_err < cx->opts->tol_angle) &&
-        (x_err < cx->opts->tol_trans) &&
-        (dq_norm < cx->opts->tol_dq) )
+    if( kin_solve_cancelled(cx) ) {
+        return -1;
+    } else if( kin_solve_converged(cx, E) &&
+               (dq_norm < cx->opts->tol_dq) )
     {
         return 1;
     } else if( cx->iteration > cx->opts->max_iterations ) {
@@ -341,18 +625,216 @@ static int kin_solve_check( void *vcx, double t, double *AA_RESTRICT x, double *
 }
 
 
+/* Damped Newton (Levenberg-Marquardt)
+ *
+ *   dq = J^T (J J^T + lambda*I)^{-1} e + (I - J^+ J) dq_dt * (q_ref - q)
+ *   q(k+1) = clamp( q(k) + alpha * dq )
+ *
+ *   e is the gain-weighted pose error.  The step size alpha is
+ *   limited to kin_lm_max_step of joint motion, then found by
+ *   backtracking until the error decreases.  lambda shrinks after
+ *   accepted steps and grows after rejected steps.
+ */
+
+static const double kin_lm_damp_dec = 3;    ///< damping decrease on accepted step
+static const double kin_lm_damp_inc = 10;   ///< damping increase on rejected step
+static const double kin_lm_damp_min = 1e-12;
+static const double kin_lm_damp_max = 1e6;  ///< give up above this damping
+static const size_t kin_lm_line_search = 4; ///< maximum step halvings
+static const double kin_lm_max_step = .5;   ///< maximum joint motion per step
+
+/* Damped step for the joints not blocked at a position limit
+ *
+ * Joints at a limit that the step would push further out are removed
+ * from the Jacobian and the step is recomputed, so the remaining
+ * joints compensate instead of losing the step to clamping.
+ */
+static void kin_lm_step( const struct kin_solve_cx *cx, double lambda, int null,
+                         const double *q, const double *J, const double *e,
+                         double *dq )
+{
+    const struct aa_rx_ksol_opts *opts = cx->opts;
+    size_t n = cx->n;
+    size_t m = cx->m;
+    double J_free[m*n], J_star[m*n], dqnull[n];
+    int blocked[n];
+
+    AA_MEM_CPY( J_free, J, m*n );
+    AA_MEM_ZERO( blocked, n );
+
+    for( size_t pass = 0; pass <= n; pass ++ ) {
+        aa_la_dpinv( m, n, lambda, J_free, J_star );
+        if( null ) {
+            for( size_t i = 0; i < n; i ++ )  {
+                dqnull[i] = blocked[i] ? 0 :
+                    - opts->dq_dt[i] * ( q[i] - opts->q_ref[i] );
+            }
+            if( 6 != m || aa_la_d6xlsnp( n, J_free, J_star, e, dqnull, dq ) ) {
+                aa_la_xlsnp( m, n, J_free, J_star, e, dqnull, dq );
+            }
+        } else {
+            aa_la_mvmul( n, m, J_star, e, dq );
+        }
+
+        int changed = 0;
+        for( size_t i = 0; i < n; i ++ ) {
+            double min,max;
+            aa_rx_config_id id = aa_rx_sg_sub_config(cx->ssg,i);
+            if( blocked[i] ) {
+                dq[i] = 0;
+            } else if( 0 == aa_rx_sg_get_limit_pos(cx->ssg->scenegraph, id, &min, &max ) &&
+                       ( (q[i] <= min && dq[i] < 0) || (q[i] >= max && dq[i] > 0) ) )
+            {
+                blocked[i] = 1;
+                changed = 1;
+                AA_MEM_ZERO( J_free + m*i, m );
+            }
+        }
+        if( ! changed ) break;
+    }
+}
+
+/* Step as a box-constrained QP
+ *
+ *   min  1/2 |J dq - e|^2 + lambda/2 |dq|^2 + w/2 |dq - dqnull|^2
+ *   s.t. max(q_min - q, v_min*dt, -s) <= dq <= min(q_max - q, v_max*dt, s)
+ *
+ * where s is kin_lm_max_step.  Unlike clamping after the step, the
+ * bounds are part of the solution, so the free joints compensate for
+ * the joints at a limit.
+ */
+static const double kin_qp_null_weight = 1e-4;
+
+static int kin_qp_step( const struct kin_solve_cx *cx, double lambda, int null,
+                        const double *q, const double *J, const double *e,
+                        double *dq )
+{
+    const struct aa_rx_ksol_opts *opts = cx->opts;
+    const struct aa_rx_sg *sg = cx->ssg->scenegraph;
+    size_t n = cx->n;
+    size_t m = cx->m;
+    double D[n*n], c[n], l[n], u[n];
+
+    /* D = J^T J + (lambda + w) I,  c = -J^T e - w dqnull */
+    double w = null ? kin_qp_null_weight : 0;
+    for( size_t j = 0; j < n; j ++ ) {
+        for( size_t i = 0; i <= j; i ++ ) {
+            double d = aa_la_dot( m, J + m*i, J + m*j );
+            D[i+n*j] = D[j+n*i] = d;
+        }
+        D[j+n*j] += lambda + w;
+        c[j] = - aa_la_dot( m, J + m*j, e );
+        if( null ) {
+            c[j] += w * opts->dq_dt[j] * ( q[j] - opts->q_ref[j] );
+        }
+    }
+
+    for( size_t i = 0; i < n; i ++ ) {
+        double min, max;
+        aa_rx_config_id id = aa_rx_sg_sub_config(cx->ssg,i);
+        l[i] = -kin_lm_max_step;
+        u[i] = kin_lm_max_step;
+        if( 0 == aa_rx_sg_get_limit_pos(sg, id, &min, &max) ) {
+            l[i] = AA_MAX( l[i], min - q[i] );
+            u[i] = AA_MIN( u[i], max - q[i] );
+        }
+        if( 0 == aa_rx_sg_get_limit_vel(sg, id, &min, &max) ) {
+            l[i] = AA_MAX( l[i], min * opts->dt );
+            u[i] = AA_MIN( u[i], max * opts->dt );
+        }
+        /* q may be slightly outside the limits after clamping round-off */
+        l[i] = AA_MIN( l[i], 0 );
+        u[i] = AA_MAX( u[i], 0 );
+    }
+
+    return aa_opt_qp_box_dense( n, D, n, c, l, u, dq );
+}
+
+static int kin_solve_lm( struct kin_solve_cx *cx, const double *q0, double *q )
+{
+    const struct aa_rx_ksol_opts *opts = cx->opts;
+    size_t n = cx->n;
+    size_t m = cx->m;
+
+    double J[m*n];
+    double dq[n], q_try[n];
+    double E[7*cx->n_ee], E_try[7*cx->n_ee];
+    double e[m], e_try[m];
+    double lambda = opts->k_dls;
+
+    AA_MEM_CPY( q, q0, n );
+    kin_solve_clamp( cx->ssg, n, q );
+    ksol_qutr( cx, q, E, J );
+    double f = kin_solve_err( cx, E, e );
+
+    for( cx->iteration = 0;
+         cx->iteration < opts->max_iterations && !kin_solve_converged(cx, E) &&
+             !kin_solve_cancelled(cx);
+         cx->iteration++ )
+    {
+        /* Backtracking line search, first including the nullspace
+         * motion.  Near convergence, the nullspace motion may dominate
+         * the step, so fall back to the task-space step alone. */
+        int accept = 0;
+        int null = opts->q_ref && opts->dq_dt;
+        for( int pass = null ? 0 : 1; !accept && pass < 2; pass++ ) {
+            if( AA_RX_IK_QP != opts->ik_method ||
+                kin_qp_step( cx, lambda, 0 == pass, q, J, e, dq ) )
+            {
+                kin_lm_step( cx, lambda, 0 == pass, q, J, e, dq );
+            }
+            /* Limit the step so large initial errors do not jump
+             * into distant local minima */
+            double dq_max = 0;
+            for( size_t i = 0; i < n; i ++ ) {
+                dq_max = AA_MAX( dq_max, fabs(dq[i]) );
+            }
+            double alpha = (dq_max > kin_lm_max_step) ? kin_lm_max_step / dq_max : 1;
+            for( size_t k = 0; !accept && k <= kin_lm_line_search; k++, alpha /= 2 ) {
+                for( size_t i = 0; i < n; i ++ ) {
+                    q_try[i] = q[i] + alpha*dq[i];
+                }
+                kin_solve_clamp( cx->ssg, n, q_try );
+                ksol_qutr( cx, q_try, E_try, NULL );
+                double f_try = kin_solve_err( cx, E_try, e_try );
+                if( f_try < f ) {
+                    accept = 1;
+                    f = f_try;
+                }
+            }
+        }
+
+        if( accept ) {
+            AA_MEM_CPY( q, q_try, n );
+            AA_MEM_CPY( E, E_try, 7*cx->n_ee );
+            AA_MEM_CPY( e, e_try, m );
+            lambda = AA_MAX( lambda / kin_lm_damp_dec, kin_lm_damp_min );
+            /* The workspace transforms are current for q_try */
+            ksol_jacobian( cx, J );
+        } else {
+            lambda *= kin_lm_damp_inc;
+            if( lambda > kin_lm_damp_max ) break;
+        }
+    }
+
+    return kin_solve_converged(cx, E) ? 0 : -1;
+}
+
+
 static int
-aa_rx_sg_sub_ksol_dls( const struct aa_rx_sg_sub *ssg,
-                       const struct aa_rx_ksol_opts *opts,
-                       size_t n_tf, const double *TF, size_t ld_TF,
-                       size_t n_q_all, const double *q_start_all,
-                       size_t n_q, double *q_subset )
+kin_solve_jac( const struct aa_rx_sg_sub *ssg,
+               const struct aa_rx_ksol_opts *opts,
+               struct aa_mem_region *reg, atomic_int *cancel,
+               size_t n_tf, const double *TF, size_t ld_TF,
+               size_t n_q_all, const double *q_start_all,
+               size_t n_q, double *q_subset )
 {
 
-    /* Only chains for now */
-    assert(n_tf == 1 );
+    size_t n_ee = kin_solve_frame_override(opts, ssg) ? 1 : aa_rx_sg_sub_ee_count(ssg);
+    if( n_tf != n_ee || 0 == n_ee ) {
+        return AA_RX_INVALID_PARAMETER;
+    }
     assert(n_q == aa_rx_sg_sub_config_count(ssg) );
-    (void)ld_TF;
 
     if( 0 == n_q_all || NULL == q_start_all ) {
         q_start_all = opts->q_all_seed;
@@ -364,9 +846,6 @@ aa_rx_sg_sub_ksol_dls( const struct aa_rx_sg_sub *ssg,
 
     assert( aa_rx_sg_sub_all_config_count(ssg) == n_q_all );
 
-    const struct aa_rx_sg *sg = ssg->scenegraph;
-    size_t n_f = aa_rx_sg_frame_count(sg);
-
     assert( aa_rx_sg_sub_config_count(ssg) == n_q);
 
     double q0_sub[n_q];
@@ -385,35 +864,43 @@ aa_rx_sg_sub_ksol_dls( const struct aa_rx_sg_sub *ssg,
     cx.n = n_q;
     cx.opts = opts;
     cx.E1 = TF;
+    cx.ld_E1 = ld_TF;
+    cx.n_ee = n_ee;
+    cx.m = 6*n_ee;
+    cx.weight = (opts->ee_weight && opts->n_ee_weight == n_ee) ? opts->ee_weight : NULL;
     cx.ssg = ssg;
     //cx.dq_dt = opts->dq_dt;
     cx.iteration = 0;
 
-    struct aa_ode_sol_opts sol_opts;
-    sol_opts.adapt_tol_dec = opts->tol_dq / 16;
-    sol_opts.adapt_tol_inc = opts->tol_dq / 2;
-    sol_opts.adapt_factor_dec = 0.1;
-    sol_opts.adapt_factor_inc = 2.0;
-
-    cx.q0_all = q_start_all;
     cx.n_all = n_q_all;
 
-    cx.reg = aa_mem_region_local_get();
-    cx.TF_rel0 = AA_MEM_REGION_NEW_N(cx.reg, double, 7*n_f);
-    cx.TF_abs0 = AA_MEM_REGION_NEW_N(cx.reg, double, 7*n_f);
-
-    aa_rx_sg_tf( ssg->scenegraph,
-                 cx.n_all, cx.q0_all,
-                 n_f,
-                 cx.TF_rel0, 7,
-                 cx.TF_abs0, 7 );
-
-    int r = aa_ode_sol( AA_ODE_RK23_BS, &sol_opts, n_q,
+    cx.reg = reg;
+    cx.cancel = cancel;
+    kin_solve_cx_init( &cx, q_start_all );
+
+    int r;
+    switch( opts->ik_method ) {
+    case AA_RX_IK_LM:
+    case AA_RX_IK_QP:
+        r = kin_solve_lm( &cx, q0_sub, q_subset );
+        break;
+    case AA_RX_IK_ODE:
+    default: {
+        struct aa_ode_sol_opts sol_opts;
+        sol_opts.adapt_tol_dec = opts->tol_dq / 16;
+        sol_opts.adapt_tol_inc = opts->tol_dq / 2;
+        sol_opts.adapt_factor_dec = 0.1;
+        sol_opts.adapt_factor_inc = 2.0;
+
+        r = aa_ode_sol( AA_ODE_RK23_BS, &sol_opts, n_q,
                         kin_solve_sys, &cx,
                         kin_solve_check, &cx,
                         0, opts->dt, q0_sub, q_subset );
+        break;
+    }
+    }
 
-    aa_mem_region_pop(cx.reg, cx.TF_rel0);
+    aa_mem_region_pop(cx.reg, cx.q_all);
 
     if( r ) {
         return AA_RX_NO_SOLUTION | AA_RX_NO_IK;
@@ -428,6 +915,20 @@ aa_rx_sg_sub_ksol_dls( const struct aa_rx_sg_sub *ssg,
 
 }
 
+static int
+aa_rx_sg_sub_ksol_dls( const struct aa_rx_sg_sub *ssg,
+                       const struct aa_rx_ksol_opts *opts,
+                       size_t n_tf, const double *TF, size_t ld_TF,
+                       size_t n_q_all, const double *q_start_all,
+                       size_t n_q, double *q_subset )
+{
+    return kin_solve_jac( ssg, opts,
+                          aa_mem_region_local_get(), NULL,
+                          n_tf, TF, ld_TF,
+                          n_q_all, q_start_all,
+                          n_q, q_subset );
+}
+
 struct aa_rx_ik_jac_cx
 {
     const struct aa_rx_sg_sub *ssg;
@@ -450,14 +951,52 @@ aa_rx_ik_jac_cx_destroy( struct aa_rx_ik_jac_cx *cx )
 }
 
 
+/* Number of cached seeds to try before the option seed */
+static const size_t ik_cache_seeds = 2;
+
 AA_API int aa_rx_ik_jac_solve( const struct aa_rx_ik_jac_cx *context,
                                size_t n_tf, const double *TF, size_t ld_TF,
                                size_t n_q, double *q )
 {
-    return aa_rx_sg_sub_ksol_dls( context->ssg, context->opts,
-                                  n_tf, TF, ld_TF,
-                                  0, NULL,
-                                  n_q, q );
+    const struct aa_rx_sg_sub *ssg = context->ssg;
+    const struct aa_rx_ksol_opts *opts = context->opts;
+    struct aa_rx_ik_cache *cache = aa_rx_ksol_opts_cache( opts );
+
+    if( NULL == cache || 1 != n_tf || NULL == opts->q_all_seed ) {
+        return aa_rx_sg_sub_ksol_dls( ssg, opts,
+                                      n_tf, TF, ld_TF,
+                                      0, NULL,
+                                      n_q, q );
+    }
+
+    /* Try the nearest cached solutions, then the option seed */
+    size_t n_q_all = opts->n_all_seed;
+    struct aa_mem_region *reg = aa_mem_region_local_get();
+    double *Q = AA_MEM_REGION_NEW_N( reg, double, n_q*ik_cache_seeds );
+    double *q_all = AA_MEM_REGION_NEW_N( reg, double, n_q_all );
+
+    size_t n_c = aa_rx_ik_cache_nearest( cache, TF, ik_cache_seeds, n_q, Q, n_q );
+    int r = AA_RX_NO_SOLUTION | AA_RX_NO_IK;
+    for( size_t j = 0; r && j < n_c; j ++ ) {
+        AA_MEM_CPY( q_all, opts->q_all_seed, n_q_all );
+        aa_rx_sg_sub_config_set( ssg, n_q, Q + j*n_q, n_q_all, q_all );
+        r = aa_rx_sg_sub_ksol_dls( ssg, opts,
+                                   n_tf, TF, ld_TF,
+                                   n_q_all, q_all,
+                                   n_q, q );
+    }
+    if( r ) {
+        r = aa_rx_sg_sub_ksol_dls( ssg, opts,
+                                   n_tf, TF, ld_TF,
+                                   0, NULL,
+                                   n_q, q );
+    }
+    if( 0 == r ) {
+        aa_rx_ik_cache_add( cache, TF, n_q, q );
+    }
+
+    aa_mem_region_pop( reg, Q );
+    return r;
 }
 
 AA_API int aa_rx_ik_jac_fun( void *context_,
@@ -470,6 +1009,210 @@ AA_API int aa_rx_ik_jac_fun( void *context_,
                                n_q, q );
 }
 
+/*-- Multi-start --*/
+
+/* Minimum joint distance (infinity norm) between distinct solutions */
+static const double ik_ms_distinct = 1e-2;
+
+struct ik_ms_cx {
+    const struct aa_rx_ik_jac_cx *ik_cx;
+
+    size_t n_tf;
+    const double *TF;
+    size_t ld_TF;
+
+    size_t n_q_all;
+    size_t n_q;
+
+    size_t n_starts;
+    const double *seeds;        ///< seed configurations, n_q x n_starts
+    size_t n_sol;               ///< stop after this many distinct solutions
+
+    atomic_int cancel;
+    pthread_mutex_t mutex;      ///< protects the fields below
+    size_t next;                ///< next seed to solve
+    size_t n_found;
+    double *sols;               ///< distinct solutions, n_q x n_starts
+};
+
+static void
+ik_ms_add( struct ik_ms_cx *cx, const double *q )
+{
+    size_t n_q = cx->n_q;
+    pthread_mutex_lock( &cx->mutex );
+    int distinct = 1;
+    for( size_t j = 0; distinct && j < cx->n_found; j ++ ) {
+        const double *q_j = cx->sols + j*n_q;
+        double d = 0;
+        for( size_t i = 0; i < n_q; i ++ ) {
+            d = AA_MAX( d, fabs(q[i] - q_j[i]) );
+        }
+        distinct = (d > ik_ms_distinct);
+    }
+    if( distinct && cx->n_found < cx->n_sol ) {
+        AA_MEM_CPY( cx->sols + n_q*cx->n_found, q, n_q );
+        cx->n_found++;
+        if( cx->n_found >= cx->n_sol ) {
+            atomic_store( &cx->cancel, 1 );
+        }
+    }
+    pthread_mutex_unlock( &cx->mutex );
+}
+
+static void *
+ik_ms_worker( void *vcx )
+{
+    struct ik_ms_cx *cx = (struct ik_ms_cx*)vcx;
+    const struct aa_rx_sg_sub *ssg = cx->ik_cx->ssg;
+    const struct aa_rx_ksol_opts *opts = cx->ik_cx->opts;
+    size_t n_q_all = cx->n_q_all;
+    size_t n_q = cx->n_q;
+
+    /* Private workspace */
+    struct aa_mem_region reg;
+    aa_mem_region_init( &reg, 16*1024 );
+    double *q_all = AA_MEM_REGION_NEW_N( &reg, double, n_q_all );
+    double *q = AA_MEM_REGION_NEW_N( &reg, double, n_q );
+
+    for(;;) {
+        pthread_mutex_lock( &cx->mutex );
+        size_t k = cx->next++;
+        pthread_mutex_unlock( &cx->mutex );
+
+        if( k >= cx->n_starts || atomic_load(&cx->cancel) ) break;
+
+        AA_MEM_CPY( q_all, opts->q_all_seed, n_q_all );
+        aa_rx_sg_sub_config_set( ssg, n_q, cx->seeds + k*n_q, n_q_all, q_all );
+
+        int r = kin_solve_jac( ssg, opts, &reg, &cx->cancel,
+                               cx->n_tf, cx->TF, cx->ld_TF,
+                               n_q_all, q_all,
+                               n_q, q );
+        if( 0 == r ) {
+            ik_ms_add( cx, q );
+        }
+    }
+
+    aa_mem_region_destroy( &reg );
+    return NULL;
+}
+
+AA_API int
+aa_rx_ik_solve_multistart( const struct aa_rx_ik_jac_cx *context,
+                           size_t n_threads, size_t n_starts,
+                           size_t n_tf, const double *TF, size_t ld_TF,
+                           const double *q_ref,
+                           size_t n_q, size_t n_sol, double *Q, size_t ld_Q,
+                           size_t *n_found )
+{
+    const struct aa_rx_sg_sub *ssg = context->ssg;
+    const struct aa_rx_ksol_opts *opts = context->opts;
+    const struct aa_rx_sg *sg = ssg->scenegraph;
+
+    if( n_found ) *n_found = 0;
+
+    assert( aa_rx_sg_sub_config_count(ssg) == n_q );
+    if( NULL == opts->q_all_seed || 0 == n_starts || 0 == n_sol ) {
+        return AA_RX_INVALID_PARAMETER;
+    }
+    size_t n_q_all = opts->n_all_seed;
+
+    if( 0 == n_threads ) {
+        long n_cpu = sysconf(_SC_NPROCESSORS_ONLN);
+        n_threads = (n_cpu > 0) ? (size_t)n_cpu : 1;
+    }
+    n_threads = AA_MIN( n_threads, n_starts );
+
+    struct aa_mem_region *reg = aa_mem_region_local_get();
+    double *seeds = AA_MEM_REGION_NEW_N( reg, double, n_q*n_starts );
+    double *sols = AA_MEM_REGION_NEW_N( reg, double, n_q*n_starts );
+    double *dist = AA_MEM_REGION_NEW_N( reg, double, n_starts );
+    pthread_t *threads = AA_MEM_REGION_NEW_N( reg, pthread_t, n_threads );
+
+    /* The first seed is the nearest cached solution or else the
+     * option seed.  Others are sampled within the position limits. */
+    struct aa_rx_ik_cache *cache = aa_rx_ksol_opts_cache( opts );
+    if( NULL == cache || 1 != n_tf ||
+        0 == aa_rx_ik_cache_nearest( cache, TF, 1, n_q, seeds, n_q ) )
+    {
+        aa_rx_sg_config_get( sg, n_q_all, n_q, aa_rx_sg_sub_configs(ssg),
+                             opts->q_all_seed, seeds );
+    }
+    for( size_t k = 1; k < n_starts; k ++ ) {
+        double *q = seeds + k*n_q;
+        for( size_t i = 0; i < n_q; i ++ ) {
+            double min, max;
+            aa_rx_config_id id = aa_rx_sg_sub_config(ssg,i);
+            if( 0 == aa_rx_sg_get_limit_pos(sg, id, &min, &max) ) {
+                q[i] = min + (max-min)*aa_frand();
+            } else {
+                q[i] = seeds[i] + M_PI*(2*aa_frand() - 1);
+            }
+        }
+    }
+
+    /* Solve */
+    struct ik_ms_cx cx;
+    cx.ik_cx = context;
+    cx.n_tf = n_tf;
+    cx.TF = TF;
+    cx.ld_TF = ld_TF;
+    cx.n_q_all = n_q_all;
+    cx.n_q = n_q;
+    cx.n_starts = n_starts;
+    cx.seeds = seeds;
+    cx.n_sol = n_sol;
+    atomic_init( &cx.cancel, 0 );
+    pthread_mutex_init( &cx.mutex, NULL );
+    cx.next = 0;
+    cx.n_found = 0;
+    cx.sols = sols;
+
+    size_t n_started = 0;
+    for( ; n_started < n_threads; n_started ++ ) {
+        if( pthread_create( threads + n_started, NULL, ik_ms_worker, &cx ) ) {
+            break;
+        }
+    }
+    if( 0 == n_started ) {
+        /* No threads, solve here */
+        ik_ms_worker( &cx );
+    }
+    for( size_t j = 0; j < n_started; j ++ ) {
+        pthread_join( threads[j], NULL );
+    }
+    pthread_mutex_destroy( &cx.mutex );
+
+    /* Rank by distance to the reference */
+    if( NULL == q_ref ) {
+        q_ref = opts->q_ref ? opts->q_ref : seeds;
+    }
+    for( size_t j = 0; j < cx.n_found; j ++ ) {
+        dist[j] = aa_la_ssd( n_q, q_ref, sols + j*n_q );
+    }
+    for( size_t j = 0; j < cx.n_found; j ++ ) {
+        size_t i_min = j;
+        for( size_t i = j+1; i < cx.n_found; i ++ ) {
+            if( dist[i] < dist[i_min] ) i_min = i;
+        }
+        AA_MEM_CPY( Q + j*ld_Q, sols + i_min*n_q, n_q );
+        if( i_min != j ) {
+            dist[i_min] = dist[j];
+            AA_MEM_CPY( sols + i_min*n_q, sols + j*n_q, n_q );
+        }
+    }
+
+    aa_mem_region_pop( reg, seeds );
+
+    if( n_found ) *n_found = cx.n_found;
+
+    if( cache && 1 == n_tf && cx.n_found ) {
+        aa_rx_ik_cache_add( cache, TF, n_q, Q );
+    }
+
+    return cx.n_found ? 0 : (AA_RX_NO_SOLUTION | AA_RX_NO_IK);
+}
+
 
 
 /* Levenberg Marquardt
@@ -80,6 +80,8 @@ aa_rx_ksol_opts_create()
 
     opt->frame = AA_RX_FRAME_NONE;
 
+    opt->ik_method = AA_RX_IK_ODE;
+
     return opt;
 }
 
@@ -88,6 +90,7 @@ aa_rx_ksol_opts_destroy( struct aa_rx_ksol_opts *opts)
 {
     if( opts->dq_dt_data ) free( opts->dq_dt_data );
     if( opts->q_ref_data ) free( opts->q_ref_data );
+    if( opts->ee_weight_data ) free( opts->ee_weight_data );
 }
 
 
@@ -104,6 +107,8 @@ AA_DEF_SETTER( aa_rx_ksol_opts, double, k_dls )
 AA_DEF_SETTER( aa_rx_ksol_opts, double, gain_angle )
 AA_DEF_SETTER( aa_rx_ksol_opts, double, gain_trans )
 AA_DEF_SETTER( aa_rx_ksol_opts, size_t, max_iterations )
+AA_DEF_SETTER( aa_rx_ksol_opts, enum aa_rx_ik_method, ik_method )
+AA_DEF_SETTER( aa_rx_ksol_opts, struct aa_rx_ik_cache *, cache )
 
 
 
@@ -138,6 +143,16 @@ aa_rx_ksol_opts_take_seed( struct aa_rx_ksol_opts *opts, size_t n_q,
     opts->n_all_seed = n_q;
 }
 
+AA_API void
+aa_rx_ksol_opts_take_ee_weights( struct aa_rx_ksol_opts *opts, size_t n,
+                                 double *w, enum aa_mem_refop refop )
+{
+    aa_checked_free(opts->ee_weight_data);
+    AA_MEM_DUPOP( refop, double, opts->ee_weight,
+                  opts->ee_weight_data, w, n );
+    opts->n_ee_weight = n;
+}
+
 
 AA_API void
 aa_rx_ksol_opts_center_configs( struct aa_rx_ksol_opts *opts,
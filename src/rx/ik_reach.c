@@ -0,0 +1,474 @@
+/* -*- mode: C; c-basic-offset: 4; -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2016, Rice University
+ * All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of copyright holder the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+#include "amino.h"
+#include "amino/rx/rxtype.h"
+#include "amino/rx/rxerr.h"
+#include "amino/rx/scenegraph.h"
+#include "amino/rx/scene_sub.h"
+#include "amino/rx/scene_kin.h"
+
+static const char rmap_magic[8] = {'a','a','r','x','r','m','p','1'};
+
+/*
+ * Cells are indexed by voxel, then by orientation bin.  Orientation
+ * bins are a cube map over the direction of the end-effector z axis:
+ * 6 faces of n_side x n_side bins each.
+ *
+ * A cell value of 0 is unreached.  Otherwise, the value is the
+ * largest sampled manipulability, quantized to 1..255 over
+ * [0,manip_max].
+ */
+struct aa_rx_reach_map {
+    double min[3];
+    double resolution;
+    size_t dim[3];
+    size_t n_side;
+    size_t n_bin;
+    size_t n_cell;
+    aa_rx_frame_id frame;   ///< sampled frame
+    double manip_max;
+    uint8_t *cell;
+    uint64_t rng;           ///< seed state for sampling workers
+};
+
+AA_API struct aa_rx_reach_map *
+aa_rx_reach_map_create( const double min[3], const double max[3],
+                        double resolution, size_t n_side )
+{
+    if( !(resolution > 0) || 0 == n_side ) return NULL;
+
+    struct aa_rx_reach_map *m = AA_NEW0( struct aa_rx_reach_map );
+    AA_MEM_CPY( m->min, min, 3 );
+    m->resolution = resolution;
+    size_t n_vox = 1;
+    for( size_t i = 0; i < 3; i ++ ) {
+        double d = ceil( (max[i] - min[i]) / resolution );
+        m->dim[i] = (d > 1) ? (size_t)d : 1;
+        n_vox *= m->dim[i];
+    }
+    m->n_side = n_side;
+    m->n_bin = 6*n_side*n_side;
+    m->n_cell = n_vox * m->n_bin;
+    m->frame = AA_RX_FRAME_NONE;
+    m->cell = AA_NEW0_AR( uint8_t, m->n_cell );
+    m->rng = 0;
+    return m;
+}
+
+AA_API void
+aa_rx_reach_map_set_seed( struct aa_rx_reach_map *m, uint64_t seed )
+{
+    m->rng = seed;
+}
+
+AA_API void
+aa_rx_reach_map_destroy( struct aa_rx_reach_map *m )
+{
+    if( NULL == m ) return;
+    free( m->cell );
+    free( m );
+}
+
+AA_API aa_rx_frame_id
+aa_rx_reach_map_frame( const struct aa_rx_reach_map *m )
+{
+    return m->frame;
+}
+
+/*-- Indexing --*/
+
+/* Voxel index, or SIZE_MAX when outside the grid */
+static size_t
+rmap_voxel( const struct aa_rx_reach_map *m, const double v[3] )
+{
+    size_t k[3];
+    for( size_t i = 0; i < 3; i ++ ) {
+        double x = floor( (v[i] - m->min[i]) / m->resolution );
+        if( !(x >= 0) || x >= (double)m->dim[i] ) return SIZE_MAX;
+        k[i] = (size_t)x;
+    }
+    return (k[0]*m->dim[1] + k[1])*m->dim[2] + k[2];
+}
+
+/* Cube map bin of unit direction d, with equal-angle spacing on
+ * each face */
+static size_t
+rmap_bin( const struct aa_rx_reach_map *m, const double d[3] )
+{
+    size_t a = 0;
+    if( fabs(d[1]) > fabs(d[a]) ) a = 1;
+    if( fabs(d[2]) > fabs(d[a]) ) a = 2;
+    size_t face = 2*a + (d[a] < 0);
+    double s = fabs(d[a]);
+    size_t ij[2];
+    for( size_t k = 0; k < 2; k ++ ) {
+        double u = (s > 0) ? atan( d[(a+1+k)%3] / s ) * (4/M_PI) : 0;
+        double x = floor( (u + 1) / 2 * (double)m->n_side );
+        ij[k] = (x <= 0) ? 0 : AA_MIN( (size_t)x, m->n_side - 1 );
+    }
+    return (face*m->n_side + ij[0])*m->n_side + ij[1];
+}
+
+/* Cell index of pose E, or SIZE_MAX when outside the grid */
+static size_t
+rmap_cell( const struct aa_rx_reach_map *m, const double E[7] )
+{
+    size_t vox = rmap_voxel( m, E + AA_TF_QUTR_T );
+    if( SIZE_MAX == vox ) return SIZE_MAX;
+    double d[3];
+    aa_tf_qrot( E + AA_TF_QUTR_Q, aa_tf_vec_z, d );
+    return vox*m->n_bin + rmap_bin( m, d );
+}
+
+/*-- Queries --*/
+
+AA_API double
+aa_rx_reach_map_manip( const struct aa_rx_reach_map *m, const double E[7] )
+{
+    size_t c = rmap_cell( m, E );
+    if( SIZE_MAX == c || 0 == m->cell[c] ) return -1;
+    return (m->cell[c] - 1) * m->manip_max / 254;
+}
+
+AA_API int
+aa_rx_reach_map_reachable( const struct aa_rx_reach_map *m, const double E[7] )
+{
+    size_t c = rmap_cell( m, E );
+    return SIZE_MAX != c && 0 != m->cell[c];
+}
+
+AA_API double
+aa_rx_reach_map_index( const struct aa_rx_reach_map *m, const double v[3] )
+{
+    size_t vox = rmap_voxel( m, v );
+    if( SIZE_MAX == vox ) return 0;
+    const uint8_t *c = m->cell + vox*m->n_bin;
+    size_t n = 0;
+    for( size_t j = 0; j < m->n_bin; j ++ ) n += (0 != c[j]);
+    return (double)n / (double)m->n_bin;
+}
+
+/*-- Sampling --*/
+
+/* sqrt(det(J*J')) for 6 x n J, by Cholesky factorization */
+static double
+rmap_manip( size_t n, const double *J )
+{
+    double A[36];
+    for( size_t i = 0; i < 6; i ++ ) {
+        for( size_t j = 0; j <= i; j ++ ) {
+            double s = 0;
+            for( size_t k = 0; k < n; k ++ ) s += J[6*k+i] * J[6*k+j];
+            A[6*j+i] = s;
+        }
+    }
+    double det = 1;
+    for( size_t j = 0; j < 6; j ++ ) {
+        double d = A[6*j+j];
+        for( size_t k = 0; k < j; k ++ ) d -= A[6*k+j]*A[6*k+j];
+        if( !(d > 0) ) return 0;
+        double l = sqrt(d);
+        det *= l;
+        for( size_t i = j+1; i < 6; i ++ ) {
+            double s = A[6*j+i];
+            for( size_t k = 0; k < j; k ++ ) s -= A[6*k+i]*A[6*k+j];
+            A[6*j+i] = s / l;
+        }
+    }
+    return det;
+}
+
+/* splitmix64, to derive independent worker seeds from the map's seed */
+static uint64_t
+rmap_splitmix( uint64_t *x )
+{
+    uint64_t z = (*x += UINT64_C(0x9e3779b97f4a7c15));
+    z = (z ^ (z >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+    z = (z ^ (z >> 27)) * UINT64_C(0x94d049bb133111eb);
+    return z ^ (z >> 31);
+}
+
+/*
+ * Cells accumulate as the bits of a nonnegative float plus one, with
+ * zero for unreached.  Nonnegative floats order the same as their
+ * bits, so all workers can share one buffer through an atomic max.
+ */
+typedef _Atomic uint32_t rmap_acc;
+
+static uint32_t
+rmap_acc_enc( float w )
+{
+    uint32_t u;
+    memcpy( &u, &w, sizeof(u) );
+    return u + 1;
+}
+
+static float
+rmap_acc_dec( uint32_t u )
+{
+    float w;
+    u -= 1;
+    memcpy( &w, &u, sizeof(w) );
+    return w;
+}
+
+static void
+rmap_acc_max( rmap_acc *a, float w )
+{
+    uint32_t u = rmap_acc_enc( w );
+    uint32_t x = atomic_load_explicit( a, memory_order_relaxed );
+    while( u > x &&
+           !atomic_compare_exchange_weak_explicit( a, &x, u,
+                                                   memory_order_relaxed,
+                                                   memory_order_relaxed ) )
+    {}
+}
+
+struct rmap_cx {
+    const struct aa_rx_reach_map *map;
+    const struct aa_rx_sg_sub *ssg;
+    size_t n_q_all;
+    const double *q_all;
+    size_t n_samples;
+    rmap_acc *acc;              ///< shared accumulation buffer
+};
+
+struct rmap_worker_cx {
+    struct rmap_cx *cx;
+    unsigned short xsubi[3];
+};
+
+static void *
+rmap_worker( void *vwcx )
+{
+    struct rmap_worker_cx *wcx = (struct rmap_worker_cx*)vwcx;
+    struct rmap_cx *cx = wcx->cx;
+    const struct aa_rx_reach_map *map = cx->map;
+    const struct aa_rx_sg_sub *ssg = cx->ssg;
+    const struct aa_rx_sg *sg = aa_rx_sg_sub_sg(ssg);
+    size_t n_q_all = cx->n_q_all;
+    size_t n_q = aa_rx_sg_sub_config_count(ssg);
+    size_t n_f = aa_rx_sg_frame_count(sg);
+    size_t rows, cols;
+    aa_rx_sg_sub_jacobian_size( ssg, &rows, &cols );
+
+    /* Private workspace */
+    struct aa_mem_region reg;
+    aa_mem_region_init( &reg, 16*1024 );
+    double *q_all = AA_MEM_REGION_NEW_N( &reg, double, n_q_all );
+    double *q = AA_MEM_REGION_NEW_N( &reg, double, n_q );
+    double *lo = AA_MEM_REGION_NEW_N( &reg, double, n_q );
+    double *hi = AA_MEM_REGION_NEW_N( &reg, double, n_q );
+    double *TF_rel = AA_MEM_REGION_NEW_N( &reg, double, 7*n_f );
+    double *TF_abs = AA_MEM_REGION_NEW_N( &reg, double, 7*n_f );
+    double *J = AA_MEM_REGION_NEW_N( &reg, double, rows*cols );
+
+    AA_MEM_CPY( q_all, cx->q_all, n_q_all );
+    for( size_t i = 0; i < n_q; i ++ ) {
+        if( aa_rx_sg_get_limit_pos(sg, aa_rx_sg_sub_config(ssg,i), lo+i, hi+i) ) {
+            lo[i] = -M_PI;
+            hi[i] = M_PI;
+        }
+    }
+
+    /* Frames outside the chain stay fixed, so compute them once and
+     * update only the chain per sample. */
+    aa_rx_sg_tf( sg, n_q_all, q_all, n_f, TF_rel, 7, TF_abs, 7 );
+
+    for( size_t k = 0; k < cx->n_samples; k ++ ) {
+        for( size_t i = 0; i < n_q; i ++ ) {
+            q[i] = lo[i] + (hi[i] - lo[i])*erand48(wcx->xsubi);
+        }
+        aa_rx_sg_sub_config_set( ssg, n_q, q, n_q_all, q_all );
+        aa_rx_sg_sub_tf( ssg, n_q_all, q_all, n_f, TF_abs, 7 );
+
+        size_t c = rmap_cell( map, TF_abs + 7*map->frame );
+        if( SIZE_MAX == c ) continue;
+
+        aa_rx_sg_sub_jacobian( ssg, n_f, TF_abs, 7, J, rows );
+        rmap_acc_max( cx->acc + c, (float)rmap_manip( cols, J ) );
+    }
+
+    aa_mem_region_destroy( &reg );
+    return NULL;
+}
+
+AA_API int
+aa_rx_reach_map_sample( struct aa_rx_reach_map *map,
+                        const struct aa_rx_sg_sub *ssg,
+                        size_t n_q_all, const double *q_all,
+                        size_t n_threads, size_t n_samples )
+{
+    const struct aa_rx_sg *sg = aa_rx_sg_sub_sg(ssg);
+    aa_rx_frame_id frame = aa_rx_sg_sub_frame_ee(ssg);
+    if( 1 != aa_rx_sg_sub_ee_count(ssg) ||
+        n_q_all != aa_rx_sg_config_count(sg) ||
+        (AA_RX_FRAME_NONE != map->frame && frame != map->frame) )
+    {
+        return AA_RX_INVALID_PARAMETER;
+    }
+
+    if( 0 == n_threads ) {
+        long n_cpu = sysconf(_SC_NPROCESSORS_ONLN);
+        n_threads = (n_cpu > 0) ? (size_t)n_cpu : 1;
+    }
+    n_threads = AA_MAX( (size_t)1, AA_MIN(n_threads, n_samples) );
+
+    /* Start from the current cells */
+    rmap_acc *acc = (rmap_acc*)malloc( map->n_cell * sizeof(*acc) );
+    struct rmap_worker_cx *wcx = AA_NEW_AR( struct rmap_worker_cx, n_threads );
+    pthread_t *threads = AA_NEW_AR( pthread_t, n_threads );
+    if( NULL == acc || NULL == wcx || NULL == threads ) {
+        free( acc );
+        free( wcx );
+        free( threads );
+        return AA_RX_INVALID_PARAMETER;
+    }
+    map->frame = frame;
+    for( size_t c = 0; c < map->n_cell; c ++ ) {
+        atomic_init( acc + c,
+                     map->cell[c]
+                     ? rmap_acc_enc( (float)((map->cell[c] - 1) * map->manip_max / 254) )
+                     : 0 );
+    }
+
+    struct rmap_cx cx;
+    cx.map = map;
+    cx.ssg = ssg;
+    cx.n_q_all = n_q_all;
+    cx.q_all = q_all;
+    cx.n_samples = (n_samples + n_threads - 1) / n_threads;
+    cx.acc = acc;
+
+    for( size_t j = 0; j < n_threads; j ++ ) {
+        uint64_t x = rmap_splitmix( &map->rng );
+        wcx[j].cx = &cx;
+        wcx[j].xsubi[0] = (unsigned short)x;
+        wcx[j].xsubi[1] = (unsigned short)(x >> 16);
+        wcx[j].xsubi[2] = (unsigned short)(x >> 32);
+    }
+
+    size_t n_started = 0;
+    for( ; n_started < n_threads; n_started ++ ) {
+        if( pthread_create( threads + n_started, NULL, rmap_worker, wcx + n_started ) ) {
+            break;
+        }
+    }
+    if( 0 == n_started ) {
+        /* No threads, sample here */
+        cx.n_samples = n_samples;
+        rmap_worker( wcx );
+    }
+    for( size_t j = 0; j < n_started; j ++ ) {
+        pthread_join( threads[j], NULL );
+    }
+
+    /* Quantize */
+    double w_max = 0;
+    for( size_t c = 0; c < map->n_cell; c ++ ) {
+        uint32_t u = atomic_load_explicit( acc + c, memory_order_relaxed );
+        if( u ) w_max = AA_MAX( w_max, (double)rmap_acc_dec(u) );
+    }
+    map->manip_max = w_max;
+    for( size_t c = 0; c < map->n_cell; c ++ ) {
+        uint32_t u = atomic_load_explicit( acc + c, memory_order_relaxed );
+        if( 0 == u ) {
+            map->cell[c] = 0;
+        } else {
+            double x = (w_max > 0) ? 254 * rmap_acc_dec(u) / w_max : 0;
+            map->cell[c] = (uint8_t)(1 + AA_MIN( 254, (int)lround(x) ));
+        }
+    }
+
+    free( acc );
+    free( wcx );
+    free( threads );
+    return 0;
+}
+
+/*-- Persistence --*/
+
+AA_API int
+aa_rx_reach_map_write( const struct aa_rx_reach_map *m, FILE *out )
+{
+    uint64_t hdr[5] = { m->dim[0], m->dim[1], m->dim[2], m->n_side,
+                        (uint64_t)(int64_t)m->frame };
+    double param[5] = { m->min[0], m->min[1], m->min[2],
+                        m->resolution, m->manip_max };
+    int ok =
+        1 == fwrite( rmap_magic, sizeof(rmap_magic), 1, out ) &&
+        1 == fwrite( hdr, sizeof(hdr), 1, out ) &&
+        1 == fwrite( param, sizeof(param), 1, out ) &&
+        m->n_cell == fwrite( m->cell, 1, m->n_cell, out );
+    return ok ? 0 : AA_RX_INVALID_PARAMETER;
+}
+
+AA_API struct aa_rx_reach_map *
+aa_rx_reach_map_read( FILE *in )
+{
+    char magic[sizeof(rmap_magic)];
+    uint64_t hdr[5];
+    double param[5];
+    if( 1 != fread( magic, sizeof(magic), 1, in ) ||
+        0 != memcmp( magic, rmap_magic, sizeof(magic) ) ||
+        1 != fread( hdr, sizeof(hdr), 1, in ) ||
+        1 != fread( param, sizeof(param), 1, in ) ||
+        !(param[3] > 0) || 0 == hdr[3] )
+    {
+        return NULL;
+    }
+
+    double max[3];
+    for( size_t i = 0; i < 3; i ++ ) {
+        /* Center of the last voxel, to recover the same dimensions */
+        max[i] = param[i] + ((double)hdr[i] - .5) * param[3];
+    }
+    struct aa_rx_reach_map *m = aa_rx_reach_map_create( param, max, param[3], (size_t)hdr[3] );
+    if( NULL == m ) return NULL;
+    m->frame = (aa_rx_frame_id)(int64_t)hdr[4];
+    m->manip_max = param[4];
+    if( m->dim[0] != hdr[0] || m->dim[1] != hdr[1] || m->dim[2] != hdr[2] ||
+        m->n_cell != fread( m->cell, 1, m->n_cell, in ) )
+    {
+        aa_rx_reach_map_destroy( m );
+        return NULL;
+    }
+    return m;
+}
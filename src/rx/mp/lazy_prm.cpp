@@ -0,0 +1,452 @@
+/* -*- mode: C++; c-basic-offset: 4; -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2015, Rice University
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@rice.edu>
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of copyright holder the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <vector>
+
+#include "amino.h"
+#include "amino/rx/rxerr.h"
+#include "amino/rx/rxtype.h"
+#include "amino/rx/scenegraph.h"
+#include "amino/rx/scenegraph_internal.h"
+#include "amino/rx/scene_sub.h"
+#include "amino/rx/scene_collision.h"
+#include "amino/rx/scene_planning.h"
+
+#include "amino/rx/ompl/scene_state_space.h"
+#include "amino/rx/ompl/scene_ompl_internal.h"
+#include "amino/rx/ompl/scene_native_prm.h"
+
+struct aa_rx_mp_prm_attr
+{
+    size_t n_neighbors;
+};
+
+AA_API struct aa_rx_mp_prm_attr*
+aa_rx_mp_prm_attr_create(void)
+{
+    struct aa_rx_mp_prm_attr * a = AA_NEW(struct aa_rx_mp_prm_attr);
+    a->n_neighbors = 10;
+    return a;
+}
+
+AA_API void
+aa_rx_mp_prm_attr_destroy(struct aa_rx_mp_prm_attr* a)
+{
+    free(a);
+}
+
+AA_API void
+aa_rx_mp_prm_attr_set_neighbors( struct aa_rx_mp_prm_attr* attrs,
+                                 size_t n_neighbors )
+{
+    attrs->n_neighbors = n_neighbors;
+}
+
+
+/*
+ * The roadmap keeps its own collision contexts.  Invalid nodes and
+ * edges record the first colliding frame pair as their blocker.
+ * Before each query, the roadmap compares the scene against a
+ * snapshot of frame geometry versions, allowed collisions, and the
+ * configuration outside the sub-scenegraph:
+ *
+ * - Changed geometry makes valid results stale and reopens invalid
+ *   results blocked by a changed frame.  Stale results are rechecked
+ *   only against pairs involving the changed frames.
+ *
+ * - Newly allowed collisions reopen invalid results they blocked.
+ *
+ * - Anything else discards all results.
+ */
+struct aa_rx_mp_roadmap {
+    aa_rx_mp_roadmap( struct aa_rx_mp *mp, size_t n_neighbors );
+    ~aa_rx_mp_roadmap();
+
+    void snapshot();
+    void sync();
+    void set_prm( amino::sgLazyPRM *p );
+    bool check( struct aa_rx_cl *c, const double *q );
+
+    struct aa_rx_mp *mp;
+    amino::sgStateSpace *ss;
+    amino::sgLazyPRM *prm;
+    size_t n_neighbors;
+
+    struct aa_rx_cl *cl;
+    struct aa_rx_cl *cl_changed;
+    struct aa_rx_cl_set *cl_set;
+    struct aa_rx_cl_set *allowed;
+    struct aa_rx_cl_set *allowed_new;
+
+    std::vector<uint64_t> versions;
+    std::vector<char> changed;
+    std::vector<double> q_all;
+    std::vector<double> q_fixed;
+    bool have_config;
+
+    const amino::sgNativeProblem *query;
+    uint64_t blocker;
+};
+
+static inline uint64_t
+blocker_pair( aa_rx_frame_id i, aa_rx_frame_id j )
+{
+    /* Zero means an unknown blocker */
+    return 1 + (((uint64_t)i << 32) | (uint64_t)(uint32_t)j);
+}
+
+static inline void
+blocker_frames( uint64_t b, aa_rx_frame_id *i, aa_rx_frame_id *j )
+{
+    b -= 1;
+    *i = (aa_rx_frame_id)(b >> 32);
+    *j = (aa_rx_frame_id)(uint32_t)b;
+}
+
+aa_rx_mp_roadmap::aa_rx_mp_roadmap( struct aa_rx_mp *mp_, size_t n_neighbors_ ) :
+    mp(mp_),
+    ss(mp_->space_information->getTypedStateSpace()),
+    prm(NULL),
+    n_neighbors(n_neighbors_),
+    cl(NULL),
+    cl_changed(NULL),
+    cl_set(aa_rx_cl_set_create(ss->scene_graph)),
+    allowed(aa_rx_cl_set_create(ss->scene_graph)),
+    allowed_new(aa_rx_cl_set_create(ss->scene_graph)),
+    query(NULL),
+    blocker(0)
+{
+    const ompl::base::RealVectorBounds &b = ss->getBounds();
+    set_prm( new amino::sgLazyPRM( ss->config_count_subset(),
+                                   b.low.data(), b.high.data() ) );
+}
+
+aa_rx_mp_roadmap::~aa_rx_mp_roadmap()
+{
+    delete prm;
+    if( cl ) aa_rx_cl_destroy(cl);
+    if( cl_changed ) aa_rx_cl_destroy(cl_changed);
+    aa_rx_cl_set_destroy(cl_set);
+    aa_rx_cl_set_destroy(allowed);
+    aa_rx_cl_set_destroy(allowed_new);
+}
+
+void
+aa_rx_mp_roadmap::set_prm( amino::sgLazyPRM *p )
+{
+    delete prm;
+    prm = p;
+    prm->set_neighbors(n_neighbors);
+    snapshot();
+}
+
+/* Take the current scene as the reference for validity results */
+void
+aa_rx_mp_roadmap::snapshot()
+{
+    const struct aa_rx_sg *sg = ss->scene_graph;
+    size_t n_f = ss->frame_count();
+    size_t n_all = ss->config_count_all();
+
+    versions.resize(n_f);
+    changed.assign(n_f, 0);
+    for( size_t i = 0; i < n_f; i ++ ) {
+        versions[i] = aa_rx_sg_frame_geom_version(sg, (aa_rx_frame_id)i);
+    }
+
+    aa_rx_cl_set_clear(allowed);
+    aa_rx_cl_set_fill(allowed, ss->allowed);
+
+    q_all.assign(n_all, 0);
+    have_config = (NULL != mp->config_start);
+    if( mp->config_start ) {
+        AA_MEM_CPY( q_all.data(), mp->config_start, n_all );
+    }
+    q_fixed = q_all;
+    std::vector<double> zero(ss->config_count_subset(), 0);
+    ss->insert_state( zero.data(), q_fixed.data() );
+
+    if( cl ) aa_rx_cl_destroy(cl);
+    cl = aa_rx_cl_create(sg);
+    aa_rx_cl_allow_set(cl, allowed);
+
+    if( cl_changed ) aa_rx_cl_destroy(cl_changed);
+    cl_changed = NULL;
+}
+
+static bool
+affected( void *cx, uint64_t blocker )
+{
+    struct aa_rx_mp_roadmap *rm = (struct aa_rx_mp_roadmap*)cx;
+    if( 0 == blocker ) return true;
+    aa_rx_frame_id i, j;
+    blocker_frames( blocker, &i, &j );
+    return rm->changed[(size_t)i] || rm->changed[(size_t)j] ||
+        aa_rx_cl_set_get(rm->allowed_new, i, j);
+}
+
+/* Update validity results for changes to the scene */
+void
+aa_rx_mp_roadmap::sync()
+{
+    const struct aa_rx_sg *sg = ss->scene_graph;
+    size_t n_f = ss->frame_count();
+    size_t n_all = ss->config_count_all();
+
+    /* Configuration outside the sub-scenegraph */
+    std::vector<double> q(n_all, 0);
+    if( mp->config_start ) {
+        AA_MEM_CPY( q.data(), mp->config_start, n_all );
+    }
+    std::vector<double> zero(ss->config_count_subset(), 0);
+    ss->insert_state( zero.data(), q.data() );
+    bool reset = have_config && (q != q_fixed);
+    if( !have_config && mp->config_start ) {
+        /* First start configuration, e.g., after reading a roadmap */
+        AA_MEM_CPY( q_all.data(), mp->config_start, n_all );
+        q_fixed = q;
+        have_config = true;
+    }
+
+    /* Allowed collisions */
+    bool more_allowed = false;
+    aa_rx_cl_set_clear(allowed_new);
+    for( size_t i = 0; !reset && i < n_f; i ++ ) {
+        for( size_t j = 0; j < i; j ++ ) {
+            int a0 = aa_rx_cl_set_get(allowed, (aa_rx_frame_id)i, (aa_rx_frame_id)j);
+            int a1 = aa_rx_cl_set_get(ss->allowed, (aa_rx_frame_id)i, (aa_rx_frame_id)j);
+            if( a0 && !a1 ) {
+                reset = true;
+            } else if( a1 && !a0 ) {
+                more_allowed = true;
+                aa_rx_cl_set_set(allowed_new, (aa_rx_frame_id)i, (aa_rx_frame_id)j, 1);
+            }
+        }
+    }
+
+    if( reset ) {
+        prm->invalidate_all();
+        snapshot();
+        return;
+    }
+
+    /* Geometry */
+    bool geom_changed = false;
+    std::vector<char> frames_changed(n_f, 0);
+    for( size_t i = 0; i < n_f; i ++ ) {
+        uint64_t v = aa_rx_sg_frame_geom_version(sg, (aa_rx_frame_id)i);
+        if( v != versions[i] ) {
+            frames_changed[i] = 1;
+            geom_changed = true;
+        }
+    }
+
+    if( !geom_changed && !more_allowed ) return;
+
+    if( geom_changed ) {
+        changed = frames_changed;
+        prm->invalidate( affected, this );
+    } else {
+        /* Stale results still refer to the previously changed frames */
+        frames_changed = changed;
+        changed.assign(n_f, 0);
+        prm->reopen_invalid( affected, this );
+    }
+
+    /* Refresh reference state and collision contexts */
+    snapshot();
+    changed = frames_changed;
+
+    bool any_changed = false;
+    for( char c : changed ) any_changed = any_changed || c;
+    if( any_changed ) {
+        cl_changed = aa_rx_cl_create(sg);
+        aa_rx_cl_allow_set(cl_changed, allowed);
+        for( size_t i = 0; i < n_f; i ++ ) {
+            if( changed[i] ) continue;
+            for( size_t j = 0; j < i; j ++ ) {
+                if( !changed[j] ) {
+                    aa_rx_cl_allow(cl_changed, (aa_rx_frame_id)i, (aa_rx_frame_id)j, 1);
+                }
+            }
+        }
+    }
+}
+
+bool
+aa_rx_mp_roadmap::check( struct aa_rx_cl *c, const double *q )
+{
+    size_t n_f = ss->frame_count();
+    double *TF_abs = ss->get_tf_abs(q, q_all.data());
+    int is_collision = aa_rx_cl_check( c, n_f, TF_abs, 7, NULL );
+    if( is_collision ) {
+        /* Record the first colliding pair */
+        aa_rx_cl_set_clear(cl_set);
+        aa_rx_cl_check( c, n_f, TF_abs, 7, cl_set );
+        blocker = 0;
+        for( size_t i = 0; 0 == blocker && i < n_f; i ++ ) {
+            for( size_t j = 0; j < i; j ++ ) {
+                if( aa_rx_cl_set_get(cl_set, (aa_rx_frame_id)i, (aa_rx_frame_id)j) ) {
+                    blocker = blocker_pair( (aa_rx_frame_id)i, (aa_rx_frame_id)j );
+                    break;
+                }
+            }
+        }
+    }
+    ss->region_pop(TF_abs);
+    return !is_collision;
+}
+
+static bool
+roadmap_is_valid( void *cx, const double *q )
+{
+    struct aa_rx_mp_roadmap *rm = (struct aa_rx_mp_roadmap*)cx;
+    return rm->check( rm->cl, q );
+}
+
+static bool
+roadmap_is_valid_changed( void *cx, const double *q )
+{
+    struct aa_rx_mp_roadmap *rm = (struct aa_rx_mp_roadmap*)cx;
+    return rm->check( rm->cl_changed ? rm->cl_changed : rm->cl, q );
+}
+
+static uint64_t
+roadmap_blocker( void *cx )
+{
+    return ((struct aa_rx_mp_roadmap*)cx)->blocker;
+}
+
+static int
+roadmap_next_goal( void *cx, double *q )
+{
+    const amino::sgNativeProblem *p = ((struct aa_rx_mp_roadmap*)cx)->query;
+    return p->next_goal( p->cx, q );
+}
+
+static bool
+roadmap_is_cancelled( void *cx )
+{
+    const amino::sgNativeProblem *p = ((struct aa_rx_mp_roadmap*)cx)->query;
+    return p->is_cancelled && p->is_cancelled( p->cx );
+}
+
+int
+aa_rx_mp_roadmap_solve( struct aa_rx_mp_roadmap *rm,
+                        const amino::sgNativeProblem *prob,
+                        double timeout, std::vector<double> &path )
+{
+    rm->sync();
+
+    amino::sgRoadmapProblem rp;
+    rp.cx = rm;
+    rp.is_valid = roadmap_is_valid;
+    rp.next_goal = roadmap_next_goal;
+    rp.is_cancelled = roadmap_is_cancelled;
+    rp.n_start = prob->n_start;
+    rp.start = prob->start;
+    rp.is_valid_changed = roadmap_is_valid_changed;
+    rp.blocker = roadmap_blocker;
+
+    rm->query = prob;
+    int r = rm->prm->solve( &rp, timeout, path );
+    rm->query = NULL;
+    return r;
+}
+
+void
+aa_rx_mp_roadmap_destroy( struct aa_rx_mp_roadmap *rm )
+{
+    delete rm;
+}
+
+
+AA_API void
+aa_rx_mp_set_lazy_prm( struct aa_rx_mp* mp,
+                       const struct aa_rx_mp_prm_attr *attr )
+{
+    struct aa_rx_mp_prm_attr *default_attr = NULL;
+    if( NULL == attr ) {
+        default_attr = aa_rx_mp_prm_attr_create();
+        attr = default_attr;
+    }
+
+    mp->set_planner(NULL);
+    mp->set_roadmap( new aa_rx_mp_roadmap(mp, attr->n_neighbors) );
+
+    if( default_attr ) {
+        aa_rx_mp_prm_attr_destroy(default_attr);
+    }
+}
+
+AA_API int
+aa_rx_mp_prm_grow( struct aa_rx_mp* mp, size_t n_nodes )
+{
+    if( NULL == mp->roadmap ) return AA_RX_INVALID_PARAMETER;
+    mp->roadmap->prm->grow(n_nodes);
+    return AA_RX_OK;
+}
+
+AA_API size_t
+aa_rx_mp_prm_node_count( const struct aa_rx_mp* mp )
+{
+    return mp->roadmap ? mp->roadmap->prm->node_count() : 0;
+}
+
+AA_API int
+aa_rx_mp_prm_write( const struct aa_rx_mp* mp, FILE *out )
+{
+    if( NULL == mp->roadmap ) return AA_RX_INVALID_PARAMETER;
+    return mp->roadmap->prm->write(out);
+}
+
+AA_API int
+aa_rx_mp_prm_read( struct aa_rx_mp* mp, FILE *in )
+{
+    if( NULL == mp->roadmap ) return AA_RX_INVALID_PARAMETER;
+    amino::sgStateSpace *ss = mp->roadmap->ss;
+    const ompl::base::RealVectorBounds &b = ss->getBounds();
+    amino::sgLazyPRM *p = amino::sgLazyPRM::read( in, ss->config_count_subset(),
+                                                  b.low.data(), b.high.data() );
+    if( NULL == p ) return AA_RX_INVALID_PARAMETER;
+
+    /* The file does not identify the scene its results were checked
+     * against */
+    p->invalidate_all();
+    mp->roadmap->set_prm(p);
+    return AA_RX_OK;
+}
@@ -0,0 +1,346 @@
+/* -*- mode: C++; c-basic-offset: 4; -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2015, Rice University
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@rice.edu>
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of copyright holder the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include "amino.h"
+#include "amino/rx/ompl/scene_native_path.h"
+
+namespace amino {
+
+static double
+now_sec()
+{
+    return aa_tm_timespec2sec( aa_tm_now() );
+}
+
+double
+sgPathLength( size_t n_q, const std::vector<double> &path )
+{
+    double d = 0;
+    for( size_t j = n_q; j < path.size(); j += n_q ) {
+        d += sqrt( aa_la_ssd(n_q, &path[j-n_q], &path[j]) );
+    }
+    return d;
+}
+
+namespace {
+
+struct Shortcut {
+    double s0, s1;              ///< arc lengths of the endpoints
+    double gain;                ///< reduction in length
+    std::vector<double> q0, q1; ///< endpoint configurations
+    bool valid;
+};
+
+/* Path with cumulative arc length */
+struct ArcPath {
+    ArcPath( size_t n_q_, const std::vector<double> &path_ ) :
+        n_q(n_q_), path(path_), s(path_.size() / n_q_)
+    {
+        s[0] = 0;
+        for( size_t i = 1; i < s.size(); i ++ ) {
+            s[i] = s[i-1] + sqrt( aa_la_ssd(n_q, &path[(i-1)*n_q], &path[i*n_q]) );
+        }
+    }
+
+    double length() const { return s.back(); }
+
+    /* Configuration at arc length t */
+    void at( double t, double *q ) const {
+        size_t i = (size_t)(std::upper_bound(s.begin(), s.end(), t) - s.begin());
+        if( i >= s.size() ) {
+            AA_MEM_CPY( q, &path[(s.size()-1)*n_q], n_q );
+            return;
+        }
+        if( 0 == i ) i = 1;
+        double ds = s[i] - s[i-1];
+        double u = (ds > 0) ? (t - s[i-1]) / ds : 0;
+        const double *qa = &path[(i-1)*n_q], *qb = &path[i*n_q];
+        for( size_t d = 0; d < n_q; d ++ ) {
+            q[d] = qa[d] + u*(qb[d] - qa[d]);
+        }
+    }
+
+    size_t n_q;
+    const std::vector<double> &path;
+    std::vector<double> s;
+};
+
+bool
+check_segment( const sgPathProblem *prob, size_t thread, size_t n_q,
+               double resolution, const double *q0, const double *q1 )
+{
+    double q[n_q];
+    double d = sqrt( aa_la_ssd(n_q, q0, q1) );
+    size_t n_steps = (size_t)ceil( d / resolution );
+    if( 0 == n_steps ) n_steps = 1;
+    for( size_t j = 0; j <= n_steps; j ++ ) {
+        double u = (double)j / (double)n_steps;
+        for( size_t i = 0; i < n_q; i ++ ) {
+            q[i] = q0[i] + u*(q1[i] - q0[i]);
+        }
+        if( ! prob->is_valid(prob->cx, thread, q) ) return false;
+    }
+    return true;
+}
+
+void
+check_batch( const sgPathProblem *prob, size_t thread, size_t n_q,
+             double resolution, double t_end,
+             std::vector<Shortcut> *batch, std::atomic<size_t> *next )
+{
+    for( size_t k = (*next)++; k < batch->size(); k = (*next)++ ) {
+        Shortcut &c = (*batch)[k];
+        c.valid = (now_sec() < t_end) &&
+            check_segment( prob, thread, n_q, resolution, c.q0.data(), c.q1.data() );
+    }
+}
+
+struct Smooth {
+    size_t i;                   ///< waypoint index
+    std::vector<double> q;      ///< smoothed configuration
+    bool valid;
+};
+
+void
+check_smooth( const sgPathProblem *prob, size_t thread, size_t n_q,
+              double resolution, double t_end, const std::vector<double> *path,
+              std::vector<Smooth> *batch, std::atomic<size_t> *next )
+{
+    for( size_t k = (*next)++; k < batch->size(); k = (*next)++ ) {
+        Smooth &c = (*batch)[k];
+        const double *q = &(*path)[c.i*n_q];
+        c.valid = (now_sec() < t_end) &&
+            check_segment( prob, thread, n_q, resolution, q - n_q, c.q.data() ) &&
+            check_segment( prob, thread, n_q, resolution, c.q.data(), q + n_q );
+    }
+}
+
+void
+check_path( const sgPathProblem *prob, size_t thread, size_t n_q,
+            double resolution, const std::vector<double> *path,
+            std::vector<char> *valid, std::atomic<size_t> *next )
+{
+    for( size_t k = (*next)++; k < valid->size(); k = (*next)++ ) {
+        (*valid)[k] = check_segment( prob, thread, n_q, resolution,
+                                     &(*path)[k*n_q], &(*path)[(k+1)*n_q] );
+    }
+}
+
+} /* namespace */
+
+size_t
+sgPathCheck( const sgPathProblem *prob, size_t n_q, double resolution,
+             const std::vector<double> &path, std::vector<char> &valid )
+{
+    size_t n_seg = path.size() / n_q;
+    n_seg = (n_seg > 0) ? n_seg - 1 : 0;
+    valid.assign( n_seg, 0 );
+
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> threads;
+    for( size_t t = 1; t < prob->n_threads && t < n_seg; t ++ ) {
+        threads.push_back( std::thread( check_path, prob, t, n_q, resolution,
+                                        &path, &valid, &next ) );
+    }
+    check_path( prob, 0, n_q, resolution, &path, &valid, &next );
+    for( auto &t : threads ) t.join();
+
+    return (size_t)std::count( valid.begin(), valid.end(), 0 );
+}
+
+size_t
+sgPathShortcut( const sgPathProblem *prob, size_t n_q, double resolution,
+                double t_end, unsigned seed, std::vector<double> &path )
+{
+    unsigned short xsubi[3] = { 0x330e, (unsigned short)seed, (unsigned short)(seed >> 16) };
+    size_t n_threads = AA_MAX( (size_t)1, prob->n_threads );
+    size_t n_batch = 4 * n_threads;
+    size_t n_applied = 0;
+    size_t n_stall = 0;
+
+    while( n_stall < 3 && now_sec() < t_end && path.size() / n_q >= 3 ) {
+        ArcPath arc( n_q, path );
+        double len = arc.length();
+        double min_gain = 1e-6 * len;
+
+        /* Draw candidate shortcuts */
+        std::vector<Shortcut> batch;
+        for( size_t k = 0; k < n_batch; k ++ ) {
+            Shortcut c;
+            c.s0 = len * erand48(xsubi);
+            c.s1 = len * erand48(xsubi);
+            if( c.s0 > c.s1 ) std::swap( c.s0, c.s1 );
+            c.q0.resize(n_q);
+            c.q1.resize(n_q);
+            arc.at( c.s0, c.q0.data() );
+            arc.at( c.s1, c.q1.data() );
+            c.gain = (c.s1 - c.s0) - sqrt( aa_la_ssd(n_q, c.q0.data(), c.q1.data()) );
+            c.valid = false;
+            if( c.gain > min_gain ) batch.push_back(c);
+        }
+        std::sort( batch.begin(), batch.end(),
+                   []( const Shortcut &a, const Shortcut &b ) { return a.gain > b.gain; } );
+
+        /* Check candidates in parallel */
+        std::atomic<size_t> next(0);
+        std::vector<std::thread> threads;
+        for( size_t t = 1; t < n_threads && t < batch.size(); t ++ ) {
+            try {
+                threads.push_back( std::thread( check_batch, prob, t, n_q, resolution, t_end,
+                                                &batch, &next ) );
+            } catch(...) {
+                break;
+            }
+        }
+        check_batch( prob, 0, n_q, resolution, t_end, &batch, &next );
+        for( auto &t : threads ) t.join();
+
+        /* Apply non-overlapping shortcuts, largest gain first */
+        std::vector<const Shortcut*> accepted;
+        double gain = 0;
+        for( const Shortcut &c : batch ) {
+            if( !c.valid ) continue;
+            bool overlap = false;
+            for( const Shortcut *a : accepted ) {
+                overlap = overlap || (c.s0 <= a->s1 && a->s0 <= c.s1);
+            }
+            if( !overlap ) {
+                accepted.push_back(&c);
+                gain += c.gain;
+            }
+        }
+        std::sort( accepted.begin(), accepted.end(),
+                   []( const Shortcut *a, const Shortcut *b ) { return a->s0 < b->s0; } );
+
+        if( !accepted.empty() ) {
+            std::vector<double> out;
+            size_t n_pts = arc.s.size();
+            size_t i = 0;
+            for( const Shortcut *c : accepted ) {
+                for( ; i < n_pts && arc.s[i] < c->s0; i ++ ) {
+                    out.insert( out.end(), &path[i*n_q], &path[(i+1)*n_q] );
+                }
+                out.insert( out.end(), c->q0.begin(), c->q0.end() );
+                out.insert( out.end(), c->q1.begin(), c->q1.end() );
+                for( ; i < n_pts && arc.s[i] <= c->s1; i ++ );
+            }
+            for( ; i < n_pts; i ++ ) {
+                out.insert( out.end(), &path[i*n_q], &path[(i+1)*n_q] );
+            }
+            path.swap(out);
+            n_applied += accepted.size();
+        }
+
+        n_stall = (gain > 1e-4 * len) ? 0 : n_stall + 1;
+    }
+
+    return n_applied;
+}
+
+size_t
+sgPathSmooth( const sgPathProblem *prob, size_t n_q, double resolution,
+              double t_end, size_t max_steps, double min_change,
+              std::vector<double> &path )
+{
+    size_t n_threads = AA_MAX( (size_t)1, prob->n_threads );
+    size_t n_moved = 0;
+
+    for( size_t step = 0; step < max_steps && now_sec() < t_end; step ++ ) {
+        /* Subdivide */
+        size_t n_pts = path.size() / n_q;
+        if( n_pts < 2 ) break;
+        std::vector<double> sub;
+        sub.reserve( (2*n_pts - 1) * n_q );
+        for( size_t i = 0; i + 1 < n_pts; i ++ ) {
+            const double *qa = &path[i*n_q], *qb = &path[(i+1)*n_q];
+            sub.insert( sub.end(), qa, qa + n_q );
+            for( size_t d = 0; d < n_q; d ++ ) sub.push_back( .5*(qa[d] + qb[d]) );
+        }
+        sub.insert( sub.end(), path.end() - (ssize_t)n_q, path.end() );
+        path.swap( sub );
+        n_pts = path.size() / n_q;
+
+        /* Candidates at every other waypoint, whose neighbors stay fixed */
+        std::vector<Smooth> batch;
+        for( size_t i = 2; i + 1 < n_pts; i += 2 ) {
+            const double *q = &path[i*n_q];
+            const double *qa = q - n_q, *qb = q + n_q;
+            Smooth c;
+            c.i = i;
+            c.q.resize(n_q);
+            for( size_t d = 0; d < n_q; d ++ ) {
+                c.q[d] = .25 * ( qa[d] + 2*q[d] + qb[d] );
+            }
+            c.valid = false;
+            if( sqrt(aa_la_ssd(n_q, q, c.q.data())) > min_change ) batch.push_back(c);
+        }
+
+        /* Check candidates in parallel */
+        std::atomic<size_t> next(0);
+        std::vector<std::thread> threads;
+        for( size_t t = 1; t < n_threads && t < batch.size(); t ++ ) {
+            try {
+                threads.push_back( std::thread( check_smooth, prob, t, n_q, resolution, t_end,
+                                                &path, &batch, &next ) );
+            } catch(...) {
+                break;
+            }
+        }
+        check_smooth( prob, 0, n_q, resolution, t_end, &path, &batch, &next );
+        for( auto &t : threads ) t.join();
+
+        size_t n = 0;
+        for( const Smooth &c : batch ) {
+            if( c.valid ) {
+                std::copy( c.q.begin(), c.q.end(), path.begin() + (ssize_t)(c.i*n_q) );
+                n++;
+            }
+        }
+        n_moved += n;
+        if( 0 == n ) break;
+    }
+
+    return n_moved;
+}
+
+} /* namespace amino */
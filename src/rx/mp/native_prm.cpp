@@ -0,0 +1,451 @@
+/* -*- mode: C++; c-basic-offset: 4; -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2015, Rice University
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@rice.edu>
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of copyright holder the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <queue>
+#include <time.h>
+
+#include "amino.h"
+#include "amino/rx/ompl/scene_native_prm.h"
+
+namespace amino {
+
+static double
+now_sec()
+{
+    return aa_tm_timespec2sec( aa_tm_now() );
+}
+
+sgLazyPRM::sgLazyPRM( size_t n_q_, const double *lo_, const double *hi_ ) :
+    n_q(n_q_),
+    k(10),
+    prob(NULL),
+    tree(n_q_, &reg)
+{
+    aa_mem_region_init( &reg, 64*1024 );
+    lo = AA_MEM_REGION_NEW_N( &reg, double, n_q );
+    hi = AA_MEM_REGION_NEW_N( &reg, double, n_q );
+    q_a = AA_MEM_REGION_NEW_N( &reg, double, n_q );
+    q_b = AA_MEM_REGION_NEW_N( &reg, double, n_q );
+    q_tmp = AA_MEM_REGION_NEW_N( &reg, double, n_q );
+    AA_MEM_CPY( lo, lo_, n_q );
+    AA_MEM_CPY( hi, hi_, n_q );
+
+    resolution = .01 * sqrt( aa_la_ssd(n_q, lo, hi) );
+
+    set_seed( (unsigned)rand() );
+}
+
+sgLazyPRM::~sgLazyPRM()
+{
+    aa_mem_region_destroy( &reg );
+}
+
+void
+sgLazyPRM::set_seed( unsigned seed )
+{
+    xsubi[0] = 0x330e;
+    xsubi[1] = (unsigned short)seed;
+    xsubi[2] = (unsigned short)(seed >> 16);
+}
+
+void
+sgLazyPRM::add_edge( size_t a, size_t b, double length )
+{
+    Edge e;
+    e.a = a;
+    e.b = b;
+    e.length = length;
+    e.blocker = 0;
+    e.validity = UNKNOWN;
+    nodes[a].edges.push_back(edges.size());
+    nodes[b].edges.push_back(edges.size());
+    edges.push_back(e);
+}
+
+size_t
+sgLazyPRM::add_node( const double *q )
+{
+    size_t idx[k+1];
+    double d2[k+1];
+    size_t n_near = tree.nearest_k( q, k, idx, d2 );
+
+    size_t i = tree.add( q, sgNNTree::NONE );
+    Node node;
+    node.blocker = 0;
+    node.validity = UNKNOWN;
+    nodes.push_back(node);
+
+    for( size_t j = 0; j < n_near; j ++ ) {
+        add_edge( idx[j], i, sqrt(d2[j]) );
+    }
+    return i;
+}
+
+void
+sgLazyPRM::grow( size_t n )
+{
+    for( size_t j = 0; j < n; j ++ ) {
+        for( size_t i = 0; i < n_q; i ++ ) {
+            q_tmp[i] = lo[i] + (hi[i] - lo[i]) * erand48(xsubi);
+        }
+        add_node( q_tmp );
+    }
+}
+
+size_t
+sgLazyPRM::find_or_add( const double *q )
+{
+    double d2;
+    size_t i = tree.nearest( q, &d2 );
+    return (sgNNTree::NONE != i && 0 == d2) ? i : add_node(q);
+}
+
+bool
+sgLazyPRM::check_config( const double *q, bool stale, uint64_t *blocker )
+{
+    bool valid = (stale && prob->is_valid_changed) ?
+        prob->is_valid_changed( prob->cx, q ) :
+        prob->is_valid( prob->cx, q );
+    if( !valid ) {
+        *blocker = prob->blocker ? prob->blocker( prob->cx ) : 0;
+    }
+    return valid;
+}
+
+bool
+sgLazyPRM::check_node( size_t i )
+{
+    Node &node = nodes[i];
+    switch( node.validity ) {
+    case VALID: return true;
+    case INVALID: return false;
+    }
+
+    tree.get( i, q_a );
+    bool valid = check_config( q_a, STALE == node.validity, &node.blocker );
+    node.validity = valid ? VALID : INVALID;
+    return valid;
+}
+
+bool
+sgLazyPRM::check_edge( size_t i )
+{
+    Edge &e = edges[i];
+    switch( e.validity ) {
+    case VALID: return true;
+    case INVALID: return false;
+    }
+
+    /* Endpoints are checked as nodes */
+    bool stale = (STALE == e.validity);
+    tree.get( e.a, q_a );
+    tree.get( e.b, q_b );
+    size_t n_steps = (size_t)ceil( e.length / resolution );
+    bool valid = true;
+    for( size_t j = 1; valid && j < n_steps; j ++ ) {
+        double s = (double)j / (double)n_steps;
+        for( size_t d = 0; d < n_q; d ++ ) {
+            q_tmp[d] = q_a[d] + s*(q_b[d] - q_a[d]);
+        }
+        valid = check_config( q_tmp, stale, &e.blocker );
+    }
+    e.validity = valid ? VALID : INVALID;
+    return valid;
+}
+
+bool
+sgLazyPRM::search( const std::vector<size_t> &starts,
+                   const std::vector<size_t> &goals,
+                   std::vector<size_t> &path_edges, size_t *i_start )
+{
+    size_t n = nodes.size();
+    std::vector<double> cost(n, HUGE_VAL);
+    std::vector<size_t> pred(n, sgNNTree::NONE);
+    std::vector<char> is_goal(n, 0), closed(n, 0);
+    std::vector<double> q_goal(goals.size() * n_q);
+    for( size_t j = 0; j < goals.size(); j ++ ) {
+        is_goal[goals[j]] = 1;
+        tree.get( goals[j], &q_goal[j*n_q] );
+    }
+
+    /* A* with the distance to the nearest goal as the heuristic */
+    typedef std::pair<double,size_t> Entry;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > open;
+    auto heuristic = [&]( size_t i ) {
+        tree.get( i, q_tmp );
+        double h = HUGE_VAL;
+        for( size_t j = 0; j < goals.size(); j ++ ) {
+            h = std::min( h, aa_la_ssd(n_q, q_tmp, &q_goal[j*n_q]) );
+        }
+        return sqrt(h);
+    };
+
+    for( size_t s : starts ) {
+        if( INVALID == nodes[s].validity ) continue;
+        cost[s] = 0;
+        open.push( Entry(heuristic(s), s) );
+    }
+
+    while( !open.empty() ) {
+        size_t i = open.top().second;
+        open.pop();
+        if( closed[i] ) continue;
+        closed[i] = 1;
+
+        if( is_goal[i] ) {
+            path_edges.clear();
+            for( ; sgNNTree::NONE != pred[i];
+                 i = (edges[pred[i]].a == i) ? edges[pred[i]].b : edges[pred[i]].a )
+            {
+                path_edges.push_back(pred[i]);
+            }
+            std::reverse( path_edges.begin(), path_edges.end() );
+            *i_start = i;
+            return true;
+        }
+
+        for( size_t ie : nodes[i].edges ) {
+            const Edge &e = edges[ie];
+            size_t j = (e.a == i) ? e.b : e.a;
+            if( INVALID == e.validity || INVALID == nodes[j].validity ) continue;
+            double c = cost[i] + e.length;
+            if( c < cost[j] ) {
+                cost[j] = c;
+                pred[j] = ie;
+                open.push( Entry(c + heuristic(j), j) );
+            }
+        }
+    }
+    return false;
+}
+
+int
+sgLazyPRM::solve( const sgRoadmapProblem *prob_, double timeout,
+                  std::vector<double> &path )
+{
+    prob = prob_;
+    path.clear();
+
+    double t_end = now_sec() + timeout;
+
+    std::vector<size_t> starts, goals;
+    for( size_t j = 0; j < prob->n_start; j ++ ) {
+        starts.push_back( find_or_add(prob->start + j*n_q) );
+    }
+    if( starts.empty() ) return -1;
+
+    bool goals_done = false;
+    std::vector<size_t> path_edges;
+    size_t i_start;
+    int r = -1;
+
+    while( now_sec() < t_end ) {
+        if( prob->is_cancelled && prob->is_cancelled(prob->cx) ) break;
+
+        /* Add new goals to the roadmap */
+        while( !goals_done ) {
+            int g = prob->next_goal( prob->cx, q_b );
+            if( g > 0 ) {
+                goals.push_back( find_or_add(q_b) );
+            } else {
+                goals_done = (g < 0);
+                break;
+            }
+        }
+        if( goals.empty() ) {
+            if( goals_done ) break;
+            struct timespec ts = {0, 1000000};
+            nanosleep( &ts, NULL );
+            continue;
+        }
+
+        if( ! search(starts, goals, path_edges, &i_start) ) {
+            grow( std::max( (size_t)64, nodes.size() / 8 ) );
+            continue;
+        }
+
+        /* Check the candidate path, nodes first */
+        bool valid = check_node(i_start);
+        for( size_t j = 0; valid && j < path_edges.size(); j ++ ) {
+            valid = check_node( edges[path_edges[j]].a ) && check_node( edges[path_edges[j]].b );
+        }
+        for( size_t j = 0; valid && j < path_edges.size(); j ++ ) {
+            valid = check_edge( path_edges[j] );
+        }
+        if( !valid ) continue;
+
+        path.resize( (path_edges.size() + 1) * n_q );
+        size_t i = i_start;
+        tree.get( i, &path[0] );
+        for( size_t j = 0; j < path_edges.size(); j ++ ) {
+            const Edge &e = edges[path_edges[j]];
+            i = (e.a == i) ? e.b : e.a;
+            tree.get( i, &path[(j+1)*n_q] );
+        }
+        r = 0;
+        break;
+    }
+
+    return r;
+}
+
+static void
+reopen( uint8_t *validity, uint64_t blocker, bool stale,
+        bool (*affected)(void *cx, uint64_t blocker), void *cx )
+{
+    switch( *validity ) {
+    case sgLazyPRM::VALID:
+        if( stale ) *validity = sgLazyPRM::STALE;
+        break;
+    case sgLazyPRM::STALE:
+        if( stale ) *validity = sgLazyPRM::UNKNOWN;
+        break;
+    case sgLazyPRM::INVALID:
+        if( affected(cx, blocker) ) *validity = sgLazyPRM::UNKNOWN;
+        break;
+    }
+}
+
+void
+sgLazyPRM::invalidate( bool (*affected)(void *cx, uint64_t blocker), void *cx )
+{
+    for( Node &n : nodes ) reopen( &n.validity, n.blocker, true, affected, cx );
+    for( Edge &e : edges ) reopen( &e.validity, e.blocker, true, affected, cx );
+}
+
+void
+sgLazyPRM::reopen_invalid( bool (*affected)(void *cx, uint64_t blocker), void *cx )
+{
+    for( Node &n : nodes ) reopen( &n.validity, n.blocker, false, affected, cx );
+    for( Edge &e : edges ) reopen( &e.validity, e.blocker, false, affected, cx );
+}
+
+void
+sgLazyPRM::invalidate_all()
+{
+    for( Node &n : nodes ) n.validity = UNKNOWN;
+    for( Edge &e : edges ) e.validity = UNKNOWN;
+}
+
+/*-- Persistence --*/
+
+static const char prm_magic[8] = {'a','a','r','x','p','r','m','1'};
+
+int
+sgLazyPRM::write( FILE *out ) const
+{
+    uint64_t header[3] = { n_q, nodes.size(), edges.size() };
+    if( 1 != fwrite(prm_magic, sizeof(prm_magic), 1, out) ) return -1;
+    if( 1 != fwrite(header, sizeof(header), 1, out) ) return -1;
+
+    double q[n_q];
+    for( size_t i = 0; i < nodes.size(); i ++ ) {
+        tree.get( i, q );
+        if( n_q != fwrite(q, sizeof(double), n_q, out) ||
+            1 != fwrite(&nodes[i].validity, sizeof(uint8_t), 1, out) ||
+            1 != fwrite(&nodes[i].blocker, sizeof(uint64_t), 1, out) )
+        {
+            return -1;
+        }
+    }
+    for( const Edge &e : edges ) {
+        uint64_t ab[2] = { e.a, e.b };
+        if( 1 != fwrite(ab, sizeof(ab), 1, out) ||
+            1 != fwrite(&e.validity, sizeof(uint8_t), 1, out) ||
+            1 != fwrite(&e.blocker, sizeof(uint64_t), 1, out) )
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+sgLazyPRM *
+sgLazyPRM::read( FILE *in, size_t n_q, const double *lo, const double *hi )
+{
+    char magic[sizeof(prm_magic)];
+    uint64_t header[3];
+    if( 1 != fread(magic, sizeof(magic), 1, in) ||
+        0 != memcmp(magic, prm_magic, sizeof(magic)) ||
+        1 != fread(header, sizeof(header), 1, in) ||
+        header[0] != n_q )
+    {
+        return NULL;
+    }
+
+    sgLazyPRM *prm = new sgLazyPRM( n_q, lo, hi );
+    double q[n_q];
+    for( uint64_t i = 0; i < header[1]; i ++ ) {
+        Node node;
+        if( n_q != fread(q, sizeof(double), n_q, in) ||
+            1 != fread(&node.validity, sizeof(uint8_t), 1, in) ||
+            1 != fread(&node.blocker, sizeof(uint64_t), 1, in) )
+        {
+            goto ERR;
+        }
+        prm->tree.add( q, sgNNTree::NONE );
+        prm->nodes.push_back(node);
+    }
+    for( uint64_t i = 0; i < header[2]; i ++ ) {
+        uint64_t ab[2];
+        uint8_t validity;
+        uint64_t blocker;
+        if( 1 != fread(ab, sizeof(ab), 1, in) ||
+            1 != fread(&validity, sizeof(uint8_t), 1, in) ||
+            1 != fread(&blocker, sizeof(uint64_t), 1, in) ||
+            ab[0] >= header[1] || ab[1] >= header[1] )
+        {
+            goto ERR;
+        }
+        prm->tree.get( ab[0], prm->q_a );
+        prm->tree.get( ab[1], prm->q_b );
+        prm->add_edge( ab[0], ab[1], sqrt(aa_la_ssd(n_q, prm->q_a, prm->q_b)) );
+        prm->edges.back().validity = validity;
+        prm->edges.back().blocker = blocker;
+    }
+    return prm;
+
+ERR:
+    delete prm;
+    return NULL;
+}
+
+} /* namespace amino */
@@ -0,0 +1,357 @@
+/* -*- mode: C++; c-basic-offset: 4; -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2015, Rice University
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@rice.edu>
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of copyright holder the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include <stdint.h>
+#include <algorithm>
+#include <time.h>
+
+#include "amino.h"
+#include "amino/rx/ompl/scene_native_rrt.h"
+
+namespace amino {
+
+typedef double nn_vec __attribute__ ((vector_size (sizeof(double)*sgNNTree::LANES)));
+
+/*-- Nearest-neighbor tree --*/
+
+sgNNTree::sgNNTree( size_t n_q_, struct aa_mem_region *reg_ ) :
+    n_q(n_q_),
+    n_nodes(0),
+    reg(reg_)
+{ }
+
+size_t
+sgNNTree::add( const double *q, size_t parent )
+{
+    size_t i = n_nodes;
+    size_t i_chunk = i / CHUNK_NODES;
+    if( i_chunk == chunks.size() ) {
+        /* Over-allocate to align blocks for vector loads */
+        size_t n = n_q*CHUNK_NODES + LANES;
+        double *q_chunk = AA_MEM_REGION_NEW_N( reg, double, n );
+        uintptr_t a = (uintptr_t)q_chunk;
+        uintptr_t align = sizeof(nn_vec);
+        Chunk c;
+        c.q = (double*) ((a + align - 1) & ~(align - 1));
+        c.parent = AA_MEM_REGION_NEW_N( reg, size_t, CHUNK_NODES );
+        chunks.push_back(c);
+    }
+
+    size_t lane = i % LANES;
+    double *blk = const_cast<double*>( block(i) );
+    if( 0 == lane ) {
+        /* Empty lanes are never nearest */
+        std::fill( blk, blk + n_q*LANES, HUGE_VAL );
+    }
+    for( size_t d = 0; d < n_q; d ++ ) {
+        blk[d*LANES + lane] = q[d];
+    }
+    chunks[i_chunk].parent[i % CHUNK_NODES] = parent;
+
+    n_nodes++;
+    return i;
+}
+
+size_t
+sgNNTree::nearest( const double *q, double *d2 ) const
+{
+    size_t i_best = NONE;
+    double d2_best = HUGE_VAL;
+    size_t n_blocks = (n_nodes + LANES - 1) / LANES;
+    for( size_t b = 0; b < n_blocks; b ++ ) {
+        const double *blk = block( b*LANES );
+        nn_vec acc = {0};
+        for( size_t d = 0; d < n_q; d ++ ) {
+            nn_vec x = *(const nn_vec*)(blk + d*LANES);
+            x -= q[d];
+            acc += x*x;
+        }
+        for( size_t l = 0; l < LANES; l ++ ) {
+            if( acc[l] < d2_best ) {
+                d2_best = acc[l];
+                i_best = b*LANES + l;
+            }
+        }
+    }
+    if( d2 ) *d2 = d2_best;
+    return i_best;
+}
+
+size_t
+sgNNTree::nearest_k( const double *q, size_t k, size_t *idx, double *d2 ) const
+{
+    size_t n = 0;
+    size_t n_blocks = (n_nodes + LANES - 1) / LANES;
+    for( size_t b = 0; b < n_blocks && k > 0; b ++ ) {
+        const double *blk = block( b*LANES );
+        nn_vec acc = {0};
+        for( size_t d = 0; d < n_q; d ++ ) {
+            nn_vec x = *(const nn_vec*)(blk + d*LANES);
+            x -= q[d];
+            acc += x*x;
+        }
+        for( size_t l = 0; l < LANES; l ++ ) {
+            double a = acc[l];
+            if( n == k && a >= d2[n-1] ) continue;
+            if( a == HUGE_VAL ) continue;
+            /* Insert into sorted list */
+            size_t j = (n < k) ? n++ : n-1;
+            for( ; j > 0 && d2[j-1] > a; j-- ) {
+                d2[j] = d2[j-1];
+                idx[j] = idx[j-1];
+            }
+            d2[j] = a;
+            idx[j] = b*LANES + l;
+        }
+    }
+    return n;
+}
+
+void
+sgNNTree::get( size_t i, double *q ) const
+{
+    const double *blk = block(i);
+    size_t lane = i % LANES;
+    for( size_t d = 0; d < n_q; d ++ ) {
+        q[d] = blk[d*LANES + lane];
+    }
+}
+
+size_t
+sgNNTree::parent( size_t i ) const
+{
+    return chunks[i / CHUNK_NODES].parent[i % CHUNK_NODES];
+}
+
+/*-- RRT-Connect --*/
+
+sgRRTConnect::sgRRTConnect( size_t n_q_, const double *lo_, const double *hi_ ) :
+    n_q(n_q_),
+    prob(NULL),
+    tree_start(n_q_, &reg),
+    tree_goal(n_q_, &reg)
+{
+    aa_mem_region_init( &reg, 64*1024 );
+    lo = AA_MEM_REGION_NEW_N( &reg, double, n_q );
+    hi = AA_MEM_REGION_NEW_N( &reg, double, n_q );
+    q_near = AA_MEM_REGION_NEW_N( &reg, double, n_q );
+    q_new = AA_MEM_REGION_NEW_N( &reg, double, n_q );
+    q_tmp = AA_MEM_REGION_NEW_N( &reg, double, n_q );
+    q_rand = AA_MEM_REGION_NEW_N( &reg, double, n_q );
+    q_conn = AA_MEM_REGION_NEW_N( &reg, double, n_q );
+    AA_MEM_CPY( lo, lo_, n_q );
+    AA_MEM_CPY( hi, hi_, n_q );
+
+    double extent = 0;
+    for( size_t i = 0; i < n_q; i ++ ) {
+        extent += (hi[i] - lo[i]) * (hi[i] - lo[i]);
+    }
+    extent = sqrt(extent);
+    range = .2 * extent;
+    resolution = .01 * extent;
+
+    set_seed( (unsigned)rand() );
+}
+
+sgRRTConnect::~sgRRTConnect()
+{
+    aa_mem_region_destroy( &reg );
+}
+
+void
+sgRRTConnect::set_seed( unsigned seed )
+{
+    xsubi[0] = 0x330e;
+    xsubi[1] = (unsigned short)seed;
+    xsubi[2] = (unsigned short)(seed >> 16);
+}
+
+void
+sgRRTConnect::sample( double *q )
+{
+    for( size_t i = 0; i < n_q; i ++ ) {
+        q[i] = lo[i] + (hi[i] - lo[i]) * erand48(xsubi);
+    }
+}
+
+bool
+sgRRTConnect::check_motion( const double *q0, const double *q1 )
+{
+    double d = sqrt( aa_la_ssd(n_q, q0, q1) );
+    size_t n_steps = (size_t)ceil( d / resolution );
+    if( 0 == n_steps ) n_steps = 1;
+    for( size_t k = 1; k <= n_steps; k ++ ) {
+        double s = (double)k / (double)n_steps;
+        for( size_t i = 0; i < n_q; i ++ ) {
+            q_tmp[i] = q0[i] + s*(q1[i] - q0[i]);
+        }
+        if( ! prob->is_valid( prob->cx, q_tmp ) ) return false;
+    }
+    return true;
+}
+
+sgRRTConnect::Status
+sgRRTConnect::extend( sgNNTree &tree, const double *q_target, size_t *i_new )
+{
+    double d2;
+    size_t i_near = tree.nearest( q_target, &d2 );
+    if( 0 == d2 ) {
+        *i_new = i_near;
+        return REACHED;
+    }
+    tree.get( i_near, q_near );
+
+    double d = sqrt(d2);
+    bool reached = (d <= range);
+    if( reached ) {
+        AA_MEM_CPY( q_new, q_target, n_q );
+    } else {
+        for( size_t i = 0; i < n_q; i ++ ) {
+            q_new[i] = q_near[i] + (range/d) * (q_target[i] - q_near[i]);
+        }
+    }
+
+    if( ! check_motion( q_near, q_new ) ) return TRAPPED;
+
+    *i_new = tree.add( q_new, i_near );
+    return reached ? REACHED : ADVANCED;
+}
+
+static double
+now_sec()
+{
+    return aa_tm_timespec2sec( aa_tm_now() );
+}
+
+int
+sgRRTConnect::solve( const sgNativeProblem *prob_, double timeout,
+                     std::vector<double> &path )
+{
+    prob = prob_;
+    tree_start.clear();
+    tree_goal.clear();
+    path.clear();
+
+    double t_end = now_sec() + timeout;
+
+    for( size_t j = 0; j < prob->n_start; j ++ ) {
+        const double *q = prob->start + j*n_q;
+        if( prob->is_valid( prob->cx, q ) ) {
+            tree_start.add( q, sgNNTree::NONE );
+        }
+    }
+    if( 0 == tree_start.size() ) return -1;
+
+    bool goals_done = false;
+    bool grow_start = true;
+    int r = -1;
+
+    while( now_sec() < t_end ) {
+        if( prob->is_cancelled && prob->is_cancelled(prob->cx) ) break;
+
+        /* Take any new goals as roots of the goal tree */
+        while( !goals_done ) {
+            int g = prob->next_goal( prob->cx, q_rand );
+            if( g > 0 ) {
+                if( prob->is_valid( prob->cx, q_rand ) ) {
+                    tree_goal.add( q_rand, sgNNTree::NONE );
+                }
+            } else {
+                goals_done = (g < 0);
+                break;
+            }
+        }
+        if( 0 == tree_goal.size() ) {
+            if( goals_done ) break;
+            /* Wait for the goal sampler */
+            struct timespec ts = {0, 1000000};
+            nanosleep( &ts, NULL );
+            continue;
+        }
+
+        sgNNTree &ta = grow_start ? tree_start : tree_goal;
+        sgNNTree &tb = grow_start ? tree_goal : tree_start;
+
+        sample( q_rand );
+        size_t i_a;
+        if( TRAPPED != extend( ta, q_rand, &i_a ) ) {
+            /* Connect the other tree to the new node */
+            ta.get( i_a, q_conn );
+            size_t i_b;
+            Status s;
+            do {
+                s = extend( tb, q_conn, &i_b );
+            } while( ADVANCED == s );
+
+            if( REACHED == s ) {
+                /* root(ta) .. i_a, then parent(i_b) .. root(tb) */
+                std::vector<size_t> ia;
+                for( size_t i = i_a; sgNNTree::NONE != i; i = ta.parent(i) ) {
+                    ia.push_back(i);
+                }
+                size_t n_pts = ia.size();
+                for( size_t i = tb.parent(i_b); sgNNTree::NONE != i; i = tb.parent(i) ) {
+                    n_pts++;
+                }
+                path.resize( n_pts * n_q );
+                double *p = &path[0];
+                for( auto itr = ia.rbegin(); itr != ia.rend(); itr++, p += n_q ) {
+                    ta.get( *itr, p );
+                }
+                for( size_t i = tb.parent(i_b); sgNNTree::NONE != i; i = tb.parent(i), p += n_q ) {
+                    tb.get( i, p );
+                }
+                if( ! grow_start ) {
+                    /* Path runs goal to start */
+                    for( size_t j = 0; j < n_pts/2; j ++ ) {
+                        std::swap_ranges( &path[j*n_q], &path[(j+1)*n_q],
+                                          &path[(n_pts-1-j)*n_q] );
+                    }
+                }
+                r = 0;
+                break;
+            }
+        }
+        grow_start = !grow_start;
+    }
+
+    return r;
+}
+
+} /* namespace amino */
@@ -38,8 +38,12 @@
 
 #include "amino.h"
 
+#include "amino/rx/scene_sub.h"
 #include "amino/rx/scene_planning.h"
 #include "amino/rx/ompl/scene_ompl.h"
+#include "amino/rx/ompl/scene_state_space.h"
+#include "amino/rx/ompl/scene_ompl_internal.h"
+#include "amino/rx/ompl/scene_native_rrt.h"
 
 #include <ompl/geometric/planners/rrt/RRTConnect.h>
 #include <ompl/geometric/planners/rrt/RRT.h>
@@ -48,6 +52,7 @@
 struct aa_rx_mp_rrt_attr
 {
     unsigned is_bidirectional : 1;
+    unsigned is_native : 1;
 };
 
 
@@ -56,6 +61,7 @@ aa_rx_mp_rrt_attr_create(void)
 {
     struct aa_rx_mp_rrt_attr * a = AA_NEW(struct aa_rx_mp_rrt_attr);
     a->is_bidirectional = 1;
+    a->is_native = 0;
     return a;
 }
 
@@ -75,6 +81,14 @@ aa_rx_mp_rrt_attr_set_bidirectional( struct aa_rx_mp_rrt_attr* attrs,
 }
 
 
+AA_API void
+aa_rx_mp_rrt_attr_set_native( struct aa_rx_mp_rrt_attr* attrs,
+                              int is_native )
+{
+    attrs->is_native = is_native ? 1 : 0;
+}
+
+
 AA_API void
 aa_rx_mp_set_rrt( struct aa_rx_mp* mp,
                   const struct aa_rx_mp_rrt_attr *attr )
@@ -85,7 +99,13 @@ aa_rx_mp_set_rrt( struct aa_rx_mp* mp,
         attr = default_attr;
     }
 
-    if( attr->is_bidirectional ) {
+    if( attr->is_native && attr->is_bidirectional ) {
+        amino::sgStateSpace *ss = mp->space_information->getTypedStateSpace();
+        const ompl::base::RealVectorBounds &b = ss->getBounds();
+        mp->set_planner(NULL);
+        mp->set_native( new amino::sgRRTConnect( ss->config_count_subset(),
+                                                 b.low.data(), b.high.data() ) );
+    } else if( attr->is_bidirectional ) {
         aa_rx_mp_set_planner( mp,
                               new ompl::geometric::RRTConnect(aa_rx_mp_get_space_information(mp)) );
     } else {
@@ -0,0 +1,497 @@
+/* -*- mode: C++; c-basic-offset: 4; -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2015, Rice University
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@rice.edu>
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of copyright holder the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <vector>
+#include <time.h>
+
+#include "amino.h"
+#include "amino/rx/rxerr.h"
+#include "amino/rx/rxtype.h"
+#include "amino/rx/scenegraph.h"
+#include "amino/rx/scenegraph_internal.h"
+#include "amino/rx/scene_sub.h"
+#include "amino/rx/scene_collision.h"
+#include "amino/rx/scene_planning.h"
+
+#include "amino/rx/ompl/scene_state_space.h"
+#include "amino/rx/ompl/scene_state_validity_checker.h"
+#include "amino/rx/ompl/scene_workspace_goal.h"
+#include "amino/rx/ompl/scene_ompl_internal.h"
+#include "amino/rx/ompl/scene_native_rrt.h"
+
+#include <ompl/base/goals/GoalState.h>
+#include <ompl/base/goals/GoalLazySamples.h>
+#include <ompl/geometric/PathGeometric.h>
+#include <ompl/geometric/planners/rrt/RRTConnect.h>
+#include <ompl/geometric/planners/sbl/SBL.h>
+#include <ompl/geometric/planners/kpiece/LBKPIECE1.h>
+
+namespace ob = ::ompl::base;
+namespace og = ::ompl::geometric;
+
+struct aa_rx_mp_parallel_attr
+{
+    unsigned algorithms;
+    size_t n_solutions;
+    unsigned seed;
+};
+
+AA_API struct aa_rx_mp_parallel_attr*
+aa_rx_mp_parallel_attr_create(void)
+{
+    struct aa_rx_mp_parallel_attr * a = AA_NEW(struct aa_rx_mp_parallel_attr);
+    a->algorithms = AA_RX_MP_NATIVE_RRT | AA_RX_MP_RRT;
+    a->n_solutions = 1;
+    a->seed = 0;
+    return a;
+}
+
+AA_API void
+aa_rx_mp_parallel_attr_destroy(struct aa_rx_mp_parallel_attr* a)
+{
+    free(a);
+}
+
+AA_API void
+aa_rx_mp_parallel_attr_set_algorithms( struct aa_rx_mp_parallel_attr* attrs,
+                                       unsigned algorithms )
+{
+    attrs->algorithms = algorithms;
+}
+
+AA_API void
+aa_rx_mp_parallel_attr_set_solutions( struct aa_rx_mp_parallel_attr* attrs,
+                                      size_t n_solutions )
+{
+    attrs->n_solutions = n_solutions;
+}
+
+AA_API void
+aa_rx_mp_parallel_attr_set_seed( struct aa_rx_mp_parallel_attr* attrs,
+                                 unsigned seed )
+{
+    attrs->seed = seed;
+}
+
+/*
+ * Per-thread space information and collision checking.  Creating the
+ * collision managers dominates short queries, so they are kept in the
+ * context and rebuilt only when the scene geometry changes.
+ */
+struct aa_rx_mp_parallel {
+    struct thread {
+        amino::sgSpaceInformation::Ptr si;
+        amino::sgStateValidityChecker *checker; ///< owned by si
+    };
+    std::vector<thread> threads;
+    uint64_t geom_version;
+};
+
+void
+aa_rx_mp_parallel_destroy( struct aa_rx_mp_parallel *par )
+{
+    delete par;
+}
+
+namespace {
+
+/* State shared by all planning threads */
+struct par_shared {
+    struct aa_rx_mp *mp;
+    const ob::GoalState *goal;
+    const ob::GoalStates *goals;
+    const ob::GoalLazySamples *lazy;
+    size_t n_wanted;
+    double t_end;
+    std::atomic<bool> stop;
+    std::atomic<size_t> n_found;
+};
+
+/* A single planning thread */
+struct par_worker {
+    par_shared *sh;
+    unsigned algorithm;
+    unsigned seed;
+    amino::sgSpaceInformation::Ptr si;
+    amino::sgStateValidityChecker *checker;
+    unsigned i_goal;
+    std::vector<double> path;
+    int result;
+};
+
+double
+now_sec()
+{
+    return aa_tm_timespec2sec( aa_tm_now() );
+}
+
+bool
+par_cancelled( const par_shared *sh )
+{
+    return sh->stop || sh->mp->cancelled || now_sec() > sh->t_end;
+}
+
+/* Copy the worker's next goal from the shared goal into q */
+int
+par_next_goal( par_worker *w, double *q )
+{
+    par_shared *sh = w->sh;
+    size_t n_s = w->si->getTypedStateSpace()->config_count_subset();
+    if( par_cancelled(sh) ) return -1;
+
+    const ob::State *s = NULL;
+    if( sh->goal ) {
+        if( 0 == w->i_goal++ ) s = sh->goal->getState();
+    } else if( w->i_goal < sh->goals->getStateCount() ) {
+        s = sh->goals->getState(w->i_goal++);
+    }
+
+    if( s ) {
+        AA_MEM_CPY( q, s->as<amino::sgStateSpace::StateType>()->values, n_s );
+        return 1;
+    } else if( sh->lazy && sh->lazy->isSampling() ) {
+        return 0;
+    } else {
+        return -1;
+    }
+}
+
+bool
+native_is_valid( void *cx, const double *q )
+{
+    par_worker *w = (par_worker*)cx;
+    return w->checker->is_valid_config(q);
+}
+
+int
+native_next_goal( void *cx, double *q )
+{
+    return par_next_goal( (par_worker*)cx, q );
+}
+
+bool
+native_is_cancelled( void *cx )
+{
+    return par_cancelled( ((par_worker*)cx)->sh );
+}
+
+bool
+ompl_sample_goal( par_worker *w, ob::State *state )
+{
+    double *q = state->as<amino::sgStateSpace::StateType>()->values;
+    for(;;) {
+        int r = par_next_goal( w, q );
+        if( r > 0 ) return true;
+        if( r < 0 ) return false;
+        struct timespec ts = {0, 1000000};
+        nanosleep( &ts, NULL );
+    }
+}
+
+void
+par_run_native( par_worker *w, const std::vector<double> &start, size_t n_start )
+{
+    amino::sgStateSpace *ss = w->si->getTypedStateSpace();
+    const ob::RealVectorBounds &b = ss->getBounds();
+    amino::sgRRTConnect planner( ss->config_count_subset(),
+                                 b.low.data(), b.high.data() );
+    planner.set_seed( w->seed );
+
+    amino::sgNativeProblem prob;
+    prob.cx = w;
+    prob.is_valid = native_is_valid;
+    prob.next_goal = native_next_goal;
+    prob.is_cancelled = native_is_cancelled;
+    prob.n_start = n_start;
+    prob.start = start.data();
+
+    w->result = planner.solve( &prob, w->sh->t_end - now_sec(), w->path );
+}
+
+void
+par_run_ompl( par_worker *w, const std::vector<double> &start, size_t n_start )
+{
+    amino::sgStateSpace *ss = w->si->getTypedStateSpace();
+    size_t n_s = ss->config_count_subset();
+
+    ob::ProblemDefinitionPtr pdef( new ob::ProblemDefinition(w->si) );
+    amino::sgSpaceInformation::ScopedStateType state(w->si);
+    for( size_t i = 0; i < n_start; i ++ ) {
+        ss->copy_state( &start[i*n_s], state.get() );
+        pdef->addStartState(state);
+    }
+    ob::GoalLazySamples *goal =
+        new ob::GoalLazySamples( w->si,
+                                 [w](const ob::GoalLazySamples*, ob::State *s) {
+                                     return ompl_sample_goal(w, s);
+                                 } );
+    pdef->setGoal( ob::GoalPtr(goal) );
+
+    ob::PlannerPtr planner;
+    switch( w->algorithm ) {
+    case AA_RX_MP_SBL:
+        planner.reset( new og::SBL(w->si) );
+        break;
+    case AA_RX_MP_KPIECE:
+        planner.reset( new og::LBKPIECE1(w->si) );
+        break;
+    default:
+        planner.reset( new og::RRTConnect(w->si) );
+    }
+    planner->setProblemDefinition(pdef);
+
+    par_shared *sh = w->sh;
+    ob::PlannerStatus status =
+        planner->solve( ob::PlannerTerminationCondition( [sh]{ return par_cancelled(sh); } ) );
+    goal->stopSampling();
+
+    if( ob::PlannerStatus::EXACT_SOLUTION == status ) {
+        og::PathGeometric &path = static_cast<og::PathGeometric&>(*pdef->getSolutionPath());
+        std::vector<ob::State*> &states = path.getStates();
+        w->path.resize( states.size() * n_s );
+        for( size_t j = 0; j < states.size(); j ++ ) {
+            AA_MEM_CPY( &w->path[j*n_s],
+                        states[j]->as<amino::sgStateSpace::StateType>()->values,
+                        n_s );
+        }
+        w->result = 0;
+    }
+}
+
+void
+par_run( par_worker *w, const std::vector<double> *start, size_t n_start )
+{
+    try {
+        if( AA_RX_MP_NATIVE_RRT == w->algorithm ) {
+            par_run_native( w, *start, n_start );
+        } else {
+            par_run_ompl( w, *start, n_start );
+        }
+    } catch(...) {
+        w->result = -1;
+    }
+
+    if( 0 == w->result ) {
+        par_shared *sh = w->sh;
+        if( ++sh->n_found >= sh->n_wanted ) {
+            sh->stop = true;
+        }
+    }
+}
+
+double
+path_length( size_t n_s, const std::vector<double> &path )
+{
+    double d = 0;
+    for( size_t j = n_s; j < path.size(); j += n_s ) {
+        d += sqrt( aa_la_ssd(n_s, &path[j-n_s], &path[j]) );
+    }
+    return d;
+}
+
+} /* namespace */
+
+
+AA_API int
+aa_rx_mp_plan_parallel( struct aa_rx_mp *mp,
+                        size_t n_threads,
+                        double timeout,
+                        const struct aa_rx_mp_parallel_attr *attr,
+                        size_t *n_path,
+                        double **p_path_all )
+{
+    struct aa_rx_mp_parallel_attr *default_attr = NULL;
+    if( NULL == attr ) {
+        default_attr = aa_rx_mp_parallel_attr_create();
+        attr = default_attr;
+    }
+
+    *n_path = 0;
+    *p_path_all = NULL;
+
+    /* A cancellation of an earlier query does not apply to this one */
+    mp->cancelled = false;
+
+    if( NULL == mp->config_start ) {
+        aa_checked_free( default_attr );
+        return AA_RX_INVALID_STATE;
+    }
+
+    amino::sgSpaceInformation::Ptr &si = mp->space_information;
+    amino::sgStateSpace *ss = si->getTypedStateSpace();
+    size_t n_s = ss->config_count_subset();
+    size_t n_all = ss->config_count_all();
+    ob::ProblemDefinitionPtr &pdef = mp->problem_definition;
+
+    if( 0 == n_threads ) {
+        n_threads = std::thread::hardware_concurrency();
+        if( 0 == n_threads ) n_threads = 1;
+    }
+
+    /* Algorithms, assigned to threads in turn */
+    std::vector<unsigned> algs;
+    for( unsigned a = AA_RX_MP_NATIVE_RRT; a <= AA_RX_MP_KPIECE; a <<= 1 ) {
+        if( attr->algorithms & a ) algs.push_back(a);
+    }
+    if( algs.empty() ) algs.push_back(AA_RX_MP_NATIVE_RRT);
+
+    /* Shared problem */
+    par_shared sh;
+    sh.mp = mp;
+    const ob::Goal *g = pdef->getGoal().get();
+    sh.goal = dynamic_cast<const ob::GoalState*>(g);
+    sh.goals = dynamic_cast<const ob::GoalStates*>(g);
+    sh.lazy = dynamic_cast<const ob::GoalLazySamples*>(g);
+    sh.n_wanted = AA_MAX( (size_t)1, AA_MIN(attr->n_solutions, n_threads) );
+    sh.t_end = now_sec() + timeout;
+    sh.stop = false;
+    sh.n_found = 0;
+
+    unsigned seed = attr->seed;
+    if( default_attr ) {
+        aa_rx_mp_parallel_attr_destroy(default_attr);
+    }
+    if( NULL == sh.goal && NULL == sh.goals ) {
+        return AA_RX_NO_SOLUTION | AA_RX_NO_MP;
+    }
+
+    size_t n_start = pdef->getStartStateCount();
+    std::vector<double> start(n_s * n_start);
+    for( size_t i = 0; i < n_start; i ++ ) {
+        const ob::State *s = pdef->getStartState((unsigned)i);
+        AA_MEM_CPY( &start[i*n_s], s->as<amino::sgStateSpace::StateType>()->values, n_s );
+    }
+
+    /* Per-thread space information and collision checking */
+    mp->validity_checker->allow();
+    if( mp->collisions ) {
+        aa_rx_cl_set_clear(mp->collisions);
+    }
+    uint64_t geom_version = aa_rx_sg_geom_version( ss->get_scene_graph() );
+    if( NULL == mp->parallel ) {
+        mp->parallel = new aa_rx_mp_parallel;
+        mp->parallel->geom_version = geom_version;
+    }
+    aa_rx_mp_parallel *par = mp->parallel;
+    if( par->geom_version != geom_version ) {
+        par->threads.clear();
+        par->geom_version = geom_version;
+    }
+    while( par->threads.size() < n_threads ) {
+        aa_rx_mp_parallel::thread t;
+        t.si.reset( new amino::sgSpaceInformation(
+                        amino::sgSpaceInformation::SpacePtr(
+                            new amino::sgStateSpace(ss->sub_scene_graph))) );
+        t.checker = new amino::sgStateValidityChecker(t.si.get());
+        t.si->setStateValidityChecker( ob::StateValidityCheckerPtr(t.checker) );
+        t.si->setup();
+        par->threads.push_back(t);
+    }
+
+    std::vector<par_worker> workers(n_threads);
+    for( size_t i = 0; i < n_threads; i ++ ) {
+        aa_rx_mp_parallel::thread &t = par->threads[i];
+        amino::sgStateSpace *ts = t.si->getTypedStateSpace();
+        ts->reset_allowed();
+        aa_rx_cl_set_fill( ts->allowed, ss->allowed );
+        t.checker->reset_allowed();
+        t.checker->set_start( n_all, mp->config_start );
+
+        par_worker *w = &workers[i];
+        w->sh = &sh;
+        w->algorithm = algs[i % algs.size()];
+        w->seed = seed + (unsigned)i;
+        w->si = t.si;
+        w->checker = t.checker;
+        w->i_goal = 0;
+        w->result = -1;
+    }
+
+    /* Race the planners */
+    if( mp->lazy_samples ) {
+        mp->lazy_samples->clear();
+        mp->lazy_samples->setStart(n_all, mp->config_start);
+        mp->lazy_samples->startSampling();
+    }
+
+    std::vector<std::thread> threads;
+    for( size_t i = 0; i < n_threads; i ++ ) {
+        try {
+            threads.push_back( std::thread(par_run, &workers[i], &start, n_start) );
+        } catch(...) {
+            /* Could not start thread, run inline */
+            par_run( &workers[i], &start, n_start );
+        }
+    }
+    for( auto itr = threads.begin(); itr != threads.end(); itr++ ) {
+        itr->join();
+    }
+
+    if( mp->lazy_samples ) {
+        mp->lazy_samples->stopSampling();
+    }
+
+    /* Select the shortest solution */
+    par_worker *best = NULL;
+    double best_length = HUGE_VAL;
+    for( auto itr = workers.begin(); itr != workers.end(); itr++ ) {
+        if( 0 == itr->result ) {
+            double d = path_length(n_s, itr->path);
+            if( d < best_length ) {
+                best_length = d;
+                best = &*itr;
+            }
+        }
+    }
+    if( NULL == best ) {
+        return AA_RX_NO_SOLUTION | AA_RX_NO_MP;
+    }
+
+    og::PathGeometric path(si);
+    amino::sgSpaceInformation::ScopedStateType state(si);
+    for( size_t j = 0; j < best->path.size(); j += n_s ) {
+        ss->copy_state( &best->path[j], state.get() );
+        path.append( state.get() );
+    }
+    aa_rx_mp_path_cleanup(mp, path);
+    aa_rx_mp_path_output(mp, path, n_path, p_path_all);
+
+    return AA_RX_OK;
+}
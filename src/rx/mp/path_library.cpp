@@ -0,0 +1,408 @@
+/* -*- mode: C++; c-basic-offset: 4; -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2015, Rice University
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@rice.edu>
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of copyright holder the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "amino.h"
+#include "amino/rx/rxerr.h"
+#include "amino/rx/rxtype.h"
+#include "amino/rx/scenegraph.h"
+#include "amino/rx/scene_sub.h"
+#include "amino/rx/scene_collision.h"
+#include "amino/rx/scene_planning.h"
+
+#include "amino/rx/ompl/scene_state_space.h"
+#include "amino/rx/ompl/scene_ompl_internal.h"
+#include "amino/rx/ompl/scene_native_rrt.h"
+#include "amino/rx/ompl/scene_native_path.h"
+
+#include <ompl/geometric/PathGeometric.h>
+#include <ompl/base/goals/GoalState.h>
+#include <ompl/base/goals/GoalStates.h>
+
+/* Paths indexed by their start and goal */
+struct aa_rx_mp_library {
+    aa_rx_mp_library( const struct aa_rx_sg_sub *ssg );
+    ~aa_rx_mp_library();
+
+    /* Store path, replacing any path with the same endpoints */
+    void add( const std::vector<double> &path );
+
+    const struct aa_rx_sg_sub *ssg;
+    size_t n_q;
+    struct aa_mem_region reg;
+    amino::sgNNTree index;      ///< start and goal of each path
+    std::vector< std::vector<double> > paths;
+    struct aa_rx_mp_library_stats stats;
+};
+
+aa_rx_mp_library::aa_rx_mp_library( const struct aa_rx_sg_sub *ssg_ ) :
+    ssg(ssg_),
+    n_q(aa_rx_sg_sub_config_count(ssg_)),
+    index(2*aa_rx_sg_sub_config_count(ssg_), &reg)
+{
+    aa_mem_region_init( &reg, 16*1024 );
+    AA_MEM_ZERO( &stats, 1 );
+}
+
+aa_rx_mp_library::~aa_rx_mp_library()
+{
+    aa_mem_region_destroy( &reg );
+}
+
+void
+aa_rx_mp_library::add( const std::vector<double> &path )
+{
+    double key[2*n_q], d2;
+    AA_MEM_CPY( key, &path[0], n_q );
+    AA_MEM_CPY( key+n_q, &path[path.size()-n_q], n_q );
+
+    size_t i = index.nearest( key, &d2 );
+    if( amino::sgNNTree::NONE != i && 0 == d2 ) {
+        paths[i] = path;
+    } else {
+        paths.push_back( path );
+        try {
+            index.add( key, amino::sgNNTree::NONE );
+        } catch(...) {
+            paths.pop_back();
+            throw;
+        }
+    }
+}
+
+AA_API struct aa_rx_mp_library *
+aa_rx_mp_library_create( const struct aa_rx_sg_sub *ssg )
+{
+    try {
+        return new aa_rx_mp_library(ssg);
+    } catch(...) {
+        return NULL;
+    }
+}
+
+AA_API void
+aa_rx_mp_library_destroy( struct aa_rx_mp_library *lib )
+{
+    delete lib;
+}
+
+AA_API size_t
+aa_rx_mp_library_size( const struct aa_rx_mp_library *lib )
+{
+    return lib->paths.size();
+}
+
+AA_API const struct aa_rx_mp_library_stats *
+aa_rx_mp_library_get_stats( const struct aa_rx_mp_library *lib )
+{
+    return &lib->stats;
+}
+
+AA_API int
+aa_rx_mp_set_library( struct aa_rx_mp *mp, struct aa_rx_mp_library *lib,
+                      size_t n_candidates )
+{
+    if( lib &&
+        lib->n_q != mp->space_information->getTypedStateSpace()->config_count_subset() )
+    {
+        return AA_RX_INVALID_PARAMETER;
+    }
+    mp->library = lib;
+    mp->library_candidates = n_candidates ? n_candidates : 3;
+    return AA_RX_OK;
+}
+
+static const char library_magic[8] = {'a','a','r','x','p','l','b','1'};
+
+AA_API int
+aa_rx_mp_library_write( const struct aa_rx_mp_library *lib, FILE *out )
+{
+    uint64_t header[2] = { lib->n_q, lib->paths.size() };
+    if( 1 != fwrite(library_magic, sizeof(library_magic), 1, out) ||
+        1 != fwrite(header, sizeof(header), 1, out) )
+    {
+        return AA_RX_INVALID_PARAMETER;
+    }
+    for( const std::vector<double> &path : lib->paths ) {
+        uint64_t n = path.size() / lib->n_q;
+        if( 1 != fwrite(&n, sizeof(n), 1, out) ||
+            path.size() != fwrite(path.data(), sizeof(double), path.size(), out) )
+        {
+            return AA_RX_INVALID_PARAMETER;
+        }
+    }
+    return AA_RX_OK;
+}
+
+/* Bytes from the current position to the end of a seekable file, or
+ * UINT64_MAX if unknown */
+static uint64_t
+file_remaining( FILE *in )
+{
+    long pos = ftell(in);
+    if( pos < 0 || 0 != fseek(in, 0, SEEK_END) ) return UINT64_MAX;
+    long end = ftell(in);
+    if( 0 != fseek(in, pos, SEEK_SET) ) return 0;
+    return (end >= pos) ? (uint64_t)(end - pos) : 0;
+}
+
+/* Largest waypoint count to accept, so that a corrupt count can
+ * neither overflow nor exceed what the file holds */
+static uint64_t
+library_max_waypoints( FILE *in, size_t n_q )
+{
+    uint64_t row = n_q * sizeof(double);
+    uint64_t n_max = SIZE_MAX / row;
+    uint64_t remaining = file_remaining(in);
+    if( UINT64_MAX != remaining ) n_max = AA_MIN( n_max, remaining / row );
+    return n_max;
+}
+
+static int
+library_read( struct aa_rx_mp_library *lib, FILE *in )
+{
+    char magic[sizeof(library_magic)];
+    uint64_t header[2];
+    if( 1 != fread(magic, sizeof(magic), 1, in) ||
+        0 != memcmp(magic, library_magic, sizeof(magic)) ||
+        1 != fread(header, sizeof(header), 1, in) ||
+        header[0] != lib->n_q || 0 == lib->n_q )
+    {
+        return AA_RX_INVALID_PARAMETER;
+    }
+
+    std::vector< std::vector<double> > paths;
+    for( uint64_t i = 0; i < header[1]; i ++ ) {
+        uint64_t n;
+        if( 1 != fread(&n, sizeof(n), 1, in) || n < 2 ||
+            n > library_max_waypoints(in, lib->n_q) )
+        {
+            return AA_RX_INVALID_PARAMETER;
+        }
+        std::vector<double> path( (size_t)n * lib->n_q );
+        if( path.size() != fread(path.data(), sizeof(double), path.size(), in) ) {
+            return AA_RX_INVALID_PARAMETER;
+        }
+        paths.push_back( std::move(path) );
+    }
+
+    /* Replace the contents only after reading everything */
+    lib->index.clear();
+    lib->paths.clear();
+    for( const std::vector<double> &path : paths ) {
+        lib->add( path );
+    }
+    return AA_RX_OK;
+}
+
+AA_API int
+aa_rx_mp_library_read( struct aa_rx_mp_library *lib, FILE *in )
+{
+    try {
+        return library_read( lib, in );
+    } catch(...) {
+        return AA_RX_INVALID_PARAMETER;
+    }
+}
+
+static double
+now_sec()
+{
+    return aa_tm_timespec2sec( aa_tm_now() );
+}
+
+/* Single start and goal configuration of the query, if any */
+static bool
+query_endpoints( struct aa_rx_mp *mp, size_t n_q, double *start, double *goal )
+{
+    const ompl::base::ProblemDefinitionPtr &pdef = mp->problem_definition;
+    if( 1 != pdef->getStartStateCount() ) return false;
+
+    const ompl::base::State *s_goal = NULL;
+    const ompl::base::Goal *g = pdef->getGoal().get();
+    if( const ompl::base::GoalState *gs = dynamic_cast<const ompl::base::GoalState*>(g) ) {
+        s_goal = gs->getState();
+    } else if( const ompl::base::GoalStates *gs = dynamic_cast<const ompl::base::GoalStates*>(g) ) {
+        if( 1 == gs->getStateCount() ) s_goal = gs->getState(0);
+    }
+    if( NULL == s_goal ) return false;
+
+    AA_MEM_CPY( start, pdef->getStartState(0)->as<amino::sgStateSpace::StateType>()->values, n_q );
+    AA_MEM_CPY( goal, s_goal->as<amino::sgStateSpace::StateType>()->values, n_q );
+    return true;
+}
+
+/* Replan between configurations q0 and q1, appending the waypoints
+ * after q0 to out */
+static int
+repair( struct aa_rx_mp *mp, const double *q0, const double *q1, double timeout,
+        std::vector<double> &out )
+{
+    amino::sgSpaceInformation::Ptr &si = mp->space_information;
+    amino::sgStateSpace *ss = si->getTypedStateSpace();
+    size_t n_q = ss->config_count_subset();
+
+    ompl::base::ProblemDefinitionPtr pdef( new ompl::base::ProblemDefinition(si) );
+    amino::sgSpaceInformation::ScopedStateType state(si);
+    ss->copy_state( q0, state.get() );
+    pdef->addStartState( state.get() );
+    ompl::base::GoalStates *goal = new ompl::base::GoalStates(si);
+    ss->copy_state( q1, state.get() );
+    goal->addState( state.get() );
+    pdef->setGoal( ompl::base::GoalPtr(goal) );
+
+    if( mp->planner ) mp->planner->clear();
+    ompl::geometric::PathGeometric path(si);
+    int r = aa_rx_mp_solve( mp, pdef, timeout, path );
+    if( mp->planner ) mp->planner->clear();
+    if( r ) return r;
+
+    const std::vector<ompl::base::State*> &states = path.getStates();
+    for( size_t i = 1; i < states.size(); i ++ ) {
+        const double *q = states[i]->as<amino::sgStateSpace::StateType>()->values;
+        out.insert( out.end(), q, q + n_q );
+    }
+    return 0;
+}
+
+int
+aa_rx_mp_library_solve( struct aa_rx_mp_library *lib, struct aa_rx_mp *mp,
+                        double timeout, ompl::geometric::PathGeometric &path )
+{
+    amino::sgSpaceInformation::Ptr &si = mp->space_information;
+    amino::sgStateSpace *ss = si->getTypedStateSpace();
+    size_t n_q = lib->n_q;
+    double t_end = now_sec() + timeout;
+
+    double key[2*n_q];
+    if( 0 == lib->paths.size() || !query_endpoints(mp, n_q, key, key+n_q) ) {
+        return -1;
+    }
+
+    size_t k = mp->library_candidates;
+    size_t idx[k];
+    double d2[k];
+    k = lib->index.nearest_k( key, k, idx, d2 );
+
+    aa_rx_mp_path_checker *checker = aa_rx_mp_get_path_checker( mp );
+    for( size_t c = 0; c < k && now_sec() < t_end && !mp->cancelled; c ++ ) {
+        /* Connect the stored path to the query start and goal */
+        const std::vector<double> &stored = lib->paths[idx[c]];
+        std::vector<double> q_path( key, key + n_q );
+        size_t i0 = (0 == aa_la_ssd(n_q, key, &stored[0])) ? n_q : 0;
+        size_t i1 = stored.size() - n_q;
+        if( 0 != aa_la_ssd(n_q, key+n_q, &stored[i1]) ) i1 += n_q;
+        q_path.insert( q_path.end(), stored.begin() + (ssize_t)i0, stored.begin() + (ssize_t)i1 );
+        q_path.insert( q_path.end(), key + n_q, key + 2*n_q );
+
+        /* Check all segments, then replan each run of invalid ones */
+        std::vector<char> valid;
+        if( amino::sgPathCheck( &checker->problem, n_q, checker->resolution, q_path, valid ) ) {
+            std::vector<double> repaired( q_path.begin(), q_path.begin() + (ssize_t)n_q );
+            size_t n_repairs = 0;
+            bool ok = true;
+            for( size_t i = 0; ok && i < valid.size(); ) {
+                if( valid[i] ) {
+                    repaired.insert( repaired.end(),
+                                     q_path.begin() + (ssize_t)((i+1)*n_q),
+                                     q_path.begin() + (ssize_t)((i+2)*n_q) );
+                    i++;
+                } else {
+                    size_t j = i;
+                    while( j < valid.size() && !valid[j] ) j++;
+                    ok = ( now_sec() < t_end &&
+                           0 == repair( mp, &q_path[i*n_q], &q_path[j*n_q],
+                                        t_end - now_sec(), repaired ) );
+                    n_repairs++;
+                    i = j;
+                }
+            }
+            if( !ok ) continue;
+            lib->stats.n_repairs += n_repairs;
+            q_path.swap( repaired );
+        }
+
+        path.clear();
+        amino::sgSpaceInformation::ScopedStateType state(si);
+        for( size_t j = 0; j < q_path.size(); j += n_q ) {
+            ss->copy_state( &q_path[j], state.get() );
+            path.append( state.get() );
+        }
+        return 0;
+    }
+
+    return -1;
+}
+
+void
+aa_rx_mp_library_record( struct aa_rx_mp_library *lib,
+                         const ompl::geometric::PathGeometric *path,
+                         int hit, double time )
+{
+    struct aa_rx_mp_library_stats *stats = &lib->stats;
+    stats->n_queries++;
+    if( hit ) {
+        stats->n_hits++;
+        stats->time_hits += time;
+    } else {
+        stats->time_misses += time;
+    }
+
+    /* Hits save the mean time of planning from scratch */
+    size_t n_misses = stats->n_queries - stats->n_hits;
+    stats->time_saved = (n_misses > 0) ?
+        (double)stats->n_hits * stats->time_misses / (double)n_misses - stats->time_hits :
+        0;
+
+    if( path && path->getStateCount() >= 2 ) {
+        size_t n_q = lib->n_q;
+        try {
+            std::vector<double> q_path;
+            for( size_t i = 0; i < path->getStateCount(); i ++ ) {
+                const ompl::base::State *s = path->getState((unsigned)i);
+                const double *q = s->as<amino::sgStateSpace::StateType>()->values;
+                q_path.insert( q_path.end(), q, q + n_q );
+            }
+            lib->add( q_path );
+        } catch(...) {
+            /* The path is only a cache entry, so skip it */
+        }
+    }
+}
@@ -0,0 +1,127 @@
+/* -*- mode: C++; c-basic-offset: 4; -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2015, Rice University
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@rice.edu>
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of copyright holder the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <atomic>
+#include <system_error>
+#include <thread>
+
+#include "amino.h"
+#include "amino/rx/rxerr.h"
+#include "amino/rx/rxtype.h"
+#include "amino/rx/scenegraph.h"
+#include "amino/rx/scene_sub.h"
+#include "amino/rx/scene_planning.h"
+
+#include "amino/rx/ompl/scene_state_space.h"
+#include "amino/rx/ompl/scene_ompl_internal.h"
+
+struct aa_rx_mp_job {
+    struct aa_rx_mp *mp;
+    double timeout;
+    std::thread thread;
+    std::atomic<bool> done;
+    int result;
+    size_t n_path;
+    double *path_all;
+};
+
+static void
+job_run( struct aa_rx_mp_job *job )
+{
+    struct aa_rx_mp *mp = job->mp;
+    job->result = aa_rx_mp_plan_run( mp, job->timeout, &job->n_path, &job->path_all );
+
+    /* A cancellation stays set until the next query starts, so a late
+     * aa_rx_mp_job_cancel() cannot leak into it */
+    mp->solution_fun = NULL;
+    mp->solution_cx = NULL;
+    job->done = true;
+}
+
+AA_API struct aa_rx_mp_job *
+aa_rx_mp_plan_async( struct aa_rx_mp *mp,
+                     double timeout,
+                     aa_rx_mp_solution_fun *fun, void *cx )
+{
+    struct aa_rx_mp_job *job = new aa_rx_mp_job;
+    job->mp = mp;
+    job->timeout = timeout;
+    job->done = false;
+    job->result = AA_RX_NO_SOLUTION;
+    job->n_path = 0;
+    job->path_all = NULL;
+
+    /* A cancellation of an earlier query does not apply to this one */
+    mp->cancelled = false;
+    mp->solution_fun = fun;
+    mp->solution_cx = cx;
+
+    try {
+        job->thread = std::thread( job_run, job );
+    } catch( const std::system_error & ) {
+        mp->solution_fun = NULL;
+        mp->solution_cx = NULL;
+        delete job;
+        return NULL;
+    }
+    return job;
+}
+
+AA_API void
+aa_rx_mp_job_cancel( struct aa_rx_mp_job *job )
+{
+    job->mp->cancelled = true;
+}
+
+AA_API int
+aa_rx_mp_job_poll( const struct aa_rx_mp_job *job )
+{
+    return job->done.load();
+}
+
+AA_API int
+aa_rx_mp_job_wait( struct aa_rx_mp_job *job,
+                   size_t *n_path,
+                   double **p_path_all )
+{
+    job->thread.join();
+    int r = job->result;
+    *n_path = job->n_path;
+    *p_path_all = job->path_all;
+    delete job;
+    return r;
+}
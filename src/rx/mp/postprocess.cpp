@@ -0,0 +1,210 @@
+/* -*- mode: C++; c-basic-offset: 4; -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2015, Rice University
+ * All rights reserved.
+ *
+ * Author(s): Neil T. Dantam <ntd@rice.edu>
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of copyright holder the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <thread>
+#include <vector>
+
+#include "amino.h"
+#include "amino/rx/rxerr.h"
+#include "amino/rx/rxtype.h"
+#include "amino/rx/scenegraph.h"
+#include "amino/rx/scenegraph_internal.h"
+#include "amino/rx/scene_kin.h"
+#include "amino/rx/scene_sub.h"
+#include "amino/rx/scene_collision.h"
+#include "amino/rx/scene_planning.h"
+
+#include "amino/rx/ompl/scene_state_space.h"
+#include "amino/rx/ompl/scene_ompl_internal.h"
+#include "amino/rx/ompl/scene_native_path.h"
+
+#include <ompl/geometric/PathGeometric.h>
+
+AA_API void
+aa_rx_mp_set_postprocess( struct aa_rx_mp *mp,
+                          double budget, size_t n_threads )
+{
+    mp->pp_budget = budget;
+    mp->pp_threads = n_threads;
+}
+
+AA_API const struct aa_rx_mp_pp_stats *
+aa_rx_mp_get_postprocess_stats( const struct aa_rx_mp *mp )
+{
+    return &mp->pp_stats;
+}
+
+namespace {
+
+double
+now_sec()
+{
+    return aa_tm_timespec2sec( aa_tm_now() );
+}
+
+} /* namespace */
+
+aa_rx_mp_path_checker::aa_rx_mp_path_checker( struct aa_rx_mp *mp, size_t n_threads_ ) :
+    n_threads(n_threads_),
+    geom_version(aa_rx_sg_geom_version(mp->space_information->getTypedStateSpace()->scene_graph)),
+    ss(mp->space_information->getTypedStateSpace())
+{
+    amino::sgSpaceInformation::Ptr &si = mp->space_information;
+    size_t n_all = ss->config_count_all();
+    size_t n_f = ss->frame_count();
+
+    size_t n = n_threads;
+    if( 0 == n ) {
+        n = std::thread::hardware_concurrency();
+        if( 0 == n ) n = 1;
+    }
+
+    threads.resize(n);
+    for( thread &t : threads ) {
+        t.cl = aa_rx_cl_create( ss->scene_graph );
+        t.q_all.assign( n_all, 0 );
+        t.TF_abs.resize( 7*n_f );
+    }
+
+    problem.cx = this;
+    problem.n_threads = n;
+    problem.is_valid = is_valid;
+
+    resolution = si->getStateValidityCheckingResolution() * si->getMaximumExtent();
+    update(mp);
+}
+
+void
+aa_rx_mp_path_checker::update( struct aa_rx_mp *mp )
+{
+    size_t n_all = ss->config_count_all();
+    for( thread &t : threads ) {
+        aa_rx_cl_allow_reset( t.cl );
+        aa_rx_cl_allow_set( t.cl, ss->allowed );
+        ss->set_moving( t.cl );
+        if( mp->config_start ) {
+            AA_MEM_CPY( t.q_all.data(), mp->config_start, n_all );
+        } else {
+            std::fill( t.q_all.begin(), t.q_all.end(), 0 );
+        }
+    }
+}
+
+struct aa_rx_mp_path_checker *
+aa_rx_mp_get_path_checker( struct aa_rx_mp *mp )
+{
+    aa_rx_mp_path_checker *c = mp->pp_checker;
+    const struct aa_rx_sg *sg = mp->space_information->getTypedStateSpace()->scene_graph;
+    if( c && c->n_threads == mp->pp_threads &&
+        c->geom_version == aa_rx_sg_geom_version(sg) )
+    {
+        c->update(mp);
+    } else {
+        delete c;
+        c = mp->pp_checker = new aa_rx_mp_path_checker( mp, mp->pp_threads );
+    }
+    return c;
+}
+
+aa_rx_mp_path_checker::~aa_rx_mp_path_checker()
+{
+    for( thread &t : threads ) {
+        aa_rx_cl_destroy(t.cl);
+    }
+}
+
+bool
+aa_rx_mp_path_checker::is_valid( void *cx_, size_t i, const double *q )
+{
+    aa_rx_mp_path_checker *cx = (aa_rx_mp_path_checker*)cx_;
+    thread *t = &cx->threads[i];
+    amino::sgStateSpace *ss = cx->ss;
+    size_t n_f = ss->frame_count();
+
+    ss->tf_abs( q, t->q_all.data(), t->TF_abs.data() );
+    return !aa_rx_cl_check( t->cl, n_f, t->TF_abs.data(), 7, NULL );
+}
+
+void
+aa_rx_mp_path_cleanup( struct aa_rx_mp *mp, ompl::geometric::PathGeometric &path )
+{
+    amino::sgSpaceInformation::Ptr &si = mp->space_information;
+    amino::sgStateSpace *ss = si->getTypedStateSpace();
+    struct aa_rx_mp_pp_stats *stats = &mp->pp_stats;
+
+    AA_MEM_ZERO(stats, 1);
+    stats->length_initial = path.length();
+    stats->length_shortcut = stats->length_initial;
+    stats->length_smooth = stats->length_initial;
+    if( mp->pp_budget <= 0 ) return;
+
+    double t_start = now_sec();
+    double t_end = t_start + mp->pp_budget;
+
+    /* Shortcut */
+    size_t n_s = ss->config_count_subset();
+    std::vector<double> q_path;
+    for( ompl::base::State *s : path.getStates() ) {
+        const double *q = s->as<amino::sgStateSpace::StateType>()->values;
+        q_path.insert( q_path.end(), q, q + n_s );
+    }
+
+    aa_rx_mp_path_checker *checker = aa_rx_mp_get_path_checker( mp );
+    stats->n_shortcuts = amino::sgPathShortcut( &checker->problem, n_s, checker->resolution,
+                                                t_end, (unsigned)rand(), q_path );
+
+    double t_shortcut = now_sec();
+    stats->time_shortcut = t_shortcut - t_start;
+    stats->length_shortcut = amino::sgPathLength( n_s, q_path );
+    stats->length_smooth = stats->length_shortcut;
+
+    /* Smooth with any remaining time */
+    if( t_shortcut < t_end ) {
+        amino::sgPathSmooth( &checker->problem, n_s, checker->resolution, t_end,
+                             3, stats->length_shortcut / 100.0, q_path );
+        stats->time_smooth = now_sec() - t_shortcut;
+        stats->length_smooth = amino::sgPathLength( n_s, q_path );
+    }
+
+    ompl::geometric::PathGeometric out(si);
+    amino::sgSpaceInformation::ScopedStateType state(si);
+    for( size_t j = 0; j < q_path.size(); j += n_s ) {
+        ss->copy_state( &q_path[j], state.get() );
+        out.append( state.get() );
+    }
+    path = out;
+}
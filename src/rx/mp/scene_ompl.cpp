@@ -53,13 +53,14 @@
 #include "amino/rx/ompl/scene_state_validity_checker.h"
 #include "amino/rx/ompl/scene_workspace_goal.h"
 #include "amino/rx/ompl/scene_ompl_internal.h"
+#include "amino/rx/ompl/scene_native_rrt.h"
 
 
 #include <ompl/base/Planner.h>
 #include <ompl/base/SpaceInformation.h>
 #include <ompl/geometric/planners/rrt/RRTConnect.h>
 #include <ompl/geometric/PathGeometric.h>
-#include <ompl/geometric/PathSimplifier.h>
+#include <ompl/base/goals/GoalState.h>
 #include <ompl/base/goals/GoalLazySamples.h>
 
 
@@ -73,11 +74,27 @@ aa_rx_mp::aa_rx_mp( const struct aa_rx_sg_sub *sub_sg ) :
             amino::sgSpaceInformation::SpacePtr(
                 new amino::sgStateSpace (sub_sg)))),
     problem_definition(new ompl::base::ProblemDefinition(space_information)),
-    simplify(0),
     validity_checker(new amino::sgStateValidityChecker(space_information.get())),
+    native_rrt(NULL),
+    roadmap(NULL),
+    parallel(NULL),
     lazy_samples(NULL),
-    collisions(NULL)
+    wsg_threads(1),
+    wsg_min_dist(1e-2),
+    ik_fun(NULL),
+    ik_context(NULL),
+    reach_map(NULL),
+    collisions(NULL),
+    pp_budget(0),
+    pp_threads(0),
+    pp_checker(NULL),
+    library(NULL),
+    library_candidates(0),
+    cancelled(false),
+    solution_fun(NULL),
+    solution_cx(NULL)
 {
+    AA_MEM_ZERO(&pp_stats, 1);
 
     space_information->setStateValidityChecker( ompl::base::StateValidityCheckerPtr(validity_checker) );
     space_information->setup();
@@ -101,6 +118,24 @@ aa_rx_mp_destroy( struct aa_rx_mp *mp )
 aa_rx_mp::~aa_rx_mp()
 {
     if( this->collisions ) aa_rx_cl_set_destroy(this->collisions);
+    delete this->native_rrt;
+    aa_rx_mp_roadmap_destroy(this->roadmap);
+    aa_rx_mp_parallel_destroy(this->parallel);
+    delete this->pp_checker;
+}
+
+void
+aa_rx_mp::set_native( amino::sgRRTConnect *p )
+{
+    delete this->native_rrt;
+    this->native_rrt = p;
+}
+
+void
+aa_rx_mp::set_roadmap( struct aa_rx_mp_roadmap *p )
+{
+    aa_rx_mp_roadmap_destroy(this->roadmap);
+    this->roadmap = p;
 }
 
 AA_API void
@@ -111,13 +146,13 @@ aa_rx_mp_set_start( struct aa_rx_mp *mp,
     /* Assume the start state is valid */
     aa_rx_mp_allow_config(mp, n_all, q_all);
 
-    // FIXME: Seems that there are problems if this is called repeatedly
     amino::sgSpaceInformation::Ptr &si = mp->space_information;
     amino::sgStateSpace *ss = si->getTypedStateSpace();
 
-    /* Add Start State */
+    /* Replace Start State */
     amino::sgSpaceInformation::ScopedStateType state(si);
     ss->extract_state( q_all, state.get() );
+    mp->problem_definition->clearStartStates();
     mp->problem_definition->addStartState(state);
 
 
@@ -126,6 +161,39 @@ aa_rx_mp_set_start( struct aa_rx_mp *mp,
     mp->config_start = AA_MEM_DUP(double, q_all, n_all);
 }
 
+AA_API void
+aa_rx_mp_reset( struct aa_rx_mp *mp )
+{
+    /* Goal, which owns any workspace goal sampler */
+    if( mp->lazy_samples ) {
+        mp->lazy_samples->stopSampling();
+        mp->lazy_samples = NULL;
+    }
+    mp->problem_definition->clearGoal();
+
+    /* Start */
+    mp->problem_definition->clearStartStates();
+    mp->problem_definition->clearSolutionPaths();
+    aa_checked_free(mp->config_start);
+    mp->config_start = NULL;
+
+    /* Collisions allowed for earlier start configurations */
+    mp->space_information->getTypedStateSpace()->reset_allowed();
+    mp->validity_checker->reset_allowed();
+
+    /* Planner data.  The native planner clears its trees on each
+     * solve, and the persistent roadmap is meant to outlive queries. */
+    if( mp->planner ) {
+        mp->planner->clear();
+    }
+
+    if( mp->collisions ) {
+        aa_rx_cl_set_clear( mp->collisions );
+    }
+    AA_MEM_ZERO(&mp->pp_stats, 1);
+    mp->cancelled = false;
+}
+
 AA_API void
 aa_rx_mp_allow_config( struct aa_rx_mp *mp,
                        size_t n_all,
@@ -165,6 +233,11 @@ aa_rx_mp_set_goal( struct aa_rx_mp *mp,
 
     mp->validity_checker->allow();
     if( si->isValid( state.get() ) ) {
+        /* Any workspace goal sampler goes with the old goal */
+        if( mp->lazy_samples ) {
+            mp->lazy_samples->stopSampling();
+            mp->lazy_samples = NULL;
+        }
         mp->problem_definition->setGoalState(state);
         return AA_RX_OK;
     } else {
@@ -172,24 +245,165 @@ aa_rx_mp_set_goal( struct aa_rx_mp *mp,
     }
 }
 
-static void
-path_cleanup( struct aa_rx_mp *mp, ompl::geometric::PathGeometric &path )
+void
+aa_rx_mp_path_output( struct aa_rx_mp *mp, ompl::geometric::PathGeometric &path,
+                      size_t *n_path, double **p_path_all )
+{
+    amino::sgStateSpace *ss = mp->space_information->getTypedStateSpace();
+
+    /* Allocate a simple array */
+    *n_path = path.getStateCount();
+    *p_path_all = (double*)calloc( *n_path * ss->config_count_all(),
+                                   sizeof(double) );
+
+    /* Fill array */
+    std::vector< ompl::base::State *> &states = path.getStates();
+    double *ptr = *p_path_all;
+    for( auto itr = states.begin(); itr != states.end(); itr++, ptr += ss->config_count_all() )
+    {
+        AA_MEM_CPY( ptr, mp->config_start, ss->config_count_all() );
+        amino::sgSpaceInformation::StateType *state = amino::sgSpaceInformation::state_as(*itr);
+        ss->insert_state( state, ptr );
+    }
+}
+
+/* Native planner callbacks */
+struct native_cx {
+    struct aa_rx_mp *mp;
+    const ompl::base::GoalState *goal;
+    const ompl::base::GoalStates *goals;
+    const ompl::base::GoalLazySamples *lazy;
+    unsigned i_goal;
+};
+
+static bool
+native_is_valid( void *cx_, const double *q )
+{
+    struct native_cx *cx = (struct native_cx*)cx_;
+    return cx->mp->validity_checker->is_valid_config(q);
+}
+
+static int
+native_next_goal( void *cx_, double *q )
+{
+    struct native_cx *cx = (struct native_cx*)cx_;
+    amino::sgStateSpace *ss = cx->mp->space_information->getTypedStateSpace();
+    const ompl::base::State *s = NULL;
+    if( cx->goal ) {
+        if( 0 == cx->i_goal++ ) s = cx->goal->getState();
+    } else if( cx->i_goal < cx->goals->getStateCount() ) {
+        s = cx->goals->getState(cx->i_goal++);
+    }
+
+    if( s ) {
+        AA_MEM_CPY( q, s->as<amino::sgStateSpace::StateType>()->values,
+                    ss->config_count_subset() );
+        return 1;
+    } else if( cx->lazy && cx->lazy->isSampling() ) {
+        return 0;
+    } else {
+        return -1;
+    }
+}
+
+static bool
+native_is_cancelled( void *cx_ )
+{
+    struct native_cx *cx = (struct native_cx*)cx_;
+    return cx->mp->cancelled.load();
+}
+
+static int
+plan_native( struct aa_rx_mp *mp, const ompl::base::ProblemDefinitionPtr &pdef,
+             double timeout, ompl::geometric::PathGeometric &path )
 {
     amino::sgSpaceInformation::Ptr &si = mp->space_information;
+    amino::sgStateSpace *ss = si->getTypedStateSpace();
+    size_t n_s = ss->config_count_subset();
+
+    struct native_cx cx;
+    cx.mp = mp;
+    /* aa_rx_mp_set_goal() gives a GoalState; workspace and multiple
+     * goals give GoalStates or GoalLazySamples */
+    const ompl::base::Goal *g = pdef->getGoal().get();
+    cx.goal = dynamic_cast<const ompl::base::GoalState*>(g);
+    cx.goals = dynamic_cast<const ompl::base::GoalStates*>(g);
+    cx.lazy = dynamic_cast<const ompl::base::GoalLazySamples*>(g);
+    cx.i_goal = 0;
+    if( NULL == cx.goal && NULL == cx.goals ) return -1;
+
+    size_t n_start = pdef->getStartStateCount();
+    std::vector<double> start(n_s * n_start);
+    for( size_t i = 0; i < n_start; i ++ ) {
+        const ompl::base::State *s = pdef->getStartState((unsigned)i);
+        AA_MEM_CPY( &start[i*n_s], s->as<amino::sgStateSpace::StateType>()->values, n_s );
+    }
 
-    if( mp->simplify ) {
-        ompl::geometric::PathSimplifier ps(si);
-        int n = (int)path.getStateCount();
-        path.interpolate(n*10);
+    amino::sgNativeProblem prob;
+    prob.cx = &cx;
+    prob.is_valid = native_is_valid;
+    prob.next_goal = native_next_goal;
+    prob.is_cancelled = native_is_cancelled;
+    prob.n_start = n_start;
+    prob.start = start.data();
 
-        for( int i = 0; i < 10; i ++ ) {
-            ps.reduceVertices(path);
-            ps.collapseCloseVertices(path);
-            ps.shortcutPath(path);
-        }
+    std::vector<double> q_path;
+    int r = mp->roadmap ?
+        aa_rx_mp_roadmap_solve( mp->roadmap, &prob, timeout, q_path ) :
+        mp->native_rrt->solve( &prob, timeout, q_path );
+    if( r ) return r;
+
+    amino::sgSpaceInformation::ScopedStateType state(si);
+    for( size_t j = 0; j < q_path.size(); j += n_s ) {
+        ss->copy_state( &q_path[j], state.get() );
+        path.append( state.get() );
+    }
+    return 0;
+}
 
-        ps.smoothBSpline(path, 3, path.length()/100.0);
+int
+aa_rx_mp_solve( struct aa_rx_mp *mp, const ompl::base::ProblemDefinitionPtr &pdef,
+                double timeout, ompl::geometric::PathGeometric &path )
+{
+    if( mp->native_rrt || mp->roadmap ) {
+        return plan_native(mp, pdef, timeout, path);
     }
+
+    ompl::base::PlannerPtr planner = (NULL == mp->planner.get()) ?
+        ompl::base::PlannerPtr(new ompl::geometric::RRTConnect(mp->space_information)) :
+        mp->planner;
+    planner->setProblemDefinition(pdef);
+    planner->solve( ompl::base::plannerOrTerminationCondition(
+                        ompl::base::timedPlannerTerminationCondition(timeout),
+                        ompl::base::PlannerTerminationCondition(
+                            [mp]{ return mp->cancelled.load(); } ) ) );
+    if( ! pdef->hasSolution() ) return -1;
+
+    const ompl::base::PathPtr &path_ptr = pdef->getSolutionPath();
+    path = static_cast<ompl::geometric::PathGeometric&>(*path_ptr);
+    return 0;
+}
+
+static double
+now_sec()
+{
+    return aa_tm_timespec2sec( aa_tm_now() );
+}
+
+/* Pass an anytime planner's improved solution to the user callback */
+static void
+report_solution( struct aa_rx_mp *mp, const std::vector<const ompl::base::State*> &states )
+{
+    amino::sgStateSpace *ss = mp->space_information->getTypedStateSpace();
+    size_t n_all = ss->config_count_all();
+    std::vector<double> path_all( states.size() * n_all );
+    double *ptr = path_all.data();
+    for( const ompl::base::State *s : states ) {
+        AA_MEM_CPY( ptr, mp->config_start, n_all );
+        ss->insert_state( s->as<amino::sgStateSpace::StateType>(), ptr );
+        ptr += n_all;
+    }
+    mp->solution_fun( mp->solution_cx, states.size(), path_all.data() );
 }
 
 AA_API int
@@ -198,9 +412,21 @@ aa_rx_mp_plan( struct aa_rx_mp *mp,
                size_t *n_path,
                double **p_path_all )
 {
+    /* A cancellation of an earlier query does not apply to this one */
+    mp->cancelled = false;
+    return aa_rx_mp_plan_run( mp, timeout, n_path, p_path_all );
+}
+
+int
+aa_rx_mp_plan_run( struct aa_rx_mp *mp,
+                   double timeout,
+                   size_t *n_path,
+                   double **p_path_all )
+{
 
     amino::sgSpaceInformation::Ptr &si = mp->space_information;
     amino::sgStateSpace *ss = si->getTypedStateSpace();
+    double t_start = now_sec();
 
     /* Configure State Validity Checker */
     mp->validity_checker->allow();
@@ -216,12 +442,38 @@ aa_rx_mp_plan( struct aa_rx_mp *mp,
     *p_path_all = NULL;
 
     ompl::base::ProblemDefinitionPtr &pdef = mp->problem_definition;
+    ompl::geometric::PathGeometric path(si);
+
+    /* Try stored paths first, leaving at least half the time for
+     * planning from scratch */
+    if( mp->library ) {
+        int r;
+        try {
+            r = aa_rx_mp_library_solve( mp->library, mp, timeout/2, path );
+        } catch(...) {
+            r = -1;
+        }
+        if( 0 == r ) {
+            aa_rx_mp_path_cleanup(mp, path);
+            aa_rx_mp_library_record( mp->library, &path, 1, now_sec() - t_start );
+            aa_rx_mp_path_output(mp, path, n_path, p_path_all);
+            return AA_RX_OK;
+        }
+        timeout -= now_sec() - t_start;
+    }
 
-    ompl::base::PlannerPtr planner = (NULL == mp->planner.get()) ?
-        ompl::base::PlannerPtr(new ompl::geometric::RRTConnect(si)) :
-        mp->planner;
+    if( mp->solution_fun ) {
+        pdef->setIntermediateSolutionCallback(
+            [mp]( const ompl::base::Planner*,
+                  const std::vector<const ompl::base::State*> &states,
+                  const ompl::base::Cost ) {
+                report_solution( mp, states );
+            } );
+    } else {
+        pdef->setIntermediateSolutionCallback( ompl::base::ReportIntermediateSolutionFn() );
+    }
 
-    planner->setProblemDefinition(pdef);
+    int result = -1;
     try {
         if( mp->lazy_samples ) {
             fprintf(stderr, "Starting sampling thread\n");
@@ -229,7 +481,7 @@ aa_rx_mp_plan( struct aa_rx_mp *mp,
             mp->lazy_samples->setStart(ss->config_count_all(), mp->config_start);
             mp->lazy_samples->startSampling();
         }
-        planner->solve(timeout);
+        result = aa_rx_mp_solve(mp, pdef, timeout, path);
         if( mp->lazy_samples ) {
             fprintf(stderr, "Stopping sampling thread\n");
             mp->lazy_samples->stopSampling();
@@ -237,37 +489,27 @@ aa_rx_mp_plan( struct aa_rx_mp *mp,
     } catch(...) {
         return AA_RX_NO_SOLUTION;
     }
-    if( pdef->hasSolution() ) {
-        const ompl::base::PathPtr &path_ptr = pdef->getSolutionPath();
-        ompl::geometric::PathGeometric &path = static_cast<ompl::geometric::PathGeometric&>(*path_ptr);
-        path_cleanup(mp, path);
-
-
-        /* Allocate a simple array */
-        *n_path = path.getStateCount();
-        *p_path_all = (double*)calloc( *n_path * ss->config_count_all(),
-                                       sizeof(double) );
-
-        /* Fill array */
-        std::vector< ompl::base::State *> &states = path.getStates();
-        double *ptr = *p_path_all;
-        for( auto itr = states.begin(); itr != states.end(); itr++, ptr += ss->config_count_all() )
-        {
-            AA_MEM_CPY( ptr, mp->config_start, ss->config_count_all() );
-            amino::sgSpaceInformation::StateType *state = amino::sgSpaceInformation::state_as(*itr);
-            ss->insert_state( state, ptr );
+
+    if( result ) {
+        if( mp->library ) {
+            aa_rx_mp_library_record( mp->library, NULL, 0, now_sec() - t_start );
         }
-        return AA_RX_OK;
-    } else {
         return AA_RX_NO_SOLUTION | AA_RX_NO_MP;
     }
+
+    aa_rx_mp_path_cleanup(mp, path);
+    if( mp->library ) {
+        aa_rx_mp_library_record( mp->library, &path, 0, now_sec() - t_start );
+    }
+    aa_rx_mp_path_output(mp, path, n_path, p_path_all);
+    return AA_RX_OK;
 }
 
 AA_API void
 aa_rx_mp_set_simplify( struct aa_rx_mp *mp,
                        int simplify )
 {
-    mp->simplify = simplify ? 1 : 0;
+    aa_rx_mp_set_postprocess( mp, simplify ? 1.0 : 0.0, 0 );
 }
 
 AA_API void
@@ -86,6 +86,32 @@ sgStateSpace::sgStateSpace( const struct aa_rx_sg_sub *sub_sg ) :
 
         // Load allowable configs from scenegraph
         aa_rx_sg_cl_set_copy(scene_graph, allowed);
+
+        // Partition frames into those the sub-scenegraph moves and
+        // those it cannot
+        size_t n_q = config_count_all();
+        size_t n_f = frame_count();
+        bool in_sub[n_q];
+        std::fill( in_sub, in_sub + n_q, false );
+        for( size_t i = 0; i < n_configs; i ++ ) {
+            in_sub[aa_rx_sg_sub_config(sub_scene_graph, i)] = true;
+        }
+        for( size_t i = 0; i < n_q; i ++ ) {
+            if( !in_sub[i] ) static_configs.push_back((aa_rx_config_id)i);
+        }
+
+        bool moving[n_f];
+        for( size_t i = 0; i < n_f; i ++ ) {
+            aa_rx_config_id cid = aa_rx_sg_frame_config(scene_graph, (aa_rx_frame_id)i);
+            aa_rx_frame_id parent = aa_rx_sg_frame_parent(scene_graph, (aa_rx_frame_id)i);
+            moving[i] = ( (AA_RX_CONFIG_NONE != cid && in_sub[cid]) ||
+                          (parent >= 0 && moving[parent]) );
+            if( moving[i] ) moving_frames.push_back((aa_rx_frame_id)i);
+        }
+
+        static_q.resize( static_configs.size() );
+        static_tf.resize( 7*n_f );
+        static_valid = false;
     }
 
 double * sgStateSpace::get_tf_abs( const ompl::base::State *state)
@@ -99,23 +125,59 @@ double * sgStateSpace::get_tf_abs( const ompl::base::State *state)
 double * sgStateSpace::get_tf_abs( const ompl::base::State *state_, const double *q_all )
 {
     const StateType *state = state_->as<StateType>();
+    return this->get_tf_abs(state->values, q_all);
+}
+
+double * sgStateSpace::get_tf_abs( const double *q_set, const double *q_all )
+{
+    double *TF_abs = AA_MEM_REGION_NEW_N(&this->reg, double, 7*frame_count());
+    this->tf_abs(q_set, q_all, TF_abs);
+    return TF_abs;
+}
+
+void sgStateSpace::set_static( const double *q_all )
+{
     size_t n_q = this->config_count_all();
-    size_t n_s = this->config_count_subset();
     size_t n_f = this->frame_count();
+    for( size_t i = 0; i < static_configs.size(); i ++ ) {
+        static_q[i] = q_all[static_configs[i]];
+    }
+    std::vector<double> TF_rel(7*n_f);
+    aa_rx_sg_tf( this->scene_graph, n_q, q_all,
+                 n_f,
+                 TF_rel.data(), 7,
+                 static_tf.data(), 7 );
+    static_valid = true;
+}
+
+void sgStateSpace::tf_abs( const double *q_set, const double *q_all, double *TF_abs )
+{
+    size_t n_q = this->config_count_all();
+    size_t n_f = this->frame_count();
+    size_t n_static = static_configs.size();
 
-    // Set configs
     double q[n_q];
     std::copy( q_all, q_all + n_q, q );
-    this->insert_state(state, q);
+    this->insert_state(q_set, q);
 
-    // Find TFs
-    double TF_rel[7*n_f];
-    double *TF_abs = AA_MEM_REGION_NEW_N(&this->reg, double, 7*n_f);
-    aa_rx_sg_tf( this->scene_graph, n_q, q,
-                 n_f,
-                 TF_rel, 7,
-                 TF_abs, 7 );
-    return TF_abs;
+    bool cached = static_valid;
+    for( size_t i = 0; cached && i < n_static; i ++ ) {
+        cached = (q_all[static_configs[i]] == static_q[i]);
+    }
+
+    if( cached ) {
+        // Static frames from the cache, then the moving frames
+        std::copy( static_tf.begin(), static_tf.end(), TF_abs );
+        aa_rx_sg_tf_frames( this->scene_graph, n_q, q,
+                            moving_frames.size(), moving_frames.data(),
+                            n_f, TF_abs, 7 );
+    } else {
+        double TF_rel[7*n_f];
+        aa_rx_sg_tf( this->scene_graph, n_q, q,
+                     n_f,
+                     TF_rel, 7,
+                     TF_abs, 7 );
+    }
 }
 
 } /* namespace amino */
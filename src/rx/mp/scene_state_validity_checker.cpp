@@ -56,6 +56,8 @@ sgStateValidityChecker::sgStateValidityChecker(sgSpaceInformation *si)
     cl(aa_rx_cl_create(getTypedStateSpace()->scene_graph)),
     collisions(NULL)
 {
+    AA_MEM_ZERO(q_all, getTypedStateSpace()->config_count_all());
+    getTypedStateSpace()->set_moving(cl);
     this->allow();
 }
 
@@ -66,6 +68,11 @@ sgStateValidityChecker::~sgStateValidityChecker()
 }
 
 bool sgStateValidityChecker::isValid(const ompl::base::State *state) const
+{
+    return is_valid_config( state->as<sgStateSpace::StateType>()->values );
+}
+
+bool sgStateValidityChecker::is_valid_config(const double *q_set) const
 {
     sgStateSpace *space = getTypedStateSpace();
     size_t n_f = space->frame_count();
@@ -74,7 +81,7 @@ bool sgStateValidityChecker::isValid(const ompl::base::State *state) const
     // check collision
     {
         std::lock_guard<std::mutex> lock(mutex);
-        double *TF_abs = space->get_tf_abs(state, this->q_all);
+        double *TF_abs = space->get_tf_abs(q_set, this->q_all);
         is_collision = aa_rx_cl_check( cl, n_f, TF_abs, 7, this->collisions );
         space->region_pop(TF_abs);
     }
@@ -87,6 +94,9 @@ void sgStateValidityChecker::set_start( size_t n_q, double *q_initial)
 {
     assert( n_q == getTypedStateSpace()->config_count_all() );
     std::copy( q_initial, q_initial + n_q, q_all );
+    /* Static frames may have moved */
+    getTypedStateSpace()->set_static(q_all);
+    getTypedStateSpace()->set_moving(cl);
     this->allow();
 }
 
@@ -95,4 +105,10 @@ void sgStateValidityChecker::allow( )
     aa_rx_cl_allow_set( cl, getTypedStateSpace()->allowed );
 }
 
+void sgStateValidityChecker::reset_allowed( )
+{
+    aa_rx_cl_allow_reset( cl );
+    this->allow();
+}
+
 } /* namespace amino */
@@ -36,6 +36,13 @@
  *
  */
 
+#include <atomic>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include "amino.h"
 #include "amino/rx/rxerr.h"
@@ -56,11 +63,326 @@ namespace ob = ::ompl::base;
 namespace amino {
 
 
+/* IK and collision checking context for one sampling worker */
+struct sgGoalWorker {
+    struct aa_rx_ksol_opts *ko;
+    struct aa_rx_ik_jac_cx *ik_cx;
+    ob::StateSamplerPtr state_sampler;
+    sgSpaceInformation::StateType *seed;
+    struct aa_rx_cl *cl;
+    std::vector<double> qs;
+    std::vector<double> q_all;
+    std::vector<double> TF_abs;
+    std::vector<double> best;
+};
+
+/* Goals queued ahead of the planner; workers pause when it is full */
+static const size_t pool_queue_max = 16;
+
+/* Recent goals kept for deduplication */
+static const size_t pool_recent_max = 256;
+
+struct sgGoalPool {
+    std::vector<sgGoalWorker> workers;
+    std::vector<std::thread> threads;
+    std::atomic<bool> stop{true};
+
+    std::mutex mutex;
+    /* Signalled when a goal is queued or the pool stops */
+    std::condition_variable cond;
+    /* Signalled when the queue has room or the pool stops */
+    std::condition_variable space;
+    /* Set by stopSampling() so the sampling thread neither waits on
+     * nor restarts the workers */
+    bool halt = false;
+    /* Goals awaiting the OMPL sampling thread */
+    std::deque< std::vector<double> > queue;
+    /* Ring of the last pool_recent_max queued goals, for deduplication */
+    std::vector<double> recent;
+    size_t n_recent = 0;
+};
+
+static void
+init_opts( const sgWorkspaceGoal *wsg, struct aa_rx_ksol_opts *ko )
+{
+    const struct aa_rx_sg_sub *ssg = wsg->typed_si->getTypedStateSpace()->sub_scene_graph;
+    // TODO: multiple frames
+    aa_rx_ksol_opts_set_frame(ko, wsg->frames[0]);
+
+    /* These settings should be optional */
+    aa_rx_ksol_opts_center_seed(ko, ssg);
+    aa_rx_ksol_opts_center_configs(ko, ssg, .1);
+    aa_rx_ksol_opts_set_tol_dq(ko, .01);
+}
+
+static void
+pool_destroy_workers( sgGoalPool *pool, sgSpaceInformation *si )
+{
+    for( sgGoalWorker &w : pool->workers ) {
+        si->freeState(w.seed);
+        aa_rx_ik_jac_cx_destroy(w.ik_cx);
+        aa_rx_ksol_opts_destroy(w.ko);
+        aa_rx_cl_destroy(w.cl);
+    }
+    pool->workers.clear();
+}
+
+/* Wake everything waiting on the pool and tell workers to exit */
+static void
+pool_signal_stop( sgGoalPool *pool, bool halt )
+{
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        pool->stop = true;
+        if( halt ) pool->halt = true;
+    }
+    pool->cond.notify_all();
+    pool->space.notify_all();
+}
+
+static void
+pool_stop( sgGoalPool *pool )
+{
+    pool_signal_stop(pool, false);
+    for( std::thread &t : pool->threads ) t.join();
+    pool->threads.clear();
+}
+
+/* Is q within min_dist of a recent goal?  Caller holds the lock. */
+static bool
+pool_is_duplicate( const sgGoalPool *pool, size_t n_s, const double *q, double min_dist )
+{
+    double d2_min = min_dist*min_dist;
+    for( size_t i = 0; i < pool->recent.size(); i += n_s ) {
+        double d2 = 0;
+        for( size_t j = 0; j < n_s; j ++ ) {
+            double d = q[j] - pool->recent[i+j];
+            d2 += d*d;
+        }
+        if( d2 <= d2_min ) return true;
+    }
+    return false;
+}
+
+/* Remember q for deduplication, replacing the oldest goal when full.
+ * Caller holds the lock. */
+static void
+pool_remember( sgGoalPool *pool, size_t n_s, const double *q )
+{
+    if( pool->recent.size() < pool_recent_max * n_s ) {
+        pool->recent.insert( pool->recent.end(), q, q + n_s );
+    } else {
+        size_t i = (pool->n_recent % pool_recent_max) * n_s;
+        std::copy( q, q + n_s, pool->recent.begin() + (std::ptrdiff_t)i );
+    }
+    pool->n_recent++;
+}
+
+/* Number of candidate seeds per IK attempt with a reach map */
+static const size_t reach_seed_candidates = 8;
+
+/*
+ * Draw an IK seed.  With a reach map, draw several candidates and keep
+ * the one whose map frame lands nearest its goal, discounted by the
+ * manipulability the map records there.  q_all supplies variables
+ * outside the sub-scenegraph; TF_abs and best are scratch.
+ */
+static void
+sample_seed( const sgWorkspaceGoal *wsg, ob::StateSampler *sampler,
+             sgSpaceInformation::StateType *seed,
+             const double *q_all, double *TF_abs, double *best )
+{
+    sampler->sampleUniform(seed);
+    if( NULL == wsg->reach_map || wsg->reach_goal >= wsg->n_e ) return;
+
+    amino::sgStateSpace *ss = wsg->typed_si->getTypedStateSpace();
+    size_t n_s = ss->config_count_subset();
+    const double *E_ref = wsg->E + 7*wsg->reach_goal;
+    aa_rx_frame_id frame = wsg->frames[wsg->reach_goal];
+
+    double score_min = INFINITY;
+    for( size_t k = 0; k < reach_seed_candidates; k ++ ) {
+        if( k ) sampler->sampleUniform(seed);
+        ss->tf_abs( seed->values, q_all, TF_abs );
+        const double *E = TF_abs + 7*frame;
+        double dv[3];
+        for( size_t j = 0; j < 3; j ++ ) {
+            dv[j] = E_ref[AA_TF_QUTR_T+j] - E[AA_TF_QUTR_T+j];
+        }
+        double d = wsg->weight_orientation * aa_tf_qangle_rel( E_ref + AA_TF_QUTR_Q,
+                                                               E + AA_TF_QUTR_Q )
+            + wsg->weight_translation * sqrt( AA_TF_VDOT(dv, dv) );
+        double m = aa_rx_reach_map_manip( wsg->reach_map, E );
+        double score = d / (1 + AA_MAX(0.0, m));
+        if( score < score_min ) {
+            score_min = score;
+            AA_MEM_CPY( best, seed->values, n_s );
+        }
+    }
+    AA_MEM_CPY( seed->values, best, n_s );
+}
+
+static void
+pool_worker( const sgWorkspaceGoal *wsg, sgGoalWorker *w )
+{
+    sgGoalPool *pool = wsg->pool;
+    amino::sgStateSpace *ss = wsg->typed_si->getTypedStateSpace();
+    const struct aa_rx_sg_sub *ssg = ss->sub_scene_graph;
+    size_t n_all = ss->config_count_all();
+    size_t n_s = ss->config_count_subset();
+    size_t n_f = ss->frame_count();
+    double *q_all = w->q_all.data();
+    double *qs = w->qs.data();
+
+    for(;;) {
+        /* Pause while the planner has enough goals */
+        {
+            std::unique_lock<std::mutex> lock(pool->mutex);
+            pool->space.wait( lock, [pool]{
+                    return pool->stop || pool->queue.size() < pool_queue_max; } );
+            if( pool->stop ) break;
+        }
+
+        /* Re-seed */
+        if( wsg->q_start ) {
+            AA_MEM_CPY(q_all, wsg->q_start, n_all);
+        } else {
+            AA_MEM_ZERO(q_all, n_all);
+        }
+        sample_seed( wsg, w->state_sampler.get(), w->seed,
+                     q_all, w->TF_abs.data(), w->best.data() );
+        aa_rx_sg_sub_config_set( ssg,
+                                 n_s, w->seed->values,
+                                 n_all, q_all );
+        aa_rx_ksol_opts_take_seed( w->ko, n_all, q_all, AA_MEM_COPY );
+
+        /* solve */
+        if( AA_RX_OK != aa_rx_ik_jac_solve( w->ik_cx,
+                                            wsg->n_e, wsg->E, 7,
+                                            n_s, qs ) )
+        {
+            continue;
+        }
+
+        /* filter */
+        ss->copy_state( qs, w->seed );
+        if( ! wsg->typed_si->satisfiesBounds(w->seed) ) continue;
+
+        ss->tf_abs( qs, q_all, w->TF_abs.data() );
+        if( aa_rx_cl_check( w->cl, n_f, w->TF_abs.data(), 7, NULL ) ) continue;
+
+        /* push */
+        {
+            std::lock_guard<std::mutex> lock(pool->mutex);
+            if( pool_is_duplicate(pool, n_s, qs, wsg->min_dist) ) continue;
+            pool_remember( pool, n_s, qs );
+            pool->queue.emplace_back( qs, qs + n_s );
+        }
+        pool->cond.notify_one();
+    }
+}
+
+static void
+pool_start( const sgWorkspaceGoal *wsg, size_t n_threads )
+{
+    sgGoalPool *pool = wsg->pool;
+    sgSpaceInformation *si = wsg->typed_si.get();
+    amino::sgStateSpace *ss = si->getTypedStateSpace();
+    size_t n_f = ss->frame_count();
+
+    if( pool->workers.size() != n_threads ) {
+        pool_destroy_workers(pool, si);
+        pool->workers.resize(n_threads);
+        for( sgGoalWorker &w : pool->workers ) {
+            w.ko = aa_rx_ksol_opts_create();
+            init_opts(wsg, w.ko);
+            w.ik_cx = aa_rx_ik_jac_cx_create(ss->sub_scene_graph, w.ko);
+            w.state_sampler = si->allocStateSampler();
+            w.seed = si->allocTypedState();
+            w.cl = aa_rx_cl_create( ss->scene_graph );
+            w.qs.resize( ss->config_count_subset() );
+            w.q_all.resize( ss->config_count_all() );
+            w.TF_abs.resize( 7*n_f );
+            w.best.resize( ss->config_count_subset() );
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        if( pool->halt ) return;
+        pool->stop = false;
+    }
+    for( sgGoalWorker &w : pool->workers ) {
+        /* Allowed collisions may change between plans */
+        aa_rx_cl_allow_reset( w.cl );
+        aa_rx_cl_allow_set( w.cl, ss->allowed );
+        /* The start configuration may change between plans */
+        ss->set_moving( w.cl );
+        try {
+            pool->threads.emplace_back( pool_worker, wsg, &w );
+        } catch( ... ) {
+            break;
+        }
+    }
+}
+
+static bool
+sampler_inline( const sgWorkspaceGoal *wsg, ob::State *state );
+
+/* Wait for a goal from the pool */
+static bool
+sampler_pool( const sgWorkspaceGoal *wsg, ob::State *state, size_t n_threads )
+{
+    sgGoalPool *pool = wsg->pool;
+    if( pool->stop ) {
+        /* Reap workers left from an earlier sampling run */
+        pool_stop(pool);
+    }
+    if( pool->threads.empty() ) {
+        pool_start(wsg, n_threads);
+        if( pool->threads.empty() ) {
+            if( pool->halt ) return false;
+            /* Could not start threads */
+            return sampler_inline(wsg, state);
+        }
+    }
+
+    /* Workers are joined by sgWorkspaceGoal::stopSampling() */
+    std::unique_lock<std::mutex> lock(pool->mutex);
+    pool->cond.wait( lock, [pool]{ return pool->stop || !pool->queue.empty(); } );
+    if( pool->queue.empty() ) return false;
+
+    amino::sgStateSpace *ss = wsg->typed_si->getTypedStateSpace();
+    ss->copy_state( pool->queue.front().data(), wsg->typed_si->state_as(state) );
+    pool->queue.pop_front();
+    lock.unlock();
+    pool->space.notify_one();
+    return true;
+}
+
 static bool
 sampler_fun( const ob::GoalLazySamples *arg, ob::State *state )
 {
     const sgWorkspaceGoal *wsg = static_cast<const sgWorkspaceGoal*>(arg);
 
+    size_t n_threads = wsg->n_threads;
+    if( 0 == n_threads ) {
+        n_threads = std::thread::hardware_concurrency();
+        if( 0 == n_threads ) n_threads = 1;
+    }
+
+    /* A user IK function may not be reentrant, so it stays on one thread */
+    if( n_threads > 1 && NULL == wsg->ik_fun ) {
+        return sampler_pool(wsg, state, n_threads);
+    } else {
+        return sampler_inline(wsg, state);
+    }
+}
+
+static bool
+sampler_inline( const sgWorkspaceGoal *wsg, ob::State *state )
+{
+
     amino::sgStateSpace *ss = wsg->typed_si->getTypedStateSpace();
     const struct aa_rx_sg_sub *ssg = ss->sub_scene_graph;
     const struct aa_rx_sg *sg = ss->scene_graph;
@@ -69,27 +391,37 @@ sampler_fun( const ob::GoalLazySamples *arg, ob::State *state )
     size_t n_all = aa_rx_sg_config_count(sg);
     size_t n_s = aa_rx_sg_sub_config_count(ssg);
     double qs[n_s];
+    std::vector<double> TF_abs( 7*ss->frame_count() );
+    std::vector<double> best( n_s );
 
     int r = AA_RX_NO_IK;
 
     while( AA_RX_OK != r && wsg->isSampling() ) {
         /* Re-seed */
-        wsg->state_sampler->sampleUniform(wsg->seed);
         double q[n_all];
         if( wsg->q_start ) {
             AA_MEM_CPY(q, wsg->q_start, n_all);
         } else {
             AA_MEM_ZERO(q,n_all);
         }
+        sample_seed( wsg, wsg->state_sampler.get(), wsg->seed,
+                     q, TF_abs.data(), best.data() );
         aa_rx_sg_sub_config_set( ssg,
                                  n_s, wsg->seed->values,
                                  n_all, q );
         aa_rx_ksol_opts_take_seed( wsg->ko, n_all, q, AA_MEM_COPY );
 
         /* solve */
-        r = aa_rx_ik_jac_solve( wsg->ik_cx,
-                                wsg->n_e, wsg->E, 7,
-                                n_s, qs );
+        if( wsg->ik_fun ) {
+            AA_MEM_CPY( qs, wsg->seed->values, n_s );
+            r = wsg->ik_fun( wsg->ik_fun_cx,
+                             wsg->n_e, wsg->E, 7,
+                             n_s, qs );
+        } else {
+            r = aa_rx_ik_jac_solve( wsg->ik_cx,
+                                    wsg->n_e, wsg->E, 7,
+                                    n_s, qs );
+        }
     }
 
     if( AA_RX_OK == r ) {
@@ -109,12 +441,19 @@ sgWorkspaceGoal::sgWorkspaceGoal (const sgSpaceInformation::Ptr &si,
     ob::GoalLazySamples(si, ob::GoalSamplingFn(sampler_fun), false),
     ko( aa_rx_ksol_opts_create() ),
     ik_cx( aa_rx_ik_jac_cx_create(si->getTypedStateSpace()->sub_scene_graph, ko) ),
+    ik_fun(NULL),
+    ik_fun_cx(NULL),
     n_e(n_e_),
     state_sampler( si->allocStateSampler() ),
     seed(typed_si->allocTypedState()),
     q_start(NULL),
     weight_orientation(1),
-    weight_translation(1)
+    weight_translation(1),
+    n_threads(1),
+    min_dist(1e-2),
+    reach_map(NULL),
+    reach_goal(n_e_),
+    pool(new sgGoalPool)
 {
     const struct aa_rx_sg_sub *ssg = si->getTypedStateSpace()->sub_scene_graph;
     const struct aa_rx_sg *sg = si->getTypedStateSpace()->scene_graph;
@@ -129,8 +468,6 @@ sgWorkspaceGoal::sgWorkspaceGoal (const sgSpaceInformation::Ptr &si,
         aa_rx_frame_id id_last = aa_rx_sg_sub_frame(ssg, n_s-1);
         AA_MEM_SET(this->frames, id_last, n_e);
     }
-    // TODO: multiple frames
-    aa_rx_ksol_opts_set_frame(ko, this->frames[0]);
 
     /* Set goals */
     this->E = new double[n_e*7];
@@ -138,15 +475,18 @@ sgWorkspaceGoal::sgWorkspaceGoal (const sgSpaceInformation::Ptr &si,
                    E_arg, (int)ldE,
                    this->E, 7 );
 
-    /* These settings should be optional */
-    aa_rx_ksol_opts_center_seed(ko, ssg);
-    aa_rx_ksol_opts_center_configs(ko, ssg, .1);
-    aa_rx_ksol_opts_set_tol_dq(ko, .01);
+    init_opts(this, ko);
 }
 
 
 sgWorkspaceGoal::~sgWorkspaceGoal ()
 {
+    /* The sampling thread uses our members, so stop it before
+     * GoalLazySamples::~GoalLazySamples() would. */
+    this->stopSampling();
+    pool_destroy_workers(pool, typed_si.get());
+    delete pool;
+
     typed_si->freeState(this->seed);
     aa_rx_ksol_opts_destroy(this->ko);
     aa_rx_ik_jac_cx_destroy(this->ik_cx);
@@ -157,9 +497,38 @@ sgWorkspaceGoal::~sgWorkspaceGoal ()
 
 void sgWorkspaceGoal::setStart(size_t n_all, double *q)
 {
+    aa_checked_free( this->q_start );
     this->q_start = q ? AA_MEM_DUP(double, q, n_all) : NULL;
 }
 
+void sgWorkspaceGoal::startSampling()
+{
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        pool->halt = false;
+    }
+    ob::GoalLazySamples::startSampling();
+}
+
+void sgWorkspaceGoal::stopSampling()
+{
+    /* Wake the sampling thread if it waits on the pool, then join it */
+    pool_signal_stop(pool, true);
+    ob::GoalLazySamples::stopSampling();
+    pool_stop(pool);
+}
+
+void sgWorkspaceGoal::clear()
+{
+    this->stopSampling();
+    ob::GoalLazySamples::clear();
+
+    std::lock_guard<std::mutex> lock(pool->mutex);
+    pool->queue.clear();
+    pool->recent.clear();
+    pool->n_recent = 0;
+}
+
 
 // unsigned int sgWorkspaceGoal::maxSampleCount () const
 // {
@@ -205,6 +574,22 @@ aa_rx_mp_set_wsgoal( struct aa_rx_mp *mp,
     // TODO: add interface to set IK options for motion planner
     amino::sgWorkspaceGoal *g = new amino::sgWorkspaceGoal(mp->space_information,
                                                            n_e, frames, E, ldE);
+    if( mp->reach_map ) {
+        /* The map only biases seeds; a map miss is not a proof of
+         * unreachability. */
+        aa_rx_frame_id frame = aa_rx_reach_map_frame(mp->reach_map);
+        for( size_t i = 0; i < n_e; i ++ ) {
+            if( g->frames[i] == frame ) {
+                g->reach_map = mp->reach_map;
+                g->reach_goal = i;
+                break;
+            }
+        }
+    }
+    g->ik_fun = mp->ik_fun;
+    g->ik_fun_cx = mp->ik_context;
+    g->n_threads = mp->wsg_threads;
+    g->min_dist = mp->wsg_min_dist;
     mp->problem_definition->setGoal(ompl::base::GoalPtr(g));
     mp->lazy_samples = g;
     return 0;
@@ -246,3 +631,34 @@ aa_rx_mp_set_wsgoal( struct aa_rx_mp *mp,
     // }
 
 }
+
+AA_API void
+aa_rx_mp_set_wsgoal_pool( struct aa_rx_mp *mp,
+                          size_t n_threads, double min_dist )
+{
+    mp->wsg_threads = n_threads;
+    mp->wsg_min_dist = min_dist;
+    if( mp->lazy_samples ) {
+        mp->lazy_samples->n_threads = n_threads;
+        mp->lazy_samples->min_dist = min_dist;
+    }
+}
+
+AA_API void
+aa_rx_mp_set_reach_map( struct aa_rx_mp *mp,
+                        const struct aa_rx_reach_map *map )
+{
+    mp->reach_map = map;
+}
+
+AA_API void
+aa_rx_mp_set_ik_fun( struct aa_rx_mp *mp,
+                     aa_rx_ik_fun *ik_fun, void *ik_context )
+{
+    mp->ik_fun = ik_fun;
+    mp->ik_context = ik_context;
+    if( mp->lazy_samples ) {
+        mp->lazy_samples->ik_fun = ik_fun;
+        mp->lazy_samples->ik_fun_cx = ik_context;
+    }
+}
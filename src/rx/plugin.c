@@ -45,6 +45,8 @@
 #include "amino/rx/scenegraph_internal.h"
 #include "amino/rx/scene_geom.h"
 #include "amino/rx/scene_geom_internal.h"
+#include "amino/rx/scene_kin.h"
+#include "amino/rx/scene_kin_internal.h"
 #include "amino/rx/scene_plugin.h"
 
 
@@ -131,3 +133,28 @@ aa_rx_dl_sg( const char *filename, const char *name,
         return NULL;
     }
 }
+
+AA_API struct aa_rx_ik_analytic_cx *
+aa_rx_dl_ik_analytic( const char *filename, const char *name,
+                      const struct aa_rx_sg_sub *ssg,
+                      const struct aa_rx_ksol_opts *opts )
+{
+    struct aa_rx_ik_analytic_cx *cx = aa_rx_ik_analytic_cx_create(ssg, opts);
+    if( NULL == cx ) return NULL;
+
+    size_t n = strlen(name);
+    char buf[32+n];
+    snprintf(buf, sizeof(buf), "aa_rx_dl_ik__%s", name);
+
+    void *handle;
+    aa_rx_dl_ik_fun fun = (aa_rx_dl_ik_fun)rx_dlopen(filename, buf, &handle);
+    if(fun) {
+        cx->dl_kernel = fun;
+        cx->destructor = plugin_destructor;
+        cx->destructor_context = handle;
+        return cx;
+    } else {
+        aa_rx_ik_analytic_cx_destroy(cx);
+        return NULL;
+    }
+}
@@ -46,6 +46,10 @@ aa_rx_sg_sub_destroy( struct aa_rx_sg_sub *ssg )
 {
     if( ssg->frames ) free( ssg->frames );
     if( ssg->configs ) free( ssg->configs );
+    if( ssg->ees ) free( ssg->ees );
+    if( ssg->ee_col_ptr ) free( ssg->ee_col_ptr );
+    if( ssg->ee_cols ) free( ssg->ee_cols );
+    if( ssg->col_frames ) free( ssg->col_frames );
 
     free(ssg);
 }
@@ -96,8 +100,21 @@ aa_rx_sg_sub_frame( const struct aa_rx_sg_sub *sg_sub, size_t i )
 AA_API aa_rx_frame_id
 aa_rx_sg_sub_frame_ee( const struct aa_rx_sg_sub *sg_sub )
 {
-    // Only handling chains for now
-    return aa_rx_sg_sub_frame(sg_sub, aa_rx_sg_sub_frame_count(sg_sub) - 1 );
+    return ( sg_sub->ee_count > 0 )
+        ? sg_sub->ees[0]
+        : AA_RX_FRAME_NONE;
+}
+
+AA_API size_t
+aa_rx_sg_sub_ee_count( const struct aa_rx_sg_sub *sg_sub )
+{
+    return sg_sub->ee_count;
+}
+
+AA_API aa_rx_frame_id
+aa_rx_sg_sub_ee( const struct aa_rx_sg_sub *sg_sub, size_t i )
+{
+    return sg_sub->ees[i];
 }
 
 AA_API aa_rx_config_id*
@@ -256,6 +273,20 @@ aa_rx_sg_sub_expand_path( const struct aa_rx_sg_sub *ssg, size_t n_pts,
 }
 
 
+/* Find the joint frame of each configuration */
+static void
+sub_col_frames( struct aa_rx_sg_sub *ssg )
+{
+    const struct aa_rx_sg *sg = ssg->scenegraph;
+    size_t n_c = ssg->config_count;
+    ssg->col_frames = AA_NEW_AR(aa_rx_frame_id, AA_MAX(n_c,1));
+    for( size_t i = 0, j = 0; i < ssg->frame_count && j < n_c; i ++ ) {
+        if( AA_RX_FRAME_FIXED != aa_rx_sg_frame_type(sg, ssg->frames[i]) ) {
+            ssg->col_frames[j++] = ssg->frames[i];
+        }
+    }
+}
+
 AA_API struct aa_rx_sg_sub *
 aa_rx_sg_chain_create( const struct aa_rx_sg *sg,
                        aa_rx_frame_id root, aa_rx_frame_id tip )
@@ -273,9 +304,103 @@ aa_rx_sg_chain_create( const struct aa_rx_sg *sg,
     aa_rx_sg_chain_configs( sg, ssg->frame_count, ssg->frames,
                             ssg->config_count, ssg->configs );
 
+    /* The chain tip is the end-effector, moved by every configuration */
+    ssg->ee_count = (ssg->frame_count > 0) ? 1 : 0;
+    ssg->ees = AA_NEW_AR(aa_rx_frame_id, 1);
+    ssg->ees[0] = (ssg->frame_count > 0) ? ssg->frames[ssg->frame_count-1] : AA_RX_FRAME_NONE;
+    ssg->ee_col_ptr = AA_NEW_AR(size_t, 2);
+    ssg->ee_col_ptr[0] = 0;
+    ssg->ee_col_ptr[1] = ssg->config_count;
+    ssg->ee_cols = AA_NEW_AR(size_t, ssg->config_count);
+    for( size_t i = 0; i < ssg->config_count; i ++ ) {
+        ssg->ee_cols[i] = i;
+    }
+    sub_col_frames( ssg );
+
+    return ssg;
+}
+
+static int
+frame_id_cmp( const void *a, const void *b )
+{
+    aa_rx_frame_id x = *(const aa_rx_frame_id*)a;
+    aa_rx_frame_id y = *(const aa_rx_frame_id*)b;
+    return (x > y) - (x < y);
+}
+
+AA_API struct aa_rx_sg_sub *
+aa_rx_sg_tree_create( const struct aa_rx_sg *sg,
+                      aa_rx_frame_id root,
+                      size_t n_tips, const aa_rx_frame_id *tips )
+{
+    struct aa_rx_sg_sub *ssg = AA_NEW( struct aa_rx_sg_sub );
+    ssg->scenegraph = sg;
+
+    /* Union of the chain frames, sorted so parents precede children */
+    size_t n_max = 0;
+    for( size_t k = 0; k < n_tips; k ++ ) {
+        n_max += aa_rx_sg_chain_frame_count( sg, root, tips[k] );
+    }
+    ssg->frames = AA_NEW_AR(aa_rx_frame_id, AA_MAX(n_max,1) );
+    size_t n_f = 0;
+    for( size_t k = 0; k < n_tips; k ++ ) {
+        size_t n_c = aa_rx_sg_chain_frame_count( sg, root, tips[k] );
+        aa_rx_sg_chain_frames( sg, root, tips[k], n_c, ssg->frames + n_f );
+        n_f += n_c;
+    }
+    qsort( ssg->frames, n_f, sizeof(ssg->frames[0]), frame_id_cmp );
+    ssg->frame_count = 0;
+    for( size_t i = 0; i < n_f; i ++ ) {
+        if( 0 == ssg->frame_count ||
+            ssg->frames[i] != ssg->frames[ssg->frame_count-1] )
+        {
+            ssg->frames[ssg->frame_count++] = ssg->frames[i];
+        }
+    }
+
+    ssg->config_count = aa_rx_sg_chain_config_count( sg, ssg->frame_count, ssg->frames );
+    ssg->configs = AA_NEW_AR(aa_rx_config_id, ssg->config_count );
+    aa_rx_sg_chain_configs( sg, ssg->frame_count, ssg->frames,
+                            ssg->config_count, ssg->configs );
+
+    /* Configurations on the path to each tip */
+    ssg->ee_count = n_tips;
+    ssg->ees = AA_NEW_AR(aa_rx_frame_id, AA_MAX(n_tips,1));
+    AA_MEM_CPY( ssg->ees, tips, n_tips );
+    ssg->ee_col_ptr = AA_NEW_AR(size_t, n_tips+1);
+    ssg->ee_cols = AA_NEW_AR(size_t, AA_MAX(n_tips*ssg->config_count,1));
+    size_t n_cols = 0;
+    for( size_t k = 0; k < n_tips; k ++ ) {
+        ssg->ee_col_ptr[k] = n_cols;
+        for( size_t j = 0; j < ssg->config_count; j ++ ) {
+            for( aa_rx_frame_id f = tips[k]; f != root && f >= 0;
+                 f = aa_rx_sg_frame_parent(sg, f) )
+            {
+                if( AA_RX_FRAME_FIXED != aa_rx_sg_frame_type(sg, f) &&
+                    aa_rx_sg_frame_config(sg, f) == ssg->configs[j] )
+                {
+                    ssg->ee_cols[n_cols++] = j;
+                    break;
+                }
+            }
+        }
+    }
+    ssg->ee_col_ptr[n_tips] = n_cols;
+    sub_col_frames( ssg );
+
     return ssg;
 }
 
+AA_API void
+aa_rx_sg_sub_tf( const struct aa_rx_sg_sub *ssg,
+                 size_t n_q_all, const double *q_all,
+                 size_t n_tf, double *TF_abs, size_t ld_TF )
+{
+    aa_rx_sg_tf_frames( ssg->scenegraph, n_q_all, q_all,
+                        ssg->frame_count, ssg->frames,
+                        n_tf, TF_abs, ld_TF );
+}
+
 AA_API void
 aa_rx_sg_chain_jacobian( const struct aa_rx_sg *sg,
                          size_t n_tf, const double *TF_abs, size_t ld_TF,
@@ -339,7 +464,7 @@ AA_API void
 aa_rx_sg_sub_jacobian_size( const struct aa_rx_sg_sub *ssg,
                             size_t *rows, size_t *cols )
 {
-    *rows = 6;
+    *rows = 6*ssg->ee_count;
     *cols = ssg->config_count;
 
 }
@@ -349,11 +474,56 @@ aa_rx_sg_sub_jacobian( const struct aa_rx_sg_sub *ssg,
                        size_t n_tf, const double *TF_abs, size_t ld_TF,
                        double *J, size_t ld_J )
 {
-    aa_rx_sg_chain_jacobian( ssg->scenegraph,
-                             n_tf, TF_abs, ld_TF,
-                             ssg->frame_count, ssg->frames,
-                             ssg->config_count, ssg->configs,
-                             J, ld_J );
+    if( 1 == ssg->ee_count &&
+        ssg->ee_col_ptr[1] == ssg->config_count &&
+        ssg->ees[0] == ssg->frames[ssg->frame_count-1] )
+    {
+        /* Chain */
+        aa_rx_sg_chain_jacobian( ssg->scenegraph,
+                                 n_tf, TF_abs, ld_TF,
+                                 ssg->frame_count, ssg->frames,
+                                 ssg->config_count, ssg->configs,
+                                 J, ld_J );
+        return;
+    }
+
+    /* Tree: stack the rows of each end-effector, filling only the
+     * columns that move it */
+    const struct aa_rx_sg *sg = ssg->scenegraph;
+    size_t n_c = ssg->config_count;
+
+    for( size_t j = 0; j < n_c; j ++ ) {
+        AA_MEM_ZERO( J + j*ld_J, 6*ssg->ee_count );
+    }
+
+    for( size_t k = 0; k < ssg->ee_count; k ++ ) {
+        const double *pe = TF_abs + (size_t)ssg->ees[k] * ld_TF + AA_TF_QUTR_T;
+        for( size_t p = ssg->ee_col_ptr[k]; p < ssg->ee_col_ptr[k+1]; p ++ ) {
+            size_t j = ssg->ee_cols[p];
+            aa_rx_frame_id frame = ssg->col_frames[j];
+            assert( (size_t)frame < n_tf );
+            double *Jr = J + j*ld_J + 6*k + AA_TF_DX_W;
+            double *Jt = J + j*ld_J + 6*k + AA_TF_DX_V;
+            const double *a = aa_rx_sg_frame_axis(sg, frame);
+            const double *E = TF_abs + (size_t)frame*ld_TF;
+            const double *q = E+AA_TF_QUTR_Q;
+            const double *t = E+AA_TF_QUTR_T;
+            switch( aa_rx_sg_frame_type(sg, frame) ) {
+            case AA_RX_FRAME_REVOLUTE: {
+                aa_tf_qrot(q,a,Jr);
+                double tmp[3];
+                for( size_t i = 0; i < 3; i++ ) tmp[i] = pe[i] - t[i];
+                aa_tf_cross(Jr, tmp, Jt);
+                break;
+            }
+            case AA_RX_FRAME_PRISMATIC:
+                aa_tf_qrot(q,a,Jt);
+                break;
+            default: assert(0);
+            }
+        }
+    }
+    (void)n_tf;
 }
 
 AA_API void
@@ -377,7 +547,9 @@ aa_rx_sg_sub_center_configs( const struct aa_rx_sg_sub *ssg,
 AA_API double *
 aa_rx_sg_sub_alloc_jacobian( const struct aa_rx_sg_sub *ssg, struct aa_mem_region *region )
 {
-    return AA_MEM_REGION_NEW_N( region, double, 6*aa_rx_sg_sub_config_count(ssg) );
+    size_t rows, cols;
+    aa_rx_sg_sub_jacobian_size( ssg, &rows, &cols );
+    return AA_MEM_REGION_NEW_N( region, double, rows*cols );
 }
 
 AA_API double *
@@ -58,7 +58,9 @@ SceneFrame::SceneFrame(
     type(type_),
     name(_name),
     parent(_parent),
-    inertial(NULL)
+    inertial(NULL),
+    geom_version(0),
+    tf_version(0)
 {
     AA_MEM_CPY(E+AA_TF_QUTR_Q, q ? q : aa_tf_quat_ident, 4);
     AA_MEM_CPY(E+AA_TF_QUTR_V, v ? v : aa_tf_vec_ident, 3);
@@ -200,7 +202,9 @@ void SceneFrameRevolute::tf_rel( const double *q, double _E[7] )
 
 SceneGraph::SceneGraph()
     : dirty_indices(0),
-      destructor(NULL)
+      destructor(NULL),
+      geom_version(0),
+      geom_version_all(0)
 {}
 
 SceneGraph::~SceneGraph()
@@ -329,9 +333,12 @@ void
 aa_rx_sg_add_geom( aa_rx_sg *scene_graph, const char *frame,
                    struct aa_rx_geom* geom )
 {
-    aa_rx_sg_dirty_geom( scene_graph );
+    amino::SceneGraph *sg = scene_graph->sg;
+    sg->dirty_gl = 1;
+    sg->dirty_collision = 1;
     aa_rx_scene_frame *f = aa_rx_sg_find(scene_graph, frame);
     f->geometry.push_back(geom);
+    f->geom_version = ++sg->geom_version;
 }
 
 AA_API void
@@ -340,6 +347,39 @@ aa_rx_sg_dirty_geom( struct aa_rx_sg *scene_graph )
     amino::SceneGraph *sg = scene_graph->sg;
     sg->dirty_gl = 1;
     sg->dirty_collision = 1;
+    sg->geom_version_all = ++sg->geom_version;
+}
+
+AA_API void
+aa_rx_sg_frame_dirty_geom( struct aa_rx_sg *scene_graph,
+                           aa_rx_frame_id frame_id )
+{
+    amino::SceneGraph *sg = scene_graph->sg;
+    aa_rx_sg_ensure_clean_frames(scene_graph);
+    sg->dirty_gl = 1;
+    sg->dirty_collision = 1;
+    sg->frames[(size_t)frame_id]->geom_version = ++sg->geom_version;
+}
+
+AA_API uint64_t
+aa_rx_sg_geom_version( const struct aa_rx_sg *scene_graph )
+{
+    return scene_graph->sg->geom_version;
+}
+
+AA_API uint64_t
+aa_rx_sg_frame_geom_version( const struct aa_rx_sg *scene_graph,
+                             aa_rx_frame_id frame_id )
+{
+    amino::SceneGraph *sg = scene_graph->sg;
+    aa_rx_sg_ensure_clean_frames(scene_graph);
+    uint64_t v = AA_MAX( sg->frames[(size_t)frame_id]->geom_version,
+                         sg->geom_version_all );
+    /* Moving a frame moves the geometry of its descendants */
+    for( aa_rx_frame_id i = frame_id; i >= 0; i = sg->frames[(size_t)i]->parent_id ) {
+        v = AA_MAX( v, sg->frames[(size_t)i]->tf_version );
+    }
+    return v;
 }
 
 AA_API void
@@ -233,6 +233,35 @@ AA_API void aa_rx_sg_tf
     }
 }
 
+AA_API void aa_rx_sg_tf_frames
+( const struct aa_rx_sg *scene_graph,
+  size_t n_q, const double *q,
+  size_t n_frames, const aa_rx_frame_id *frames,
+  size_t n_tf,
+  double *TF_abs, size_t ld_abs )
+{
+    aa_rx_sg_ensure_clean_frames( scene_graph );
+    assert( n_q == scene_graph->sg->config_size );
+    (void)n_q;
+    (void)n_tf;
+
+    amino::SceneGraph *sg = scene_graph->sg;
+    for( size_t i = 0; i < n_frames; i ++ ) {
+        size_t i_frame = (size_t)frames[i];
+        assert( i_frame < n_tf && i_frame < sg->frames.size() );
+
+        amino::SceneFrame *f = sg->frames[i_frame];
+        double *E_abs = TF_abs + ld_abs*i_frame;
+        if( f->in_global() ) {
+            f->tf_rel( q, E_abs );
+        } else {
+            double E_rel[7];
+            f->tf_rel( q, E_rel );
+            double *E_abs_parent = TF_abs + (ld_abs * (size_t)f->parent_id);
+            aa_tf_qutr_mul(E_abs_parent, E_rel, E_abs);
+        }
+    }
+}
 
 
 AA_API void aa_rx_sg_tf_update
@@ -561,6 +590,7 @@ AA_API void aa_rx_sg_reparent_name (const struct aa_rx_sg *scene_graph,
     AA_MEM_CPY(f->E, E1, 7);
 
     scene_graph->sg->dirty_indices = 1;
+    f->tf_version = ++scene_graph->sg->geom_version;
 }
 
 struct sg_copy_geom_cx{
@@ -663,6 +693,19 @@ aa_rx_sg_allow_collision_name( struct aa_rx_sg *scene_graph,
     scene_graph->sg->dirty_collision = 1;
 }
 
+AA_API int
+aa_rx_sg_is_collision_allowed( const struct aa_rx_sg *scene_graph,
+                               aa_rx_frame_id id0, aa_rx_frame_id id1 )
+{
+    /* Pairs hold the frames' own name pointers, ordered by name */
+    const char *name0 = aa_rx_sg_frame_name(scene_graph, id0);
+    const char *name1 = aa_rx_sg_frame_name(scene_graph, id1);
+    std::pair<const char*, const char*> p = (strcmp(name0, name1) < 0)
+        ? std::make_pair(name0, name1)
+        : std::make_pair(name1, name0);
+    return scene_graph->sg->allowed.count(p) > 0;
+}
+
 AA_API double *
 aa_rx_sg_alloc_tf ( const struct aa_rx_sg *sg, struct aa_mem_region *region )
 {
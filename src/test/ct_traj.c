@@ -44,6 +44,9 @@
 
 #include "amino/ct/state.h"
 #include "amino/ct/traj.h"
+#include "amino/ct/stream.h"
+
+#include <pthread.h>
 
 void
 test_tjX(void)
@@ -272,6 +275,54 @@ test_tjq_check( struct aa_mem_region *reg,
     aveq("Traj q Final", n_q, state1->q, vstate->q, 1e-3);
 }
 
+void
+test_tjq_random_access( struct aa_mem_region *reg,
+                        struct aa_ct_seg_list *seg_list )
+{
+    size_t n_q = aa_ct_seg_list_n_q(seg_list);
+    double duration = aa_ct_seg_list_duration(seg_list);
+    struct aa_ct_state *state = aa_ct_state_alloc(reg, n_q, 0);
+
+    /* Sorted times, including both ends */
+    size_t n_t = 64;
+    double *t = AA_MEM_REGION_NEW_N(reg, double, n_t);
+    for( size_t j = 0; j < n_t; j ++ ) {
+        t[j] = duration * (double)j / (double)(n_t-1);
+    }
+    t[n_t-1] = duration;
+
+    double *Q = AA_MEM_REGION_NEW_N(reg, double, n_q*n_t);
+    double *Qg = AA_MEM_REGION_NEW_N(reg, double, n_q*n_t);
+
+    /* Reverse order */
+    for( size_t j = n_t; j > 0; j -- ) {
+        int r = aa_ct_seg_list_eval(seg_list, state, t[j-1]);
+        test( "Traj reverse eval", AA_CT_SEG_IN == r );
+        AA_MEM_CPY(Q + (j-1)*n_q, state->q, n_q);
+    }
+
+    /* Grid */
+    int r = aa_ct_seg_list_eval_grid(seg_list, n_t, t, n_q, Qg, n_q);
+    test( "Traj grid eval", AA_CT_SEG_IN == r );
+    aveq("Traj grid", n_q*n_t, Q, Qg, 1e-9);
+
+    /* Random order with a stale hint */
+    size_t hint = 0;
+    for( size_t k = 0; k < n_t; k ++ ) {
+        size_t j = (size_t)(aa_frand() * (double)n_t) % n_t;
+        r = aa_ct_seg_list_eval_hint(seg_list, state, t[j], &hint);
+        test( "Traj random eval", AA_CT_SEG_IN == r );
+        aveq("Traj random", n_q, Q + j*n_q, state->q, 1e-9);
+    }
+
+    /* Outside the trajectory */
+    test( "Traj eval before", AA_CT_SEG_OUT == aa_ct_seg_list_eval(seg_list, state, -1) );
+    test( "Traj eval after",
+          AA_CT_SEG_OUT == aa_ct_seg_list_eval(seg_list, state, duration + 1) );
+
+    aa_mem_region_pop(reg, state);
+}
+
 void
 test_tjq(size_t n_p)
 {
@@ -328,12 +379,471 @@ test_tjq(size_t n_p)
                         &limit, 1, 0);
         test_tjq_check( &reg, pt_list, lin_list,
                         &limit, 1, 0);
+        test_tjq_random_access( &reg, pb_list );
+        test_tjq_random_access( &reg, lin_list );
+
+        struct aa_ct_seg_list *topp_list =
+            aa_ct_tjq_topp_generate(&reg, pt_list, &limit, NULL);
+        test( "Traj TOPP generate", NULL != topp_list );
+        test_tjq_check( &reg, pt_list, topp_list,
+                        &limit, 1, 0);
+        test_tjq_random_access( &reg, topp_list );
+
+        double dddq_max[n_q];
+        for (size_t j = 0; j < n_q; j++) dddq_max[j] = aa_frand() + .5;
+        struct aa_ct_seg_list *quintic_list =
+            aa_ct_tjq_quintic_generate(&reg, pt_list, &limit, dddq_max);
+        test_tjq_check( &reg, pt_list, quintic_list,
+                        &limit, 1, 1);
+        test_tjq_random_access( &reg, quintic_list );
+    }
+
+    aa_ct_pt_list_destroy(pt_list);
+    aa_mem_region_destroy(&reg);
+}
+
+void
+test_tjq_dense(void)
+{
+    size_t n_p = 1000, n_q = 7, n_t = 20000;
+
+    struct aa_mem_region reg;
+    aa_mem_region_init(&reg, 512);
+
+    struct aa_ct_pt_list *pt_list = aa_ct_pt_list_create(&reg);
+    double q[n_q];
+    for (size_t i = 0; i < n_p; i++) {
+        aa_vrand(n_q, q);
+        aa_ct_pt_list_add_q(pt_list, n_q, q);
+    }
+
+    struct aa_ct_state lim_max, lim_min;
+    double dq_max[n_q], ddq_max[n_q], dq_min[n_q], ddq_min[n_q];
+    struct aa_ct_limit limit = {.max = &lim_max, .min=&lim_min};
+    limit.max->n_q = limit.min->n_q = n_q;
+    limit.max->dq = dq_max;
+    limit.max->ddq = ddq_max;
+    limit.min->dq = dq_min;
+    limit.min->ddq = ddq_min;
+    for (size_t j = 0; j < n_q; j++) {
+        dq_max[j] = ddq_max[j] = 1;
+        dq_min[j] = ddq_min[j] = -1;
+    }
+
+    struct aa_ct_seg_list *lists[] = {
+        aa_ct_tjq_pb_generate(&reg, pt_list, &limit),
+        aa_ct_tjq_lin_generate(&reg, pt_list, &limit)
+    };
+
+    for (size_t k = 0; k < sizeof(lists)/sizeof(lists[0]); k++) {
+        struct aa_ct_seg_list *segs = lists[k];
+        double duration = aa_ct_seg_list_duration(segs);
+        double *t = AA_MEM_REGION_NEW_N(&reg, double, n_t);
+        for (size_t j = 0; j < n_t; j++) {
+            t[j] = duration * (double)j / (double)(n_t-1);
+        }
+        t[n_t-1] = duration;
+
+        double *Q = AA_MEM_REGION_NEW_N(&reg, double, n_q*n_t);
+        int r = aa_ct_seg_list_eval_grid(segs, n_t, t, n_q, Q, n_q);
+        test( "Dense grid eval", AA_CT_SEG_IN == r );
+
+        for (size_t j = 0; j < n_t; j += 97) {
+            aa_ct_seg_list_eval_q(segs, t[j], n_q, q);
+            aveq("Dense grid", n_q, Q + j*n_q, q, 1e-9);
+        }
+
+        test( "Dense continuous",
+              0 == aa_ct_seg_list_check_c0(segs, duration / (double)n_t, 1, 1e-6) );
+        aa_ct_seg_list_destroy(segs);
     }
 
     aa_ct_pt_list_destroy(pt_list);
     aa_mem_region_destroy(&reg);
 }
 
+void
+test_tjq_topp_specific_numbers(void)
+{
+    struct aa_mem_region reg;
+    aa_mem_region_init(&reg, 512);
+
+    /* A single segment is a trapezoidal velocity profile */
+    struct aa_ct_pt_list *pt_list = aa_ct_pt_list_create(&reg);
+    double q1[1] = {1}, q2[1] = {3};
+    aa_ct_pt_list_add_q(pt_list, 1, q1);
+    aa_ct_pt_list_add_q(pt_list, 1, q2);
+
+    double dqlimMax[1] = {2}, ddqlimMax[1] = {4};
+    double dqlimMin[1] = {-2}, ddqlimMin[1] = {-4};
+    struct aa_ct_state max = {0}, min = {0};
+    max.n_q = min.n_q = 1;
+    max.dq = dqlimMax;
+    max.ddq = ddqlimMax;
+    min.dq = dqlimMin;
+    min.ddq = ddqlimMin;
+    struct aa_ct_limit limits = {.min = &min, .max = &max};
+
+    struct aa_ct_seg_list *seg_list =
+        aa_ct_tjq_topp_generate(&reg, pt_list, &limits, NULL);
+    test( "TOPP generate", NULL != seg_list );
+
+    /* Accelerate for .5s, cruise for .5s, decelerate for .5s */
+    test_feq( "TOPP duration", aa_ct_seg_list_duration(seg_list), 1.5, 1e-2 );
+
+    struct aa_ct_state *state = aa_ct_state_alloc(&reg, 1, 0);
+    aa_ct_seg_list_eval(seg_list, state, .75);
+    test_feq( "TOPP State at t = .75 ", state->q[0], 2, 1e-2);
+    test_feq( "TOPP Vel at t = .75 ", state->dq[0], 2, 1e-2);
+
+    aa_ct_seg_list_eval(seg_list, state, .25);
+    test_feq( "TOPP Accel at t = .25 ", state->ddq[0], 4, 1e-2);
+
+    /* Unreachable without breaking the limits */
+    min.ddq[0] = 0;
+    test( "TOPP infeasible",
+          NULL == aa_ct_tjq_topp_generate(&reg, pt_list, &limits, NULL) );
+
+    aa_ct_seg_list_destroy(seg_list);
+    aa_ct_pt_list_destroy(pt_list);
+    aa_mem_region_destroy(&reg);
+}
+
+void
+test_tjq_topp_degenerate(void)
+{
+    struct aa_mem_region reg;
+    aa_mem_region_init(&reg, 512);
+
+    double dqlimMax[2] = {2,2}, ddqlimMax[2] = {4,4};
+    double dqlimMin[2] = {-2,-2}, ddqlimMin[2] = {-4,-4};
+    struct aa_ct_state max = {0}, min = {0};
+    max.n_q = min.n_q = 2;
+    max.dq = dqlimMax;
+    max.ddq = ddqlimMax;
+    min.dq = dqlimMin;
+    min.ddq = ddqlimMin;
+    struct aa_ct_limit limits = {.min = &min, .max = &max};
+    struct aa_ct_state *state = aa_ct_state_alloc(&reg, 2, 0);
+
+    /* Repeated waypoints are skipped */
+    {
+        struct aa_ct_pt_list *pt_list = aa_ct_pt_list_create(&reg);
+        double q0[2] = {0,0}, q1[2] = {1,0}, q2[2] = {1,1};
+        aa_ct_pt_list_add_q(pt_list, 2, q0);
+        aa_ct_pt_list_add_q(pt_list, 2, q1);
+        aa_ct_pt_list_add_q(pt_list, 2, q1);
+        aa_ct_pt_list_add_q(pt_list, 2, q2);
+        struct aa_ct_seg_list *seg_list =
+            aa_ct_tjq_topp_generate(&reg, pt_list, &limits, NULL);
+        test( "TOPP repeated generate", NULL != seg_list );
+
+        /* The corner does not overshoot the waypoints */
+        double dur = aa_ct_seg_list_duration(seg_list);
+        test( "TOPP repeated duration", isfinite(dur) && dur > 0 );
+        int in_box = 1;
+        for( double t = 0; t <= dur; t += dur / 200 ) {
+            aa_ct_seg_list_eval(seg_list, state, t);
+            in_box = in_box && isfinite(state->q[0]) && isfinite(state->q[1]) &&
+                state->q[0] >= -1e-9 && state->q[0] <= 1 + 1e-9 &&
+                state->q[1] >= -1e-9 && state->q[1] <= 1 + 1e-9;
+        }
+        test( "TOPP monotone", in_box );
+
+        aa_ct_seg_list_destroy(seg_list);
+        aa_ct_pt_list_destroy(pt_list);
+    }
+
+    /* Coincident waypoints rest in place */
+    {
+        struct aa_ct_pt_list *pt_list = aa_ct_pt_list_create(&reg);
+        double q0[2] = {1,2};
+        aa_ct_pt_list_add_q(pt_list, 2, q0);
+        aa_ct_pt_list_add_q(pt_list, 2, q0);
+        struct aa_ct_seg_list *seg_list =
+            aa_ct_tjq_topp_generate(&reg, pt_list, &limits, NULL);
+        test( "TOPP rest generate", NULL != seg_list );
+        test_feq( "TOPP rest duration", aa_ct_seg_list_duration(seg_list), 0, 0 );
+        test( "TOPP rest eval", AA_CT_SEG_IN == aa_ct_seg_list_eval(seg_list, state, 0) );
+        aveq( "TOPP rest q", 2, q0, state->q, 0 );
+        test_feq( "TOPP rest dq", state->dq[0], 0, 0 );
+
+        aa_ct_seg_list_destroy(seg_list);
+        aa_ct_pt_list_destroy(pt_list);
+    }
+
+    aa_mem_region_destroy(&reg);
+}
+
+/* Distance from q to the segment from a to b */
+static double
+seg_dist( const double *a, const double *b, const double *q )
+{
+    double ab[2] = {b[0]-a[0], b[1]-a[1]};
+    double aq[2] = {q[0]-a[0], q[1]-a[1]};
+    double l = AA_MAX( 0, AA_MIN( 1, (ab[0]*aq[0] + ab[1]*aq[1]) /
+                                  (ab[0]*ab[0] + ab[1]*ab[1]) ) );
+    return hypot( aq[0] - l*ab[0], aq[1] - l*ab[1] );
+}
+
+void
+test_tjq_topp_tolerance(void)
+{
+    struct aa_mem_region reg;
+    aa_mem_region_init(&reg, 512);
+
+    double dqlimMax[2] = {2,2}, ddqlimMax[2] = {4,4};
+    double dqlimMin[2] = {-2,-2}, ddqlimMin[2] = {-4,-4};
+    struct aa_ct_state max = {0}, min = {0};
+    max.n_q = min.n_q = 2;
+    max.dq = dqlimMax;
+    max.ddq = ddqlimMax;
+    min.dq = dqlimMin;
+    min.ddq = ddqlimMin;
+    struct aa_ct_limit limits = {.min = &min, .max = &max};
+    struct aa_ct_state *state = aa_ct_state_alloc(&reg, 2, 0);
+
+    /* A corner, a collinear point, and a reversal */
+    double q[5][2] = {{0,0}, {1,0}, {1,1}, {1,2}, {1,.5}};
+    struct aa_ct_pt_list *pt_list = aa_ct_pt_list_create(&reg);
+    for( size_t i = 0; i < 5; i ++ ) aa_ct_pt_list_add_q(pt_list, 2, q[i]);
+
+    double tol = .05;
+    struct aa_ct_topp_opts *opts = aa_ct_topp_opts_create();
+    aa_ct_topp_opts_set_tolerance( opts, tol );
+    struct aa_ct_seg_list *seg_list =
+        aa_ct_tjq_topp_generate(&reg, pt_list, &limits, opts);
+    test( "TOPP tolerance generate", NULL != seg_list );
+
+    double dur = aa_ct_seg_list_duration(seg_list);
+    test( "TOPP tolerance duration", isfinite(dur) && dur > 0 );
+
+    /* Within tol of the polyline and within the velocity limits */
+    double dev = 0, dq = 0;
+    for( double t = 0; t <= dur; t += dur / 1000 ) {
+        aa_ct_seg_list_eval(seg_list, state, t);
+        double d = INFINITY;
+        for( size_t i = 0; i < 4; i ++ ) {
+            d = AA_MIN( d, seg_dist(q[i], q[i+1], state->q) );
+        }
+        dev = AA_MAX( dev, d );
+        dq = AA_MAX( dq, AA_MAX(fabs(state->dq[0]), fabs(state->dq[1])) );
+    }
+    test( "TOPP tolerance deviation", dev <= tol + 1e-9 );
+    test( "TOPP tolerance velocity", dq <= 2 + 1e-6 );
+
+    /* The corner is cut, not passed through */
+    double corner = INFINITY;
+    for( double t = 0; t <= dur; t += dur / 1000 ) {
+        aa_ct_seg_list_eval(seg_list, state, t);
+        corner = AA_MIN( corner, hypot(state->q[0] - 1, state->q[1]) );
+    }
+    test( "TOPP tolerance corner", corner > tol/2 && corner <= tol + 1e-3 );
+
+    /* Ends exactly at the goal */
+    aa_ct_seg_list_eval(seg_list, state, dur);
+    aveq( "TOPP tolerance goal", 2, q[4], state->q, 1e-9 );
+
+    aa_ct_topp_opts_destroy(opts);
+    aa_ct_seg_list_destroy(seg_list);
+    aa_ct_pt_list_destroy(pt_list);
+    aa_mem_region_destroy(&reg);
+}
+
+void
+test_tjq_quintic_specific_numbers(void)
+{
+    struct aa_mem_region reg;
+    aa_mem_region_init(&reg, 512);
+
+    struct aa_ct_pt_list *pt_list = aa_ct_pt_list_create(&reg);
+    double q1[1] = {1}, q2[1] = {3}, q3[1] = {4};
+    aa_ct_pt_list_add_q(pt_list, 1, q1);
+    aa_ct_pt_list_add_q(pt_list, 1, q2);
+
+    double dqlimMax[1] = {2}, ddqlimMax[1] = {4};
+    double dqlimMin[1] = {-2}, ddqlimMin[1] = {-4};
+    struct aa_ct_state max = {0}, min = {0};
+    max.n_q = min.n_q = 1;
+    max.dq = dqlimMax;
+    max.ddq = ddqlimMax;
+    min.dq = dqlimMin;
+    min.ddq = ddqlimMin;
+    struct aa_ct_limit limits = {.min = &min, .max = &max};
+    struct aa_ct_state *state = aa_ct_state_alloc(&reg, 1, 0);
+
+    /* Rest to rest, velocity limited: peak velocity is 15/8 the average */
+    struct aa_ct_seg_list *seg_list =
+        aa_ct_tjq_quintic_generate(&reg, pt_list, &limits, NULL);
+    test_feq( "Quintic duration", aa_ct_seg_list_duration(seg_list), 1.875, 1e-6 );
+    aa_ct_seg_list_eval(seg_list, state, 1.875/2);
+    test_feq( "Quintic State at midpoint", state->q[0], 2, 1e-6);
+    test_feq( "Quintic Vel at midpoint", state->dq[0], 2, 1e-6);
+    test_feq( "Quintic Accel at midpoint", state->ddq[0], 0, 1e-6);
+    aa_ct_seg_list_destroy(seg_list);
+
+    /* Jerk limited: peak jerk is 60 times the distance over time cubed */
+    double dddq_max[1] = {10};
+    seg_list = aa_ct_tjq_quintic_generate(&reg, pt_list, &limits, dddq_max);
+    test_feq( "Quintic jerk duration", aa_ct_seg_list_duration(seg_list), cbrt(12), 1e-6 );
+    aa_ct_seg_list_destroy(seg_list);
+
+    /* Smooth through an interior point */
+    aa_ct_pt_list_add_q(pt_list, 1, q3);
+    seg_list = aa_ct_tjq_quintic_generate(&reg, pt_list, &limits, dddq_max);
+    test( "Quintic continuous", 0 == aa_ct_seg_list_check_c0(seg_list, 1e-3, 1e-2, 1e-9) );
+    aa_ct_seg_list_eval(seg_list, state, aa_ct_seg_list_duration(seg_list));
+    test_feq( "Quintic final", state->q[0], 4, 1e-9);
+    test_feq( "Quintic final vel", state->dq[0], 0, 1e-9);
+
+    aa_ct_seg_list_destroy(seg_list);
+    aa_ct_pt_list_destroy(pt_list);
+    aa_mem_region_destroy(&reg);
+}
+
+static struct aa_ct_seg_list *
+stream_traj( struct aa_mem_region *reg, struct aa_ct_limit *limit,
+             double q0, double q1 )
+{
+    struct aa_ct_pt_list *pt_list = aa_ct_pt_list_create(reg);
+    double q[2] = {q0, -q0};
+    aa_ct_pt_list_add_q(pt_list, 2, q);
+    q[0] = q1; q[1] = -q1;
+    aa_ct_pt_list_add_q(pt_list, 2, q);
+    return aa_ct_tjq_pb_generate(reg, pt_list, limit);
+}
+
+/* Check a popped setpoint against a trajectory started at tick start */
+static void
+stream_check( struct aa_ct_stream *stream, struct aa_ct_seg_list *segs,
+              uint64_t start, uint64_t tick, const double *q )
+{
+    double dt = aa_ct_stream_dt(stream);
+    double t = AA_MIN( (double)(tick - start) * dt, aa_ct_seg_list_duration(segs) );
+    double q_ref[2];
+    struct aa_ct_state state = {0};
+    double dq[2], ddq[2];
+    state.n_q = 2;
+    state.q = q_ref;
+    state.dq = dq;
+    state.ddq = ddq;
+    aa_ct_seg_list_eval(segs, &state, t);
+    aveq("Stream setpoint", 2, q_ref, q, 1e-9);
+}
+
+struct stream_thread_cx {
+    struct aa_ct_stream *stream;
+    size_t n;
+    double *Q;
+    int ok;
+};
+
+static void *
+stream_consumer( void *vcx )
+{
+    struct stream_thread_cx *cx = (struct stream_thread_cx *)vcx;
+    uint64_t expect = 0;
+    cx->ok = 1;
+    while( expect < cx->n ) {
+        uint64_t tick;
+        if( aa_ct_stream_pop(cx->stream, &tick, cx->Q + 2*expect, NULL, NULL) ) continue;
+        cx->ok &= (tick == expect);
+        expect++;
+    }
+    return NULL;
+}
+
+void
+test_stream(void)
+{
+    struct aa_mem_region reg;
+    aa_mem_region_init(&reg, 512);
+
+    double dqlimMax[2] = {2, 2}, ddqlimMax[2] = {4, 4};
+    double dqlimMin[2] = {-2, -2}, ddqlimMin[2] = {-4, -4};
+    struct aa_ct_state max = {0}, min = {0};
+    max.n_q = min.n_q = 2;
+    max.dq = dqlimMax;
+    max.ddq = ddqlimMax;
+    min.dq = dqlimMin;
+    min.ddq = ddqlimMin;
+    struct aa_ct_limit limits = {.min = &min, .max = &max};
+
+    struct aa_ct_seg_list *segs0 = stream_traj(&reg, &limits, 0, 1);
+    struct aa_ct_seg_list *segs1 = stream_traj(&reg, &limits, .5, -1);
+
+    /* Single thread */
+    {
+        struct aa_ct_stream *stream = aa_ct_stream_create(2, 64, .01);
+        uint64_t tick;
+        double q[2];
+
+        test( "Stream empty", 0 != aa_ct_stream_pop(stream, &tick, q, NULL, NULL) );
+        test( "Stream start", 0 == aa_ct_stream_splice(stream, segs0, 0) );
+        test( "Stream fill", 64 == aa_ct_stream_fill(stream, 0) );
+        test( "Stream full", 0 == aa_ct_stream_fill(stream, 0) );
+
+        for( uint64_t i = 0; i < 10; i ++ ) {
+            test( "Stream pop", 0 == aa_ct_stream_pop(stream, &tick, q, NULL, NULL) );
+            test( "Stream tick", tick == i );
+            stream_check(stream, segs0, 0, tick, q);
+        }
+        test( "Stream refill", 10 == aa_ct_stream_fill(stream, 0) );
+
+        /* Replace buffered setpoints */
+        test( "Stream late splice", 0 != aa_ct_stream_splice(stream, segs1, 5) );
+        test( "Stream splice", 0 == aa_ct_stream_splice(stream, segs1, 20) );
+        test( "Stream splice write", 21 == aa_ct_stream_write_tick(stream) );
+        aa_ct_stream_fill(stream, 0);
+        for( uint64_t i = 10; i < 200; i ++ ) {
+            test( "Stream pop", 0 == aa_ct_stream_pop(stream, &tick, q, NULL, NULL) );
+            test( "Stream tick", tick == i );
+            if( i < 20 ) stream_check(stream, segs0, 0, tick, q);
+            else stream_check(stream, segs1, 20, tick, q);
+            aa_ct_stream_fill(stream, 1);
+        }
+
+        aa_ct_stream_destroy(stream);
+    }
+
+    /* Producer and consumer threads, splicing just ahead of the consumer */
+    {
+        struct stream_thread_cx cx;
+        cx.stream = aa_ct_stream_create(2, 32, .01);
+        cx.n = 2000;
+        cx.Q = AA_MEM_REGION_NEW_N(&reg, double, 2*cx.n);
+        aa_ct_stream_splice(cx.stream, segs0, 0);
+        aa_ct_stream_fill(cx.stream, 0);
+
+        pthread_t thread;
+        pthread_create(&thread, NULL, stream_consumer, &cx);
+
+        uint64_t splice = UINT64_MAX;
+        while( aa_ct_stream_read_tick(cx.stream) < cx.n ) {
+            uint64_t r = aa_ct_stream_read_tick(cx.stream);
+            if( UINT64_MAX == splice && r > 100 &&
+                0 == aa_ct_stream_splice(cx.stream, segs1, r + 2) )
+            {
+                splice = r + 2;
+            }
+            aa_ct_stream_fill(cx.stream, 0);
+        }
+        pthread_join(thread, NULL);
+        test( "Stream threads", cx.ok );
+        test( "Stream threads spliced", UINT64_MAX != splice );
+
+        /* Old trajectory before the splice, new one after */
+        for( uint64_t i = 0; i < cx.n; i ++ ) {
+            if( i < splice ) stream_check(cx.stream, segs0, 0, i, cx.Q + 2*i);
+            else stream_check(cx.stream, segs1, splice, i, cx.Q + 2*i);
+        }
+
+        aa_ct_stream_destroy(cx.stream);
+    }
+
+    aa_mem_region_destroy(&reg);
+}
+
 /**
  * Test making a parabolic blend trajectory
  */
@@ -347,6 +857,12 @@ main(void)
 
     test_tjX();
     test_tjq_pb_specific_numbers();
+    test_tjq_topp_specific_numbers();
+    test_tjq_topp_degenerate();
+    test_tjq_topp_tolerance();
+    test_tjq_quintic_specific_numbers();
+    test_tjq_dense();
+    test_stream();
 
     for( size_t i = 0; i < 400; i ++ ) {
         size_t n_p = 2 + (size_t)(10*aa_frand());
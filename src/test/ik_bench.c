@@ -0,0 +1,326 @@
+/* -*- mode: C; c-basic-offset: 4; -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2016, Rice University
+ * All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of copyright holder the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Benchmark the Jacobian IK solver methods on random reachable poses.
+ *
+ * Targets are the end-effector poses of uniformly sampled
+ * configurations within the position limits.  Each method solves
+ * every target from the same seed.  The multi-start row additionally
+ * tries random seeds in parallel until the first solution.  The cache
+ * row first solves every target to fill a seed cache, then times
+ * solves of nearby poses.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+
+#include "amino.h"
+#include "amino/rx/rxtype.h"
+#include "amino/rx/scenegraph.h"
+#include "amino/rx/scene_sub.h"
+#include "amino/rx/scene_kin.h"
+#include "amino/rx/scene_plugin.h"
+
+static const char *method_name[] = {"ode", "lm", "qp", "lm-multi", "lm-cache"};
+
+static int
+dcmp( const void *a, const void *b )
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static double
+percentile( size_t n, const double *x_sorted, double p )
+{
+    if( 0 == n ) return nan("");
+    size_t i = (size_t)(p * (double)(n-1) + .5);
+    return x_sorted[AA_MIN(i,n-1)];
+}
+
+/* A 7-DOF arm, used when no plugin is given */
+static struct aa_rx_sg *
+arm7( void )
+{
+    static const double L0[3] = {0, 0, .3};
+    static const double L1[3] = {0, 0, .4};
+    static const double L2[3] = {.1, 0, .2};
+    const double *axes[7] = {aa_tf_vec_z, aa_tf_vec_y, aa_tf_vec_z, aa_tf_vec_y,
+                             aa_tf_vec_z, aa_tf_vec_y, aa_tf_vec_z };
+    const double *offs[7] = {L0, L0, L1, L1, L1, L2, L2};
+
+    struct aa_rx_sg *sg = aa_rx_sg_create();
+    const char *parent = "";
+    char names[7][4];
+    for( size_t i = 0; i < 7; i ++ ) {
+        sprintf(names[i], "a%d", (int)i);
+        aa_rx_sg_add_frame_revolute( sg, parent, names[i],
+                                     NULL, offs[i],
+                                     NULL, axes[i], 0 );
+        aa_rx_sg_set_limit_pos( sg, names[i], -M_PI, M_PI );
+        parent = names[i];
+    }
+    aa_rx_sg_add_frame_fixed( sg, parent, "ee", NULL, L2 );
+    return sg;
+}
+
+static void
+sample_config( const struct aa_rx_sg_sub *ssg, size_t n, double *q )
+{
+    const struct aa_rx_sg *sg = aa_rx_sg_sub_sg(ssg);
+    for( size_t i = 0; i < n; i ++ ) {
+        double min = -M_PI, max = M_PI;
+        aa_rx_sg_get_limit_pos( sg, aa_rx_sg_sub_config(ssg,i), &min, &max );
+        q[i] = min + (max-min)*aa_frand();
+    }
+}
+
+static int
+check_pose( const struct aa_rx_sg_sub *ssg, aa_rx_frame_id id_ee,
+            size_t n_qs, const double *qs, const double *q_seed,
+            const double E_ref[7], double tol_angle, double tol_trans )
+{
+    const struct aa_rx_sg *sg = aa_rx_sg_sub_sg(ssg);
+    size_t n_q = aa_rx_sg_config_count(sg);
+    size_t n_f = aa_rx_sg_frame_count(sg);
+    double q[n_q];
+    double TF_rel[7*n_f], TF_abs[7*n_f];
+    AA_MEM_CPY( q, q_seed, n_q );
+    aa_rx_sg_sub_config_set( ssg, n_qs, qs, n_q, q );
+    aa_rx_sg_tf( sg, n_q, q, n_f, TF_rel, 7, TF_abs, 7 );
+
+    double E_rel[7];
+    aa_tf_qutr_cmul( E_ref, TF_abs + 7*id_ee, E_rel );
+    aa_tf_qminimize( E_rel + AA_TF_QUTR_Q );
+    double theta = 2*atan2( aa_la_norm(3, E_rel + AA_TF_QUTR_Q), E_rel[AA_TF_QUTR_Q+3] );
+    double x = aa_la_norm(3, E_rel + AA_TF_QUTR_T);
+    return theta < 2*tol_angle && x < 2*tol_trans;
+}
+
+int main( int argc, char *argv[] )
+{
+    const char *name = "scenegraph";
+    const char *plugin = NULL;
+    const char *root = NULL;
+    const char *end_effector = NULL;
+    size_t n_samples = 1000;
+    size_t n_starts = 8;
+    size_t n_threads = 0;
+    unsigned seed = 42;
+
+    /* Parse Options */
+    {
+        int c;
+        while( (c = getopt( argc, argv, "n:r:e:k:m:j:s:?")) != -1 ) {
+            switch(c) {
+            case 'n':
+                name = optarg;
+                break;
+            case 'r':
+                root = optarg;
+                break;
+            case 'e':
+                end_effector = optarg;
+                break;
+            case 'k':
+                n_samples = (size_t)atol(optarg);
+                break;
+            case 'm':
+                n_starts = (size_t)atol(optarg);
+                break;
+            case 'j':
+                n_threads = (size_t)atol(optarg);
+                break;
+            case 's':
+                seed = (unsigned)atol(optarg);
+                break;
+            case '?':
+            default:
+                puts("Usage: ik_bench [OPTIONS] [PLUGIN_NAME]\n"
+                     "Benchmark Jacobian IK methods on random reachable poses\n"
+                     "\n"
+                     "Options:\n"
+                     "  -n NAME         scene graph name (default: scenegraph)\n"
+                     "  -r NAME         root frame of the chain (default: global)\n"
+                     "  -e NAME         end-effector frame of the chain\n"
+                     "  -k COUNT        number of samples (default: 1000)\n"
+                     "  -m COUNT        seeds for multi-start LM, 0 to skip (default: 8)\n"
+                     "  -j COUNT        threads for multi-start LM (default: CPUs)\n"
+                     "  -s SEED         random seed (default: 42)\n"
+                     "\n"
+                     "Without a plugin, a built-in 7-DOF arm is used.\n"
+                     "\n"
+                     "Report bugs to " PACKAGE_BUGREPORT "\n" );
+                exit(EXIT_SUCCESS);
+            }
+        }
+        if( optind < argc ) {
+            plugin = argv[optind++];
+        }
+    }
+
+    struct aa_rx_sg *sg;
+    if( plugin ) {
+        if( NULL == end_effector ) {
+            fprintf(stderr, "ik_bench: end-effector frame required (-e)\n");
+            exit(EXIT_FAILURE);
+        }
+        sg = aa_rx_dl_sg(plugin, name, NULL);
+    } else {
+        sg = arm7();
+        end_effector = "ee";
+    }
+    aa_rx_sg_init(sg);
+
+    aa_rx_frame_id id_root = root ? aa_rx_sg_frame_id(sg, root) : AA_RX_FRAME_ROOT;
+    aa_rx_frame_id id_ee = aa_rx_sg_frame_id(sg, end_effector);
+    if( AA_RX_FRAME_NONE == id_root || AA_RX_FRAME_NONE == id_ee ) {
+        fprintf(stderr, "ik_bench: invalid chain frames\n");
+        exit(EXIT_FAILURE);
+    }
+
+    struct aa_rx_sg_sub *ssg = aa_rx_sg_chain_create( sg, id_root, id_ee );
+    size_t n_q = aa_rx_sg_config_count(sg);
+    size_t n_f = aa_rx_sg_frame_count(sg);
+    size_t n_qs = aa_rx_sg_sub_config_count(ssg);
+
+    printf("scene: %s, chain: %s -> %s, %lu configs, %lu samples\n",
+           plugin ? plugin : "arm7",
+           aa_rx_sg_frame_name(sg, id_root), end_effector,
+           n_qs, n_samples);
+
+    /* Generate reachable targets */
+    double *E_ref = AA_NEW_AR( double, 7*n_samples );
+    double *q_seed = AA_NEW0_AR( double, n_q );
+    {
+        double q[n_q], qs[n_qs];
+        double TF_rel[7*n_f], TF_abs[7*n_f];
+        srand(seed);
+        for( size_t k = 0; k < n_samples; k ++ ) {
+            AA_MEM_ZERO( q, n_q );
+            sample_config( ssg, n_qs, qs );
+            aa_rx_sg_sub_config_set( ssg, n_qs, qs, n_q, q );
+            aa_rx_sg_tf( sg, n_q, q, n_f, TF_rel, 7, TF_abs, 7 );
+            AA_MEM_CPY( E_ref + 7*k, TF_abs + 7*id_ee, 7 );
+        }
+        double qs_center[n_qs];
+        aa_rx_sg_sub_center_configs( ssg, n_qs, qs_center );
+        aa_rx_sg_sub_config_set( ssg, n_qs, qs_center, n_q, q_seed );
+    }
+
+    /* Nearby targets: 5 mm and about 3 degrees from each target */
+    double *E_near = AA_NEW_AR( double, 7*n_samples );
+    for( size_t k = 0; k < n_samples; k ++ ) {
+        double v[3], E_d[7];
+        for( size_t i = 0; i < 3; i ++ ) {
+            v[i] = .05*(2*aa_frand() - 1) / sqrt(3);
+            E_d[AA_TF_QUTR_T+i] = .005*(2*aa_frand() - 1) / sqrt(3);
+        }
+        aa_tf_rotvec2quat( v, E_d + AA_TF_QUTR_Q );
+        aa_tf_qutr_mul( E_ref + 7*k, E_d, E_near + 7*k );
+    }
+
+    /* Run each method */
+    printf("%-10s %8s %12s %12s %12s\n",
+           "method", "success", "median (ms)", "p99 (ms)", "max (ms)");
+    for( int m = 0; m < 5; m ++ ) {
+        int multi = (m == 3);
+        int cached = (m == 4);
+        if( multi && 0 == n_starts ) continue;
+        struct aa_rx_ksol_opts *opts = aa_rx_ksol_opts_create();
+        aa_rx_ksol_opts_center_configs( opts, ssg, .1 );
+        aa_rx_ksol_opts_take_seed( opts, n_q, q_seed, AA_MEM_BORROW );
+        aa_rx_ksol_opts_set_ik_method( opts, (m < 3) ? (enum aa_rx_ik_method)m : AA_RX_IK_LM );
+        struct aa_rx_ik_jac_cx *ik_cx = aa_rx_ik_jac_cx_create( ssg, opts );
+
+        struct aa_rx_ik_cache *cache = NULL;
+        const double *E_target = E_ref;
+        if( cached ) {
+            cache = aa_rx_ik_cache_create( n_qs, n_samples );
+            aa_rx_ksol_opts_set_cache( opts, cache );
+            for( size_t k = 0; k < n_samples; k ++ ) {
+                double qs[n_qs];
+                aa_rx_ik_jac_solve( ik_cx, 1, E_ref + 7*k, 7, n_qs, qs );
+            }
+            E_target = E_near;
+        }
+
+        double *t = AA_NEW_AR( double, n_samples );
+        size_t n_success = 0;
+        for( size_t k = 0; k < n_samples; k ++ ) {
+            double qs[n_qs];
+            struct timespec t0 = aa_tm_now();
+            int r = multi ?
+                aa_rx_ik_solve_multistart( ik_cx, n_threads, n_starts,
+                                           1, E_target + 7*k, 7, NULL,
+                                           n_qs, 1, qs, n_qs, NULL ) :
+                aa_rx_ik_jac_solve( ik_cx, 1, E_target + 7*k, 7, n_qs, qs );
+            struct timespec t1 = aa_tm_now();
+            t[k] = 1e3 * aa_tm_timespec2sec( aa_tm_sub(t1, t0) );
+            if( 0 == r &&
+                check_pose( ssg, id_ee, n_qs, qs, q_seed, E_target + 7*k,
+                            .1*M_PI/180, .1e-3 ) )
+            {
+                n_success++;
+            }
+        }
+
+        qsort( t, n_samples, sizeof(t[0]), dcmp );
+        printf("%-10s %7.1f%% %12.3f %12.3f %12.3f\n",
+               method_name[m],
+               100.0 * (double)n_success / (double)n_samples,
+               percentile(n_samples, t, .5),
+               percentile(n_samples, t, .99),
+               n_samples ? t[n_samples-1] : nan(""));
+
+        free(t);
+        aa_rx_ik_jac_cx_destroy( ik_cx );
+        aa_rx_ksol_opts_destroy( opts );
+        aa_rx_ik_cache_destroy( cache );
+    }
+
+    free( E_near );
+    free( q_seed );
+    free( E_ref );
+    aa_rx_sg_sub_destroy( ssg );
+    aa_rx_sg_destroy( sg );
+
+    return 0;
+}
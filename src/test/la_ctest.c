@@ -55,6 +55,7 @@ static void test_angle();
 //static void test_proj_orth();
 //static void test_std();
 static void test_meancov();
+static void test_d6pinv();
 
 
 int main( int argc, char **argv ) {
@@ -70,6 +71,7 @@ int main( int argc, char **argv ) {
     test_ssd();
     test_angle();
     test_meancov();
+    test_d6pinv();
 
     printf("Ending la_ctest\n");
 }
@@ -156,6 +158,45 @@ static void test_meancov()
 }
 
 
+static void test_d6pinv()
+{
+    const double s2_min = 5e-3;
+    for( size_t n = 1; n <= 10; n ++ ) {
+        double U[36];
+        AA_MEM_ZERO( U, 36 );
+        for( size_t i = 0; i < 6; i ++ ) U[7*i] = 1;
+        for( size_t k = 0; k < 100; k ++ ) {
+            double A[6*n], A_star[6*n], A_star_r[6*n];
+            double b[6], xp[n], x[n], x_r[n];
+            for( size_t i = 0; i < 6*n; i ++ ) A[i] = 2*aa_frand() - 1;
+            for( size_t i = 0; i < 6; i ++ ) b[i] = 2*aa_frand() - 1;
+            for( size_t i = 0; i < n; i ++ ) xp[i] = 2*aa_frand() - 1;
+            /* Rank deficient */
+            if( n > 1 && 0 == k % 10 ) {
+                AA_MEM_CPY( A + 6*(n-1), A, 6 );
+            }
+
+            test( "d6zdpinv ok", 0 == aa_la_d6zdpinv( n, s2_min, A, A_star ) );
+            aa_la_dzdpinv( 6, n, s2_min, A, A_star_r );
+            aveq( "d6zdpinv", 6*n, A_star, A_star_r, 1e-8 );
+
+            /* Warm start from the previous, unrelated matrix */
+            test( "d6zdpinv_warm ok", 0 == aa_la_d6zdpinv_warm( n, s2_min, A, U, A_star ) );
+            aveq( "d6zdpinv_warm", 6*n, A_star, A_star_r, 1e-8 );
+
+            test( "d6xlsnp ok", 0 == aa_la_d6xlsnp( n, A, A_star_r, b, xp, x ) );
+            aa_la_xlsnp( 6, n, A, A_star_r, b, xp, x_r );
+            aveq( "d6xlsnp", n, x, x_r, 1e-8 );
+        }
+    }
+
+    {
+        double A[6*11], A_star[6*11];
+        AA_MEM_ZERO( A, 6*11 );
+        test( "d6zdpinv size", 0 != aa_la_d6zdpinv( 11, s2_min, A, A_star ) );
+    }
+}
+
 /* static void test_proj_orth() */
 /* { */
 /*     double  theta,a[2],p[2],o[2],rp[2],ro[2],s[2]; */
@@ -0,0 +1,565 @@
+/* -*- mode: C; c-basic-offset: 4; -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2016, Rice University
+ * All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of copyright holder the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "amino.h"
+#include "amino/test.h"
+#include "amino/rx/rxtype.h"
+#include "amino/rx/rxerr.h"
+#include "amino/rx/scenegraph.h"
+#include "amino/rx/scene_sub.h"
+#include "amino/rx/scene_geom.h"
+#include "amino/rx/scene_collision.h"
+#include "amino/rx/scene_planning.h"
+
+/* Planar two-link arm, optionally with a box obstacle that blocks the
+ * direct motion between the test configurations */
+static struct aa_rx_sg *
+arm( int obstacle )
+{
+    struct aa_rx_sg *sg = aa_rx_sg_create();
+    static const double axis[3] = {0,0,1};
+    static const double v_joint[3] = {1,0,0};
+    static const double v_link[3] = {.5,0,0};
+    static const double d_link[3] = {.8,.1,.1};
+    static const double v_obstacle[3] = {1.3,.7,0};
+    static const double d_obstacle[3] = {.4,.4,.2};
+
+    aa_rx_sg_add_frame_revolute( sg, "", "j0",
+                                 aa_tf_quat_ident, aa_tf_vec_ident,
+                                 "q0", axis, 0 );
+    aa_rx_sg_add_frame_fixed( sg, "j0", "l0", aa_tf_quat_ident, v_link );
+    aa_rx_sg_add_frame_revolute( sg, "j0", "j1",
+                                 aa_tf_quat_ident, v_joint,
+                                 "q1", axis, 0 );
+    aa_rx_sg_add_frame_fixed( sg, "j1", "l1", aa_tf_quat_ident, v_link );
+    aa_rx_sg_set_limit_pos( sg, "q0", -M_PI, M_PI );
+    aa_rx_sg_set_limit_pos( sg, "q1", -2, 2 );
+
+    struct aa_rx_geom_opt *opt = aa_rx_geom_opt_create();
+    aa_rx_geom_opt_set_collision(opt, 1);
+    aa_rx_geom_attach( sg, "l0", aa_rx_geom_box(opt, d_link) );
+    aa_rx_geom_attach( sg, "l1", aa_rx_geom_box(opt, d_link) );
+    if( obstacle ) {
+        aa_rx_sg_add_frame_fixed( sg, "", "obstacle", aa_tf_quat_ident, v_obstacle );
+        aa_rx_geom_attach( sg, "obstacle", aa_rx_geom_box(opt, d_obstacle) );
+    }
+    aa_rx_geom_opt_destroy(opt);
+
+    aa_rx_sg_init(sg);
+    aa_rx_sg_cl_init(sg);
+    return sg;
+}
+
+/* Whether configuration q is in collision */
+static int
+config_collides( const struct aa_rx_sg *sg, struct aa_rx_cl *cl, const double *q )
+{
+    size_t n_q = aa_rx_sg_config_count(sg);
+    size_t n_f = aa_rx_sg_frame_count(sg);
+    double TF_rel[7*n_f], TF_abs[7*n_f];
+    aa_rx_sg_tf( sg, n_q, q, n_f, TF_rel, 7, TF_abs, 7 );
+    return aa_rx_cl_check( cl, n_f, TF_abs, 7, NULL );
+}
+
+/* Whether the path is collision-free, also checking between waypoints */
+static int
+path_free( const struct aa_rx_sg *sg, size_t n_path, const double *path )
+{
+    size_t n_q = aa_rx_sg_config_count(sg);
+    struct aa_rx_cl *cl = aa_rx_cl_create(sg);
+    int ok = 1;
+    for( size_t i = 0; ok && i < n_path; i ++ ) {
+        const double *q0 = path + i*n_q;
+        const double *q1 = (i+1 < n_path) ? q0 + n_q : q0;
+        double d = 0;
+        for( size_t j = 0; j < n_q; j ++ ) d = AA_MAX( d, fabs(q1[j] - q0[j]) );
+        size_t n_sub = (size_t)ceil( d / .05 );
+        for( size_t k = 0; ok && k <= n_sub; k ++ ) {
+            double q[n_q], s = n_sub ? (double)k / (double)n_sub : 0;
+            for( size_t j = 0; j < n_q; j ++ ) q[j] = q0[j] + s*(q1[j] - q0[j]);
+            ok = !config_collides( sg, cl, q );
+        }
+    }
+    aa_rx_cl_destroy(cl);
+    return ok;
+}
+
+/* Plan from q_start to q_goal, set through aa_rx_mp_set_goal() */
+static void
+check_plan( const char *name, struct aa_rx_mp *mp, const struct aa_rx_sg *sg,
+            double *q_start, double *q_goal )
+{
+    size_t n_q = aa_rx_sg_config_count(sg);
+    aa_rx_mp_set_start( mp, n_q, q_start );
+    test( name, AA_RX_OK == aa_rx_mp_set_goal(mp, n_q, q_goal) );
+
+    size_t n_path = 0;
+    double *path = NULL;
+    int r = aa_rx_mp_plan( mp, 1, &n_path, &path );
+    test( name, AA_RX_OK == r );
+    test( name, n_path >= 2 );
+    aveq( name, n_q, q_start, path, 1e-6 );
+    aveq( name, n_q, q_goal, path + (n_path-1)*n_q, 1e-6 );
+    test( name, path_free(sg, n_path, path) );
+    free(path);
+}
+
+static void
+test_native( const struct aa_rx_sg *sg, const struct aa_rx_sg_sub *ssg )
+{
+    double q_start[2] = {0,0};
+    double q_goal[2] = {M_PI/2, -M_PI/2};
+
+    struct aa_rx_mp *mp = aa_rx_mp_create(ssg);
+    struct aa_rx_mp_rrt_attr *attr = aa_rx_mp_rrt_attr_create();
+    aa_rx_mp_rrt_attr_set_native( attr, 1 );
+    aa_rx_mp_set_rrt( mp, attr );
+    aa_rx_mp_rrt_attr_destroy(attr);
+    check_plan( "native rrt", mp, sg, q_start, q_goal );
+    aa_rx_mp_destroy(mp);
+
+    mp = aa_rx_mp_create(ssg);
+    aa_rx_mp_set_lazy_prm( mp, NULL );
+    check_plan( "lazy prm", mp, sg, q_start, q_goal );
+    aa_rx_mp_reset(mp);
+    check_plan( "lazy prm reuse", mp, sg, q_goal, q_start );
+
+    /* Round trip a roadmap through a file */
+    size_t n_nodes = aa_rx_mp_prm_node_count(mp);
+    FILE *f = tmpfile();
+    test( "prm write", 0 == aa_rx_mp_prm_write(mp, f) );
+    rewind(f);
+    struct aa_rx_mp *mp1 = aa_rx_mp_create(ssg);
+    aa_rx_mp_set_lazy_prm( mp1, NULL );
+    test( "prm read", AA_RX_OK == aa_rx_mp_prm_read(mp1, f) );
+    test( "prm read nodes", n_nodes == aa_rx_mp_prm_node_count(mp1) );
+    check_plan( "prm read plan", mp1, sg, q_start, q_goal );
+    aa_rx_mp_destroy(mp1);
+
+    /* Reject a roadmap of the wrong dimension */
+    static const char magic[8] = {'a','a','r','x','p','r','m','1'};
+    uint64_t header[3] = {64, 1, 0};
+    rewind(f);
+    fwrite( magic, sizeof(magic), 1, f );
+    fwrite( header, sizeof(header), 1, f );
+    rewind(f);
+    test( "prm read dimension", AA_RX_INVALID_PARAMETER == aa_rx_mp_prm_read(mp, f) );
+    test( "prm read keeps roadmap", n_nodes == aa_rx_mp_prm_node_count(mp) );
+    fclose(f);
+
+    aa_rx_mp_destroy(mp);
+}
+
+/* The direct motion is blocked, so the planners must go around */
+static void
+test_obstacle( const struct aa_rx_sg *sg, const struct aa_rx_sg_sub *ssg )
+{
+    double q_start[2] = {0,0};
+    double q_goal[2] = {M_PI/2, -M_PI/2};
+    double q_mid[2] = {M_PI/4, -M_PI/4};
+
+    struct aa_rx_cl *cl = aa_rx_cl_create(sg);
+    test( "obstacle start free", !config_collides(sg, cl, q_start) );
+    test( "obstacle goal free", !config_collides(sg, cl, q_goal) );
+    test( "obstacle blocks", config_collides(sg, cl, q_mid) );
+    aa_rx_cl_destroy(cl);
+
+    struct aa_rx_mp *mp = aa_rx_mp_create(ssg);
+    struct aa_rx_mp_rrt_attr *attr = aa_rx_mp_rrt_attr_create();
+    aa_rx_mp_rrt_attr_set_native( attr, 1 );
+    aa_rx_mp_set_rrt( mp, attr );
+    aa_rx_mp_rrt_attr_destroy(attr);
+    check_plan( "obstacle native rrt", mp, sg, q_start, q_goal );
+    aa_rx_mp_destroy(mp);
+
+    /* The second query reuses the per-thread collision contexts */
+    size_t n_q = aa_rx_sg_config_count(sg);
+    mp = aa_rx_mp_create(ssg);
+    for( int k = 0; k < 2; k ++ ) {
+        size_t n_path = 0;
+        double *path = NULL;
+        aa_rx_mp_set_start( mp, n_q, k ? q_goal : q_start );
+        aa_rx_mp_set_goal( mp, n_q, k ? q_start : q_goal );
+        test( "obstacle parallel",
+              AA_RX_OK == aa_rx_mp_plan_parallel(mp, 3, 1, NULL, &n_path, &path) );
+        test( "obstacle parallel free", path_free(sg, n_path, path) );
+        free(path);
+    }
+    aa_rx_mp_destroy(mp);
+}
+
+/* Post-processing must keep paths valid, shorten them, and respect
+ * its budget, also when reusing its checkers */
+static void
+test_postprocess( const struct aa_rx_sg *sg, const struct aa_rx_sg_sub *ssg )
+{
+    double q_start[2] = {0,0};
+    double q_goal[2] = {M_PI/2, -M_PI/2};
+    double budget = .2;
+
+    struct aa_rx_mp *mp = aa_rx_mp_create(ssg);
+    aa_rx_mp_set_postprocess( mp, budget, 2 );
+    for( int k = 0; k < 2; k ++ ) {
+        check_plan( "postprocess", mp, sg, q_start, q_goal );
+        const struct aa_rx_mp_pp_stats *stats = aa_rx_mp_get_postprocess_stats(mp);
+        test( "postprocess shortcut",
+              stats->length_shortcut <= stats->length_initial + 1e-9 );
+        test( "postprocess smooth",
+              stats->length_smooth <= stats->length_shortcut + 1e-9 );
+        test( "postprocess budget",
+              stats->time_shortcut + stats->time_smooth < budget + .05 );
+    }
+
+    /* Disabled */
+    aa_rx_mp_set_postprocess( mp, 0, 0 );
+    check_plan( "postprocess off", mp, sg, q_start, q_goal );
+    {
+        const struct aa_rx_mp_pp_stats *stats = aa_rx_mp_get_postprocess_stats(mp);
+        test( "postprocess off stats",
+              0 == stats->n_shortcuts &&
+              stats->length_smooth == stats->length_initial );
+    }
+    aa_rx_mp_destroy(mp);
+}
+
+/* Move the obstacle of the test arm */
+static void
+move_obstacle( struct aa_rx_sg *sg, double x, double y )
+{
+    double E[7] = {0,0,0,1, x,y,0};
+    aa_rx_sg_reparent_name( sg, "", "obstacle", E );
+    aa_rx_sg_init(sg);
+}
+
+/* The roadmap must drop results blocked by a moved obstacle and reuse
+ * them once it moves away */
+static void
+test_lazy_prm_obstacle( struct aa_rx_sg *sg, const struct aa_rx_sg_sub *ssg )
+{
+    double q_start[2] = {0,0};
+    double q_goal[2] = {M_PI/2, -M_PI/2};
+
+    struct aa_rx_mp *mp = aa_rx_mp_create(ssg);
+    aa_rx_mp_set_lazy_prm( mp, NULL );
+
+    move_obstacle( sg, 5, 5 );
+    check_plan( "lazy prm far", mp, sg, q_start, q_goal );
+    size_t n_nodes = aa_rx_mp_prm_node_count(mp);
+
+    move_obstacle( sg, 1.3, .7 );
+    check_plan( "lazy prm blocked", mp, sg, q_start, q_goal );
+
+    move_obstacle( sg, 5, 5 );
+    check_plan( "lazy prm cleared", mp, sg, q_start, q_goal );
+    test( "lazy prm kept nodes", aa_rx_mp_prm_node_count(mp) >= n_nodes );
+
+    move_obstacle( sg, 1.3, .7 );
+    aa_rx_mp_destroy(mp);
+}
+
+static void
+test_parallel( const struct aa_rx_sg *sg, const struct aa_rx_sg_sub *ssg )
+{
+    size_t n_q = aa_rx_sg_config_count(sg);
+    double q_start[2] = {0,0};
+    double q_goal[2] = {-M_PI/2, M_PI/2};
+    size_t n_path = 0;
+    double *path = NULL;
+
+    struct aa_rx_mp *mp = aa_rx_mp_create(ssg);
+
+    /* No start configuration */
+    test( "parallel goal", AA_RX_OK == aa_rx_mp_set_goal(mp, n_q, q_goal) );
+    test( "parallel no start",
+          AA_RX_INVALID_STATE == aa_rx_mp_plan_parallel(mp, 2, 1, NULL, &n_path, &path) );
+    test( "parallel no start path", 0 == n_path && NULL == path );
+
+    aa_rx_mp_set_start( mp, n_q, q_start );
+    test( "parallel",
+          AA_RX_OK == aa_rx_mp_plan_parallel(mp, 2, 1, NULL, &n_path, &path) );
+    test( "parallel path", n_path >= 2 );
+    aveq( "parallel start", n_q, q_start, path, 1e-6 );
+    aveq( "parallel goal", n_q, q_goal, path + (n_path-1)*n_q, 1e-6 );
+    free(path);
+
+    aa_rx_mp_destroy(mp);
+}
+
+/* Store plans in a path library, reuse them, and round trip the
+ * library through a file */
+static void
+test_library( const struct aa_rx_sg *sg, const struct aa_rx_sg_sub *ssg )
+{
+    double q_start[2] = {0,0};
+    double q_goal[2] = {-M_PI/2, M_PI/2};
+
+    struct aa_rx_mp_library *lib = aa_rx_mp_library_create(ssg);
+    struct aa_rx_mp *mp = aa_rx_mp_create(ssg);
+    test( "library set", AA_RX_OK == aa_rx_mp_set_library(mp, lib, 0) );
+    check_plan( "library miss", mp, sg, q_start, q_goal );
+    test( "library stored", 1 == aa_rx_mp_library_size(lib) );
+    aa_rx_mp_reset(mp);
+    check_plan( "library hit", mp, sg, q_start, q_goal );
+    const struct aa_rx_mp_library_stats *stats = aa_rx_mp_library_get_stats(lib);
+    test( "library queries", 2 == stats->n_queries );
+    test( "library hits", 1 == stats->n_hits );
+
+    FILE *f = tmpfile();
+    test( "library write", AA_RX_OK == aa_rx_mp_library_write(lib, f) );
+    rewind(f);
+    struct aa_rx_mp_library *lib1 = aa_rx_mp_library_create(ssg);
+    test( "library read", AA_RX_OK == aa_rx_mp_library_read(lib1, f) );
+    test( "library read size", 1 == aa_rx_mp_library_size(lib1) );
+
+    /* Reject a waypoint count larger than the file */
+    static const char magic[8] = {'a','a','r','x','p','l','b','1'};
+    uint64_t header[3] = {2, 1, UINT64_MAX / 8};
+    rewind(f);
+    fwrite( magic, sizeof(magic), 1, f );
+    fwrite( header, sizeof(header), 1, f );
+    rewind(f);
+    test( "library read count", AA_RX_INVALID_PARAMETER == aa_rx_mp_library_read(lib1, f) );
+    test( "library read keeps paths", 1 == aa_rx_mp_library_size(lib1) );
+
+    /* Reject a library of the wrong dimension */
+    header[0] = 3;
+    rewind(f);
+    fwrite( magic, sizeof(magic), 1, f );
+    fwrite( header, sizeof(header), 1, f );
+    rewind(f);
+    test( "library read dimension", AA_RX_INVALID_PARAMETER == aa_rx_mp_library_read(lib1, f) );
+    fclose(f);
+
+    aa_rx_mp_destroy(mp);
+    aa_rx_mp_library_destroy(lib1);
+    aa_rx_mp_library_destroy(lib);
+}
+
+/* A start in collision allows its colliding pairs until reset */
+static void
+test_reset( const struct aa_rx_sg *sg, const struct aa_rx_sg_sub *ssg )
+{
+    size_t n_q = aa_rx_sg_config_count(sg);
+    aa_rx_frame_id id_l1 = aa_rx_sg_frame_id(sg, "l1");
+    aa_rx_frame_id id_obs = aa_rx_sg_frame_id(sg, "obstacle");
+    double q_hit[2] = {.5, 0};
+    double q_start[2] = {0,0};
+    double q_goal[2] = {-M_PI/2, M_PI/2};
+
+    struct aa_rx_mp *mp = aa_rx_mp_create(ssg);
+    aa_rx_mp_set_start( mp, n_q, q_hit );
+    test( "reset start allows",
+          aa_rx_cl_set_get(aa_rx_mp_get_allowed(mp), id_l1, id_obs) );
+    aa_rx_mp_set_start( mp, n_q, q_start );
+    test( "reset goal allowed", AA_RX_OK == aa_rx_mp_set_goal(mp, n_q, q_hit) );
+
+    aa_rx_mp_reset(mp);
+    test( "reset disallows",
+          !aa_rx_cl_set_get(aa_rx_mp_get_allowed(mp), id_l1, id_obs) );
+    aa_rx_mp_set_start( mp, n_q, q_start );
+    test( "reset goal collides",
+          AA_RX_INVALID_STATE == aa_rx_mp_set_goal(mp, n_q, q_hit) );
+
+    check_plan( "reset reuse", mp, sg, q_start, q_goal );
+    aa_rx_mp_destroy(mp);
+}
+
+/* Plan with q0 outside the sub-scenegraph, so the planner holds the
+ * frames it moves static at the start configuration */
+static void
+test_static_frames( const struct aa_rx_sg *sg )
+{
+    size_t n_q = aa_rx_sg_config_count(sg);
+    struct aa_rx_sg_sub *ssg =
+        aa_rx_sg_chain_create( sg, aa_rx_sg_frame_id(sg, "j0"),
+                               aa_rx_sg_frame_id(sg, "l1") );
+    test( "static frames sub", 1 == aa_rx_sg_sub_config_count(ssg) );
+
+    double q_start[2] = {.5, -1};
+    struct aa_rx_mp *mp = aa_rx_mp_create(ssg);
+    aa_rx_mp_set_start( mp, n_q, q_start );
+
+    /* Free with q0 = 0, but l1 meets the obstacle with q0 = .5 */
+    double q_hit = 0;
+    test( "static frames goal collides",
+          AA_RX_INVALID_STATE == aa_rx_mp_set_goal(mp, 1, &q_hit) );
+
+    double q_goal = -1.5;
+    test( "static frames goal", AA_RX_OK == aa_rx_mp_set_goal(mp, 1, &q_goal) );
+    size_t n_path = 0;
+    double *path = NULL;
+    test( "static frames plan", AA_RX_OK == aa_rx_mp_plan(mp, 1, &n_path, &path) );
+    test( "static frames path", n_path >= 2 );
+    for( size_t i = 0; i < n_path; i ++ ) {
+        test( "static frames q0", fabs(path[i*n_q] - q_start[0]) < 1e-6 );
+    }
+    test( "static frames free", path_free(sg, n_path, path) );
+    free(path);
+
+    aa_rx_mp_destroy(mp);
+    aa_rx_sg_sub_destroy(ssg);
+}
+
+/* Plan in a job, cancel an unsolvable job, and check that neither an
+ * early nor a late cancellation affects the next query */
+static void
+test_async( const struct aa_rx_sg *sg )
+{
+    size_t n_q = aa_rx_sg_config_count(sg);
+    struct aa_rx_sg_sub *ssg =
+        aa_rx_sg_chain_create( sg, aa_rx_sg_frame_id(sg, "j0"),
+                               aa_rx_sg_frame_id(sg, "l1") );
+    double q_start[2] = {.5, -1};
+    double q_free = -1.5;
+    double q_blocked = 1;   /* joint limits keep l1 from going around */
+    size_t n_path = 0;
+    double *path = NULL;
+
+    struct aa_rx_mp *mp = aa_rx_mp_create(ssg);
+    aa_rx_mp_set_start( mp, n_q, q_start );
+
+    /* Cancel before the job is likely to have started */
+    test( "async goal blocked", AA_RX_OK == aa_rx_mp_set_goal(mp, 1, &q_blocked) );
+    double t0 = aa_tm_timespec2sec( aa_tm_now() );
+    struct aa_rx_mp_job *job = aa_rx_mp_plan_async( mp, 30, NULL, NULL );
+    test( "async start", NULL != job );
+    aa_rx_mp_job_cancel( job );
+    int r = aa_rx_mp_job_wait( job, &n_path, &path );
+    test( "async cancel", AA_RX_OK != r );
+    test( "async cancel time", aa_tm_timespec2sec(aa_tm_now()) - t0 < 10 );
+    free(path);
+
+    /* The cancellation does not carry over */
+    test( "async goal free", AA_RX_OK == aa_rx_mp_set_goal(mp, 1, &q_free) );
+    path = NULL;
+    test( "async after cancel", AA_RX_OK == aa_rx_mp_plan(mp, 5, &n_path, &path) );
+    free(path);
+
+    /* Cancel after the job finished */
+    job = aa_rx_mp_plan_async( mp, 5, NULL, NULL );
+    test( "async start 2", NULL != job );
+    while( !aa_rx_mp_job_poll(job) ) {
+        struct timespec ts = {0, 1000000};
+        nanosleep( &ts, NULL );
+    }
+    aa_rx_mp_job_cancel( job );
+    path = NULL;
+    test( "async done", AA_RX_OK == aa_rx_mp_job_wait(job, &n_path, &path) );
+    test( "async path", n_path >= 2 && path_free(sg, n_path, path) );
+    free(path);
+    path = NULL;
+    test( "async after late cancel", AA_RX_OK == aa_rx_mp_plan(mp, 5, &n_path, &path) );
+    free(path);
+
+    aa_rx_mp_destroy(mp);
+    aa_rx_sg_sub_destroy(ssg);
+}
+
+/* Pose of frame l1 at configuration q */
+static void
+l1_pose( const struct aa_rx_sg *sg, const double *q, double E[7] )
+{
+    size_t n_q = aa_rx_sg_config_count(sg);
+    size_t n_f = aa_rx_sg_frame_count(sg);
+    double TF_rel[7*n_f], TF_abs[7*n_f];
+    aa_rx_sg_tf( sg, n_q, q, n_f, TF_rel, 7, TF_abs, 7 );
+    AA_MEM_CPY( E, TF_abs + 7*aa_rx_sg_frame_id(sg, "l1"), 7 );
+}
+
+/* Workspace goal sampled by a pool of IK threads, planned twice so
+ * the second plan restarts the stopped pool */
+static void
+test_wsgoal_pool( const struct aa_rx_sg *sg, const struct aa_rx_sg_sub *ssg )
+{
+    size_t n_q = aa_rx_sg_config_count(sg);
+    double q_start[2] = {0,0};
+    double q_goal[2] = {M_PI/2, 0};
+    double E_goal[7];
+    l1_pose( sg, q_goal, E_goal );
+
+    struct aa_rx_mp *mp = aa_rx_mp_create(ssg);
+    aa_rx_mp_set_wsgoal_pool( mp, 2, 1e-2 );
+    aa_rx_mp_set_start( mp, n_q, q_start );
+    test( "wsgoal pool goal",
+          AA_RX_OK == aa_rx_mp_set_wsgoal(mp, 1, NULL, E_goal, 7) );
+
+    for( int i = 0; i < 2; i ++ ) {
+        size_t n_path = 0;
+        double *path = NULL;
+        test( "wsgoal pool", AA_RX_OK == aa_rx_mp_plan(mp, 5, &n_path, &path) );
+        test( "wsgoal pool path", n_path >= 2 );
+        if( n_path < 2 ) continue;
+        aveq( "wsgoal pool start", n_q, q_start, path, 1e-6 );
+
+        double E_end[7];
+        l1_pose( sg, path + (n_path-1)*n_q, E_end );
+        aveq( "wsgoal pool end", 3, E_goal + AA_TF_QUTR_V, E_end + AA_TF_QUTR_V, 1e-2 );
+        test( "wsgoal pool free", path_free(sg, n_path, path) );
+        free(path);
+    }
+
+    aa_rx_mp_destroy(mp);
+}
+
+int main(void)
+{
+    struct aa_rx_sg *sg = arm(0);
+    struct aa_rx_sg_sub *ssg =
+        aa_rx_sg_chain_create( sg, AA_RX_FRAME_ROOT,
+                               aa_rx_sg_frame_id(sg, "l1") );
+
+    test_native( sg, ssg );
+    test_parallel( sg, ssg );
+
+    aa_rx_sg_sub_destroy(ssg);
+    aa_rx_sg_destroy(sg);
+
+    sg = arm(1);
+    ssg = aa_rx_sg_chain_create( sg, AA_RX_FRAME_ROOT,
+                                 aa_rx_sg_frame_id(sg, "l1") );
+
+    test_obstacle( sg, ssg );
+    test_lazy_prm_obstacle( sg, ssg );
+    test_postprocess( sg, ssg );
+    test_wsgoal_pool( sg, ssg );
+    test_reset( sg, ssg );
+    test_library( sg, ssg );
+    test_static_frames( sg );
+    test_async( sg );
+
+    aa_rx_sg_sub_destroy(ssg);
+    aa_rx_sg_destroy(sg);
+    return 0;
+}
@@ -0,0 +1,253 @@
+/* -*- mode: C; c-basic-offset: 4; -*- */
+/* ex: set shiftwidth=4 tabstop=4 expandtab: */
+/*
+ * Copyright (c) 2016, Rice University
+ * All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or
+ *   without modification, are permitted provided that the following
+ *   conditions are met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of copyright holder the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ *   CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ *   INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ *   MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ *   USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *   AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *   POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * Benchmark the per-cycle latency of differential IK servoing.
+ *
+ * Each cycle computes joint velocities from a measured configuration,
+ * a reference pose and a desired twist.  The "x2dq" row computes
+ * kinematics and calls aa_rx_ik_jac_x2dq(), as in a hand-written
+ * servo loop.  The "servo" row calls aa_rx_ik_servo_step().  The two
+ * share the same kernels and have similar latency; the servo differs
+ * in performing no allocation per cycle.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+
+#include "amino.h"
+#include "amino/rx/rxtype.h"
+#include "amino/rx/scenegraph.h"
+#include "amino/rx/scene_sub.h"
+#include "amino/rx/scene_kin.h"
+#include "amino/rx/scene_plugin.h"
+
+static int
+dcmp( const void *a, const void *b )
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static double
+percentile( size_t n, const double *x_sorted, double p )
+{
+    if( 0 == n ) return nan("");
+    size_t i = (size_t)(p * (double)(n-1) + .5);
+    return x_sorted[AA_MIN(i,n-1)];
+}
+
+/* A 7-DOF arm, used when no plugin is given */
+static struct aa_rx_sg *
+arm7( void )
+{
+    static const double L0[3] = {0, 0, .3};
+    static const double L1[3] = {0, 0, .4};
+    static const double L2[3] = {.1, 0, .2};
+    const double *axes[7] = {aa_tf_vec_z, aa_tf_vec_y, aa_tf_vec_z, aa_tf_vec_y,
+                             aa_tf_vec_z, aa_tf_vec_y, aa_tf_vec_z };
+    const double *offs[7] = {L0, L0, L1, L1, L1, L2, L2};
+
+    struct aa_rx_sg *sg = aa_rx_sg_create();
+    const char *parent = "";
+    char names[7][4];
+    for( size_t i = 0; i < 7; i ++ ) {
+        sprintf(names[i], "a%d", (int)i);
+        aa_rx_sg_add_frame_revolute( sg, parent, names[i],
+                                     NULL, offs[i],
+                                     NULL, axes[i], 0 );
+        aa_rx_sg_set_limit_pos( sg, names[i], -M_PI, M_PI );
+        parent = names[i];
+    }
+    aa_rx_sg_add_frame_fixed( sg, parent, "ee", NULL, L2 );
+    return sg;
+}
+
+/* Measured configuration at cycle k: each joint oscillates about
+ * the nominal configuration */
+static void
+measured_config( size_t n, const double *q_center, size_t k, double *q )
+{
+    for( size_t i = 0; i < n; i ++ ) {
+        q[i] = q_center[i] + .2 * sin( 2*M_PI * (double)k / 1000 + (double)i );
+    }
+}
+
+int main( int argc, char *argv[] )
+{
+    const char *name = "scenegraph";
+    const char *plugin = NULL;
+    const char *root = NULL;
+    const char *end_effector = NULL;
+    size_t n_cycles = 1000000;
+
+    /* Parse Options */
+    {
+        int c;
+        while( (c = getopt( argc, argv, "n:r:e:k:?")) != -1 ) {
+            switch(c) {
+            case 'n':
+                name = optarg;
+                break;
+            case 'r':
+                root = optarg;
+                break;
+            case 'e':
+                end_effector = optarg;
+                break;
+            case 'k':
+                n_cycles = (size_t)atol(optarg);
+                break;
+            case '?':
+            default:
+                puts("Usage: servo_bench [OPTIONS] [PLUGIN_NAME]\n"
+                     "Benchmark the cycle latency of differential IK servoing\n"
+                     "\n"
+                     "Options:\n"
+                     "  -n NAME         scene graph name (default: scenegraph)\n"
+                     "  -r NAME         root frame of the chain (default: global)\n"
+                     "  -e NAME         end-effector frame of the chain\n"
+                     "  -k COUNT        number of cycles (default: 1000000)\n"
+                     "\n"
+                     "Without a plugin, a built-in 7-DOF arm is used.\n"
+                     "\n"
+                     "Report bugs to " PACKAGE_BUGREPORT "\n" );
+                exit(EXIT_SUCCESS);
+            }
+        }
+        if( optind < argc ) {
+            plugin = argv[optind++];
+        }
+    }
+
+    struct aa_rx_sg *sg;
+    if( plugin ) {
+        if( NULL == end_effector ) {
+            fprintf(stderr, "servo_bench: end-effector frame required (-e)\n");
+            exit(EXIT_FAILURE);
+        }
+        sg = aa_rx_dl_sg(plugin, name, NULL);
+    } else {
+        sg = arm7();
+        end_effector = "ee";
+    }
+    aa_rx_sg_init(sg);
+
+    aa_rx_frame_id id_root = root ? aa_rx_sg_frame_id(sg, root) : AA_RX_FRAME_ROOT;
+    aa_rx_frame_id id_ee = aa_rx_sg_frame_id(sg, end_effector);
+    if( AA_RX_FRAME_NONE == id_root || AA_RX_FRAME_NONE == id_ee ) {
+        fprintf(stderr, "servo_bench: invalid chain frames\n");
+        exit(EXIT_FAILURE);
+    }
+
+    struct aa_rx_sg_sub *ssg = aa_rx_sg_chain_create( sg, id_root, id_ee );
+    size_t n_q = aa_rx_sg_config_count(sg);
+    size_t n_f = aa_rx_sg_frame_count(sg);
+    size_t n_qs = aa_rx_sg_sub_config_count(ssg);
+
+    printf("scene: %s, chain: %s -> %s, %lu configs, %lu cycles\n",
+           plugin ? plugin : "arm7",
+           aa_rx_sg_frame_name(sg, id_root), end_effector,
+           n_qs, n_cycles);
+
+    struct aa_rx_ksol_opts *opts = aa_rx_ksol_opts_create();
+    aa_rx_ksol_opts_center_configs( opts, ssg, .1 );
+
+    /* Reference at a nominal configuration, offset from the center
+     * to avoid the singularities of a straight arm, with a small
+     * twist */
+    double qs_center[n_qs], E_ref[7];
+    double dx_ref[6] = {.01, 0, -.01, 0, .02, 0};
+    double *q = AA_NEW0_AR( double, n_q );
+    double *TF_rel = AA_NEW_AR( double, 7*n_f );
+    double *TF_abs = AA_NEW_AR( double, 7*n_f );
+    double *J = AA_NEW_AR( double, 6*n_qs );
+    aa_rx_sg_sub_center_configs( ssg, n_qs, qs_center );
+    for( size_t i = 0; i < n_qs; i ++ ) qs_center[i] += .5;
+    aa_rx_sg_sub_config_set( ssg, n_qs, qs_center, n_q, q );
+    aa_rx_sg_tf( sg, n_q, q, n_f, TF_rel, 7, TF_abs, 7 );
+    AA_MEM_CPY( E_ref, TF_abs + 7*id_ee, 7 );
+
+    struct aa_rx_ik_servo *servo = aa_rx_ik_servo_create( ssg, opts );
+    if( NULL == servo ) {
+        fprintf(stderr, "servo_bench: unsupported chain\n");
+        exit(EXIT_FAILURE);
+    }
+
+    printf("%-10s %12s %12s %12s\n",
+           "method", "median (us)", "p99 (us)", "max (us)");
+    double *t = AA_NEW_AR( double, n_cycles );
+    for( int m = 0; m < 2; m ++ ) {
+        double qs[n_qs], dq[n_qs];
+        for( size_t k = 0; k < n_cycles; k ++ ) {
+            measured_config( n_qs, qs_center, k, qs );
+            struct timespec t0 = aa_tm_now();
+            if( 0 == m ) {
+                aa_rx_sg_sub_config_set( ssg, n_qs, qs, n_q, q );
+                aa_rx_sg_tf( sg, n_q, q, n_f, TF_rel, 7, TF_abs, 7 );
+                aa_rx_sg_sub_jacobian( ssg, n_f, TF_abs, 7, J, 6 );
+                aa_rx_ik_jac_x2dq( opts, n_qs, qs, TF_abs + 7*id_ee,
+                                   E_ref, dx_ref, J, dq );
+            } else {
+                aa_rx_ik_servo_step( servo, n_qs, qs, E_ref, dx_ref, dq );
+            }
+            struct timespec t1 = aa_tm_now();
+            t[k] = 1e6 * aa_tm_timespec2sec( aa_tm_sub(t1, t0) );
+        }
+
+        qsort( t, n_cycles, sizeof(t[0]), dcmp );
+        printf("%-10s %12.3f %12.3f %12.3f\n",
+               m ? "servo" : "x2dq",
+               percentile(n_cycles, t, .5),
+               percentile(n_cycles, t, .99),
+               n_cycles ? t[n_cycles-1] : nan(""));
+    }
+
+    free( t );
+    aa_rx_ik_servo_destroy( servo );
+    aa_rx_ksol_opts_destroy( opts );
+    free( J );
+    free( TF_abs );
+    free( TF_rel );
+    free( q );
+    aa_rx_sg_sub_destroy( ssg );
+    aa_rx_sg_destroy( sg );
+
+    return 0;
+}
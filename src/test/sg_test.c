@@ -43,8 +43,13 @@
 #include "amino.h"
 #include "amino/test.h"
 #include "amino/rx/rxtype.h"
+#include "amino/rx/rxerr.h"
 #include "amino/rx/scenegraph.h"
 #include "amino/rx/scenegraph_internal.h"
+#include "amino/rx/scene_sub.h"
+#include "amino/rx/scene_kin.h"
+#include "amino/rx/scene_geom.h"
+#include "amino/rx/rx_ct.h"
 #include <assert.h>
 
 
@@ -52,6 +57,25 @@
 static void scara( struct aa_rx_sg *sg );
 static void check_scara( struct aa_rx_sg *sg );
 static void check_tf( struct aa_rx_sg *sg );
+static void check_tf_frames( struct aa_rx_sg *sg );
+static void check_geom_version( struct aa_rx_sg *sg );
+
+static void arm7( struct aa_rx_sg *sg );
+static void check_ik( struct aa_rx_sg *sg, enum aa_rx_ik_method method );
+static void check_ik_multistart( struct aa_rx_sg *sg );
+static void check_ik_cache( struct aa_rx_sg *sg );
+static void check_reach_map( struct aa_rx_sg *sg );
+static void check_ik_servo( struct aa_rx_sg *sg );
+
+static void dual_arm( struct aa_rx_sg *sg );
+static void check_tree( struct aa_rx_sg *sg );
+
+static void ur5( struct aa_rx_sg *sg );
+static void puma( struct aa_rx_sg *sg );
+static void check_ik_analytic( struct aa_rx_sg *sg );
+
+static void planar2( struct aa_rx_sg *sg );
+static void check_traj_opt( struct aa_rx_sg *sg );
 
 int main(void)
 {
@@ -61,9 +85,57 @@ int main(void)
 
     check_scara(sg);
     check_tf(sg);
+    check_tf_frames(sg);
+    check_geom_version(sg);
+
+    aa_rx_sg_destroy(sg);
+
+    sg = aa_rx_sg_create();
+    arm7(sg);
+    aa_rx_sg_init(sg);
+
+    check_ik(sg, AA_RX_IK_ODE);
+    check_ik(sg, AA_RX_IK_LM);
+    check_ik(sg, AA_RX_IK_QP);
+    check_ik_multistart(sg);
+    check_ik_cache(sg);
+    check_reach_map(sg);
+    check_ik_servo(sg);
+
+    {
+        /* No closed-form solution for 7 DOF */
+        struct aa_rx_sg_sub *ssg = aa_rx_sg_chain_create( sg, AA_RX_FRAME_ROOT,
+                                                          aa_rx_sg_frame_id(sg,"ee") );
+        test( "analytic 7dof", NULL == aa_rx_ik_analytic_cx_create(ssg, NULL) );
+        aa_rx_sg_sub_destroy(ssg);
+    }
+
+    aa_rx_sg_destroy(sg);
+
+    sg = aa_rx_sg_create();
+    dual_arm(sg);
+    aa_rx_sg_init(sg);
 
+    check_tree(sg);
 
+    aa_rx_sg_destroy(sg);
+
+    sg = aa_rx_sg_create();
+    ur5(sg);
+    aa_rx_sg_init(sg);
+    check_ik_analytic(sg);
+    aa_rx_sg_destroy(sg);
 
+    sg = aa_rx_sg_create();
+    puma(sg);
+    aa_rx_sg_init(sg);
+    check_ik_analytic(sg);
+    aa_rx_sg_destroy(sg);
+
+    sg = aa_rx_sg_create();
+    planar2(sg);
+    aa_rx_sg_init(sg);
+    check_traj_opt(sg);
     aa_rx_sg_destroy(sg);
 
     return 0;
@@ -195,3 +267,911 @@ static void check_tf( struct aa_rx_sg *sg )
         aveq( "chain 0", 7*4, E_ref, TF_abs, 1e-6 );
     }
 }
+
+static void check_tf_frames( struct aa_rx_sg *sg )
+{
+    size_t frame_cnt =  aa_rx_sg_frame_count(sg);
+    size_t config_cnt =  aa_rx_sg_config_count(sg);
+    double q0[config_cnt], q[config_cnt];
+    double TF_rel[7*frame_cnt];
+    double TF_abs[7*frame_cnt];
+    double TF_sub[7*frame_cnt];
+
+    AA_MEM_ZERO(q0, config_cnt);
+    aa_rx_sg_tf( sg, config_cnt, q0, frame_cnt, TF_rel, 7, TF_sub, 7 );
+
+    /* Only the chain from q1 to the tip moves */
+    struct aa_rx_sg_sub *ssg = aa_rx_sg_chain_create( sg,
+                                                      aa_rx_sg_frame_id(sg,"q0"),
+                                                      aa_rx_sg_frame_id(sg,"q3") );
+    AA_MEM_CPY(q, q0, config_cnt);
+    q[aa_rx_sg_config_id(sg,"q1")] = M_PI_2;
+    q[aa_rx_sg_config_id(sg,"q2")] = -1;
+    q[aa_rx_sg_config_id(sg,"q3")] = 1.5;
+
+    aa_rx_sg_tf( sg, config_cnt, q, frame_cnt, TF_rel, 7, TF_abs, 7 );
+    aa_rx_sg_sub_tf( ssg, config_cnt, q, frame_cnt, TF_sub, 7 );
+    aveq( "sub tf", 7*frame_cnt, TF_abs, TF_sub, 1e-6 );
+
+    aa_rx_sg_sub_destroy(ssg);
+}
+
+
+static void check_geom_version( struct aa_rx_sg *sg )
+{
+    aa_rx_frame_id fid0 = aa_rx_sg_frame_id(sg,"q0");
+    aa_rx_frame_id fid1 = aa_rx_sg_frame_id(sg,"q1");
+    uint64_t v0 = aa_rx_sg_frame_geom_version(sg, fid0);
+
+    /* Adding geometry changes only that frame */
+    struct aa_rx_geom_opt *opt = aa_rx_geom_opt_create();
+    static const double d[3] = {.1, .1, .1};
+    aa_rx_geom_attach( sg, "q1", aa_rx_geom_box(opt, d) );
+    aa_rx_geom_opt_destroy(opt);
+
+    uint64_t v = aa_rx_sg_geom_version(sg);
+    test( "geom version frame", v == aa_rx_sg_frame_geom_version(sg, fid1) );
+    test( "geom version other", v0 == aa_rx_sg_frame_geom_version(sg, fid0) );
+
+    /* Marking a frame dirty changes only that frame */
+    aa_rx_sg_frame_dirty_geom( sg, fid0 );
+    v = aa_rx_sg_geom_version(sg);
+    test( "geom version dirty frame", v == aa_rx_sg_frame_geom_version(sg, fid0) );
+    test( "geom version dirty other", v > aa_rx_sg_frame_geom_version(sg, fid1) );
+
+    /* Moving a frame changes it and its descendants */
+    {
+        static const double E1[7] = {0,0,0,1, l1,0,.1};
+        aa_rx_sg_reparent_name( sg, "q0", "q1", E1 );
+        aa_rx_sg_init(sg);
+        aa_rx_frame_id fid2 = aa_rx_sg_frame_id(sg,"q2");
+        uint64_t vm = aa_rx_sg_geom_version(sg);
+        test( "geom version move", vm > v &&
+              vm == aa_rx_sg_frame_geom_version(sg, aa_rx_sg_frame_id(sg,"q1")) &&
+              vm == aa_rx_sg_frame_geom_version(sg, fid2) );
+        test( "geom version move parent", v == aa_rx_sg_frame_geom_version(sg, fid0) );
+        v = vm;
+    }
+
+    /* Unspecified changes affect all frames */
+    aa_rx_sg_dirty_geom(sg);
+    test( "geom version all",
+          aa_rx_sg_geom_version(sg) > v &&
+          aa_rx_sg_geom_version(sg) == aa_rx_sg_frame_geom_version(sg, fid0) &&
+          aa_rx_sg_geom_version(sg) == aa_rx_sg_frame_geom_version(sg, fid1) );
+}
+
+static void arm7( struct aa_rx_sg *sg )
+{
+    static const double L0[3] = {0, 0, .3};
+    static const double L1[3] = {0, 0, .4};
+    static const double L2[3] = {.1, 0, .2};
+    const double *axes[7] = {aa_tf_vec_z, aa_tf_vec_y, aa_tf_vec_z, aa_tf_vec_y,
+                             aa_tf_vec_z, aa_tf_vec_y, aa_tf_vec_z };
+    const double *offs[7] = {L0, L0, L1, L1, L1, L2, L2};
+
+    /* Unrelated frames */
+    aa_rx_sg_add_frame_fixed( sg, "", "table", NULL, L1 );
+    aa_rx_sg_add_frame_fixed( sg, "table", "object", NULL, L2 );
+
+    const char *parent = "";
+    char names[7][4];
+    for( size_t i = 0; i < 7; i ++ ) {
+        sprintf(names[i], "a%d", (int)i);
+        aa_rx_sg_add_frame_revolute( sg, parent, names[i],
+                                     NULL, offs[i],
+                                     NULL, axes[i], 0 );
+        aa_rx_sg_set_limit_pos( sg, names[i], -M_PI, M_PI );
+        parent = names[i];
+    }
+    aa_rx_sg_add_frame_fixed( sg, parent, "ee", NULL, L2 );
+}
+
+static void check_ik_pose( const struct aa_rx_sg_sub *ssg, aa_rx_frame_id id_ee,
+                           const double *qs, const double E_ref[7] )
+{
+    const struct aa_rx_sg *sg = aa_rx_sg_sub_sg(ssg);
+    size_t frame_cnt =  aa_rx_sg_frame_count(sg);
+    size_t config_cnt =  aa_rx_sg_config_count(sg);
+    size_t n_sq = aa_rx_sg_sub_config_count(ssg);
+    double q[config_cnt];
+    double TF_rel[7*frame_cnt];
+    double TF_abs[7*frame_cnt];
+
+    AA_MEM_ZERO(q, config_cnt);
+    aa_rx_sg_sub_config_set( ssg, n_sq, qs, config_cnt, q );
+    aa_rx_sg_tf( sg, config_cnt, q, frame_cnt, TF_rel, 7, TF_abs, 7 );
+
+    double E_rel[7];
+    aa_tf_qutr_cmul( E_ref, TF_abs + 7*id_ee, E_rel );
+    aa_tf_qminimize( E_rel + AA_TF_QUTR_Q );
+    test_flt( "ik trans", aa_la_norm(3, E_rel + AA_TF_QUTR_T), 1e-3, 0 );
+    test_flt( "ik angle", aa_la_norm(3, E_rel + AA_TF_QUTR_Q), 1e-2, 0 );
+}
+
+static void check_ik( struct aa_rx_sg *sg, enum aa_rx_ik_method method )
+{
+    size_t frame_cnt =  aa_rx_sg_frame_count(sg);
+    size_t config_cnt =  aa_rx_sg_config_count(sg);
+    aa_rx_frame_id id_ee = aa_rx_sg_frame_id(sg,"ee");
+
+    struct aa_rx_sg_sub *ssg = aa_rx_sg_chain_create( sg, AA_RX_FRAME_ROOT, id_ee );
+    size_t n_sq = aa_rx_sg_sub_config_count(ssg);
+    assert( 7 == n_sq );
+
+    struct aa_rx_ksol_opts *opts = aa_rx_ksol_opts_create();
+    aa_rx_ksol_opts_center_seed( opts, ssg );
+    aa_rx_ksol_opts_center_configs( opts, ssg, .1 );
+    aa_rx_ksol_opts_set_ik_method( opts, method );
+    struct aa_rx_ik_jac_cx *ik_cx = aa_rx_ik_jac_cx_create( ssg, opts );
+
+    double q[config_cnt];
+    double TF_rel[7*frame_cnt];
+    double TF_abs[7*frame_cnt];
+
+    size_t n_ok = 0;
+    for( size_t k = 0; k < 20; k ++ ) {
+        /* Reachable target pose */
+        double qs_ref[n_sq];
+        for( size_t i = 0; i < n_sq; i ++ ) {
+            qs_ref[i] = 2*aa_frand() - 1;
+        }
+        AA_MEM_ZERO(q, config_cnt);
+        aa_rx_sg_sub_config_set( ssg, n_sq, qs_ref, config_cnt, q );
+        aa_rx_sg_tf( sg, config_cnt, q, frame_cnt, TF_rel, 7, TF_abs, 7 );
+        double E_ref[7];
+        AA_MEM_CPY( E_ref, TF_abs + 7*id_ee, 7 );
+
+        double qs[n_sq];
+        int r = aa_rx_ik_jac_solve( ik_cx, 1, E_ref, 7, n_sq, qs );
+        if( r ) continue; /* numerical IK may not converge */
+
+        check_ik_pose( ssg, id_ee, qs, E_ref );
+        n_ok++;
+    }
+    /* Targets are reachable, so most solves should converge.  The
+     * ODE integrator stalls near joint limits more often. */
+    test( "ik converged", n_ok >= ((AA_RX_IK_ODE == method) ? 10 : 18) );
+
+    aa_rx_ik_jac_cx_destroy( ik_cx );
+    aa_rx_ksol_opts_destroy( opts );
+    aa_rx_sg_sub_destroy(ssg);
+}
+
+static void check_ik_multistart( struct aa_rx_sg *sg )
+{
+    size_t frame_cnt =  aa_rx_sg_frame_count(sg);
+    size_t config_cnt =  aa_rx_sg_config_count(sg);
+    aa_rx_frame_id id_ee = aa_rx_sg_frame_id(sg,"ee");
+
+    struct aa_rx_sg_sub *ssg = aa_rx_sg_chain_create( sg, AA_RX_FRAME_ROOT, id_ee );
+    size_t n_sq = aa_rx_sg_sub_config_count(ssg);
+
+    struct aa_rx_ksol_opts *opts = aa_rx_ksol_opts_create();
+    aa_rx_ksol_opts_center_seed( opts, ssg );
+    aa_rx_ksol_opts_center_configs( opts, ssg, .1 );
+    aa_rx_ksol_opts_set_ik_method( opts, AA_RX_IK_LM );
+    struct aa_rx_ik_jac_cx *ik_cx = aa_rx_ik_jac_cx_create( ssg, opts );
+
+    double q[config_cnt];
+    double TF_rel[7*frame_cnt];
+    double TF_abs[7*frame_cnt];
+
+    for( size_t k = 0; k < 10; k ++ ) {
+        double qs_ref[n_sq];
+        for( size_t i = 0; i < n_sq; i ++ ) {
+            qs_ref[i] = 2*aa_frand() - 1;
+        }
+        AA_MEM_ZERO(q, config_cnt);
+        aa_rx_sg_sub_config_set( ssg, n_sq, qs_ref, config_cnt, q );
+        aa_rx_sg_tf( sg, config_cnt, q, frame_cnt, TF_rel, 7, TF_abs, 7 );
+        double E_ref[7];
+        AA_MEM_CPY( E_ref, TF_abs + 7*id_ee, 7 );
+
+        /* First solution */
+        double qs[n_sq];
+        size_t n_found;
+        int r = aa_rx_ik_solve_multistart( ik_cx, 4, 32, 1, E_ref, 7, NULL,
+                                           n_sq, 1, qs, n_sq, &n_found );
+        test( "multistart first", 0 == r && 1 == n_found );
+        check_ik_pose( ssg, id_ee, qs, E_ref );
+
+        /* Several solutions, ranked by distance to qs_ref */
+        size_t n_sol = 4;
+        double Q[n_sq*n_sol];
+        r = aa_rx_ik_solve_multistart( ik_cx, 4, 32, 1, E_ref, 7, qs_ref,
+                                       n_sq, n_sol, Q, n_sq, &n_found );
+        test( "multistart several", 0 == r && n_found >= 1 && n_found <= n_sol );
+        for( size_t j = 0; j < n_found; j ++ ) {
+            check_ik_pose( ssg, id_ee, Q + j*n_sq, E_ref );
+            if( j > 0 ) {
+                test( "multistart ranked",
+                      aa_la_ssd(n_sq, qs_ref, Q + (j-1)*n_sq) <=
+                      aa_la_ssd(n_sq, qs_ref, Q + j*n_sq) );
+                test( "multistart distinct",
+                      aa_la_ssd(n_sq, Q + (j-1)*n_sq, Q + j*n_sq) > 0 );
+            }
+        }
+    }
+
+    aa_rx_ik_jac_cx_destroy( ik_cx );
+    aa_rx_ksol_opts_destroy( opts );
+    aa_rx_sg_sub_destroy(ssg);
+}
+
+static void dual_arm( struct aa_rx_sg *sg )
+{
+    static const double L0[3] = {0, 0, .3};
+    static const double L1[3] = {0, 0, .4};
+    static const double L2[3] = {.1, 0, .2};
+    static const double SL[3] = {0, .2, .1};
+    static const double SR[3] = {0, -.2, .1};
+    const double *axes[6] = {aa_tf_vec_z, aa_tf_vec_y, aa_tf_vec_z, aa_tf_vec_y,
+                             aa_tf_vec_z, aa_tf_vec_y };
+    const double *offs[6] = {L0, L1, L1, L1, L2, L2};
+
+    /* Shared torso */
+    aa_rx_sg_add_frame_revolute( sg, "", "torso",
+                                 NULL, L0,
+                                 NULL, aa_tf_vec_z, 0 );
+    aa_rx_sg_set_limit_pos( sg, "torso", -M_PI, M_PI );
+    aa_rx_sg_add_frame_fixed( sg, "torso", "left_shoulder", NULL, SL );
+    aa_rx_sg_add_frame_fixed( sg, "torso", "right_shoulder", NULL, SR );
+
+    /* Arms */
+    const char *prefix[2] = {"left", "right"};
+    for( size_t k = 0; k < 2; k ++ ) {
+        char parent[32], name[32];
+        sprintf(parent, "%s_shoulder", prefix[k]);
+        for( size_t i = 0; i < 6; i ++ ) {
+            sprintf(name, "%s%d", prefix[k], (int)i);
+            aa_rx_sg_add_frame_revolute( sg, parent, name,
+                                         NULL, offs[i],
+                                         NULL, axes[i], 0 );
+            aa_rx_sg_set_limit_pos( sg, name, -M_PI, M_PI );
+            strcpy(parent, name);
+        }
+        sprintf(name, "%s_ee", prefix[k]);
+        aa_rx_sg_add_frame_fixed( sg, parent, name, NULL, L2 );
+    }
+}
+
+static void check_tree( struct aa_rx_sg *sg )
+{
+    size_t frame_cnt =  aa_rx_sg_frame_count(sg);
+    size_t config_cnt =  aa_rx_sg_config_count(sg);
+    aa_rx_frame_id tips[2] = { aa_rx_sg_frame_id(sg,"left_ee"),
+                               aa_rx_sg_frame_id(sg,"right_ee") };
+
+    struct aa_rx_sg_sub *ssg = aa_rx_sg_tree_create( sg, AA_RX_FRAME_ROOT, 2, tips );
+    size_t n_sq = aa_rx_sg_sub_config_count(ssg);
+    test( "tree configs", 13 == n_sq );
+    test( "tree ees", 2 == aa_rx_sg_sub_ee_count(ssg) &&
+          tips[0] == aa_rx_sg_sub_ee(ssg,0) &&
+          tips[1] == aa_rx_sg_sub_ee(ssg,1) );
+
+    size_t rows, cols;
+    aa_rx_sg_sub_jacobian_size( ssg, &rows, &cols );
+    test( "tree jacobian size", 12 == rows && n_sq == cols );
+
+    double q[config_cnt];
+    double TF_rel[7*frame_cnt];
+    double TF_abs[7*frame_cnt];
+
+    /* Stacked Jacobian matches the chain Jacobians */
+    {
+        for( size_t i = 0; i < config_cnt; i ++ ) {
+            q[i] = 2*aa_frand() - 1;
+        }
+        aa_rx_sg_tf( sg, config_cnt, q, frame_cnt, TF_rel, 7, TF_abs, 7 );
+        double J[rows*cols];
+        aa_rx_sg_sub_jacobian( ssg, frame_cnt, TF_abs, 7, J, rows );
+
+        for( size_t k = 0; k < 2; k ++ ) {
+            struct aa_rx_sg_sub *chain = aa_rx_sg_chain_create( sg, AA_RX_FRAME_ROOT, tips[k] );
+            size_t n_c = aa_rx_sg_sub_config_count(chain);
+            double Jc[6*n_c];
+            aa_rx_sg_sub_jacobian( chain, frame_cnt, TF_abs, 7, Jc, 6 );
+            for( size_t j = 0; j < n_sq; j ++ ) {
+                aa_rx_config_id c = aa_rx_sg_sub_config(ssg, j);
+                double Jcol[6] = {0};
+                for( size_t i = 0; i < n_c; i ++ ) {
+                    if( c == aa_rx_sg_sub_config(chain, i) ) {
+                        AA_MEM_CPY( Jcol, Jc + 6*i, 6 );
+                    }
+                }
+                aveq( "tree jacobian", 6, Jcol, J + j*rows + 6*k, 1e-9 );
+            }
+            aa_rx_sg_sub_destroy(chain);
+        }
+    }
+
+    /* Solve both targets at once */
+    struct aa_rx_ksol_opts *opts = aa_rx_ksol_opts_create();
+    aa_rx_ksol_opts_center_seed( opts, ssg );
+    aa_rx_ksol_opts_center_configs( opts, ssg, .1 );
+    aa_rx_ksol_opts_set_ik_method( opts, AA_RX_IK_LM );
+    double w[2] = {1, 1};
+    aa_rx_ksol_opts_take_ee_weights( opts, 2, w, AA_MEM_COPY );
+    struct aa_rx_ik_jac_cx *ik_cx = aa_rx_ik_jac_cx_create( ssg, opts );
+
+    size_t n_ok = 0;
+    for( size_t k = 0; k < 20; k ++ ) {
+        double qs_ref[n_sq];
+        for( size_t i = 0; i < n_sq; i ++ ) {
+            qs_ref[i] = 2*aa_frand() - 1;
+        }
+        AA_MEM_ZERO(q, config_cnt);
+        aa_rx_sg_sub_config_set( ssg, n_sq, qs_ref, config_cnt, q );
+        aa_rx_sg_tf( sg, config_cnt, q, frame_cnt, TF_rel, 7, TF_abs, 7 );
+        double E_ref[2*7];
+        AA_MEM_CPY( E_ref, TF_abs + 7*tips[0], 7 );
+        AA_MEM_CPY( E_ref + 7, TF_abs + 7*tips[1], 7 );
+
+        double qs[n_sq];
+        test( "tree ik n_tf", AA_RX_INVALID_PARAMETER ==
+              aa_rx_ik_jac_solve( ik_cx, 1, E_ref, 7, n_sq, qs ) );
+
+        int r = aa_rx_ik_jac_solve( ik_cx, 2, E_ref, 7, n_sq, qs );
+        if( r ) continue; /* numerical IK may not converge */
+        n_ok++;
+
+        check_ik_pose( ssg, tips[0], qs, E_ref );
+        check_ik_pose( ssg, tips[1], qs, E_ref + 7 );
+    }
+    test( "tree ik solved", n_ok > 0 );
+
+    aa_rx_ik_jac_cx_destroy( ik_cx );
+    aa_rx_ksol_opts_destroy( opts );
+    aa_rx_sg_sub_destroy(ssg);
+}
+
+static void ur5( struct aa_rx_sg *sg )
+{
+    /* From the UR5 URDF */
+    const double s = sqrt(.5);
+    const double q_y[4] = {0, s, 0, s};
+    const double q_ee[4] = {0, 0, s, s};
+    static const double v0[3] = {0, 0, 0.089159};
+    static const double v1[3] = {0, 0.13585, 0};
+    static const double v2[3] = {0, -0.1197, 0.425};
+    static const double v3[3] = {0, 0, 0.39225};
+    static const double v4[3] = {0, 0.093, 0};
+    static const double v5[3] = {0, 0, 0.09465};
+    static const double v6[3] = {0, 0.0823, 0};
+
+    aa_rx_sg_add_frame_fixed( sg, "", "base", NULL, v1 );
+    aa_rx_sg_add_frame_revolute( sg, "base", "shoulder_pan", NULL, v0, NULL, aa_tf_vec_z, 0 );
+    aa_rx_sg_add_frame_revolute( sg, "shoulder_pan", "shoulder_lift", q_y, v1, NULL, aa_tf_vec_y, 0 );
+    aa_rx_sg_add_frame_revolute( sg, "shoulder_lift", "elbow", NULL, v2, NULL, aa_tf_vec_y, 0 );
+    aa_rx_sg_add_frame_revolute( sg, "elbow", "wrist_1", q_y, v3, NULL, aa_tf_vec_y, 0 );
+    aa_rx_sg_add_frame_revolute( sg, "wrist_1", "wrist_2", NULL, v4, NULL, aa_tf_vec_z, .5 );
+    aa_rx_sg_add_frame_revolute( sg, "wrist_2", "wrist_3", NULL, v5, NULL, aa_tf_vec_y, 0 );
+    aa_rx_sg_add_frame_fixed( sg, "wrist_3", "ee", q_ee, v6 );
+
+    const char *joints[6] = {"shoulder_pan", "shoulder_lift", "elbow",
+                             "wrist_1", "wrist_2", "wrist_3"};
+    for( size_t i = 0; i < 6; i ++ ) {
+        aa_rx_sg_set_limit_pos( sg, joints[i], -2*M_PI, 2*M_PI );
+    }
+}
+
+static void puma( struct aa_rx_sg *sg )
+{
+    static const double v0[3] = {0, 0, .6};
+    static const double v1[3] = {0, .15, 0};
+    static const double v2[3] = {.45, 0, 0};
+    static const double v3[3] = {.1, -.05, .03};
+    static const double v4[3] = {.4, 0, 0};
+    static const double v5[3] = {0, 0, 0};
+    static const double v6[3] = {.1, 0, .02};
+    const double *offs[6] = {v0, v1, v2, v3, v4, v5};
+    const double *axes[6] = {aa_tf_vec_z, aa_tf_vec_y, aa_tf_vec_y,
+                             aa_tf_vec_x, aa_tf_vec_y, aa_tf_vec_x };
+    const char *parent = "";
+    char names[6][4];
+    for( size_t i = 0; i < 6; i ++ ) {
+        sprintf(names[i], "p%d", (int)i);
+        aa_rx_sg_add_frame_revolute( sg, parent, names[i],
+                                     NULL, offs[i],
+                                     NULL, axes[i], 0 );
+        aa_rx_sg_set_limit_pos( sg, names[i], -M_PI, M_PI );
+        parent = names[i];
+    }
+    aa_rx_sg_add_frame_fixed( sg, parent, "ee", NULL, v6 );
+}
+
+static void check_ik_analytic( struct aa_rx_sg *sg )
+{
+    size_t frame_cnt =  aa_rx_sg_frame_count(sg);
+    size_t config_cnt =  aa_rx_sg_config_count(sg);
+    aa_rx_frame_id id_ee = aa_rx_sg_frame_id(sg,"ee");
+
+    struct aa_rx_sg_sub *ssg = aa_rx_sg_chain_create( sg, AA_RX_FRAME_ROOT, id_ee );
+    size_t n_sq = aa_rx_sg_sub_config_count(ssg);
+    assert( 6 == n_sq );
+
+    struct aa_rx_ik_analytic_cx *cx = aa_rx_ik_analytic_cx_create( ssg, NULL );
+    test( "analytic create", NULL != cx );
+
+    double q[config_cnt];
+    double TF_rel[7*frame_cnt];
+    double TF_abs[7*frame_cnt];
+
+    for( size_t k = 0; k < 50; k ++ ) {
+        double qs_ref[n_sq];
+        for( size_t i = 0; i < n_sq; i ++ ) {
+            qs_ref[i] = M_PI * (2*aa_frand() - 1);
+        }
+        AA_MEM_ZERO(q, config_cnt);
+        aa_rx_sg_sub_config_set( ssg, n_sq, qs_ref, config_cnt, q );
+        aa_rx_sg_tf( sg, config_cnt, q, frame_cnt, TF_rel, 7, TF_abs, 7 );
+        double E_ref[7];
+        AA_MEM_CPY( E_ref, TF_abs + 7*id_ee, 7 );
+
+        /* All solutions reach the pose, and one is the original */
+        double Q[n_sq*8];
+        size_t n = aa_rx_ik_analytic_solve_all( cx, 1, E_ref, 7, n_sq, 8, Q, n_sq );
+        test( "analytic count", n >= 1 && n <= 8 );
+        int found = 0;
+        for( size_t j = 0; j < n; j ++ ) {
+            check_ik_pose( ssg, id_ee, Q + j*n_sq, E_ref );
+            double d = 0;
+            for( size_t i = 0; i < n_sq; i ++ ) {
+                d = AA_MAX( d, fabs(aa_ang_delta(Q[j*n_sq+i], qs_ref[i])) );
+            }
+            found |= (d < 1e-6);
+        }
+        test( "analytic original", found );
+
+        /* Nearest solution */
+        double qs[n_sq], q_seed[n_sq];
+        for( size_t i = 0; i < n_sq; i ++ ) {
+            q_seed[i] = qs[i] = qs_ref[i] + 1e-2*(2*aa_frand() - 1);
+        }
+        int r = aa_rx_ik_analytic_fun( cx, 1, E_ref, 7, n_sq, qs );
+        test( "analytic fun", 0 == r );
+        check_ik_pose( ssg, id_ee, qs, E_ref );
+        test( "analytic nearest",
+              aa_la_ssd(n_sq, q_seed, qs) <= aa_la_ssd(n_sq, q_seed, qs_ref) + 1e-9 );
+    }
+
+    /* Unreachable */
+    {
+        double E[7] = {0, 0, 0, 1, 10, 0, 0};
+        double qs[6] = {0};
+        test( "analytic unreachable",
+              0 != aa_rx_ik_analytic_fun( cx, 1, E, 7, n_sq, qs ) );
+    }
+
+    /* Code generation */
+    {
+        FILE *out = tmpfile();
+        test( "analytic gen", 0 == aa_rx_ik_analytic_gen( cx, "test_arm", out ) );
+        test( "analytic gen name",
+              AA_RX_INVALID_PARAMETER == aa_rx_ik_analytic_gen( cx, "bad-name", out ) );
+        test( "analytic gen size", ftell(out) > 0 );
+        fclose(out);
+    }
+
+    aa_rx_ik_analytic_cx_destroy( cx );
+    aa_rx_sg_sub_destroy(ssg);
+}
+
+static double cache_dist2( const double *a, const double *b )
+{
+    double d2t = 0, d2p = 0, d2m = 0;
+    for( size_t i = 0; i < 3; i ++ ) {
+        double t = a[AA_TF_QUTR_T+i] - b[AA_TF_QUTR_T+i];
+        d2t += t*t;
+    }
+    for( size_t i = 0; i < 4; i ++ ) {
+        double p = a[AA_TF_QUTR_Q+i] - b[AA_TF_QUTR_Q+i];
+        double m = a[AA_TF_QUTR_Q+i] + b[AA_TF_QUTR_Q+i];
+        d2p += p*p;
+        d2m += m*m;
+    }
+    return d2t + AA_MIN(d2p, d2m);
+}
+
+static void check_ik_cache( struct aa_rx_sg *sg )
+{
+    /* Nearest lookup against brute force */
+    {
+        size_t n = 300, n_q = 2;
+        struct aa_rx_ik_cache *cache = aa_rx_ik_cache_create( n_q, n );
+        double E[7*n];
+        for( size_t j = 0; j < n; j ++ ) {
+            aa_tf_qutr_rand( E + 7*j );
+            double q[2] = {(double)j, -(double)j};
+            aa_rx_ik_cache_add( cache, E + 7*j, n_q, q );
+        }
+        test( "cache count", n == aa_rx_ik_cache_count(cache) );
+
+        for( size_t k = 0; k < 50; k ++ ) {
+            double E_q[7];
+            aa_tf_qutr_rand( E_q );
+            size_t j_min = 0;
+            for( size_t j = 1; j < n; j ++ ) {
+                if( cache_dist2(E_q, E + 7*j) < cache_dist2(E_q, E + 7*j_min) ) j_min = j;
+            }
+            double Q[3*n_q];
+            size_t n_c = aa_rx_ik_cache_nearest( cache, E_q, 3, n_q, Q, n_q );
+            test( "cache nearest", 3 == n_c && (double)j_min == Q[0] );
+        }
+
+        /* Persistence */
+        FILE *f = tmpfile();
+        test( "cache write", 0 == aa_rx_ik_cache_write(cache, f) );
+        rewind(f);
+        struct aa_rx_ik_cache *cache2 = aa_rx_ik_cache_read( f, n_q, n );
+        test( "cache read", cache2 && n == aa_rx_ik_cache_count(cache2) );
+        rewind(f);
+        test( "cache read n_q", NULL == aa_rx_ik_cache_read(f, n_q+1, n) );
+        rewind(f);
+        struct aa_rx_ik_cache *cache3 = aa_rx_ik_cache_read( f, n_q, n/2 );
+        test( "cache read cap", cache3 && n/2 == aa_rx_ik_cache_count(cache3) );
+        aa_rx_ik_cache_destroy( cache3 );
+        {
+            /* Truncated data and an oversized count */
+            rewind(f);
+            size_t len = 8 + 2*sizeof(uint64_t) + sizeof(double) + 7*sizeof(double);
+            char buf[len];
+            test( "cache read hdr", len == fread(buf, 1, len, f) );
+            uint64_t hdr[2];
+            memcpy( hdr, buf + 8, sizeof(hdr) );
+            FILE *g = tmpfile();
+            fwrite( buf, 1, len, g );
+            rewind(g);
+            test( "cache read truncated", NULL == aa_rx_ik_cache_read(g, n_q, n) );
+            hdr[1] = UINT64_MAX;
+            memcpy( buf + 8, hdr, sizeof(hdr) );
+            rewind(g);
+            fwrite( buf, 1, len, g );
+            rewind(g);
+            test( "cache read count", NULL == aa_rx_ik_cache_read(g, n_q, n) );
+            fclose(g);
+        }
+        fclose(f);
+        for( size_t k = 0; cache2 && k < 10; k ++ ) {
+            double E_q[7], Q1[n_q*2], Q2[n_q*2];
+            aa_tf_qutr_rand( E_q );
+            aa_rx_ik_cache_nearest( cache, E_q, 2, n_q, Q1, n_q );
+            aa_rx_ik_cache_nearest( cache2, E_q, 2, n_q, Q2, n_q );
+            aveq( "cache read nearest", 2*n_q, Q1, Q2, 0 );
+        }
+        aa_rx_ik_cache_destroy( cache2 );
+
+        /* Capacity */
+        struct aa_rx_ik_cache *small = aa_rx_ik_cache_create( n_q, 16 );
+        for( size_t j = 0; j < 40; j ++ ) {
+            double q[2] = {(double)j, 0};
+            aa_rx_ik_cache_add( small, E + 7*j, n_q, q );
+        }
+        test( "cache capacity", 16 == aa_rx_ik_cache_count(small) );
+        double Q[n_q];
+        aa_rx_ik_cache_nearest( small, E + 7*39, 1, n_q, Q, n_q );
+        test( "cache newest", 39 == Q[0] );
+        aa_rx_ik_cache_destroy( small );
+
+        aa_rx_ik_cache_destroy( cache );
+    }
+
+    /* Solver populates and uses the cache */
+    size_t frame_cnt =  aa_rx_sg_frame_count(sg);
+    size_t config_cnt =  aa_rx_sg_config_count(sg);
+    aa_rx_frame_id id_ee = aa_rx_sg_frame_id(sg,"ee");
+    struct aa_rx_sg_sub *ssg = aa_rx_sg_chain_create( sg, AA_RX_FRAME_ROOT, id_ee );
+    size_t n_sq = aa_rx_sg_sub_config_count(ssg);
+
+    struct aa_rx_ik_cache *cache = aa_rx_ik_cache_create( n_sq, 64 );
+    struct aa_rx_ksol_opts *opts = aa_rx_ksol_opts_create();
+    aa_rx_ksol_opts_center_seed( opts, ssg );
+    aa_rx_ksol_opts_center_configs( opts, ssg, .1 );
+    aa_rx_ksol_opts_set_ik_method( opts, AA_RX_IK_LM );
+    aa_rx_ksol_opts_set_cache( opts, cache );
+    struct aa_rx_ik_jac_cx *ik_cx = aa_rx_ik_jac_cx_create( ssg, opts );
+
+    double q[config_cnt];
+    double TF_rel[7*frame_cnt];
+    double TF_abs[7*frame_cnt];
+    size_t n_ok = 0;
+    for( size_t k = 0; k < 10; k ++ ) {
+        double qs_ref[n_sq];
+        for( size_t i = 0; i < n_sq; i ++ ) {
+            qs_ref[i] = 2*aa_frand() - 1;
+        }
+        AA_MEM_ZERO(q, config_cnt);
+        aa_rx_sg_sub_config_set( ssg, n_sq, qs_ref, config_cnt, q );
+        aa_rx_sg_tf( sg, config_cnt, q, frame_cnt, TF_rel, 7, TF_abs, 7 );
+        double E_ref[7];
+        AA_MEM_CPY( E_ref, TF_abs + 7*id_ee, 7 );
+
+        double qs[n_sq];
+        if( aa_rx_ik_jac_solve( ik_cx, 1, E_ref, 7, n_sq, qs ) ) continue;
+        n_ok++;
+        test( "cache populated", n_ok == aa_rx_ik_cache_count(cache) );
+
+        /* A repeated solve starts at the cached solution */
+        double qs2[n_sq];
+        test( "cache resolve", 0 == aa_rx_ik_jac_solve( ik_cx, 1, E_ref, 7, n_sq, qs2 ) );
+        check_ik_pose( ssg, id_ee, qs2, E_ref );
+        aveq( "cache resolve same", n_sq, qs, qs2, 1e-6 );
+    }
+
+    aa_rx_ik_jac_cx_destroy( ik_cx );
+    aa_rx_ksol_opts_destroy( opts );
+    aa_rx_ik_cache_destroy( cache );
+    aa_rx_sg_sub_destroy(ssg);
+}
+
+static void check_reach_map( struct aa_rx_sg *sg )
+{
+    size_t frame_cnt =  aa_rx_sg_frame_count(sg);
+    size_t config_cnt =  aa_rx_sg_config_count(sg);
+    aa_rx_frame_id id_ee = aa_rx_sg_frame_id(sg,"ee");
+    struct aa_rx_sg_sub *ssg = aa_rx_sg_chain_create( sg, AA_RX_FRAME_ROOT, id_ee );
+    size_t n_sq = aa_rx_sg_sub_config_count(ssg);
+
+    double min[3] = {-2.6, -2.6, -2.6};
+    double max[3] = {2.6, 2.6, 2.6};
+    struct aa_rx_reach_map *map = aa_rx_reach_map_create( min, max, .25, 1 );
+    test( "reach frame none", AA_RX_FRAME_NONE == aa_rx_reach_map_frame(map) );
+
+    double q[config_cnt];
+    AA_MEM_ZERO(q, config_cnt);
+    test( "reach sample",
+          0 == aa_rx_reach_map_sample( map, ssg, config_cnt, q, 2, 50000 ) );
+    test( "reach frame", id_ee == aa_rx_reach_map_frame(map) );
+
+    /* Poses of random configurations are mostly in reached cells */
+    double TF_rel[7*frame_cnt];
+    double TF_abs[7*frame_cnt];
+    size_t n_hit = 0, n = 200;
+    for( size_t k = 0; k < n; k ++ ) {
+        double qs[n_sq];
+        for( size_t i = 0; i < n_sq; i ++ ) {
+            qs[i] = M_PI*(2*aa_frand() - 1);
+        }
+        aa_rx_sg_sub_config_set( ssg, n_sq, qs, config_cnt, q );
+        aa_rx_sg_tf( sg, config_cnt, q, frame_cnt, TF_rel, 7, TF_abs, 7 );
+        const double *E = TF_abs + 7*id_ee;
+        if( aa_rx_reach_map_reachable(map, E) ) {
+            n_hit++;
+            test( "reach manip", aa_rx_reach_map_manip(map, E) >= 0 );
+            double x = aa_rx_reach_map_index(map, E + AA_TF_QUTR_T);
+            test( "reach index", x > 0 && x <= 1 );
+        }
+    }
+    test( "reach coverage", n_hit > 9*n/10 );
+
+    /* Out of reach, and outside the grid */
+    {
+        double E_far[7] = {0,0,0,1, 2.5, 2.5, -2.5};
+        double E_out[7] = {0,0,0,1, 5, 0, 0};
+        test( "reach far", !aa_rx_reach_map_reachable(map, E_far) );
+        test( "reach outside", !aa_rx_reach_map_reachable(map, E_out) );
+        test( "reach outside manip", -1 == aa_rx_reach_map_manip(map, E_out) );
+        test( "reach outside index", 0 == aa_rx_reach_map_index(map, E_out + AA_TF_QUTR_T) );
+    }
+
+    /* The same seed and thread count reproduce the map */
+    {
+        struct aa_rx_reach_map *m1 = aa_rx_reach_map_create( min, max, .5, 1 );
+        struct aa_rx_reach_map *m2 = aa_rx_reach_map_create( min, max, .5, 1 );
+        aa_rx_reach_map_set_seed( m1, 42 );
+        aa_rx_reach_map_set_seed( m2, 42 );
+        AA_MEM_ZERO(q, config_cnt);
+        aa_rx_reach_map_sample( m1, ssg, config_cnt, q, 3, 3000 );
+        aa_rx_reach_map_sample( m2, ssg, config_cnt, q, 3, 3000 );
+        size_t n_same = 0;
+        for( size_t k = 0; k < 100; k ++ ) {
+            double E[7];
+            aa_tf_qutr_rand( E );
+            for( size_t i = 0; i < 3; i ++ ) E[AA_TF_QUTR_T+i] *= 2;
+            n_same += aa_rx_reach_map_manip(m1, E) == aa_rx_reach_map_manip(m2, E);
+        }
+        test( "reach seed", 100 == n_same );
+        aa_rx_reach_map_destroy( m1 );
+        aa_rx_reach_map_destroy( m2 );
+    }
+
+    /* Persistence */
+    FILE *f = tmpfile();
+    test( "reach write", 0 == aa_rx_reach_map_write(map, f) );
+    rewind(f);
+    struct aa_rx_reach_map *map2 = aa_rx_reach_map_read( f );
+    fclose(f);
+    test( "reach read", NULL != map2 );
+    for( size_t k = 0; map2 && k < 100; k ++ ) {
+        double E[7];
+        aa_tf_qutr_rand( E );
+        for( size_t i = 0; i < 3; i ++ ) E[AA_TF_QUTR_T+i] *= 2;
+        test( "reach read query",
+              aa_rx_reach_map_manip(map, E) == aa_rx_reach_map_manip(map2, E) );
+    }
+    test( "reach read frame", map2 && id_ee == aa_rx_reach_map_frame(map2) );
+
+    aa_rx_reach_map_destroy( map2 );
+    aa_rx_reach_map_destroy( map );
+    aa_rx_sg_sub_destroy(ssg);
+}
+
+static void check_ik_servo( struct aa_rx_sg *sg )
+{
+    size_t frame_cnt =  aa_rx_sg_frame_count(sg);
+    size_t config_cnt =  aa_rx_sg_config_count(sg);
+    aa_rx_frame_id id_ee = aa_rx_sg_frame_id(sg,"ee");
+    struct aa_rx_sg_sub *ssg = aa_rx_sg_chain_create( sg, AA_RX_FRAME_ROOT, id_ee );
+    size_t n_sq = aa_rx_sg_sub_config_count(ssg);
+
+    for( int proj = 0; proj < 2; proj ++ ) {
+        struct aa_rx_ksol_opts *opts = aa_rx_ksol_opts_create();
+        if( proj ) aa_rx_ksol_opts_center_configs( opts, ssg, .1 );
+        struct aa_rx_ik_servo *servo = aa_rx_ik_servo_create( ssg, opts );
+        test( "servo create", NULL != servo );
+
+        double q[config_cnt];
+        double TF_rel[7*frame_cnt];
+        double TF_abs[7*frame_cnt];
+        double J[6*n_sq];
+        for( size_t k = 0; k < 20; k ++ ) {
+            double qs[n_sq], E_ref[7], dx_ref[6];
+            for( size_t i = 0; i < n_sq; i ++ ) {
+                qs[i] = 2*aa_frand() - 1;
+            }
+            for( size_t i = 0; i < 6; i ++ ) {
+                dx_ref[i] = aa_frand() - .5;
+            }
+            AA_MEM_ZERO(q, config_cnt);
+            aa_rx_sg_sub_config_set( ssg, n_sq, qs, config_cnt, q );
+            aa_rx_sg_tf( sg, config_cnt, q, frame_cnt, TF_rel, 7, TF_abs, 7 );
+            aa_rx_sg_sub_jacobian( ssg, frame_cnt, TF_abs, 7, J, 6 );
+            const double *E_act = TF_abs + 7*id_ee;
+            aa_tf_qutr_rand( E_ref );
+
+            double dq[n_sq], dq_ref[n_sq];
+            test( "servo step", 0 == aa_rx_ik_servo_step( servo, n_sq, qs, E_ref, dx_ref, dq ) );
+            aveq( "servo pose", 7, aa_rx_ik_servo_pose(servo), E_act, 1e-9 );
+            aa_rx_ik_jac_x2dq( opts, n_sq, qs, E_act, E_ref, dx_ref, J, dq_ref );
+            aveq( "servo dq", n_sq, dq, dq_ref, 1e-6 );
+
+            /* Twist only */
+            aa_rx_ik_servo_step( servo, n_sq, qs, NULL, dx_ref, dq );
+            aa_rx_ik_jac_x2dq( opts, n_sq, qs, E_act, E_act, dx_ref, J, dq_ref );
+            aveq( "servo dq twist", n_sq, dq, dq_ref, 1e-6 );
+        }
+        {
+            double dq_size[n_sq+1];
+            test( "servo size", AA_RX_INVALID_PARAMETER ==
+                  aa_rx_ik_servo_step( servo, n_sq+1, q, NULL, NULL, dq_size ) );
+        }
+
+        aa_rx_ik_servo_destroy( servo );
+        aa_rx_ksol_opts_destroy( opts );
+    }
+    aa_rx_sg_sub_destroy(ssg);
+}
+
+
+static void planar2( struct aa_rx_sg *sg )
+{
+    static const double L[3] = {1, 0, 0};
+    static const double P[3] = {1.624, .887, 0};
+
+    aa_rx_sg_add_frame_revolute( sg, "", "j0", NULL, NULL, NULL, aa_tf_vec_z, 0 );
+    aa_rx_sg_add_frame_revolute( sg, "j0", "j1", NULL, L, NULL, aa_tf_vec_z, 0 );
+    aa_rx_sg_add_frame_fixed( sg, "j1", "tip", NULL, L );
+    aa_rx_sg_add_frame_fixed( sg, "", "obstacle", NULL, P );
+
+    aa_rx_sg_set_limit_pos( sg, "j0", -M_PI, M_PI );
+    aa_rx_sg_set_limit_pos( sg, "j1", -M_PI, M_PI );
+    aa_rx_sg_set_limit_vel( sg, "j0", -1, 1 );
+    aa_rx_sg_set_limit_vel( sg, "j1", -1, 1 );
+    aa_rx_sg_set_limit_acc( sg, "j0", -2, 2 );
+    aa_rx_sg_set_limit_acc( sg, "j1", -2, 2 );
+
+    struct aa_rx_geom_opt *opt = aa_rx_geom_opt_create();
+    aa_rx_geom_attach( sg, "tip", aa_rx_geom_sphere(opt, .1) );
+    aa_rx_geom_attach( sg, "obstacle", aa_rx_geom_sphere(opt, .2) );
+    aa_rx_geom_opt_destroy(opt);
+}
+
+static void check_traj_opt( struct aa_rx_sg *sg )
+{
+    struct aa_mem_region reg;
+    aa_mem_region_init( &reg, 1024*32 );
+
+    aa_rx_frame_id id_tip = aa_rx_sg_frame_id(sg, "tip");
+    aa_rx_frame_id id_obs = aa_rx_sg_frame_id(sg, "obstacle");
+    test( "collision allowed", !aa_rx_sg_is_collision_allowed(sg, id_tip, id_obs) );
+
+    struct aa_rx_sg_sub *ssg = aa_rx_sg_chain_create( sg, AA_RX_FRAME_ROOT, id_tip );
+    size_t n_q = aa_rx_sg_config_count(sg);
+    size_t n_f = aa_rx_sg_frame_count(sg);
+
+    /* The straight path sweeps the tip through the obstacle */
+    double path[4] = {-1, 1,
+                      1, 1};
+    struct aa_ct_seg_list *segs;
+    int r = aa_rx_ct_tjq_opt( &reg, NULL, ssg, NULL, n_q, 2, path, &segs );
+    test( "traj opt status", AA_RX_OK == r );
+
+    double dur = aa_ct_seg_list_duration(segs);
+    test( "traj opt duration", dur > 0 );
+
+    struct aa_ct_state *state = aa_ct_state_alloc( &reg, n_q, 0 );
+    double *q = state->q, TF_rel[7*n_f], TF_abs[7*n_f];
+    aa_ct_seg_list_eval( segs, state, 0 );
+    test( "traj opt start", aa_la_ssd(n_q, q, path) < 1e-6 );
+    aa_ct_seg_list_eval( segs, state, dur );
+    test( "traj opt goal", aa_la_ssd(n_q, q, path+n_q) < 1e-6 );
+
+    /* Tip stays clear of the obstacle */
+    double d_min = INFINITY;
+    for( double t = 0; t <= dur; t += dur/100 ) {
+        aa_ct_seg_list_eval( segs, state, t );
+        aa_rx_sg_tf( sg, n_q, q, n_f, TF_rel, 7, TF_abs, 7 );
+        double d = aa_la_dist( 3,
+                               TF_abs + 7*id_tip + AA_TF_QUTR_T,
+                               TF_abs + 7*id_obs + AA_TF_QUTR_T );
+        d_min = AA_MIN(d, d_min);
+    }
+    test( "traj opt clearance", d_min > .3 );
+
+    /* Threads evaluate the same waypoints */
+    {
+        struct aa_rx_ct_opt_opts *opts = aa_rx_ct_opt_opts_create();
+        struct aa_ct_seg_list *segs1, *segs3;
+        aa_rx_ct_opt_opts_set_threads( opts, 1 );
+        aa_rx_ct_tjq_opt( &reg, opts, ssg, NULL, n_q, 2, path, &segs1 );
+        aa_rx_ct_opt_opts_set_threads( opts, 3 );
+        aa_rx_ct_tjq_opt( &reg, opts, ssg, NULL, n_q, 2, path, &segs3 );
+        double q1[n_q];
+        aa_ct_seg_list_eval( segs1, state, dur/2 );
+        AA_MEM_CPY( q1, q, n_q );
+        aa_ct_seg_list_eval( segs3, state, dur/2 );
+        test( "traj opt threads", aa_la_ssd(n_q, q1, q) < 1e-12 );
+        aa_rx_ct_opt_opts_destroy( opts );
+    }
+
+    /* The tip starts in contact with the obstacle.  Moving away is
+     * fine, but the contact does not excuse the straight path, which
+     * passes through the obstacle after leaving the start. */
+    {
+        double path_away[4] = {-.1416, 1,
+                               -1, 1};
+        double path_through[4] = {-.1416, 1,
+                                  1, 1};
+        struct aa_ct_seg_list *segs_contact;
+        AA_MEM_CPY( q, path_away, n_q );
+        aa_rx_sg_tf( sg, n_q, q, n_f, TF_rel, 7, TF_abs, 7 );
+        test( "traj opt contact start",
+              aa_la_dist( 3,
+                          TF_abs + 7*id_tip + AA_TF_QUTR_T,
+                          TF_abs + 7*id_obs + AA_TF_QUTR_T ) < .3 );
+        test( "traj opt contact away", AA_RX_OK ==
+              aa_rx_ct_tjq_opt( &reg, NULL, ssg, NULL, n_q, 2, path_away, &segs_contact ) );
+        test( "traj opt contact through", AA_RX_NO_SOLUTION ==
+              aa_rx_ct_tjq_opt( &reg, NULL, ssg, NULL, n_q, 2, path_through, &segs_contact ) );
+    }
+
+    /* Output to the local region, which also holds the workspace */
+    {
+        struct aa_mem_region *lreg = aa_mem_region_local_get();
+        void *ptr = aa_mem_region_alloc( lreg, 1 );
+        struct aa_ct_seg_list *segs_l;
+        r = aa_rx_ct_tjq_opt( lreg, NULL, ssg, NULL, n_q, 2, path, &segs_l );
+        test( "traj opt local status", AA_RX_OK == r );
+        double q1[n_q];
+        aa_ct_seg_list_eval( segs, state, dur/2 );
+        AA_MEM_CPY( q1, q, n_q );
+        aa_ct_seg_list_eval( segs_l, state, dur/2 );
+        test( "traj opt local", aa_la_ssd(n_q, q1, q) < 1e-12 );
+        aa_ct_seg_list_destroy( segs_l );
+        aa_mem_region_pop( lreg, ptr );
+    }
+
+    aa_rx_sg_sub_destroy(ssg);
+    aa_mem_region_destroy( &reg );
+}
@@ -143,6 +143,70 @@ void test_cylinder()
     }
 }
 
+void test_moving()
+{
+    struct aa_rx_sg *sg = aa_rx_sg_create();
+    struct aa_rx_geom_opt *opt_cl = aa_rx_geom_opt_create();
+    aa_rx_geom_opt_set_collision(opt_cl, 1);
+
+    double vb[3] = {1,0,0};
+    aa_rx_sg_add_frame_fixed( sg,
+                              "", "a",
+                              aa_tf_quat_ident, aa_tf_vec_ident );
+    aa_rx_sg_add_frame_fixed( sg,
+                              "", "b",
+                              aa_tf_quat_ident, vb );
+
+    double d[3] = {.1, .1, .1};
+    aa_rx_geom_attach( sg, "a", aa_rx_geom_box(opt_cl, d) );
+    aa_rx_geom_attach( sg, "b", aa_rx_geom_box(opt_cl, d) );
+
+    aa_rx_sg_init(sg);
+    aa_rx_sg_cl_init(sg);
+
+    aa_rx_frame_id id_a = aa_rx_sg_frame_id(sg, "a");
+    aa_rx_frame_id id_b = aa_rx_sg_frame_id(sg, "b");
+    size_t n = aa_rx_sg_frame_count(sg);
+    double TF_rel[7*n];
+    double TF_apart[7*n];
+    double TF_a_moved[7*n];
+    double TF_b_moved[7*n];
+    aa_rx_sg_tf(sg, 0, NULL,
+                n,
+                TF_rel, 7,
+                TF_apart, 7 );
+    AA_MEM_CPY( TF_a_moved, TF_apart, 7*n );
+    AA_MEM_CPY( TF_b_moved, TF_apart, 7*n );
+    TF_a_moved[7*id_a + AA_TF_QUTR_TX] = 1;
+    TF_b_moved[7*id_b + AA_TF_QUTR_TX] = 0;
+
+    struct aa_rx_cl *cl = aa_rx_cl_create(sg);
+
+    /* By default, every check poses all geometry */
+    assert( !aa_rx_cl_check( cl, n, TF_apart, 7, NULL ) );
+    assert( aa_rx_cl_check( cl, n, TF_b_moved, 7, NULL ) );
+    assert( aa_rx_cl_check( cl, n, TF_a_moved, 7, NULL ) );
+
+    /* Only a is re-posed after the first check */
+    aa_rx_cl_set_moving( cl, 1, &id_a );
+    assert( !aa_rx_cl_check( cl, n, TF_apart, 7, NULL ) );
+    assert( !aa_rx_cl_check( cl, n, TF_b_moved, 7, NULL ) );
+    assert( aa_rx_cl_check( cl, n, TF_a_moved, 7, NULL ) );
+    assert( !aa_rx_cl_check( cl, n, TF_apart, 7, NULL ) );
+
+    /* Setting the moving frames again poses b once */
+    aa_rx_cl_set_moving( cl, 1, &id_a );
+    assert( aa_rx_cl_check( cl, n, TF_b_moved, 7, NULL ) );
+
+    /* Back to the default */
+    aa_rx_cl_set_moving( cl, 0, NULL );
+    assert( !aa_rx_cl_check( cl, n, TF_apart, 7, NULL ) );
+    assert( aa_rx_cl_check( cl, n, TF_b_moved, 7, NULL ) );
+
+    aa_rx_cl_destroy(cl);
+    aa_rx_geom_opt_destroy(opt_cl);
+    aa_rx_sg_destroy(sg);
+}
 
 int main( int argc, char **argv)
 {
@@ -150,6 +214,7 @@ int main( int argc, char **argv)
     aa_rx_cl_init();
     test_box();
     test_cylinder();
+    test_moving();
 
     return 0;
 }
@@ -45,6 +45,7 @@
 #include "amino.h"
 #include "amino/test.h"
 #include "amino/opt/lp.h"
+#include "amino/opt/qp.h"
 #include <assert.h>
 #include <stdio.h>
 #include <unistd.h>
@@ -83,10 +84,50 @@ void helper( const char *name, aa_opt_gmcreate_fun fun) {
     aafeq( name, xref[0] + xref[1], x[0]+x[1], 1e-3 );
 }
 
+/* Check the KKT conditions of random box QPs */
+static void qp_box( void )
+{
+    for( size_t n = 1; n <= 10; n ++ ) {
+        for( size_t k = 0; k < 100; k ++ ) {
+            double R[n*n], D[n*n], c[n], l[n], u[n], x[n];
+            for( size_t i = 0; i < n*n; i ++ ) R[i] = 2*aa_frand() - 1;
+            for( size_t i = 0; i < n; i ++ ) {
+                c[i] = 4*aa_frand() - 2;
+                l[i] = -aa_frand();
+                u[i] = aa_frand();
+            }
+            /* D = R^T R + .1 I */
+            for( size_t j = 0; j < n; j ++ ) {
+                for( size_t i = 0; i < n; i ++ ) {
+                    D[i+n*j] = aa_la_dot( n, R + n*i, R + n*j ) + (i==j ? .1 : 0);
+                }
+            }
+
+            int r = aa_opt_qp_box_dense( n, D, n, c, l, u, x );
+            test( "qp_box result", 0 == r );
+
+            for( size_t i = 0; i < n; i ++ ) {
+                double g = c[i];
+                for( size_t j = 0; j < n; j ++ ) g += D[i+n*j]*x[j];
+                test( "qp_box feasible", l[i] <= x[i] && x[i] <= u[i] );
+                if( x[i] <= l[i] ) {
+                    test( "qp_box lower", g >= -1e-9 );
+                } else if( x[i] >= u[i] ) {
+                    test( "qp_box upper", g <= 1e-9 );
+                } else {
+                    test( "qp_box interior", fabs(g) < 1e-9 );
+                }
+            }
+        }
+    }
+}
+
 int main( int argc, char **argv ) {
     (void) argc; (void) argv;
 
 
+    qp_box();
+
 #ifdef HAVE_LPSOLVE
     helper("LP Solve", aa_opt_lpsolve_gmcreate);
 #endif